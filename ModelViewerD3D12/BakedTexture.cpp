@@ -0,0 +1,232 @@
+#include "BakedTexture.h"
+
+#include <fstream>
+#include <cstring>
+
+#include <d3d12.h>
+
+#include "MipGeneration.h"
+
+namespace
+{
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+BakedTexture::~BakedTexture()
+{
+	Close();
+}
+
+bool BakedTexture::ParseContents(std::uint64_t sourceHash)
+{
+	if (mappedSize < sizeof(FileHeader))
+		return false;
+
+	memcpy(&fileHeader, mappedData, sizeof(FileHeader));
+	if (fileHeader.magic != CACHE_MAGIC || fileHeader.version != CACHE_VERSION ||
+		fileHeader.sourceHash != sourceHash || fileHeader.texelSize == 0 ||
+		fileHeader.width == 0 || fileHeader.height == 0)
+	{
+		return false;
+	}
+
+	// Only complete chains are baked, the viewer always creates those
+	std::vector<UINT> rows;
+	std::vector<UINT64> rowSizes;
+	CalculateMipChainLayout(fileHeader.width, fileHeader.height,
+		static_cast<std::uint8_t>(fileHeader.texelSize), rows, rowSizes);
+	if (fileHeader.nrOfMipLevels != rows.size())
+		return false;
+
+	size_t headersEnd = sizeof(FileHeader) +
+		static_cast<size_t>(fileHeader.nrOfMipLevels) * sizeof(MipHeader);
+	if (headersEnd > mappedSize)
+		return false;
+
+	mipHeaders.resize(fileHeader.nrOfMipLevels);
+	memcpy(mipHeaders.data(), mappedData + sizeof(FileHeader),
+		mipHeaders.size() * sizeof(MipHeader));
+
+	for (size_t i = 0; i < mipHeaders.size(); ++i)
+	{
+		const MipHeader& header = mipHeaders[i];
+		size_t byteSize = static_cast<size_t>(header.rows) * header.rowSize;
+		if (header.rows != rows[i] || header.rowSize != rowSizes[i] ||
+			header.offset % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT != 0 ||
+			header.offset > mappedSize || byteSize > mappedSize - header.offset)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool BakedTexture::Open(const std::string& bakedPath, std::uint64_t sourceHash)
+{
+	Close();
+
+	fileHandle = CreateFileA(bakedPath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY,
+		0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mappedData = static_cast<const unsigned char*>(
+		MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+	if (mappedData == nullptr || !ParseContents(sourceHash))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void BakedTexture::Close()
+{
+	mipHeaders.clear();
+	fileHeader = FileHeader();
+
+	if (mappedData != nullptr)
+		UnmapViewOfFile(mappedData);
+
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+
+unsigned int BakedTexture::GetWidth() const
+{
+	return fileHeader.width;
+}
+
+unsigned int BakedTexture::GetHeight() const
+{
+	return fileHeader.height;
+}
+
+unsigned int BakedTexture::GetNrOfMipLevels() const
+{
+	return static_cast<unsigned int>(mipHeaders.size());
+}
+
+DXGI_FORMAT BakedTexture::GetFormat() const
+{
+	return static_cast<DXGI_FORMAT>(fileHeader.format);
+}
+
+std::uint8_t BakedTexture::GetTexelSize() const
+{
+	return static_cast<std::uint8_t>(fileHeader.texelSize);
+}
+
+size_t BakedTexture::GetMipByteSize(unsigned int mipLevel) const
+{
+	const MipHeader& header = mipHeaders[mipLevel];
+	return static_cast<size_t>(header.rows) * header.rowSize;
+}
+
+size_t BakedTexture::GetTotalByteSize() const
+{
+	size_t toReturn = 0;
+	for (unsigned int i = 0; i < GetNrOfMipLevels(); ++i)
+		toReturn += GetMipByteSize(i);
+
+	return toReturn;
+}
+
+const void* BakedTexture::GetMipData(unsigned int mipLevel) const
+{
+	return mappedData + mipHeaders[mipLevel].offset;
+}
+
+std::string BakedTexture::GetBakedPath(const std::string& sourcePath)
+{
+	return sourcePath + ".bakedtexture";
+}
+
+bool BakedTexture::Write(const std::string& bakedPath, std::uint64_t sourceHash,
+	unsigned int width, unsigned int height, DXGI_FORMAT format,
+	std::uint8_t texelSize, const unsigned char* data)
+{
+	std::vector<UINT> rows;
+	std::vector<UINT64> rowSizes;
+	CalculateMipChainLayout(width, height, texelSize, rows, rowSizes);
+
+	FileHeader header;
+	header.sourceHash = sourceHash;
+	header.width = width;
+	header.height = height;
+	header.nrOfMipLevels = static_cast<std::uint32_t>(rows.size());
+	header.format = format;
+	header.texelSize = texelSize;
+
+	std::vector<MipHeader> mips(rows.size());
+	size_t offset = sizeof(FileHeader) + mips.size() * sizeof(MipHeader);
+	unsigned int mipWidth = width;
+	unsigned int mipHeight = height;
+	for (size_t i = 0; i < mips.size(); ++i)
+	{
+		offset = AlignUp(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+		mips[i].offset = offset;
+		mips[i].width = mipWidth;
+		mips[i].height = mipHeight;
+		mips[i].rows = rows[i];
+		mips[i].rowSize = static_cast<std::uint32_t>(rowSizes[i]);
+		mips[i].rowPitch = static_cast<std::uint32_t>(
+			AlignUp(static_cast<size_t>(rowSizes[i]),
+				D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+
+		offset += static_cast<size_t>(rows[i]) * rowSizes[i];
+		mipWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+		mipHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+	}
+
+	std::vector<unsigned char> output(offset, 0);
+	memcpy(output.data(), &header, sizeof(FileHeader));
+	memcpy(output.data() + sizeof(FileHeader), mips.data(),
+		mips.size() * sizeof(MipHeader));
+
+	size_t sourceOffset = 0;
+	for (size_t i = 0; i < mips.size(); ++i)
+	{
+		size_t byteSize = static_cast<size_t>(rows[i]) * rowSizes[i];
+		memcpy(output.data() + mips[i].offset, data + sourceOffset, byteSize);
+		sourceOffset += byteSize;
+	}
+
+	std::ofstream file(bakedPath, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(output.data()),
+		static_cast<std::streamsize>(output.size()));
+
+	return static_cast<bool>(file);
+}
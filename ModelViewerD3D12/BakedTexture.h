@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <Windows.h>
+#include <dxgiformat.h>
+
+// Read only view of a baked texture with its full mip chain. Every mip starts
+// at the D3D12 subresource placement alignment and its header holds the
+// footprint GetCopyableFootprints gives for it. The rows themselves are stored
+// at their row size, as that is what SetUpdateData takes, so each level can
+// be handed to the texture component straight from the mapped file.
+class BakedTexture
+{
+private:
+	static const std::uint32_t CACHE_MAGIC = 0x5845544e; // "NTEX"
+	static const std::uint32_t CACHE_VERSION = 3; // Bumped when the mip filter changes
+
+	struct FileHeader
+	{
+		std::uint32_t magic = CACHE_MAGIC;
+		std::uint32_t version = CACHE_VERSION;
+		std::uint64_t sourceHash = 0;
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::uint32_t nrOfMipLevels = 0;
+		std::uint32_t format = DXGI_FORMAT_UNKNOWN;
+		std::uint32_t texelSize = 0;
+		std::uint32_t padding = 0;
+	};
+
+	// The offset is from the start of the file
+	struct MipHeader
+	{
+		std::uint64_t offset = 0;
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::uint32_t rows = 0;
+		std::uint32_t rowSize = 0;
+		std::uint32_t rowPitch = 0;
+		std::uint32_t padding = 0;
+	};
+
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = nullptr;
+	const unsigned char* mappedData = nullptr;
+	size_t mappedSize = 0;
+
+	FileHeader fileHeader;
+	std::vector<MipHeader> mipHeaders;
+
+	bool ParseContents(std::uint64_t sourceHash);
+
+public:
+	BakedTexture() = default;
+	~BakedTexture();
+	BakedTexture(const BakedTexture& other) = delete;
+	BakedTexture& operator=(const BakedTexture& other) = delete;
+	BakedTexture(BakedTexture&& other) = delete;
+	BakedTexture& operator=(BakedTexture&& other) = delete;
+
+	bool Open(const std::string& bakedPath, std::uint64_t sourceHash);
+	void Close();
+
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	unsigned int GetNrOfMipLevels() const;
+	DXGI_FORMAT GetFormat() const;
+	std::uint8_t GetTexelSize() const;
+	size_t GetMipByteSize(unsigned int mipLevel) const;
+	size_t GetTotalByteSize() const; // Of the texels of every level
+	const void* GetMipData(unsigned int mipLevel) const;
+
+	static std::string GetBakedPath(const std::string& sourcePath);
+
+	// The levels are stored back to back in data, as laid out by
+	// CalculateMipChainLayout, and the chain has to be complete
+	static bool Write(const std::string& bakedPath, std::uint64_t sourceHash,
+		unsigned int width, unsigned int height, DXGI_FORMAT format,
+		std::uint8_t texelSize, const unsigned char* data);
+};
@@ -0,0 +1,288 @@
+#include "FloatPacking.h"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include <immintrin.h>
+
+namespace
+{
+	const std::uint32_t FLOAT_INFINITY = 0x7F800000;
+	const std::uint32_t MAGNITUDE_MASK = 0x7FFFFFFF;
+
+	// 2^16, past the largest finite value of every format here
+	const std::uint32_t OVERFLOW_MAGNITUDE = 143u << 23;
+
+	// 2^-14, the smallest normal value of every format here
+	const std::uint32_t MIN_NORMAL_MAGNITUDE = 113u << 23;
+
+	const unsigned int HALF_MANTISSA_BITS = 10;
+	const unsigned int R11_MANTISSA_BITS = 6;
+	const unsigned int B10_MANTISSA_BITS = 5;
+
+	std::uint32_t AsBits(float value)
+	{
+		std::uint32_t toReturn;
+		memcpy(&toReturn, &value, sizeof(toReturn));
+		return toReturn;
+	}
+
+	float AsFloat(std::uint32_t bits)
+	{
+		float toReturn;
+		memcpy(&toReturn, &bits, sizeof(toReturn));
+		return toReturn;
+	}
+
+	// The magnitude is the bits of a non-negative float below infinity and
+	// the exponent bias is 15, as in every format here. Values that round past
+	// the largest finite value give the all ones exponent and a zero mantissa.
+	std::uint32_t RoundToSmallFloat(std::uint32_t magnitude,
+		unsigned int mantissaBits)
+	{
+		unsigned int shift = 23 - mantissaBits;
+		if (magnitude >= OVERFLOW_MAGNITUDE)
+			return 31u << mantissaBits;
+
+		if (magnitude < MIN_NORMAL_MAGNITUDE)
+		{
+			// The last place of the magic value is the smallest denormal of the
+			// format, so the addition itself rounds to nearest even
+			std::uint32_t magic = (136u - mantissaBits) << 23;
+			return AsBits(AsFloat(magnitude) + AsFloat(magic)) - magic;
+		}
+
+		std::uint32_t odd = (magnitude >> shift) & 1;
+		return (magnitude - (112u << 23) + (1u << (shift - 1)) - 1 + odd) >>
+			shift;
+	}
+
+	// NaNs are made quiet and keep the upper bits of their payload
+	std::uint16_t PackHalf(float value)
+	{
+		std::uint32_t bits = AsBits(value);
+		std::uint32_t sign = (bits >> 16) & 0x8000;
+		std::uint32_t magnitude = bits & MAGNITUDE_MASK;
+		if (magnitude > FLOAT_INFINITY)
+		{
+			return static_cast<std::uint16_t>(sign | 0x7E00 |
+				((magnitude >> 13) & 0x3FF));
+		}
+
+		return static_cast<std::uint16_t>(sign |
+			RoundToSmallFloat(magnitude, HALF_MANTISSA_BITS));
+	}
+
+	std::uint32_t PackUnsignedSmallFloat(float value, unsigned int mantissaBits)
+	{
+		std::uint32_t bits = AsBits(value);
+		std::uint32_t magnitude = bits & MAGNITUDE_MASK;
+		std::uint32_t infinity = 31u << mantissaBits;
+		if (magnitude > FLOAT_INFINITY)
+			return infinity | (1u << (mantissaBits - 1));
+		else if ((bits >> 31) != 0)
+			return 0;
+		else if (magnitude == FLOAT_INFINITY)
+			return infinity;
+
+		return std::min(RoundToSmallFloat(magnitude, mantissaBits),
+			infinity - 1);
+	}
+
+	float UnpackSmallFloat(std::uint32_t value, unsigned int mantissaBits)
+	{
+		std::uint32_t exponent = value >> mantissaBits;
+		std::uint32_t mantissa = value & ((1u << mantissaBits) - 1);
+		if (exponent == 0)
+		{
+			return std::ldexp(static_cast<float>(mantissa),
+				-14 - static_cast<int>(mantissaBits));
+		}
+		else if (exponent == 31)
+		{
+			return mantissa == 0 ? std::numeric_limits<float>::infinity() :
+				std::numeric_limits<float>::quiet_NaN();
+		}
+
+		return AsFloat(((exponent + 112) << 23) |
+			(mantissa << (23 - mantissaBits)));
+	}
+
+	__m128i Select(__m128i mask, __m128i ifSet, __m128i ifClear)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, ifSet),
+			_mm_andnot_si128(mask, ifClear));
+	}
+
+	// Same as the scalar RoundToSmallFloat for four magnitudes
+	// Texels are rarely outside the normal range, so the other cases are only
+	// handled when a lane needs them
+	template<unsigned int MantissaBits>
+	__m128i RoundToSmallFloat(__m128i magnitude)
+	{
+		const int SHIFT = 23 - MantissaBits;
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(magnitude, SHIFT),
+			_mm_set1_epi32(1));
+		__m128i bias = _mm_set1_epi32((1 << (SHIFT - 1)) - 1 - (112 << 23));
+		__m128i toReturn = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(magnitude,
+			bias), odd), SHIFT);
+
+		__m128i isDenormal = _mm_cmplt_epi32(magnitude,
+			_mm_set1_epi32(MIN_NORMAL_MAGNITUDE));
+		__m128i isOverflow = _mm_cmpgt_epi32(magnitude,
+			_mm_set1_epi32(OVERFLOW_MAGNITUDE - 1));
+		if (_mm_movemask_epi8(_mm_or_si128(isDenormal, isOverflow)) == 0)
+			return toReturn;
+
+		__m128i magic = _mm_set1_epi32((136 - MantissaBits) << 23);
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(
+			_mm_castsi128_ps(magnitude), _mm_castsi128_ps(magic))), magic);
+		return Select(isOverflow, _mm_set1_epi32(31 << MantissaBits),
+			Select(isDenormal, denormal, toReturn));
+	}
+
+	// The halves are in the low 16 bits of each lane
+	__m128i PackHalvesSse(__m128 values)
+	{
+		__m128i bits = _mm_castps_si128(values);
+		__m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16),
+			_mm_set1_epi32(0x8000));
+		__m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(MAGNITUDE_MASK));
+
+		__m128i nan = _mm_or_si128(_mm_set1_epi32(0x7E00), _mm_and_si128(
+			_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(0x3FF)));
+		__m128i isNan = _mm_cmpgt_epi32(magnitude,
+			_mm_set1_epi32(FLOAT_INFINITY));
+		return _mm_or_si128(sign, Select(isNan, nan,
+			RoundToSmallFloat<HALF_MANTISSA_BITS>(magnitude)));
+	}
+
+	// Same as the scalar PackUnsignedSmallFloat for four values
+	template<unsigned int MantissaBits>
+	__m128i PackUnsignedSmallFloats(__m128 values)
+	{
+		__m128i bits = _mm_castps_si128(values);
+		__m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(MAGNITUDE_MASK));
+		__m128i infinity = _mm_set1_epi32(31 << MantissaBits);
+		__m128i maxFinite = _mm_set1_epi32((31 << MantissaBits) - 1);
+
+		__m128i rounded = RoundToSmallFloat<MantissaBits>(magnitude);
+		rounded = Select(_mm_cmpgt_epi32(rounded, maxFinite), maxFinite, rounded);
+		rounded = Select(_mm_cmpeq_epi32(magnitude,
+			_mm_set1_epi32(FLOAT_INFINITY)), infinity, rounded);
+		rounded = _mm_andnot_si128(_mm_srai_epi32(bits, 31), rounded);
+
+		__m128i nan = _mm_or_si128(infinity,
+			_mm_set1_epi32(1 << (MantissaBits - 1)));
+		__m128i isNan = _mm_cmpgt_epi32(magnitude,
+			_mm_set1_epi32(FLOAT_INFINITY));
+		return Select(isNan, nan, rounded);
+	}
+
+	// F16C came with AVX2 on every processor that has it. Returns the number
+	// of values packed, the rest are left for the narrower paths.
+	size_t PackHalvesAvx2(const float* source, size_t nrOfValues,
+		std::uint16_t* toFill)
+	{
+		size_t nrOfPacked = nrOfValues - nrOfValues % 8;
+		for (size_t i = 0; i < nrOfPacked; i += 8)
+		{
+			__m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + i),
+				_MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(toFill + i), halves);
+		}
+
+		return nrOfPacked;
+	}
+
+	size_t PackHalvesSse(const float* source, size_t nrOfValues,
+		std::uint16_t* toFill)
+	{
+		size_t nrOfPacked = nrOfValues - nrOfValues % 8;
+		for (size_t i = 0; i < nrOfPacked; i += 8)
+		{
+			// The lanes are sign extended so the saturating pack keeps them
+			__m128i low = PackHalvesSse(_mm_loadu_ps(source + i));
+			__m128i high = PackHalvesSse(_mm_loadu_ps(source + i + 4));
+			low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+			high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(toFill + i),
+				_mm_packs_epi32(low, high));
+		}
+
+		return nrOfPacked;
+	}
+
+	// Only halves have an AVX2 path, where F16C packs eight in one instruction
+	size_t PackR11G11B10Sse(const float* source, size_t nrOfTexels,
+		std::uint32_t* toFill)
+	{
+		size_t nrOfPacked = nrOfTexels - nrOfTexels % 4;
+		for (size_t i = 0; i < nrOfPacked; i += 4)
+		{
+			__m128 red = _mm_loadu_ps(source + i * 4);
+			__m128 green = _mm_loadu_ps(source + i * 4 + 4);
+			__m128 blue = _mm_loadu_ps(source + i * 4 + 8);
+			__m128 alpha = _mm_loadu_ps(source + i * 4 + 12);
+			_MM_TRANSPOSE4_PS(red, green, blue, alpha);
+
+			__m128i packed = _mm_or_si128(
+				PackUnsignedSmallFloats<R11_MANTISSA_BITS>(red),
+				_mm_slli_epi32(PackUnsignedSmallFloats<R11_MANTISSA_BITS>(green),
+					11));
+			packed = _mm_or_si128(packed, _mm_slli_epi32(
+				PackUnsignedSmallFloats<B10_MANTISSA_BITS>(blue), 22));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(toFill + i), packed);
+		}
+
+		return nrOfPacked;
+	}
+}
+
+void PackHalfStream(const float* source, size_t nrOfValues,
+	std::uint16_t* toFill, InstructionSet instructionSet)
+{
+	size_t packed = 0;
+	if (instructionSet == InstructionSet::AVX2)
+		packed = PackHalvesAvx2(source, nrOfValues, toFill);
+
+	if (instructionSet != InstructionSet::SCALAR)
+	{
+		packed += PackHalvesSse(source + packed, nrOfValues - packed,
+			toFill + packed);
+	}
+
+	for (size_t i = packed; i < nrOfValues; ++i)
+		toFill[i] = PackHalf(source[i]);
+}
+
+void PackR11G11B10Stream(const float* source, size_t nrOfTexels,
+	std::uint32_t* toFill, InstructionSet instructionSet)
+{
+	size_t packed = 0;
+	if (instructionSet != InstructionSet::SCALAR)
+		packed = PackR11G11B10Sse(source, nrOfTexels, toFill);
+
+	for (size_t i = packed; i < nrOfTexels; ++i)
+	{
+		const float* texel = source + i * 4;
+		toFill[i] = PackUnsignedSmallFloat(texel[0], R11_MANTISSA_BITS) |
+			(PackUnsignedSmallFloat(texel[1], R11_MANTISSA_BITS) << 11) |
+			(PackUnsignedSmallFloat(texel[2], B10_MANTISSA_BITS) << 22);
+	}
+}
+
+float UnpackHalf(std::uint16_t value)
+{
+	float magnitude = UnpackSmallFloat(value & 0x7FFFu, HALF_MANTISSA_BITS);
+	return (value & 0x8000u) != 0 ? -magnitude : magnitude;
+}
+
+void UnpackR11G11B10(std::uint32_t value, float* toFill)
+{
+	toFill[0] = UnpackSmallFloat(value & 0x7FF, R11_MANTISSA_BITS);
+	toFill[1] = UnpackSmallFloat((value >> 11) & 0x7FF, R11_MANTISSA_BITS);
+	toFill[2] = UnpackSmallFloat(value >> 22, B10_MANTISSA_BITS);
+}
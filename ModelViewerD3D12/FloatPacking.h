@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "VertexConversion.h"
+
+// Conversions of float texels to the formats HDR textures are uploaded in.
+// Every value is rounded to nearest even and every instruction set gives bit
+// identical results.
+
+// IEEE half precision floats, as R16G16B16A16_FLOAT stores them. Values too
+// large for a half become infinities and NaNs stay NaNs, the same as the
+// F16C instructions give.
+void PackHalfStream(const float* source, size_t nrOfValues,
+	std::uint16_t* toFill,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
+
+// RGBA texels to R11G11B10_FLOAT, with alpha dropped. The formats have no
+// sign, so negative values become 0, and finite values too large for them
+// become the largest finite value rather than infinity.
+void PackR11G11B10Stream(const float* source, size_t nrOfTexels,
+	std::uint32_t* toFill,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
+
+float UnpackHalf(std::uint16_t value);
+
+// Writes the red, green and blue of the texel
+void UnpackR11G11B10(std::uint32_t value, float* toFill);
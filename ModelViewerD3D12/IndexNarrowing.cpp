@@ -0,0 +1,46 @@
+#include "IndexNarrowing.h"
+
+bool CanUseShortIndices(const SubMeshStreams& streams)
+{
+	return streams.nrOfVertices <= MAX_SHORT_INDEX_VERTICES;
+}
+
+void NarrowIndices(const SubMeshStreams& streams,
+	std::vector<std::uint16_t>& toFill)
+{
+	unsigned int nrOfIndices = streams.GetTotalNrOfIndices();
+	toFill.resize(nrOfIndices + nrOfIndices % 2);
+
+	for (unsigned int i = 0; i < nrOfIndices; ++i)
+		toFill[i] = static_cast<std::uint16_t>(streams.indices[i]);
+
+	if (nrOfIndices % 2 != 0)
+		toFill.back() = 0;
+}
+
+bool ValidateShortIndices(const SubMeshStreams& streams,
+	const std::vector<std::uint16_t>& narrowed)
+{
+	unsigned int nrOfIndices = streams.GetTotalNrOfIndices();
+	if (narrowed.size() != nrOfIndices + nrOfIndices % 2)
+		return false;
+
+	for (unsigned int i = 0; i < nrOfIndices; ++i)
+	{
+		if (static_cast<unsigned int>(narrowed[i]) != streams.indices[i])
+			return false;
+	}
+
+	return true;
+}
+
+size_t GetShortIndexBytesSaved(const SubMeshStreams& streams)
+{
+	if (!CanUseShortIndices(streams))
+		return 0;
+
+	size_t nrOfIndices = streams.GetTotalNrOfIndices();
+	size_t narrowedBytes = (nrOfIndices + nrOfIndices % 2) *
+		sizeof(std::uint16_t);
+	return nrOfIndices * sizeof(unsigned int) - narrowedBytes;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "SubMeshData.h"
+
+// Sub meshes with at most this many vertices can address every vertex with a
+// 16 bit index
+const unsigned int MAX_SHORT_INDEX_VERTICES = 65536;
+
+bool CanUseShortIndices(const SubMeshStreams& streams);
+
+// Copies the indices of every level of detail of the sub mesh into 16 bit
+// indices. The result is padded to an even count with a zero index, so it can
+// be uploaded as 32 bit elements that each hold two indices, the first one in
+// the low half.
+void NarrowIndices(const SubMeshStreams& streams,
+	std::vector<std::uint16_t>& toFill);
+
+// Checks that every narrowed index widens back to its source index
+bool ValidateShortIndices(const SubMeshStreams& streams,
+	const std::vector<std::uint16_t>& narrowed);
+
+// Bytes saved on the GPU by storing the sub mesh with 16 bit indices
+size_t GetShortIndexBytesSaved(const SubMeshStreams& streams);
\ No newline at end of file
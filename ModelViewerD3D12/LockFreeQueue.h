@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// Bounded queue between exactly one producer thread and one consumer thread.
+// Neither side locks or waits, pushing to a full queue and popping from an
+// empty one fail instead. The capacity is rounded up to a power of two.
+template<typename T>
+class LockFreeQueue
+{
+private:
+	std::vector<T> slots;
+	size_t mask = 0;
+	std::atomic<size_t> head; // Next element to pop, only the consumer writes it
+	std::atomic<size_t> tail; // Next slot to push to, only the producer writes it
+
+public:
+	explicit LockFreeQueue(size_t capacity);
+	~LockFreeQueue() = default;
+	LockFreeQueue(const LockFreeQueue& other) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue& other) = delete;
+	LockFreeQueue(LockFreeQueue&& other) = delete;
+	LockFreeQueue& operator=(LockFreeQueue&& other) = delete;
+
+	// The element is only moved from if the push succeeds
+	bool TryPush(T&& element);
+	bool TryPop(T& toFill);
+
+	size_t GetCapacity() const;
+};
+
+template<typename T>
+inline LockFreeQueue<T>::LockFreeQueue(size_t capacity) : head(0), tail(0)
+{
+	size_t roundedCapacity = 1;
+	while (roundedCapacity < capacity)
+		roundedCapacity *= 2;
+
+	slots.resize(roundedCapacity);
+	mask = roundedCapacity - 1;
+}
+
+template<typename T>
+inline bool LockFreeQueue<T>::TryPush(T&& element)
+{
+	size_t currentTail = tail.load(std::memory_order_relaxed);
+	if (currentTail - head.load(std::memory_order_acquire) == slots.size())
+		return false;
+
+	slots[currentTail & mask] = std::move(element);
+	tail.store(currentTail + 1, std::memory_order_release);
+
+	return true;
+}
+
+template<typename T>
+inline bool LockFreeQueue<T>::TryPop(T& toFill)
+{
+	size_t currentHead = head.load(std::memory_order_relaxed);
+	if (currentHead == tail.load(std::memory_order_acquire))
+		return false;
+
+	// The slot is reset so the queue does not keep popped elements alive
+	T& slot = slots[currentHead & mask];
+	toFill = std::move(slot);
+	slot = T();
+	head.store(currentHead + 1, std::memory_order_release);
+
+	return true;
+}
+
+template<typename T>
+inline size_t LockFreeQueue<T>::GetCapacity() const
+{
+	return slots.size();
+}
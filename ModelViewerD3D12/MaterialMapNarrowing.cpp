@@ -0,0 +1,79 @@
+#include "MaterialMapNarrowing.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "MipGeneration.h"
+
+namespace
+{
+	// Same mapping as the pixel shader, 0 to -1 and 255 to 1
+	float ToSignedComponent(unsigned char value)
+	{
+		return value / 127.5f - 1.0f;
+	}
+}
+
+bool IsGreyscale(const unsigned char* texels, size_t nrOfTexels)
+{
+	for (size_t i = 0; i < nrOfTexels; ++i)
+	{
+		const unsigned char* texel = texels + i * 4;
+		if (texel[0] != texel[1] || texel[0] != texel[2])
+			return false;
+	}
+
+	return true;
+}
+
+bool CanReconstructNormalZ(const unsigned char* texels, size_t nrOfTexels)
+{
+	for (size_t i = 0; i < nrOfTexels; ++i)
+	{
+		const unsigned char* texel = texels + i * 4;
+		float x = ToSignedComponent(texel[0]);
+		float y = ToSignedComponent(texel[1]);
+		float z = std::sqrt(std::max(1.0f - x * x - y * y, 0.0f));
+		if (std::fabs(ToSignedComponent(texel[2]) - z) > NORMAL_Z_TOLERANCE)
+			return false;
+	}
+
+	return true;
+}
+
+// Every texel is written at or before where it was read, so moving forward
+// never overwrites a texel that is still to be read
+void NarrowChannels(unsigned char* texels, size_t nrOfTexels,
+	unsigned int nrOfChannels)
+{
+	for (size_t i = 0; i < nrOfTexels; ++i)
+	{
+		for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+			texels[i * nrOfChannels + channel] = texels[i * 4 + channel];
+	}
+}
+
+DXGI_FORMAT GetNarrowedFormat(unsigned int nrOfChannels)
+{
+	if (nrOfChannels == 1)
+		return DXGI_FORMAT_R8_UNORM;
+	else if (nrOfChannels == 2)
+		return DXGI_FORMAT_R8G8_UNORM;
+
+	return DXGI_FORMAT_R8G8B8A8_UNORM;
+}
+
+size_t GetMipChainByteSize(unsigned int width, unsigned int height,
+	unsigned int texelSize)
+{
+	std::vector<UINT> rows;
+	std::vector<UINT64> rowSizes;
+	CalculateMipChainLayout(width, height, static_cast<std::uint8_t>(texelSize),
+		rows, rowSizes);
+
+	size_t toReturn = 0;
+	for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+		toReturn += static_cast<size_t>(rows[mipLevel] * rowSizes[mipLevel]);
+
+	return toReturn;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include <Windows.h>
+#include <dxgiformat.h>
+
+// Largest difference between the stored z of a normal map texel and the z
+// rebuilt from its x and y, with the components mapped to [-1, 1], for the map
+// to still be stored as x and y only
+const float NORMAL_Z_TOLERANCE = 0.1f;
+
+// True if the red, green and blue channels of every BYTE RGBA texel are equal,
+// alpha is not looked at
+bool IsGreyscale(const unsigned char* texels, size_t nrOfTexels);
+
+// True if every BYTE RGBA texel holds a normal with a z that is rebuilt as
+// sqrt(1 - x * x - y * y) within NORMAL_Z_TOLERANCE, alpha is not looked at
+bool CanReconstructNormalZ(const unsigned char* texels, size_t nrOfTexels);
+
+// Keeps the first nrOfChannels channels of every BYTE RGBA texel, packed in
+// place at the start of the data
+void NarrowChannels(unsigned char* texels, size_t nrOfTexels,
+	unsigned int nrOfChannels);
+
+// R8, R8G8 or R8G8B8A8 UNORM for one, two or four BYTE channels
+DXGI_FORMAT GetNarrowedFormat(unsigned int nrOfChannels);
+
+// Bytes of every level of the full mip chain of an uncompressed texture, rows
+// without pitch padding
+size_t GetMipChainByteSize(unsigned int width, unsigned int height,
+	unsigned int texelSize);
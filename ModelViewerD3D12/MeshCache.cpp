@@ -0,0 +1,497 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const size_t STREAM_ALIGNMENT = 16;
+	const std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+	void HashBytes(const char* bytes, size_t nrOfBytes, std::uint64_t& hash)
+	{
+		for (size_t i = 0; i < nrOfBytes; ++i)
+		{
+			hash ^= static_cast<unsigned char>(bytes[i]);
+			hash *= FNV_PRIME;
+		}
+	}
+
+	// Continues the hash with the contents of the file
+	bool HashFileContents(const std::string& path, std::uint64_t& hash)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		char buffer[64 * 1024];
+		while (file)
+		{
+			file.read(buffer, sizeof(buffer));
+			HashBytes(buffer, static_cast<size_t>(file.gcount()), hash);
+		}
+
+		return true;
+	}
+
+	std::string TrimWhitespace(const std::string& text)
+	{
+		size_t first = text.find_first_not_of(" \t\r\n");
+		if (first == std::string::npos)
+			return "";
+
+		size_t last = text.find_last_not_of(" \t\r\n");
+		return text.substr(first, last - first + 1);
+	}
+
+	// Relative URIs may escape characters as %XX
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string toReturn;
+		for (size_t i = 0; i < uri.size(); ++i)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size() &&
+				std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+				std::isxdigit(static_cast<unsigned char>(uri[i + 2])))
+			{
+				toReturn += static_cast<char>(
+					std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			}
+			else
+			{
+				toReturn += uri[i];
+			}
+		}
+
+		return toReturn;
+	}
+
+	// The importer takes the rest of a mtllib line as one file name
+	void FindObjDependencies(const std::string& path,
+		const std::string& directory, std::vector<std::string>& toFill)
+	{
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			line = TrimWhitespace(line);
+			if (line.compare(0, 6, "mtllib") != 0 || line.size() < 7 ||
+				!std::isspace(static_cast<unsigned char>(line[6])))
+			{
+				continue;
+			}
+
+			std::string name = TrimWhitespace(line.substr(6));
+			if (!name.empty())
+				toFill.push_back(directory + name);
+		}
+	}
+
+	// Only the uris of the buffers array are read, embedded data uris and
+	// images are skipped as the cache only holds geometry and material names
+	void FindGltfDependencies(const std::string& path,
+		const std::string& directory, std::vector<std::string>& toFill)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		std::string json = contents.str();
+
+		size_t buffers = json.find("\"buffers\"");
+		size_t begin = buffers == std::string::npos ? buffers :
+			json.find('[', buffers);
+		if (begin == std::string::npos)
+			return;
+
+		// Strings are skipped so brackets inside them do not count
+		size_t end = begin;
+		int depth = 0;
+		for (; end < json.size(); ++end)
+		{
+			if (json[end] == '"')
+			{
+				for (++end; end < json.size() && json[end] != '"'; ++end)
+				{
+					if (json[end] == '\\')
+						++end;
+				}
+			}
+			else if (json[end] == '[')
+			{
+				++depth;
+			}
+			else if (json[end] == ']' && --depth == 0)
+			{
+				break;
+			}
+		}
+
+		for (size_t key = json.find("\"uri\"", begin); key < end;
+			key = json.find("\"uri\"", key + 5))
+		{
+			size_t open = json.find('"', json.find(':', key + 5));
+			size_t close = open == std::string::npos ? open :
+				json.find('"', open + 1);
+			if (close == std::string::npos)
+				break;
+
+			std::string uri = json.substr(open + 1, close - open - 1);
+			if (uri.compare(0, 5, "data:") != 0)
+				toFill.push_back(directory + DecodeUri(uri));
+		}
+	}
+
+	void AlignOutput(std::vector<unsigned char>& output)
+	{
+		size_t padding = (STREAM_ALIGNMENT - output.size() % STREAM_ALIGNMENT) %
+			STREAM_ALIGNMENT;
+		output.resize(output.size() + padding, 0);
+	}
+
+	template<typename T>
+	std::uint64_t AppendStream(std::vector<unsigned char>& output,
+		const T* stream, size_t nrOfElements)
+	{
+		if (stream == nullptr)
+			return 0;
+
+		AlignOutput(output);
+		std::uint64_t offset = output.size();
+		const unsigned char* bytes =
+			reinterpret_cast<const unsigned char*>(stream);
+		output.insert(output.end(), bytes, bytes + nrOfElements * sizeof(T));
+
+		return offset;
+	}
+
+	std::uint64_t AppendString(std::vector<unsigned char>& output,
+		const char* toAppend)
+	{
+		if (toAppend == nullptr)
+			return 0;
+
+		std::uint64_t offset = output.size();
+		output.insert(output.end(), toAppend, toAppend + strlen(toAppend) + 1);
+
+		return offset;
+	}
+}
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+bool MeshCache::ParseContents(std::uint64_t sourceHash,
+	unsigned int importFlags, std::uint64_t settingsKey)
+{
+	if (mappedSize < sizeof(FileHeader))
+		return false;
+
+	FileHeader fileHeader;
+	memcpy(&fileHeader, mappedData, sizeof(FileHeader));
+
+	if (fileHeader.magic != CACHE_MAGIC || fileHeader.version != CACHE_VERSION ||
+		fileHeader.sourceHash != sourceHash ||
+		fileHeader.importFlags != importFlags ||
+		fileHeader.settingsKey != settingsKey)
+	{
+		return false;
+	}
+
+	size_t headersEnd = sizeof(FileHeader) +
+		static_cast<size_t>(fileHeader.nrOfSubMeshes) * sizeof(SubMeshHeader);
+	if (headersEnd > mappedSize)
+		return false;
+
+	const SubMeshHeader* subMeshHeaders = reinterpret_cast<const SubMeshHeader*>(
+		mappedData + sizeof(FileHeader));
+	subMeshes.resize(fileHeader.nrOfSubMeshes);
+
+	for (std::uint32_t i = 0; i < fileHeader.nrOfSubMeshes; ++i)
+	{
+		const SubMeshHeader& header = subMeshHeaders[i];
+		SubMeshStreams& subMesh = subMeshes[i];
+		size_t vertices = header.nrOfVertices;
+
+		subMesh.nrOfVertices = header.nrOfVertices;
+		subMesh.nrOfIndices = header.nrOfIndices;
+		subMesh.nrOfLevelsOfDetail = header.nrOfLevelsOfDetail;
+		subMesh.positions = static_cast<const XMFLOAT3*>(
+			GetStream(header.positionOffset, vertices * sizeof(XMFLOAT3)));
+		subMesh.uvs = static_cast<const XMFLOAT2*>(
+			GetStream(header.uvOffset, vertices * sizeof(XMFLOAT2)));
+		subMesh.normals = static_cast<const XMFLOAT3*>(
+			GetStream(header.normalOffset, vertices * sizeof(XMFLOAT3)));
+		subMesh.tangents = static_cast<const XMFLOAT4*>(
+			GetStream(header.tangentOffset, vertices * sizeof(XMFLOAT4)));
+		subMesh.bitangents = static_cast<const XMFLOAT3*>(
+			GetStream(header.bitangentOffset, vertices * sizeof(XMFLOAT3)));
+		subMesh.indices = static_cast<const unsigned int*>(GetStream(
+			header.indicesOffset, header.nrOfIndices * sizeof(unsigned int)));
+		subMesh.levelsOfDetail = static_cast<const LevelOfDetail*>(GetStream(
+			header.levelsOfDetailOffset,
+			header.nrOfLevelsOfDetail * sizeof(LevelOfDetail)));
+
+		subMesh.diffuseMap = GetString(header.diffuseMapOffset);
+		subMesh.specularMap = GetString(header.specularMapOffset);
+		subMesh.normalMap = GetString(header.normalMapOffset);
+
+		bool streamMissing =
+			(header.positionOffset != 0 && subMesh.positions == nullptr) ||
+			(header.uvOffset != 0 && subMesh.uvs == nullptr) ||
+			(header.normalOffset != 0 && subMesh.normals == nullptr) ||
+			(header.tangentOffset != 0 && subMesh.tangents == nullptr) ||
+			(header.bitangentOffset != 0 && subMesh.bitangents == nullptr) ||
+			(subMesh.indices == nullptr) ||
+			(header.diffuseMapOffset != 0 && subMesh.diffuseMap == nullptr) ||
+			(header.specularMapOffset != 0 && subMesh.specularMap == nullptr) ||
+			(header.normalMapOffset != 0 && subMesh.normalMap == nullptr);
+
+		if (streamMissing)
+			return false;
+
+		if (subMesh.nrOfLevelsOfDetail == 0)
+			continue;
+
+		// Every range has to be inside the stored indices
+		if (subMesh.levelsOfDetail == nullptr)
+			return false;
+
+		for (std::uint32_t j = 0; j < subMesh.nrOfLevelsOfDetail; ++j)
+		{
+			const LevelOfDetail& level = subMesh.levelsOfDetail[j];
+			if (level.firstIndex > header.nrOfIndices ||
+				level.indexCount > header.nrOfIndices - level.firstIndex)
+			{
+				return false;
+			}
+		}
+
+		subMesh.nrOfIndices = subMesh.levelsOfDetail[0].indexCount;
+	}
+
+	return true;
+}
+
+const void* MeshCache::GetStream(std::uint64_t offset, size_t byteSize)
+{
+	if (offset == 0 || offset % STREAM_ALIGNMENT != 0 ||
+		offset > mappedSize || byteSize > mappedSize - offset)
+	{
+		return nullptr;
+	}
+
+	return mappedData + offset;
+}
+
+const char* MeshCache::GetString(std::uint64_t offset)
+{
+	if (offset == 0 || offset >= mappedSize)
+		return nullptr;
+
+	const void* end = memchr(mappedData + offset, '\0',
+		mappedSize - static_cast<size_t>(offset));
+
+	return end == nullptr ? nullptr :
+		reinterpret_cast<const char*>(mappedData + offset);
+}
+
+bool MeshCache::Open(const std::string& cachePath, std::uint64_t sourceHash,
+	unsigned int importFlags, std::uint64_t settingsKey)
+{
+	Close();
+
+	fileHandle = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY,
+		0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mappedData = static_cast<const unsigned char*>(
+		MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+	if (mappedData == nullptr ||
+		!ParseContents(sourceHash, importFlags, settingsKey))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshCache::Close()
+{
+	subMeshes.clear();
+
+	if (mappedData != nullptr)
+		UnmapViewOfFile(mappedData);
+
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+
+size_t MeshCache::GetNrOfSubMeshes() const
+{
+	return subMeshes.size();
+}
+
+const SubMeshStreams& MeshCache::GetSubMesh(size_t index) const
+{
+	return subMeshes[index];
+}
+
+std::string MeshCache::GetCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+bool MeshCache::HashFile(const std::string& path, std::uint64_t& hash)
+{
+	// 64 bit FNV-1a, only used to detect changes to the source asset
+	hash = FNV_OFFSET_BASIS;
+	return HashFileContents(path, hash);
+}
+
+bool MeshCache::HashMeshSource(const std::string& path, std::uint64_t& hash)
+{
+	if (!HashFile(path, hash))
+		return false;
+
+	size_t separator = path.find_last_of("\\/");
+	std::string directory = separator == std::string::npos ? "" :
+		path.substr(0, separator + 1);
+	size_t dot = path.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](unsigned char character)
+		{
+			return static_cast<char>(std::tolower(character));
+		});
+
+	std::vector<std::string> dependencies;
+	if (extension == ".obj")
+		FindObjDependencies(path, directory, dependencies);
+	else if (extension == ".gltf")
+		FindGltfDependencies(path, directory, dependencies);
+
+	// The names are hashed as well, so a dependency that is missing now and
+	// added later still changes the hash
+	for (auto& dependency : dependencies)
+	{
+		HashBytes(dependency.c_str(), dependency.size() + 1, hash);
+		HashFileContents(dependency, hash);
+	}
+
+	return true;
+}
+
+bool MeshCache::Write(const std::string& cachePath, std::uint64_t sourceHash,
+	unsigned int importFlags, std::uint64_t settingsKey,
+	const std::vector<SubMeshStreams>& toWrite)
+{
+	FileHeader fileHeader;
+	fileHeader.sourceHash = sourceHash;
+	fileHeader.importFlags = importFlags;
+	fileHeader.settingsKey = settingsKey;
+	fileHeader.nrOfSubMeshes = static_cast<std::uint32_t>(toWrite.size());
+
+	std::vector<SubMeshHeader> subMeshHeaders(toWrite.size());
+	std::vector<unsigned char> output(sizeof(FileHeader) +
+		sizeof(SubMeshHeader) * subMeshHeaders.size());
+
+	for (size_t i = 0; i < toWrite.size(); ++i)
+	{
+		const SubMeshStreams& subMesh = toWrite[i];
+		SubMeshHeader& header = subMeshHeaders[i];
+		header.nrOfVertices = subMesh.nrOfVertices;
+		header.nrOfIndices = subMesh.GetTotalNrOfIndices();
+		header.nrOfLevelsOfDetail = subMesh.nrOfLevelsOfDetail;
+
+		header.positionOffset = AppendStream(output, subMesh.positions,
+			subMesh.nrOfVertices);
+		header.uvOffset = AppendStream(output, subMesh.uvs,
+			subMesh.nrOfVertices);
+		header.normalOffset = AppendStream(output, subMesh.normals,
+			subMesh.nrOfVertices);
+		header.tangentOffset = AppendStream(output, subMesh.tangents,
+			subMesh.nrOfVertices);
+		header.bitangentOffset = AppendStream(output, subMesh.bitangents,
+			subMesh.nrOfVertices);
+
+		// Always present, even when empty, so the reader can rely on it
+		AlignOutput(output);
+		header.indicesOffset = output.size();
+		AppendStream(output, subMesh.indices, header.nrOfIndices);
+		header.levelsOfDetailOffset = AppendStream(output,
+			subMesh.levelsOfDetail, subMesh.nrOfLevelsOfDetail);
+
+		header.diffuseMapOffset = AppendString(output, subMesh.diffuseMap);
+		header.specularMapOffset = AppendString(output, subMesh.specularMap);
+		header.normalMapOffset = AppendString(output, subMesh.normalMap);
+	}
+
+	memcpy(output.data(), &fileHeader, sizeof(FileHeader));
+	if (!subMeshHeaders.empty())
+	{
+		memcpy(output.data() + sizeof(FileHeader), subMeshHeaders.data(),
+			sizeof(SubMeshHeader) * subMeshHeaders.size());
+	}
+
+	// Written next to the cache and moved over it, so a reader never maps a
+	// partly written cache and a failed write keeps the previous one
+	std::string temporaryPath = cachePath + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(output.data()),
+			static_cast<std::streamsize>(output.size()));
+		file.close();
+		if (!file)
+		{
+			DeleteFileA(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	if (!MoveFileExA(temporaryPath.c_str(), cachePath.c_str(),
+		MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "SubMeshData.h"
+
+// Read only view of a baked mesh file. The streams are stored in the exact
+// layout the buffer components expect, so a cache hit can hand the mapped
+// memory directly to SetUpdateData without any conversion.
+class MeshCache
+{
+private:
+	static const std::uint32_t CACHE_MAGIC = 0x48534d4e; // "NMSH"
+	static const std::uint32_t CACHE_VERSION = 4;
+
+	struct FileHeader
+	{
+		std::uint32_t magic = CACHE_MAGIC;
+		std::uint32_t version = CACHE_VERSION;
+		std::uint64_t sourceHash = 0;
+		std::uint32_t importFlags = 0;
+		std::uint32_t nrOfSubMeshes = 0;
+		std::uint64_t settingsKey = 0;
+	};
+
+	// Offsets are from the start of the file, 0 means the stream is absent
+	struct SubMeshHeader
+	{
+		std::uint32_t nrOfVertices = 0;
+		std::uint32_t nrOfIndices = 0; // Of every level of detail
+		std::uint32_t nrOfLevelsOfDetail = 0;
+		std::uint32_t padding = 0;
+
+		std::uint64_t positionOffset = 0;
+		std::uint64_t uvOffset = 0;
+		std::uint64_t normalOffset = 0;
+		std::uint64_t tangentOffset = 0;
+		std::uint64_t bitangentOffset = 0;
+		std::uint64_t indicesOffset = 0;
+		std::uint64_t levelsOfDetailOffset = 0;
+
+		std::uint64_t diffuseMapOffset = 0;
+		std::uint64_t specularMapOffset = 0;
+		std::uint64_t normalMapOffset = 0;
+	};
+
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = nullptr;
+	const unsigned char* mappedData = nullptr;
+	size_t mappedSize = 0;
+
+	std::vector<SubMeshStreams> subMeshes;
+
+	bool ParseContents(std::uint64_t sourceHash, unsigned int importFlags,
+		std::uint64_t settingsKey);
+	const void* GetStream(std::uint64_t offset, size_t byteSize);
+	const char* GetString(std::uint64_t offset);
+
+public:
+	MeshCache() = default;
+	~MeshCache();
+	MeshCache(const MeshCache& other) = delete;
+	MeshCache& operator=(const MeshCache& other) = delete;
+	MeshCache(MeshCache&& other) = delete;
+	MeshCache& operator=(MeshCache&& other) = delete;
+
+	// The settings key identifies how the sub meshes were processed after the
+	// import, a cache baked with other settings is treated as a miss
+	bool Open(const std::string& cachePath, std::uint64_t sourceHash,
+		unsigned int importFlags, std::uint64_t settingsKey);
+	void Close();
+
+	size_t GetNrOfSubMeshes() const;
+	const SubMeshStreams& GetSubMesh(size_t index) const;
+
+	static std::string GetCachePath(const std::string& sourcePath);
+	static bool HashFile(const std::string& path, std::uint64_t& hash);
+
+	// Hashes the mesh file together with the files the importer reads along
+	// with it, the material libraries of .obj files and the external buffers
+	// of .gltf files, so editing any of them invalidates the cache
+	static bool HashMeshSource(const std::string& path, std::uint64_t& hash);
+	// Only replaces an existing cache once the new one is completely written,
+	// which fails while that cache is still mapped
+	static bool Write(const std::string& cachePath, std::uint64_t sourceHash,
+		unsigned int importFlags, std::uint64_t settingsKey,
+		const std::vector<SubMeshStreams>& toWrite);
+};
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include "MeshResourceLoader.h"
 
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <unordered_set>
 
+#include <psapi.h>
 #include <DirectXMath.h>
 using namespace DirectX;
 
@@ -12,227 +18,1622 @@ using namespace DirectX;
 #include "stb_image.h"
 #include "NSGG Core\Headers\FrameTexture2DComponent.h"
 #include "NSGG Core\Headers\FrameBufferComponent.h"
+#include "ParallelFor.h"
+#include "VertexConversion.h"
+#include "TextureFootprint.h"
+#include "FloatPacking.h"
 
-template<typename ComponentType, typename CombinationType>
-void GenerateMipData(std::vector<unsigned char>& data, std::vector<UINT> rows,
-	std::vector<UINT64> rowSizes, UINT16 currentMipLevel, size_t parentDataStart, 
-	std::uint8_t componentsPerTexel, ResourceIndex index, 
+PreparedMesh::~PreparedMesh()
+{
+	for (auto& texture : textures)
+	{
+		if (texture.second.data != nullptr)
+			STBI_FREE(texture.second.data);
+	}
+}
+
+namespace
+{
+	// Same traversal order as the node hierarchy was processed in before the
+	// loader was split into phases, sub mesh indices are unchanged
+	void GatherMeshes(const aiNode* node, const aiScene* scene,
+		std::vector<const aiMesh*>& toFill)
+	{
+		for (unsigned int i = 0; i < node->mNumMeshes; ++i)
+			toFill.push_back(scene->mMeshes[node->mMeshes[i]]);
+
+		for (unsigned int i = 0; i < node->mNumChildren; ++i)
+			GatherMeshes(node->mChildren[i], scene, toFill);
+	}
+
+	// Memory of an imported mesh, assuming triangulated faces
+	size_t EstimateSceneMeshBytes(const aiMesh* mesh)
+	{
+		size_t vertexStreams = 1;
+		if (mesh->mNormals != nullptr)
+			++vertexStreams;
+		if (mesh->mTangents != nullptr)
+			vertexStreams += 2; // Bitangents are generated with the tangents
+		for (unsigned int i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+		{
+			if (mesh->mTextureCoords[i] != nullptr)
+				++vertexStreams;
+		}
+
+		size_t colorStreams = 0;
+		for (unsigned int i = 0; i < AI_MAX_NUMBER_OF_COLOR_SETS; ++i)
+		{
+			if (mesh->mColors[i] != nullptr)
+				++colorStreams;
+		}
+
+		size_t vertices = mesh->mNumVertices;
+		return sizeof(aiMesh) + vertices * vertexStreams * sizeof(aiVector3D) +
+			vertices * colorStreams * sizeof(aiColor4D) +
+			mesh->mNumFaces * (sizeof(aiFace) + 3 * sizeof(unsigned int));
+	}
+
+	size_t EstimateSceneBytes(const aiScene* scene)
+	{
+		size_t bytes = 0;
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+		{
+			if (scene->mMeshes[i] != nullptr)
+				bytes += EstimateSceneMeshBytes(scene->mMeshes[i]);
+		}
+
+		return bytes;
+	}
+
+	// Returns the estimated bytes freed, the scene deletes its remaining
+	// meshes itself and skips the freed ones
+	size_t FreeSceneMesh(aiScene* scene, const aiMesh* mesh)
+	{
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+		{
+			if (scene->mMeshes[i] == mesh)
+			{
+				size_t bytes = EstimateSceneMeshBytes(mesh);
+				delete scene->mMeshes[i];
+				scene->mMeshes[i] = nullptr;
+				return bytes;
+			}
+		}
+
+		return 0;
+	}
+
+	// Upper estimate of the memory a sub mesh needs from its conversion until
+	// its upload: the converted streams, the largest packed attributes, the
+	// indices in both widths and the meshlets. The coarser levels of detail
+	// together hold fewer indices than the full detail level.
+	size_t EstimateSubMeshBytes(size_t nrOfVertices, size_t nrOfIndices,
+		const ConversionSettings& settings)
+	{
+		size_t vertexBytes = sizeof(XMFLOAT3) * 2 + sizeof(XMFLOAT2) +
+			sizeof(XMFLOAT4) + sizeof(PackedVertexAttributes) +
+			sizeof(std::uint32_t);
+		if (settings.keepBitangents)
+			vertexBytes += sizeof(XMFLOAT3);
+		size_t indexBytes = sizeof(unsigned int) + sizeof(std::uint16_t) +
+			sizeof(std::uint32_t);
+		if (settings.nrOfLevelsOfDetail > 0)
+			indexBytes *= 2;
+
+		return nrOfVertices * vertexBytes + nrOfIndices * indexBytes;
+	}
+
+	// Decoded size of a texture, only the header of the file is read
+	size_t EstimateTextureBytes(const std::string& filepath)
+	{
+		int width = 0;
+		int height = 0;
+		int components = 0;
+		if (stbi_info(filepath.c_str(), &width, &height, &components) == 0)
+			return 0;
+
+		return static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+	}
+
+	// Surface area of the bounding box of the sub mesh
+	float EstimateCoverage(const SubMeshStreams& streams)
+	{
+		if (streams.positions == nullptr || streams.nrOfVertices == 0)
+			return 0.0f;
+
+		XMVECTOR minimum = XMLoadFloat3(&streams.positions[0]);
+		XMVECTOR maximum = minimum;
+		for (unsigned int i = 1; i < streams.nrOfVertices; ++i)
+		{
+			XMVECTOR position = XMLoadFloat3(&streams.positions[i]);
+			minimum = XMVectorMin(minimum, position);
+			maximum = XMVectorMax(maximum, position);
+		}
+
+		XMFLOAT3 extents;
+		XMStoreFloat3(&extents, XMVectorSubtract(maximum, minimum));
+		return 2.0f * (extents.x * extents.y + extents.y * extents.z +
+			extents.z * extents.x);
+	}
+
+	template<typename T>
+	size_t GetVectorBytes(const std::vector<T>& vector)
+	{
+		return vector.capacity() * sizeof(T);
+	}
+
+	size_t GetWorkingSetBytes()
+	{
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+
+		return counters.WorkingSetSize;
+	}
+
+	static_assert(sizeof(aiVector3D) == sizeof(XMFLOAT3),
+		"The conversion kernels expect tightly packed aiVector3D streams");
+
+	const float* GetComponents(const aiVector3D* data)
+	{
+		return reinterpret_cast<const float*>(data);
+	}
+
+	// The kernels write straight into the sub mesh streams, which are what
+	// the buffers and the mesh cache are filled from
+	void ConvertStream(const aiVector3D* data, unsigned int nrOfElements,
+		std::vector<XMFLOAT2>& toFill)
+	{
+		if (data == nullptr)
+			return;
+
+		toFill.resize(nrOfElements);
+		ConvertVector2Stream(GetComponents(data), nrOfElements, toFill.data());
+	}
+
+	void ConvertStream(const aiVector3D* data, unsigned int nrOfElements,
+		std::vector<XMFLOAT3>& toFill)
+	{
+		if (data == nullptr)
+			return;
+
+		toFill.resize(nrOfElements);
+		ConvertVector3Stream(GetComponents(data), nrOfElements, toFill.data());
+	}
+
+	// The tangent w is the handedness of the tangent space, the bitangent is
+	// rebuilt as cross(normal, tangent) * w. That only matches the imported
+	// bitangent where the tangent space is orthogonal, which
+	// aiProcess_CalcTangentSpace does not ensure.
+	void ConvertTangents(const aiMesh* mesh, std::vector<XMFLOAT4>& toFill)
+	{
+		if (mesh->mTangents == nullptr)
+			return;
+
+		toFill.resize(mesh->mNumVertices);
+		ConvertTangentStream(GetComponents(mesh->mTangents),
+			GetComponents(mesh->mNormals), GetComponents(mesh->mBitangents),
+			mesh->mNumVertices, toFill.data());
+	}
+
+	std::string GetTextureName(const aiMaterial* material,
+		aiTextureType textureType)
+	{
+		if (material->GetTextureCount(textureType) == 0)
+			return std::string(); // No texture of this type, this is fine
+
+		aiString name;
+		material->GetTexture(textureType, 0, &name);
+		return name.C_Str();
+	}
+}
+
+// Level 0 is handed to the component from where it was decoded, only the
+// levels below it are staged, in a buffer that is left uninitialized as
+// every byte of it is filtered
+size_t MeshResourceLoader::CreateMipData(unsigned char* originalData,
+	std::uint8_t componentsPerTexel, TexelFormat texelFormat,
+	const MipFilterSettings& mipFilter, ID3D12Resource* resource,
+	ResourceIndex index, FrameTexture2DComponent<1>& textureComponent)
+{
+	auto desc = resource->GetDesc();
+	const TextureFootprint& footprint = GetTextureFootprint(
+		static_cast<UINT>(desc.Width), desc.Height, desc.Format, desc.MipLevels);
+
+	std::vector<UINT> rows(desc.MipLevels);
+	std::vector<UINT64> rowSizes(desc.MipLevels);
+	for (UINT16 mipLevel = 0; mipLevel < desc.MipLevels; ++mipLevel)
+	{
+		rows[mipLevel] = footprint.subresources[mipLevel].rows;
+		rowSizes[mipLevel] = footprint.subresources[mipLevel].rowSize;
+	}
+
+	size_t topLevelSize = rows[0] * rowSizes[0];
+	size_t totalSize = 0;
+	for (UINT16 mipLevel = 0; mipLevel < desc.MipLevels; ++mipLevel)
+		totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+	std::unique_ptr<unsigned char[]> lowerLevels(
+		new unsigned char[totalSize - topLevelSize]);
+	GenerateMipChain(originalData, lowerLevels.get(), rows, rowSizes,
+		componentsPerTexel, texelFormat, mipFilter, nrOfWorkerThreads);
+
+	textureComponent.SetUpdateData(index, originalData, 0);
+	size_t dataStart = 0;
+	for (UINT16 mipLevel = 1; mipLevel < desc.MipLevels; ++mipLevel)
+	{
+		textureComponent.SetUpdateData(index, lowerLevels.get() + dataStart,
+			static_cast<std::uint8_t>(mipLevel));
+		dataStart += rows[mipLevel] * rowSizes[mipLevel];
+	}
+
+	++mipStagingStatistics.nrOfMipChains;
+	mipStagingStatistics.stagedBytes += totalSize - topLevelSize;
+	mipStagingStatistics.uploadedBytes += totalSize;
+	return totalSize;
+}
+
+// The float levels below level 0 are filtered as in CreateMipData, then the
+// whole chain is packed, split between the worker threads by bands of texels
+std::unique_ptr<unsigned char[]> MeshResourceLoader::PackHdrMipChain(
+	const float* originalData, unsigned int width, unsigned int height,
+	DXGI_FORMAT format, const MipFilterSettings& mipFilter,
+	std::vector<size_t>& levelBytes)
+{
+	const size_t PACKING_BAND_TEXELS = 16384;
+
+	const TextureFootprint& footprint = GetTextureFootprint(width, height,
+		format);
+	bool packed = format == DXGI_FORMAT_R11G11B10_FLOAT;
+	size_t packedTexelSize = packed ? sizeof(std::uint32_t) :
+		4 * sizeof(std::uint16_t);
+
+	std::vector<UINT> rows;
+	std::vector<UINT64> rowSizes;
+	CalculateMipChainLayout(width, height, 4 * sizeof(float), rows, rowSizes);
+
+	size_t nrOfTopTexels = static_cast<size_t>(width) * height;
+	size_t nrOfTexels = 0;
+	levelBytes.clear();
+	for (auto& subresource : footprint.subresources)
+	{
+		nrOfTexels += static_cast<size_t>(subresource.width) * subresource.height;
+		levelBytes.push_back(static_cast<size_t>(subresource.rows *
+			subresource.rowSize));
+	}
+
+	std::unique_ptr<float[]> lowerLevels(
+		new float[(nrOfTexels - nrOfTopTexels) * 4]);
+	GenerateMipChain(reinterpret_cast<const unsigned char*>(originalData),
+		reinterpret_cast<unsigned char*>(lowerLevels.get()), rows, rowSizes, 4,
+		TexelFormat::FLOAT, mipFilter, nrOfWorkerThreads);
+
+	std::unique_ptr<unsigned char[]> toReturn(
+		new unsigned char[nrOfTexels * packedTexelSize]);
+	size_t nrOfBands = (nrOfTexels + PACKING_BAND_TEXELS - 1) /
+		PACKING_BAND_TEXELS;
+	ParallelFor(nrOfBands, nrOfWorkerThreads, [&](size_t band)
+		{
+			size_t start = band * PACKING_BAND_TEXELS;
+			size_t end = std::min(start + PACKING_BAND_TEXELS, nrOfTexels);
+			while (start < end)
+			{
+				// Bands that cross from level 0 to the lower levels are packed
+				// from both
+				bool topLevel = start < nrOfTopTexels;
+				size_t stop = topLevel ? std::min(end, nrOfTopTexels) : end;
+				const float* source = topLevel ? originalData + start * 4 :
+					lowerLevels.get() + (start - nrOfTopTexels) * 4;
+				unsigned char* destination = toReturn.get() +
+					start * packedTexelSize;
+				if (packed)
+				{
+					PackR11G11B10Stream(source, stop - start,
+						reinterpret_cast<std::uint32_t*>(destination));
+				}
+				else
+				{
+					PackHalfStream(source, (stop - start) * 4,
+						reinterpret_cast<std::uint16_t*>(destination));
+				}
+
+				start = stop;
+			}
+		});
+
+	mipStagingStatistics.stagedBytes += (nrOfTexels - nrOfTopTexels) *
+		4 * sizeof(float) + nrOfTexels * packedTexelSize;
+	return toReturn;
+}
+
+size_t MeshResourceLoader::CreateHdrMipData(const float* originalData,
+	const MipFilterSettings& mipFilter, ID3D12Resource* resource,
+	ResourceIndex index, FrameTexture2DComponent<1>& textureComponent)
+{
+	auto desc = resource->GetDesc();
+	std::vector<size_t> levelBytes;
+	std::unique_ptr<unsigned char[]> packedChain = PackHdrMipChain(originalData,
+		static_cast<unsigned int>(desc.Width), desc.Height, desc.Format,
+		mipFilter, levelBytes);
+
+	size_t dataStart = 0;
+	for (UINT16 mipLevel = 0; mipLevel < desc.MipLevels; ++mipLevel)
+	{
+		textureComponent.SetUpdateData(index, packedChain.get() + dataStart,
+			static_cast<std::uint8_t>(mipLevel));
+		dataStart += levelBytes[mipLevel];
+	}
+
+	++mipStagingStatistics.nrOfMipChains;
+	mipStagingStatistics.uploadedBytes += dataStart;
+	return dataStart;
+}
+
+// Unlike CreateMipData every level is staged, level 0 included, as the chain
+// outlives the decoded texture
+MeshResourceLoader::StreamedMipChain MeshResourceLoader::StageMipChain(
+	const DecodedTexture& texture, DXGI_FORMAT format, TexelFormat texelFormat,
+	const MipFilterSettings& mipFilter)
+{
+	StreamedMipChain toReturn;
+	toReturn.width = static_cast<unsigned int>(texture.width);
+	toReturn.height = static_cast<unsigned int>(texture.height);
+	toReturn.levelOffsets.push_back(0);
+	if (texture.baked != nullptr)
+	{
+		const BakedTexture& baked = *texture.baked;
+		for (unsigned int mipLevel = 0; mipLevel < baked.GetNrOfMipLevels();
+			++mipLevel)
+		{
+			toReturn.levelOffsets.push_back(toReturn.levelOffsets.back() +
+				baked.GetMipByteSize(mipLevel));
+		}
+
+		toReturn.data.reset(new unsigned char[toReturn.levelOffsets.back()]);
+		for (unsigned int mipLevel = 0; mipLevel < baked.GetNrOfMipLevels();
+			++mipLevel)
+		{
+			memcpy(toReturn.data.get() + toReturn.levelOffsets[mipLevel],
+				baked.GetMipData(mipLevel), baked.GetMipByteSize(mipLevel));
+		}
+
+		mipStagingStatistics.stagedBytes += toReturn.levelOffsets.back();
+	}
+	else if (texture.hdr)
+	{
+		// The texels are linear already
+		MipFilterSettings linearFilter = mipFilter;
+		linearFilter.gammaCorrect = false;
+		std::vector<size_t> levelBytes;
+		toReturn.data = PackHdrMipChain(static_cast<const float*>(texture.data),
+			toReturn.width, toReturn.height, format, linearFilter, levelBytes);
+		for (size_t bytes : levelBytes)
+			toReturn.levelOffsets.push_back(toReturn.levelOffsets.back() + bytes);
+	}
+	else
+	{
+		std::vector<UINT> rows;
+		std::vector<UINT64> rowSizes;
+		CalculateMipChainLayout(toReturn.width, toReturn.height,
+			static_cast<std::uint8_t>(texture.componentsPerTexel), rows,
+			rowSizes);
+		for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+		{
+			toReturn.levelOffsets.push_back(toReturn.levelOffsets.back() +
+				static_cast<size_t>(rows[mipLevel] * rowSizes[mipLevel]));
+		}
+
+		toReturn.data.reset(new unsigned char[toReturn.levelOffsets.back()]);
+		memcpy(toReturn.data.get(), texture.data, toReturn.levelOffsets[1]);
+		GenerateMipChain(toReturn.data.get(), rows, rowSizes,
+			static_cast<std::uint8_t>(texture.componentsPerTexel), texelFormat,
+			mipFilter, nrOfWorkerThreads);
+		mipStagingStatistics.stagedBytes += toReturn.levelOffsets.back();
+	}
+
+	++mipStagingStatistics.nrOfMipChains;
+	return toReturn;
+}
+
+ResourceIndex MeshResourceLoader::CreateStreamedTexture(
+	const StreamedMipChain& chain, unsigned int firstMip,
 	FrameTexture2DComponent<1>& textureComponent)
 {
-	std::uint8_t texelSize = componentsPerTexel * sizeof(ComponentType);
-	size_t texelsPerRow = rowSizes[currentMipLevel] / texelSize;
-	size_t parentComponentsPerRow = componentsPerTexel * (rowSizes[currentMipLevel - 1] / texelSize);
-	ComponentType* parentData = reinterpret_cast<ComponentType*>(data.data() + parentDataStart);
-	ComponentType* currentData = parentData;
-	currentData += rows[currentMipLevel - 1] * (rowSizes[currentMipLevel - 1] / sizeof(ComponentType));
+	TextureAllocationInfo allocationInfo(std::max(chain.width >> firstMip, 1u),
+		std::max(chain.height >> firstMip, 1u), 1, 0);
+	ResourceIndex toReturn = textureComponent.CreateTexture(allocationInfo);
+	if (toReturn == ResourceIndex(-1))
+		return toReturn;
+
+	size_t nrOfMipLevels = chain.levelOffsets.size() - 1;
+	for (size_t mipLevel = firstMip; mipLevel < nrOfMipLevels; ++mipLevel)
+	{
+		textureComponent.SetUpdateData(toReturn,
+			chain.data.get() + chain.levelOffsets[mipLevel],
+			static_cast<std::uint8_t>(mipLevel - firstMip));
+	}
+
+	mipStagingStatistics.uploadedBytes += chain.levelOffsets.back() -
+		chain.levelOffsets[firstMip];
+	return toReturn;
+}
+
+void MeshResourceLoader::RetargetTexture(const StreamedMipChain& chain,
+	ResourceIndex to)
+{
+	for (auto& user : chain.users)
+	{
+		SubMesh& subMesh = meshes[user.first].subMeshes[user.second];
+		ResourceIndex& index = chain.map == MaterialMap::DIFFUSE ?
+			subMesh.diffuseMap : chain.map == MaterialMap::SPECULAR ?
+			subMesh.specularMap : subMesh.normalMap;
+		index = to;
+	}
+}
+
+void MeshResourceLoader::AddStreamedTextureUsers(MeshIndex index,
+	size_t subMeshIndex)
+{
+	const SubMesh& subMesh = meshes[index].subMeshes[subMeshIndex];
+	for (StreamedTextureIndex streamedTexture : { subMesh.streamedDiffuseMap,
+		subMesh.streamedSpecularMap, subMesh.streamedNormalMap })
+	{
+		if (streamedTexture != StreamedTextureIndex(-1))
+		{
+			streamedMipChains.at(streamedTexture).users.emplace_back(index,
+				subMeshIndex);
+		}
+	}
+}
+
+void MeshResourceLoader::RemoveStreamedTextureUsers(MeshIndex index,
+	size_t subMeshIndex)
+{
+	const SubMesh& subMesh = meshes[index].subMeshes[subMeshIndex];
+	for (StreamedTextureIndex streamedTexture : { subMesh.streamedDiffuseMap,
+		subMesh.streamedSpecularMap, subMesh.streamedNormalMap })
+	{
+		if (streamedTexture == StreamedTextureIndex(-1))
+			continue;
+
+		auto& users = streamedMipChains.at(streamedTexture).users;
+		users.erase(std::remove(users.begin(), users.end(),
+			std::make_pair(index, subMeshIndex)), users.end());
+	}
+}
+
+std::unordered_map<std::string, LoadedTexture>&
+MeshResourceLoader::GetLoadedTextures(MaterialMap map)
+{
+	switch (map)
+	{
+	case MaterialMap::SPECULAR:
+		return loadedSpecularMaps;
+	case MaterialMap::NORMAL:
+		return loadedNormalMaps;
+	default:
+		return loadedDiffuseMaps;
+	}
+}
+
+TextureDecodePool& MeshResourceLoader::GetDecodePool()
+{
+	if (decodePool == nullptr)
+		decodePool = std::make_shared<TextureDecodePool>(nrOfWorkerThreads);
+
+	return *decodePool;
+}
+
+// Textures are decoded largest screen coverage first. As the camera is not
+// known while loading, the coverage of a texture is estimated as the summed
+// bounding box surface area of the sub meshes that use it.
+bool MeshResourceLoader::DecodeTextures(PreparedMesh& preparedMesh)
+{
+	std::vector<std::string> filepaths;
+	std::unordered_map<std::string, float> priorities;
+	std::unordered_map<std::string, MaterialMap> maps;
+	std::unordered_set<std::string> mixedMaps;
+	auto addPath = [&](const std::string& directory, const char* name,
+		const std::unordered_map<std::string, LoadedTexture>& loadedTextures,
+		MaterialMap map, float coverage)
+	{
+		if (name == nullptr)
+			return;
+
+		// Textures loaded by an earlier mesh are reused and need no decoding
+		std::string filepath = directory + name;
+		if (loadedTextures.count(filepath) != 0)
+			return;
+
+		priorities[filepath] += coverage;
+		auto added = maps.emplace(filepath, map);
+		if (added.first->second != map)
+			mixedMaps.insert(filepath);
+		if (preparedMesh.textures.emplace(filepath, DecodedTexture()).second)
+			filepaths.push_back(filepath);
+	};
+
+	for (auto& streams : preparedMesh.subMeshes)
+	{
+		float coverage = EstimateCoverage(streams);
+		addPath(directories.diffuseMapDirectory, streams.diffuseMap,
+			loadedDiffuseMaps, MaterialMap::DIFFUSE, coverage);
+		addPath(directories.specularMapDirectory, streams.specularMap,
+			loadedSpecularMaps, MaterialMap::SPECULAR, coverage);
+		addPath(directories.normalMapDirectory, streams.normalMap,
+			loadedNormalMaps, MaterialMap::NORMAL, coverage);
+	}
+
+	if (filepaths.empty())
+		return true;
+
+	// The group is published before the cancellation is checked, so either
+	// this load sees the cancellation or CancelTextureDecodes sees the group
+	TextureDecodePool& pool = GetDecodePool();
+	DecodeGroup group = pool.CreateGroup();
+	activeDecodeGroup = group;
+	if (decodesCancelled)
+		pool.Cancel(group);
+
+	// The map itself is not modified while decoding, only the values. Files
+	// shared with other kinds of maps are decoded as BYTE for all of them.
+	for (auto& filepath : filepaths)
+	{
+		bool keepHdr = maps[filepath] == MaterialMap::DIFFUSE &&
+			mixedMaps.count(filepath) == 0;
+		pool.Submit(group, filepath, priorities[filepath],
+			&preparedMesh.textures[filepath], useBakedTextures, keepHdr);
+	}
+
+	bool toReturn = pool.Wait(group);
+	activeDecodeGroup = 0;
+	if (toReturn)
+		NarrowMaterialMaps(preparedMesh, maps, mixedMaps);
+
+	return toReturn;
+}
+
+// Files used as more than one kind of map share their decoded texels, so
+// they keep every channel, as do baked textures. The maps are analyzed and
+// narrowed in place in parallel, one map per thread at a time.
+void MeshResourceLoader::NarrowMaterialMaps(PreparedMesh& preparedMesh,
+	const std::unordered_map<std::string, MaterialMap>& maps,
+	const std::unordered_set<std::string>& mixedMaps)
+{
+	std::vector<std::pair<DecodedTexture*, MaterialMap>> candidates;
+	for (auto& entry : maps)
+	{
+		DecodedTexture& texture = preparedMesh.textures.at(entry.first);
+		if (narrowMaterialMaps && texture.data != nullptr &&
+			entry.second != MaterialMap::DIFFUSE &&
+			mixedMaps.count(entry.first) == 0)
+		{
+			candidates.emplace_back(&texture, entry.second);
+		}
+	}
+
+	ParallelFor(candidates.size(), nrOfWorkerThreads, [&](size_t index)
+		{
+			DecodedTexture& texture = *candidates[index].first;
+			unsigned char* texels = static_cast<unsigned char*>(texture.data);
+			size_t nrOfTexels = static_cast<size_t>(texture.width) * texture.height;
+			if (candidates[index].second == MaterialMap::SPECULAR &&
+				IsGreyscale(texels, nrOfTexels))
+			{
+				texture.componentsPerTexel = 1;
+			}
+			else if (candidates[index].second == MaterialMap::NORMAL &&
+				CanReconstructNormalZ(texels, nrOfTexels))
+			{
+				texture.componentsPerTexel = 2;
+			}
+
+			if (texture.componentsPerTexel != 4)
+				NarrowChannels(texels, nrOfTexels, texture.componentsPerTexel);
+		});
+
+	for (auto& entry : maps)
+	{
+		const DecodedTexture& texture = preparedMesh.textures.at(entry.first);
+		if (texture.data == nullptr && texture.baked == nullptr)
+			continue;
+
+		unsigned int width = static_cast<unsigned int>(texture.width);
+		unsigned int height = static_cast<unsigned int>(texture.height);
+		unsigned int texelSize = texture.hdr ? (packHdrTextures ? 4 : 8) :
+			texture.componentsPerTexel;
+		size_t bytes = GetMipChainByteSize(width, height, texelSize);
+		loadStatistics.materialMapBytes += bytes;
+		if (texture.componentsPerTexel == 4)
+			continue;
+
+		loadStatistics.materialMapBytesSaved +=
+			GetMipChainByteSize(width, height, 4) - bytes;
+		if (texture.componentsPerTexel == 1)
+			++loadStatistics.nrOfGreyscaleSpecularMaps;
+		else
+			++loadStatistics.nrOfTwoChannelNormalMaps;
+	}
+}
+
+// Called from another thread than the one loading, the pool is never replaced
+// while a load is running
+void MeshResourceLoader::CancelTextureDecodes()
+{
+	decodesCancelled = true;
+	DecodeGroup group = activeDecodeGroup;
+	if (group != 0 && decodePool != nullptr)
+		decodePool->Cancel(group);
+}
+
+DXGI_FORMAT MeshResourceLoader::GetMaterialMapFormat(
+	const PreparedMesh& preparedMesh, const std::string& filepath,
+	const std::unordered_map<std::string, LoadedTexture>& loadedTextures)
+{
+	auto loaded = loadedTextures.find(filepath);
+	if (loaded != loadedTextures.end())
+		return loaded->second.format;
+
+	auto decoded = preparedMesh.textures.find(filepath);
+	if (decoded == preparedMesh.textures.end())
+		return DXGI_FORMAT_R8G8B8A8_UNORM; // Fails to process anyway
+
+	if (decoded->second.hdr)
+	{
+		return packHdrTextures ? DXGI_FORMAT_R11G11B10_FLOAT :
+			DXGI_FORMAT_R16G16B16A16_FLOAT;
+	}
+
+	return GetNarrowedFormat(decoded->second.componentsPerTexel);
+}
+
+size_t MeshResourceLoader::UploadMipChain(const DecodedTexture& texture,
+	TexelFormat format, const MipFilterSettings& mipFilter, ResourceIndex index,
+	FrameTexture2DComponent<1>& textureComponent)
+{
+	if (texture.baked != nullptr)
+	{
+		// The component copies the data, so the mapping may close afterwards
+		const BakedTexture& baked = *texture.baked;
+		for (unsigned int mipLevel = 0; mipLevel < baked.GetNrOfMipLevels();
+			++mipLevel)
+		{
+			textureComponent.SetUpdateData(index,
+				const_cast<void*>(baked.GetMipData(mipLevel)),
+				static_cast<std::uint8_t>(mipLevel));
+		}
+
+		return baked.GetTotalByteSize();
+	}
+
+	auto handle = textureComponent.GetTextureHandle(index);
+	if (texture.hdr)
+	{
+		// The texels are linear already
+		MipFilterSettings linearFilter = mipFilter;
+		linearFilter.gammaCorrect = false;
+		return CreateHdrMipData(static_cast<const float*>(texture.data),
+			linearFilter, handle.resource, index, textureComponent);
+	}
+
+	return CreateMipData(static_cast<unsigned char*>(texture.data),
+		static_cast<std::uint8_t>(texture.componentsPerTexel), format,
+		mipFilter, handle.resource, index, textureComponent);
+}
+
+bool MeshResourceLoader::ProcessTexture(const PreparedMesh& preparedMesh,
+	const std::string& filepath, MaterialMap map,
+	const StreamingBounds& bounds, ResourceIndex& toSet,
+	StreamedTextureIndex& streamedToSet, TexelFormat format,
+	const MipFilterSettings& mipFilter,
+	FrameTexture2DComponent<1>& textureComponent,
+	std::unordered_map<std::string, LoadedTexture>& loadedTextures)
+{
+	auto loaded = loadedTextures.find(filepath);
+	if (loaded != loadedTextures.end())
+	{
+		toSet = loaded->second.index;
+		streamedToSet = loaded->second.streamedTexture;
+		++loaded->second.referenceCount;
+		++textureCacheStatistics.cacheHits;
+		textureCacheStatistics.bytesSaved += loaded->second.byteSize;
+		if (loaded->second.streamedTexture != StreamedTextureIndex(-1))
+		{
+			textureStreamer.AddTextureUser(loaded->second.streamedTexture,
+				bounds);
+		}
+
+		return true;
+	}
+
+	auto decoded = preparedMesh.textures.find(filepath);
+	if (decoded == preparedMesh.textures.end() ||
+		(decoded->second.data == nullptr && decoded->second.baked == nullptr))
+	{
+		return false;
+	}
+
+	const DecodedTexture& texture = decoded->second;
+	DXGI_FORMAT storedFormat = GetMaterialMapFormat(preparedMesh, filepath,
+		loadedTextures);
+	StreamedTextureIndex streamedTexture = StreamedTextureIndex(-1);
+	size_t byteSize = 0;
+	// Streamed textures start out with their mip tail, the streamer adds the
+	// other levels from the staged chain
+	if (textureStreamer.GetSettings().enabled)
+	{
+		StreamedMipChain chain = StageMipChain(texture, storedFormat, format,
+			mipFilter);
+		chain.map = map;
+		chain.filepath = filepath;
+		streamedTexture = textureStreamer.AddTexture(chain.width, chain.height,
+			storedFormat);
+		toSet = CreateStreamedTexture(chain,
+			textureStreamer.GetFirstResidentMip(streamedTexture),
+			textureComponent);
+		if (toSet == ResourceIndex(-1))
+		{
+			textureStreamer.RemoveTexture(streamedTexture);
+			return false;
+		}
+
+		textureStreamer.AddTextureUser(streamedTexture, bounds);
+		byteSize = chain.levelOffsets.back();
+		streamedMipChains.emplace(streamedTexture, std::move(chain));
+	}
+	else
+	{
+		TextureAllocationInfo allocationInfo(texture.width, texture.height, 1, 0);
+		toSet = textureComponent.CreateTexture(allocationInfo);
+		if (toSet == ResourceIndex(-1))
+			return false;
+
+		byteSize = UploadMipChain(texture, format, mipFilter, toSet,
+			textureComponent);
+	}
+
+	LoadedTexture& toStore = loadedTextures[filepath];
+	toStore.index = toSet;
+	toStore.format = storedFormat;
+	toStore.byteSize = byteSize;
+	toStore.referenceCount = 1;
+	toStore.streamedTexture = streamedTexture;
+	streamedToSet = streamedTexture;
+	++textureCacheStatistics.cacheMisses;
+
+	return true;
+}
+
+void MeshResourceLoader::ReleaseBuffer(ResourceIndex index,
+	FrameBufferComponent<1>& bufferComponent)
+{
+	if (index != ResourceIndex(-1))
+		bufferComponent.RemoveComponent(index);
+}
+
+void MeshResourceLoader::ReleaseTexture(ResourceIndex index, DXGI_FORMAT format,
+	const StreamingBounds& bounds,
+	std::unordered_map<std::string, LoadedTexture>& loadedTextures,
+	FrameTexture2DComponent<1>& textureComponent)
+{
+	if (index == ResourceIndex(-1))
+		return;
+
+	// Indices are only unique within a component, so within a format
+	auto loaded = std::find_if(loadedTextures.begin(), loadedTextures.end(),
+		[index, format](const auto& entry)
+		{
+			return entry.second.index == index && entry.second.format == format;
+		});
+
+	if (loaded == loadedTextures.end())
+	{
+		textureComponent.RemoveComponent(index);
+		return;
+	}
+
+	StreamedTextureIndex streamedTexture = loaded->second.streamedTexture;
+	if (streamedTexture != StreamedTextureIndex(-1))
+		textureStreamer.RemoveTextureUser(streamedTexture, bounds);
+
+	if (--loaded->second.referenceCount == 0)
+	{
+		textureComponent.RemoveComponent(index);
+		loadedTextures.erase(loaded);
+		if (streamedTexture != StreamedTextureIndex(-1))
+		{
+			textureStreamer.RemoveTexture(streamedTexture);
+			streamedMipChains.erase(streamedTexture);
+		}
+	}
+}
+
+bool MeshResourceLoader::ProcessVertexComponent2(ResourceIndex& toSet,
+	const XMFLOAT2* data, unsigned int nrOfComponents,
+	FrameBufferComponent<1>& bufferComponent)
+{
+	if (data == nullptr)
+		return true;
+
+	toSet = bufferComponent.CreateBuffer(nrOfComponents);
+
+	if (toSet == ResourceIndex(-1))
+		return false;
+
+	bufferComponent.SetUpdateData(toSet, const_cast<XMFLOAT2*>(data));
+
+	return true;
+}
+
+bool MeshResourceLoader::ProcessVertexComponent3(ResourceIndex& toSet,
+	const XMFLOAT3* data, unsigned int nrOfComponents,
+	FrameBufferComponent<1>& bufferComponent)
+{
+	if (data == nullptr)
+		return true;
+
+	toSet = bufferComponent.CreateBuffer(nrOfComponents);
+
+	if (toSet == ResourceIndex(-1))
+		return false;
+
+	bufferComponent.SetUpdateData(toSet, const_cast<XMFLOAT3*>(data));
+
+	return true;
+}
+
+bool MeshResourceLoader::ProcessVertexComponent4(ResourceIndex& toSet,
+	const XMFLOAT4* data, unsigned int nrOfComponents,
+	FrameBufferComponent<1>& bufferComponent)
+{
+	if (data == nullptr)
+		return true;
+
+	toSet = bufferComponent.CreateBuffer(nrOfComponents);
+
+	if (toSet == ResourceIndex(-1))
+		return false;
+
+	bufferComponent.SetUpdateData(toSet, const_cast<XMFLOAT4*>(data));
+
+	return true;
+}
+
+bool MeshResourceLoader::ProcessBufferData(ResourceIndex& toSet,
+	const void* data, unsigned int nrOfComponents,
+	FrameBufferComponent<1>& bufferComponent)
+{
+	toSet = bufferComponent.CreateBuffer(nrOfComponents);
+
+	if (toSet == ResourceIndex(-1))
+		return false;
+
+	bufferComponent.SetUpdateData(toSet, const_cast<void*>(data));
+
+	return true;
+}
+
+void MeshResourceLoader::ConvertMeshes(const aiScene* scene,
+	const aiMesh* const* meshes, size_t nrOfMeshes, unsigned int nrOfThreads,
+	const ConversionSettings& settings, std::vector<SubMeshData>& toFill)
+{
+	toFill.resize(nrOfMeshes);
+
+	ParallelFor(nrOfMeshes, nrOfThreads, [&](size_t index)
+		{
+			const aiMesh* mesh = meshes[index];
+			SubMeshData& subMesh = toFill[index];
+
+			ConvertStream(mesh->mVertices, mesh->mNumVertices,
+				subMesh.positions);
+			ConvertStream(mesh->mTextureCoords[0], mesh->mNumVertices,
+				subMesh.uvs);
+			ConvertStream(mesh->mNormals, mesh->mNumVertices, subMesh.normals);
+			ConvertTangents(mesh, subMesh.tangents);
+			if (settings.keepBitangents)
+			{
+				ConvertStream(mesh->mBitangents, mesh->mNumVertices,
+					subMesh.bitangents);
+			}
+
+			subMesh.indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
+			for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+			{
+				const aiFace& face = mesh->mFaces[i];
+				for (unsigned int j = 0; j < face.mNumIndices; j++)
+					subMesh.indices.push_back(face.mIndices[j]);
+			}
+
+			if (settings.optimizeVertexOrder)
+			{
+				unsigned int nrOfVertices = mesh->mNumVertices;
+				OptimizeVertexCache(subMesh.indices.data(),
+					subMesh.indices.size(), nrOfVertices);
+				OptimizeOverdraw(subMesh.indices.data(), subMesh.indices.size(),
+					subMesh.positions.data(), nrOfVertices);
+				OptimizeVertexFetch(subMesh);
+			}
+
+			// After the vertex fetch optimization, which only knows about the
+			// full detail indices
+			GenerateLevelsOfDetail(subMesh, settings.nrOfLevelsOfDetail,
+				settings.maxSimplificationError);
+
+			const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+			subMesh.diffuseMap = GetTextureName(material, aiTextureType_DIFFUSE);
+			subMesh.specularMap = GetTextureName(material, aiTextureType_SPECULAR);
+			subMesh.normalMap = GetTextureName(material, aiTextureType_NORMALS);
+		});
+}
+
+void MeshResourceLoader::ConvertScene(const aiScene* scene,
+	unsigned int nrOfThreads, const ConversionSettings& settings,
+	std::vector<SubMeshData>& toFill)
+{
+	std::vector<const aiMesh*> orderedMeshes;
+	GatherMeshes(scene->mRootNode, scene, orderedMeshes);
+	ConvertMeshes(scene, orderedMeshes.data(), orderedMeshes.size(),
+		nrOfThreads, settings, toFill);
+}
+
+void MeshResourceLoader::PrepareDerivedData(PreparedMesh& preparedMesh)
+{
+	if (vertexLayout == VertexLayout::PACKED)
+	{
+		preparedMesh.packedAttributes.resize(preparedMesh.subMeshes.size());
+		ParallelFor(preparedMesh.subMeshes.size(), nrOfWorkerThreads,
+			[&](size_t index)
+			{
+				PackVertexAttributes(preparedMesh.subMeshes[index],
+					preparedMesh.packedAttributes[index]);
+			});
+	}
+	else if (vertexLayout == VertexLayout::QUANTIZED)
+	{
+		preparedMesh.quantizedAttributes.resize(preparedMesh.subMeshes.size());
+		ParallelFor(preparedMesh.subMeshes.size(), nrOfWorkerThreads,
+			[&](size_t index)
+			{
+				QuantizeVertexAttributes(preparedMesh.subMeshes[index],
+					preparedMesh.quantizedAttributes[index]);
+			});
+	}
+
+	if (buildMeshlets)
+	{
+		preparedMesh.meshlets.resize(preparedMesh.subMeshes.size());
+		ParallelFor(preparedMesh.subMeshes.size(), nrOfWorkerThreads,
+			[&](size_t index)
+			{
+				BuildMeshlets(preparedMesh.subMeshes[index],
+					preparedMesh.meshlets[index]);
+			});
+	}
+
+	preparedMesh.shortIndices.resize(preparedMesh.subMeshes.size());
+	ParallelFor(preparedMesh.subMeshes.size(), nrOfWorkerThreads,
+		[&](size_t index)
+		{
+			if (CanUseShortIndices(preparedMesh.subMeshes[index]))
+			{
+				NarrowIndices(preparedMesh.subMeshes[index],
+					preparedMesh.shortIndices[index]);
+			}
+		});
+}
+
+void MeshResourceLoader::BeginLoad()
+{
+	if (nrOfWorkerThreads == 0)
+		nrOfWorkerThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	loadStatistics = LoadStatistics();
+	loadStatistics.nrOfWorkerThreads = nrOfWorkerThreads;
+}
+
+void MeshResourceLoader::RecordMemoryUsage(size_t sceneBytes,
+	size_t stagingBytes)
+{
+	loadStatistics.peakTrackedBytes =
+		std::max(loadStatistics.peakTrackedBytes, sceneBytes + stagingBytes);
+	loadStatistics.peakStagingBytes =
+		std::max(loadStatistics.peakStagingBytes, stagingBytes);
+	loadStatistics.peakWorkingSetBytes =
+		std::max(loadStatistics.peakWorkingSetBytes, GetWorkingSetBytes());
+}
+
+MeshIndex MeshResourceLoader::StoreMesh(const std::string& file, Mesh&& toStore)
+{
+	MeshIndex toReturn = meshes.Add(std::move(toStore));
+	loadedFiles[file] = toReturn;
+	MeshReference& reference = meshReferences[toReturn];
+	reference.file = file;
+	reference.referenceCount = 1;
+	for (size_t i = 0; i < meshes[toReturn].subMeshes.size(); ++i)
+		AddStreamedTextureUsers(toReturn, i);
+
+	return toReturn;
+}
+
+MeshResourceLoader::~MeshResourceLoader()
+{
+	asyncLoads.clear();
+}
+
+void MeshResourceLoader::SetDirectoryInformation(
+	const DirectoryInformation& directoryInformation)
+{
+	directories = directoryInformation;
+	flags = GetImportFlags();
+}
+
+void MeshResourceLoader::SetNrOfWorkerThreads(unsigned int nrOfThreads)
+{
+	nrOfWorkerThreads = nrOfThreads;
+	decodePool.reset(); // Recreated with the new number of threads when used
+}
+
+bool MeshResourceLoader::PrepareMesh(const std::string& file,
+	PreparedMesh& toFill)
+{
+	BeginLoad();
+	loadStatistics.nrOfBatches = 1;
+	toFill.file = file;
+	auto phaseStart = std::chrono::steady_clock::now();
+	auto finishPhase = [&phaseStart](double& toSet)
+	{
+		auto now = std::chrono::steady_clock::now();
+		toSet = std::chrono::duration<double, std::milli>(now - phaseStart).count();
+		phaseStart = now;
+	};
+
+	std::string filepath = directories.meshDirectory + file;
+	std::string cachePath = MeshCache::GetCachePath(filepath);
+	std::uint64_t sourceHash = 0;
+	std::uint64_t settingsKey = conversionSettings.GetKey();
+	bool hashed = useMeshCache &&
+		MeshCache::HashMeshSource(filepath, sourceHash);
+
+	auto cache = std::make_shared<MeshCache>();
+	if (hashed && cache->Open(cachePath, sourceHash, flags, settingsKey))
+	{
+		++meshCacheStatistics.cacheHits;
+		toFill.cache = cache;
+		for (size_t i = 0; i < cache->GetNrOfSubMeshes(); ++i)
+			toFill.subMeshes.push_back(cache->GetSubMesh(i));
+
+		finishPhase(loadStatistics.importMilliseconds);
+	}
+	else
+	{
+		if (hashed)
+			++meshCacheStatistics.cacheMisses;
+
+		const aiScene* scene = importer.ReadFile(filepath, flags);
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+			return false;
+
+		size_t sceneBytes = EstimateSceneBytes(scene);
+		RecordMemoryUsage(sceneBytes, 0);
+		finishPhase(loadStatistics.importMilliseconds);
+		ConvertScene(scene, nrOfWorkerThreads, conversionSettings,
+			toFill.convertedSubMeshes);
+		RecordMemoryUsage(sceneBytes, GetStagingBytes(toFill));
+		importer.FreeScene();
+
+		for (auto& subMesh : toFill.convertedSubMeshes)
+			toFill.subMeshes.push_back(subMesh.GetStreams());
+
+		if (hashed) // A failed write only means the next start is also cold
+		{
+			MeshCache::Write(cachePath, sourceHash, flags, settingsKey,
+				toFill.subMeshes);
+		}
+	}
+
+	PrepareDerivedData(toFill);
+	finishPhase(loadStatistics.convertMilliseconds);
+
+	bool decoded = DecodeTextures(toFill);
+	RecordMemoryUsage(0, GetStagingBytes(toFill));
+	finishPhase(loadStatistics.decodeMilliseconds);
+
+	return decoded;
+}
+
+bool MeshResourceLoader::StreamMesh(const std::string& file,
+	const std::function<bool(std::unique_ptr<PreparedMesh> batch)>& consumer)
+{
+	BeginLoad();
+	auto phaseStart = std::chrono::steady_clock::now();
+	auto finishPhase = [&phaseStart](double& toAddTo)
+	{
+		auto now = std::chrono::steady_clock::now();
+		toAddTo += std::chrono::duration<double, std::milli>(now - phaseStart).count();
+		phaseStart = now;
+	};
+
+	std::string filepath = directories.meshDirectory + file;
+	std::uint64_t sourceHash = 0;
+	bool hashed = useMeshCache &&
+		MeshCache::HashMeshSource(filepath, sourceHash);
 
-	for (UINT row = 0; row < rows[currentMipLevel]; ++row)
+	auto cache = std::make_shared<MeshCache>();
+	std::unique_ptr<aiScene> scene;
+	std::vector<const aiMesh*> orderedMeshes;
+	size_t nrOfSubMeshes = 0;
+	if (hashed && cache->Open(MeshCache::GetCachePath(filepath), sourceHash, flags,
+		conversionSettings.GetKey()))
+	{
+		++meshCacheStatistics.cacheHits;
+		nrOfSubMeshes = cache->GetNrOfSubMeshes();
+	}
+	else
 	{
-		for (UINT64 rowTexel = 0; rowTexel < texelsPerRow; ++rowTexel)
+		if (hashed)
+			++meshCacheStatistics.cacheMisses;
+
+		const aiScene* imported = importer.ReadFile(filepath, flags);
+		if (!imported || imported->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+			!imported->mRootNode)
 		{
-			for (std::uint8_t component = 0; component < componentsPerTexel; ++component)
-			{
-				ComponentType topLeft = *parentData;
-				ComponentType bottomLeft = ComponentType(0);
-				ComponentType topRight = ComponentType(0);
-				ComponentType bottomRight = ComponentType(0);
-				std::uint8_t divider = 1;
+			return false;
+		}
 
-				if (row + 1 < rows[currentMipLevel])
-				{
-					bottomLeft = *(parentData + parentComponentsPerRow);
-					divider += 1;
-				}
+		// Owning the scene allows freeing its meshes one at a time
+		scene.reset(importer.GetOrphanedScene());
+		GatherMeshes(scene->mRootNode, scene.get(), orderedMeshes);
+		nrOfSubMeshes = orderedMeshes.size();
+	}
 
-				if (rowTexel + 1 < texelsPerRow)
-				{
-					topRight = *(parentData + componentsPerTexel);
-					divider += 1;
-				}
-				
-				if (row + 1 < rows[currentMipLevel] && rowTexel + 1 < texelsPerRow)
-				{
-					bottomRight = *(parentData + parentComponentsPerRow + componentsPerTexel);
-					divider += 1;
-				}
+	size_t sceneBytes = scene ? EstimateSceneBytes(scene.get()) : 0;
+	RecordMemoryUsage(sceneBytes, 0);
+	finishPhase(loadStatistics.importMilliseconds);
+
+	// A mesh referenced by several nodes is freed after its last sub mesh
+	std::unordered_map<const aiMesh*, size_t> lastUses;
+	for (size_t i = 0; i < orderedMeshes.size(); ++i)
+		lastUses[orderedMeshes[i]] = i;
+
+	std::unordered_set<std::string> batchTextures;
+	auto estimateTexture = [&](const std::string& directory,
+		const std::string& name,
+		const std::unordered_map<std::string, LoadedTexture>& loadedTextures)
+	{
+		std::string texturePath = directory + name;
+		if (name.empty() || loadedTextures.count(texturePath) != 0 ||
+			!batchTextures.insert(texturePath).second)
+		{
+			return size_t(0);
+		}
+
+		return EstimateTextureBytes(texturePath);
+	};
+
+	for (size_t first = 0; first < nrOfSubMeshes;)
+	{
+		size_t end = first;
+		size_t batchBytes = 0;
+		batchTextures.clear();
+		while (end < nrOfSubMeshes)
+		{
+			size_t subMeshBytes = 0;
+			std::string textureNames[3];
+			if (scene)
+			{
+				const aiMesh* mesh = orderedMeshes[end];
+				const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+				subMeshBytes = EstimateSubMeshBytes(mesh->mNumVertices,
+					static_cast<size_t>(mesh->mNumFaces) * 3, conversionSettings);
+				textureNames[0] = GetTextureName(material, aiTextureType_DIFFUSE);
+				textureNames[1] = GetTextureName(material, aiTextureType_SPECULAR);
+				textureNames[2] = GetTextureName(material, aiTextureType_NORMALS);
+			}
+			else
+			{
+				const SubMeshStreams& streams = cache->GetSubMesh(end);
+				subMeshBytes = EstimateSubMeshBytes(streams.nrOfVertices,
+					streams.nrOfIndices, conversionSettings);
+				const char* names[3] = { streams.diffuseMap, streams.specularMap,
+					streams.normalMap };
+				for (unsigned int i = 0; i < 3; ++i)
+					textureNames[i] = names[i] == nullptr ? "" : names[i];
+			}
 
-				CombinationType combinedComponents = topLeft + topRight +
-					bottomLeft + bottomRight;
-				combinedComponents /= divider;
+			subMeshBytes += estimateTexture(directories.diffuseMapDirectory,
+				textureNames[0], loadedDiffuseMaps);
+			subMeshBytes += estimateTexture(directories.specularMapDirectory,
+				textureNames[1], loadedSpecularMaps);
+			subMeshBytes += estimateTexture(directories.normalMapDirectory,
+				textureNames[2], loadedNormalMaps);
 
-				*currentData = static_cast<ComponentType>(combinedComponents);
-				currentData += 1;
-				parentData += 1;
+			if (end > first && memoryBudget != 0 &&
+				batchBytes + subMeshBytes > memoryBudget)
+			{
+				break;
 			}
 
-			parentData += componentsPerTexel;
+			batchBytes += subMeshBytes;
+			++end;
 		}
 
-		if (rows[currentMipLevel] % 2 == 1)
-			parentData += componentsPerTexel;
+		auto batch = std::make_unique<PreparedMesh>();
+		batch->file = file;
+		if (scene)
+		{
+			ConvertMeshes(scene.get(), orderedMeshes.data() + first, end - first,
+				nrOfWorkerThreads, conversionSettings, batch->convertedSubMeshes);
+			for (auto& subMesh : batch->convertedSubMeshes)
+				batch->subMeshes.push_back(subMesh.GetStreams());
 
-		parentData += parentComponentsPerRow;
-	}
+			RecordMemoryUsage(sceneBytes, GetStagingBytes(*batch));
+			for (size_t i = first; i < end; ++i)
+			{
+				if (lastUses[orderedMeshes[i]] == i)
+					sceneBytes -= FreeSceneMesh(scene.get(), orderedMeshes[i]);
+			}
+		}
+		else
+		{
+			batch->cache = cache;
+			for (size_t i = first; i < end; ++i)
+				batch->subMeshes.push_back(cache->GetSubMesh(i));
+		}
 
-	size_t dataStart = parentDataStart +
-		rows[currentMipLevel - 1] * rowSizes[currentMipLevel - 1];
-	textureComponent.SetUpdateData(index, data.data() + dataStart,
-		static_cast<std::uint8_t>(currentMipLevel));
+		PrepareDerivedData(*batch);
+		finishPhase(loadStatistics.convertMilliseconds);
 
-	if (currentMipLevel + 1 < rows.size())
-	{
-		size_t nextLevelDataStart = parentDataStart + 
-			rows[currentMipLevel - 1] * rowSizes[currentMipLevel - 1];
-		GenerateMipData<ComponentType, CombinationType>(data, rows, rowSizes,
-			currentMipLevel + 1, nextLevelDataStart, componentsPerTexel,
-			index, textureComponent);
+		bool decoded = DecodeTextures(*batch);
+		RecordMemoryUsage(sceneBytes, GetStagingBytes(*batch));
+		finishPhase(loadStatistics.decodeMilliseconds);
+
+		if (!decoded || !consumer(std::move(batch)))
+			return false;
+
+		phaseStart = std::chrono::steady_clock::now(); // Consumers time themselves
+		++loadStatistics.nrOfBatches;
+		first = end;
 	}
+
+	RecordMemoryUsage(sceneBytes, 0);
+	return true;
 }
 
-std::vector<unsigned char> MeshResourceLoader::CreateMipData(unsigned char* originalData,
-	std::uint8_t componentsPerTexel, TexelFormat texelFormat, ID3D12Resource* resource,
-	ResourceIndex index, FrameTexture2DComponent<1>& textureComponent)
+std::unique_ptr<AsyncMeshPreparation> MeshResourceLoader::PrepareMeshAsync(
+	const std::string& file)
 {
-	auto desc = resource->GetDesc();
-	ID3D12Device* device = nullptr;
-	HRESULT hr = resource->GetDevice(IID_PPV_ARGS(&device));
+	auto toReturn = std::make_unique<AsyncMeshPreparation>();
+	MeshResourceLoader& preparer = toReturn->preparer;
+	preparer.directories = directories;
+	preparer.flags = flags;
+	preparer.nrOfWorkerThreads = nrOfWorkerThreads;
+	preparer.vertexLayout = vertexLayout;
+	preparer.useMeshCache = useMeshCache;
+	preparer.useBakedTextures = useBakedTextures;
+	preparer.buildMeshlets = buildMeshlets;
+	preparer.conversionSettings = conversionSettings;
+	preparer.narrowMaterialMaps = narrowMaterialMaps;
+	preparer.memoryBudget = memoryBudget != 0 ? memoryBudget : ASYNC_BATCH_BYTES;
+	preparer.loadedDiffuseMaps = loadedDiffuseMaps;
+	preparer.loadedSpecularMaps = loadedSpecularMaps;
+	preparer.loadedNormalMaps = loadedNormalMaps;
+	GetDecodePool();
+	preparer.decodePool = decodePool;
 
-	if (FAILED(hr) || device == nullptr)
-		throw std::runtime_error("Could not generate mip maps due to failure to get device");
+	toReturn->thread = std::thread(&AsyncMeshPreparation::Run, toReturn.get(),
+		file);
+	return toReturn;
+}
 
-	std::vector<UINT> rows(desc.MipLevels);
-	std::vector<UINT64> rowSizes(desc.MipLevels);
-	device->GetCopyableFootprints(&desc, 0, desc.MipLevels, 0,
-		nullptr, rows.data(), rowSizes.data(), nullptr);
-	size_t totalSize = 0;
+MeshIndex MeshResourceLoader::LoadMeshAsync(const std::string& file)
+{
+	auto loaded = loadedFiles.find(file);
+	if (loaded != loadedFiles.end())
+	{
+		++meshReferences[loaded->second].referenceCount;
+		return loaded->second;
+	}
 
-	for (UINT16 mipLevel = 0; mipLevel < desc.MipLevels; ++mipLevel)
-		totalSize += rows[mipLevel] * rowSizes[mipLevel];
+	MeshIndex toReturn = StoreMesh(file, Mesh());
+	asyncLoads[toReturn].preparation = PrepareMeshAsync(file);
+
+	return toReturn;
+}
 
-	std::vector<unsigned char> toReturn(totalSize);
-	memcpy(toReturn.data(), originalData, rows[0] * rowSizes[0]);
-	textureComponent.SetUpdateData(index, toReturn.data(), 0);
+AsyncLoadState MeshResourceLoader::GetAsyncLoadState(MeshIndex index)
+{
+	if (asyncLoads.count(index) != 0)
+		return AsyncLoadState::LOADING;
+
+	auto reference = meshReferences.find(index);
+	return reference != meshReferences.end() && reference->second.failed ?
+		AsyncLoadState::FAILED : AsyncLoadState::COMPLETE;
+}
 
-	if (texelFormat == TexelFormat::BYTE)
+void MeshResourceLoader::RememberDecodedTextures(const PreparedMesh& batch)
+{
+	auto remember = [&batch](const std::string& directory, const char* name,
+		std::unordered_map<std::string, LoadedTexture>& loadedTextures)
 	{
-		GenerateMipData<std::uint8_t, std::uint16_t>(toReturn, rows,
-			rowSizes, 1, 0, componentsPerTexel, index, textureComponent);
-	}
-	else if (texelFormat == TexelFormat::FLOAT)
+		if (name == nullptr)
+			return;
+
+		std::string filepath = directory + name;
+		if (batch.textures.count(filepath) != 0)
+			loadedTextures.emplace(filepath, LoadedTexture());
+	};
+
+	for (const auto& streams : batch.subMeshes)
 	{
-		GenerateMipData<float, double>(toReturn, rows, rowSizes,
-			1, 0, componentsPerTexel, index, textureComponent);
+		remember(directories.diffuseMapDirectory, streams.diffuseMap,
+			loadedDiffuseMaps);
+		remember(directories.specularMapDirectory, streams.specularMap,
+			loadedSpecularMaps);
+		remember(directories.normalMapDirectory, streams.normalMap,
+			loadedNormalMaps);
 	}
-	else
+}
+
+void MeshResourceLoader::FinishAsyncLoads()
+{
+	for (auto entry = asyncLoads.begin(); entry != asyncLoads.end();)
 	{
-		throw std::runtime_error("Unknown texel format when generating mip maps!");
+		AsyncLoad& load = entry->second;
+		AsyncMeshPreparation& preparation = *load.preparation;
+		if (!load.failed)
+		{
+			// Finished has to be read before the queue is found empty, or a
+			// batch pushed in between would be missed
+			bool finished = preparation.IsFinished();
+			bool drained = load.currentBatch == nullptr &&
+				!preparation.TryPopBatch(load.currentBatch);
+			if (!finished || !drained)
+			{
+				++entry;
+				continue;
+			}
+
+			load.failed = !preparation.Succeeded();
+		}
+
+		if (load.failed)
+		{
+			// Waits for the thread once, the failure is kept by the reference
+			preparation.Cancel();
+			meshReferences[entry->first].failed = true;
+			entry = asyncLoads.erase(entry);
+			continue;
+		}
+
+		loadStatistics = preparation.GetLoadStatistics();
+		loadStatistics.uploadMilliseconds = load.uploadMilliseconds;
+		const MeshCacheStatistics& cacheStatistics =
+			preparation.preparer.GetMeshCacheStatistics();
+		meshCacheStatistics.cacheHits += cacheStatistics.cacheHits;
+		meshCacheStatistics.cacheMisses += cacheStatistics.cacheMisses;
+		entry = asyncLoads.erase(entry);
 	}
-	
-	device->Release();
-	return toReturn;
 }
 
-bool MeshResourceLoader::ProcessMaterial(aiMaterial* material,
-	aiTextureType textureType, const std::string& textureDirectory,
-	ResourceIndex& toSet, TexelFormat format, std::uint8_t componentsPerTexel,
-	FrameTexture2DComponent<1>& textureComponent)
+const Mesh& MeshResourceLoader::GetMeshInfo(MeshIndex index)
 {
-	unsigned int textureCount = material->GetTextureCount(textureType);
-	if (textureCount == 0) // No texture of this type, this is fine
-		return true;
+	return meshes[index];
+}
 
-	aiString name;
-	material->GetTexture(textureType, 0, &name);
-
-	std::string filepath = textureDirectory + name.C_Str();
-	int width = 0, height = 0;
-	void* data = nullptr;
-	std::uint8_t componentSize = 0;
-
-	switch (format)
-	{
-	case TexelFormat::BYTE:
-		data = stbi_load(filepath.c_str(), &width, &height,
-			nullptr, componentsPerTexel);
-		componentSize = 1;
-		break;
-	case TexelFormat::FLOAT:
-		data = stbi_loadf(filepath.c_str(), &width, &height,
-			nullptr, componentsPerTexel);
-		componentSize = 4;
-		break;
-	default:
-		break;
-	}
+void MeshResourceLoader::SetMeshCacheUsage(bool enabled)
+{
+	useMeshCache = enabled;
+}
 
-	if (data == nullptr)
-		return false;
+void MeshResourceLoader::SetBakedTextureUsage(bool enabled)
+{
+	useBakedTextures = enabled;
+}
 
-	TextureAllocationInfo allocationInfo(width, height, 1, 0);
-	toSet = textureComponent.CreateTexture(allocationInfo);
-	if (toSet == ResourceIndex(-1))
-		return false;
+void MeshResourceLoader::SetMaterialMapNarrowing(bool enabled)
+{
+	narrowMaterialMaps = enabled;
+}
 
-	auto handle = textureComponent.GetTextureHandle(toSet);
-	auto mipMappedData = CreateMipData(static_cast<unsigned char*>(data), 
-		componentsPerTexel, format, handle.resource, toSet, textureComponent);
+void MeshResourceLoader::SetHdrTexturePacking(bool enabled)
+{
+	packHdrTextures = enabled;
+}
 
-	STBI_FREE(data);
+void MeshResourceLoader::SetMipFiltering(const MipFilteringSettings& settings)
+{
+	mipFilteringSettings = settings;
+}
 
-	return true;
+void MeshResourceLoader::SetTextureStreaming(
+	const TextureStreamingSettings& settings)
+{
+	textureStreamer.SetSettings(settings);
 }
 
-bool MeshResourceLoader::ProcessVertexComponent2(ResourceIndex& toSet,
-	aiVector3D* data, unsigned int nrOfComponents,
-	FrameBufferComponent<1>& bufferComponent)
+void MeshResourceLoader::SetMemoryBudget(size_t bytes)
 {
-	if (data == nullptr)
-		return true;
+	memoryBudget = bytes;
+}
 
-	static std::vector<XMFLOAT2> temp;
-	temp.clear();
-	temp.resize(nrOfComponents);
+void MeshResourceLoader::SetVertexOrderOptimization(bool enabled)
+{
+	conversionSettings.optimizeVertexOrder = enabled;
+}
 
-	for (unsigned int i = 0; i < nrOfComponents; ++i)
-		temp[i] = XMFLOAT2(data[i].x, data[i].y);
+void MeshResourceLoader::SetLevelsOfDetail(unsigned int nrOfLevels,
+	float maxRelativeError)
+{
+	conversionSettings.nrOfLevelsOfDetail = nrOfLevels;
+	conversionSettings.maxSimplificationError = maxRelativeError;
+}
 
-	toSet = bufferComponent.CreateBuffer(nrOfComponents);
+const ConversionSettings& MeshResourceLoader::GetConversionSettings()
+{
+	return conversionSettings;
+}
 
-	if (toSet == ResourceIndex(-1))
-		return false;
+const MeshCacheStatistics& MeshResourceLoader::GetMeshCacheStatistics()
+{
+	return meshCacheStatistics;
+}
 
-	bufferComponent.SetUpdateData(toSet, temp.data());
+const TextureCacheStatistics& MeshResourceLoader::GetTextureCacheStatistics()
+{
+	return textureCacheStatistics;
+}
 
-	return true;
+const MipStagingStatistics& MeshResourceLoader::GetMipStagingStatistics()
+{
+	return mipStagingStatistics;
 }
 
-bool MeshResourceLoader::ProcessVertexComponent3(ResourceIndex& toSet, 
-	aiVector3D* data, unsigned int nrOfComponents,
-	FrameBufferComponent<1>& bufferComponent)
+const TextureStreamingStatistics&
+MeshResourceLoader::GetTextureStreamingStatistics()
 {
-	if (data == nullptr)
-		return true;
+	return textureStreamer.GetStatistics();
+}
 
-	static std::vector<XMFLOAT3> temp;
-	temp.clear();
-	temp.resize(nrOfComponents);
+TextureDecodeStatistics MeshResourceLoader::GetTextureDecodeStatistics()
+{
+	if (decodePool == nullptr)
+		return TextureDecodeStatistics();
 
-	for (unsigned int i = 0; i < nrOfComponents; ++i)
-		temp[i] = XMFLOAT3(data[i].x, data[i].y, data[i].z);
+	return decodePool->GetStatistics();
+}
 
-	toSet = bufferComponent.CreateBuffer(nrOfComponents);
+const LoadStatistics& MeshResourceLoader::GetLoadStatistics()
+{
+	return loadStatistics;
+}
 
-	if (toSet == ResourceIndex(-1))
+VertexLayout MeshResourceLoader::GetVertexLayout()
+{
+	return vertexLayout;
+}
+
+unsigned int MeshResourceLoader::GetImportFlags()
+{
+	return aiProcess_JoinIdenticalVertices |
+		aiProcess_Triangulate | aiProcess_ConvertToLeftHanded |
+		aiProcess_GenNormals | aiProcess_ValidateDataStructure |
+		aiProcess_FindInvalidData |
+		aiProcess_GenUVCoords | aiProcess_TransformUVCoords |
+		aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
+		aiProcess_CalcTangentSpace | 0;
+}
+
+size_t MeshResourceLoader::GetStagingBytes(const PreparedMesh& preparedMesh)
+{
+	size_t bytes = 0;
+	for (auto& subMesh : preparedMesh.convertedSubMeshes)
+	{
+		bytes += GetVectorBytes(subMesh.positions) + GetVectorBytes(subMesh.uvs) +
+			GetVectorBytes(subMesh.normals) + GetVectorBytes(subMesh.tangents) +
+			GetVectorBytes(subMesh.bitangents) + GetVectorBytes(subMesh.indices) +
+			GetVectorBytes(subMesh.levelsOfDetail);
+	}
+
+	for (auto& packed : preparedMesh.packedAttributes)
+		bytes += GetVectorBytes(packed);
+	for (auto& quantized : preparedMesh.quantizedAttributes)
+		bytes += GetVectorBytes(quantized);
+	for (auto& narrowed : preparedMesh.shortIndices)
+		bytes += GetVectorBytes(narrowed);
+
+	for (auto& meshlets : preparedMesh.meshlets)
+	{
+		bytes += GetVectorBytes(meshlets.meshlets) + GetVectorBytes(meshlets.bounds) +
+			GetVectorBytes(meshlets.vertices) + GetVectorBytes(meshlets.primitives);
+	}
+
+	for (auto& texture : preparedMesh.textures)
+	{
+		if (texture.second.data != nullptr)
+		{
+			bytes += static_cast<size_t>(texture.second.width) *
+				static_cast<size_t>(texture.second.height) *
+				(texture.second.hdr ? 4 * sizeof(float) : 4);
+		}
+	}
+
+	return bytes;
+}
+
+bool MeshResourceLoader::BakeMeshCache(const std::string& filepath,
+	const ConversionSettings& settings)
+{
+	std::uint64_t sourceHash = 0;
+	if (!MeshCache::HashMeshSource(filepath, sourceHash))
 		return false;
 
-	bufferComponent.SetUpdateData(toSet, temp.data());
+	Assimp::Importer bakeImporter;
+	const aiScene* scene = bakeImporter.ReadFile(filepath, GetImportFlags());
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		return false;
 
-	return true;
+	std::vector<SubMeshData> converted;
+	ConvertScene(scene, std::max(std::thread::hardware_concurrency(), 1u),
+		settings, converted);
+
+	std::vector<SubMeshStreams> streams;
+	for (auto& subMesh : converted)
+		streams.push_back(subMesh.GetStreams());
+
+	return MeshCache::Write(MeshCache::GetCachePath(filepath), sourceHash,
+		GetImportFlags(), settings.GetKey(), streams);
 }
 
-const Mesh& MeshResourceLoader::GetMeshInfo(MeshIndex index)
+// Bakes the texture the way ProcessTexture would create it from the source,
+// as BYTE RGBA with every mip filtered for the map by GenerateMipChain
+bool MeshResourceLoader::BakeTexture(const std::string& filepath,
+	MaterialMap map)
 {
-	return meshes[index];
+	std::uint64_t sourceHash = 0;
+	if (!MeshCache::HashFile(filepath, sourceHash))
+		return false;
+
+	int width = 0;
+	int height = 0;
+	stbi_uc* decoded = stbi_load(filepath.c_str(), &width, &height, nullptr, 4);
+	if (decoded == nullptr)
+		return false;
+
+	std::vector<UINT> rows;
+	std::vector<UINT64> rowSizes;
+	CalculateMipChainLayout(width, height, 4, rows, rowSizes);
+	size_t totalSize = 0;
+	for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+		totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+	std::vector<unsigned char> mipChain(totalSize);
+	memcpy(mipChain.data(), decoded, rows[0] * rowSizes[0]);
+	STBI_FREE(decoded);
+	GenerateMipChain(mipChain.data(), rows, rowSizes, 4, TexelFormat::BYTE,
+		GetMipFilterSettings(map, MipFilteringSettings()));
+
+	return BakedTexture::Write(BakedTexture::GetBakedPath(filepath), sourceHash,
+		width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4, mipChain.data());
+}
+
+MipFilterSettings MeshResourceLoader::GetMipFilterSettings(MaterialMap map,
+	const MipFilteringSettings& settings)
+{
+	MipFilterSettings toReturn;
+	toReturn.kernel = settings.kernel;
+	if (map == MaterialMap::NORMAL)
+	{
+		toReturn.renormalizeNormals = settings.renormalizeNormals;
+	}
+	else
+	{
+		toReturn.gammaCorrect = settings.gammaCorrectColour;
+		toReturn.preserveAlphaCoverage = map == MaterialMap::DIFFUSE &&
+			settings.preserveAlphaCoverage;
+		toReturn.alphaCutoff = ALPHA_CLIP_THRESHOLD;
+	}
+
+	return toReturn;
 }
 
 const ComponentIdentifier& MeshResourceLoader::GetPositionComponentIdentifier()
@@ -260,11 +1661,48 @@ const ComponentIdentifier& MeshResourceLoader::GetBitangentComponentIdentifier()
 	return bitangentBufferComponent;
 }
 
+const ComponentIdentifier& MeshResourceLoader::GetPackedAttributeComponentIdentifier()
+{
+	return packedAttributeBufferComponent;
+}
+
 const ComponentIdentifier& MeshResourceLoader::GetIndicesComponentIdentifier()
 {
 	return indicesBufferComponent;
 }
 
+const ComponentIdentifier& MeshResourceLoader::GetShortIndicesComponentIdentifier()
+{
+	return shortIndicesBufferComponent;
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetIndicesComponentIdentifier(
+	const SubMesh& subMesh)
+{
+	return subMesh.indexFormat == DXGI_FORMAT_R16_UINT ?
+		shortIndicesBufferComponent : indicesBufferComponent;
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetMeshletComponentIdentifier()
+{
+	return meshletBufferComponent;
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetMeshletBoundsComponentIdentifier()
+{
+	return meshletBoundsBufferComponent;
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetMeshletVertexComponentIdentifier()
+{
+	return meshletVertexBufferComponent;
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetMeshletPrimitiveComponentIdentifier()
+{
+	return meshletPrimitiveBufferComponent;
+}
+
 const ComponentIdentifier& MeshResourceLoader::GetDiffuseMapComponentIdentifier()
 {
 	return diffuseMapTextureComponent;
@@ -279,3 +1717,119 @@ const ComponentIdentifier& MeshResourceLoader::GetNormalMapComponentIdentifier()
 {
 	return normalMapTextureComponent;
 }
+
+const ComponentIdentifier& MeshResourceLoader::GetDiffuseMapComponentIdentifier(
+	const SubMesh& subMesh)
+{
+	return GetMaterialMapComponentIdentifier(MaterialMap::DIFFUSE,
+		subMesh.diffuseMapFormat);
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetSpecularMapComponentIdentifier(
+	const SubMesh& subMesh)
+{
+	return GetMaterialMapComponentIdentifier(MaterialMap::SPECULAR,
+		subMesh.specularMapFormat);
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetNormalMapComponentIdentifier(
+	const SubMesh& subMesh)
+{
+	return GetMaterialMapComponentIdentifier(MaterialMap::NORMAL,
+		subMesh.normalMapFormat);
+}
+
+const ComponentIdentifier& MeshResourceLoader::GetMaterialMapComponentIdentifier(
+	MaterialMap map, DXGI_FORMAT format)
+{
+	switch (map)
+	{
+	case MaterialMap::SPECULAR:
+		if (format == DXGI_FORMAT_R8_UNORM)
+			return greyscaleSpecularMapTextureComponent;
+
+		return specularMapTextureComponent;
+	case MaterialMap::NORMAL:
+		if (format == DXGI_FORMAT_R8G8_UNORM)
+			return twoChannelNormalMapTextureComponent;
+
+		return normalMapTextureComponent;
+	default:
+		if (format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+			return hdrDiffuseMapTextureComponent;
+		else if (format == DXGI_FORMAT_R11G11B10_FLOAT)
+			return packedHdrDiffuseMapTextureComponent;
+
+		return diffuseMapTextureComponent;
+	}
+}
+
+AsyncMeshPreparation::AsyncMeshPreparation() :
+	completedBatches(ASYNC_QUEUE_CAPACITY), cancelled(false), finished(false),
+	succeeded(false)
+{
+}
+
+AsyncMeshPreparation::~AsyncMeshPreparation()
+{
+	Cancel();
+}
+
+void AsyncMeshPreparation::Run(const std::string& file)
+{
+	bool streamed = preparer.StreamMesh(file,
+		[this](std::unique_ptr<PreparedMesh> batch)
+		{
+			return PushBatch(std::move(batch));
+		});
+
+	succeeded = streamed;
+	finished = true;
+}
+
+// The batches are uploaded in order, so the textures of this batch are loaded
+// before any later batch is uploaded
+bool AsyncMeshPreparation::PushBatch(std::unique_ptr<PreparedMesh> batch)
+{
+	preparer.RememberDecodedTextures(*batch);
+	while (!completedBatches.TryPush(std::move(batch)))
+	{
+		if (cancelled)
+			return false;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return !cancelled;
+}
+
+bool AsyncMeshPreparation::TryPopBatch(std::unique_ptr<PreparedMesh>& toFill)
+{
+	return completedBatches.TryPop(toFill);
+}
+
+bool AsyncMeshPreparation::IsFinished() const
+{
+	return finished;
+}
+
+bool AsyncMeshPreparation::Succeeded() const
+{
+	return succeeded;
+}
+
+void AsyncMeshPreparation::Cancel()
+{
+	cancelled = true;
+	preparer.CancelTextureDecodes();
+	if (thread.joinable())
+		thread.join();
+}
+
+const LoadStatistics& AsyncMeshPreparation::GetLoadStatistics()
+{
+	if (thread.joinable())
+		thread.join();
+
+	return preparer.GetLoadStatistics();
+}
\ No newline at end of file
@@ -1,9 +1,17 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
 
 #include <DirectXMath.h>
 
@@ -14,20 +22,62 @@
 #include "NSGG Scene\Headers\ManagedResourceComponents.h"
 #include "NSGG Core\Headers\StableVector.h"
 
+#include "MeshCache.h"
+#include "VertexPacking.h"
+#include "VertexQuantization.h"
+#include "IndexNarrowing.h"
+#include "VertexCacheOptimization.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplification.h"
+#include "LockFreeQueue.h"
+#include "TextureDecodePool.h"
+#include "MipGeneration.h"
+#include "MaterialMapNarrowing.h"
+#include "TextureStreaming.h"
+
+// Batch size of asynchronous loads when the loader has no memory budget, and
+// how many prepared batches may wait for the render thread at once
+const size_t ASYNC_BATCH_BYTES = 32 * 1024 * 1024;
+const size_t ASYNC_QUEUE_CAPACITY = 2;
+
+// The index count is that of the full detail level. The index buffer holds
+// every level of detail, the first of which is always the full detail one.
 struct SubMesh
 {
 	unsigned int indexCount;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
+	std::vector<LevelOfDetail> levelsOfDetail;
 
 	ResourceIndex position = ResourceIndex(-1);
 	ResourceIndex uv = ResourceIndex(-1);
 	ResourceIndex normal = ResourceIndex(-1);
 	ResourceIndex tangent = ResourceIndex(-1);
-	ResourceIndex bitangent = ResourceIndex(-1);
+	ResourceIndex bitangent = ResourceIndex(-1); // Only if they are stored
+	ResourceIndex packedAttributes = ResourceIndex(-1); // Packed or quantized
 	ResourceIndex indices = ResourceIndex(-1);
 
+	// Only set if the loader was initialized to build meshlets
+	unsigned int meshletCount = 0;
+	ResourceIndex meshlets = ResourceIndex(-1);
+	ResourceIndex meshletBounds = ResourceIndex(-1);
+	ResourceIndex meshletVertices = ResourceIndex(-1);
+	ResourceIndex meshletPrimitives = ResourceIndex(-1);
+
+	// HDR diffuse maps and narrowed specular and normal maps are in components
+	// of their own format, see GetDiffuseMapComponentIdentifier,
+	// GetSpecularMapComponentIdentifier and GetNormalMapComponentIdentifier
 	ResourceIndex diffuseMap = ResourceIndex(-1);
 	ResourceIndex specularMap = ResourceIndex(-1);
 	ResourceIndex normalMap = ResourceIndex(-1);
+	DXGI_FORMAT diffuseMapFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	DXGI_FORMAT specularMapFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	DXGI_FORMAT normalMapFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	// Only set if textures are streamed
+	StreamingBounds bounds;
+	StreamedTextureIndex streamedDiffuseMap = StreamedTextureIndex(-1);
+	StreamedTextureIndex streamedSpecularMap = StreamedTextureIndex(-1);
+	StreamedTextureIndex streamedNormalMap = StreamedTextureIndex(-1);
 };
 
 struct Mesh
@@ -35,12 +85,6 @@ struct Mesh
 	std::vector<SubMesh> subMeshes;
 };
 
-enum class TexelFormat
-{
-	BYTE,
-	FLOAT
-};
-
 struct DirectoryInformation
 {
 	std::string meshDirectory;
@@ -59,18 +103,240 @@ struct MemoryRequirements
 	unsigned int diffuseMapsTotalBytes = static_cast<unsigned int>(-1);
 	unsigned int specularMapsTotalBytes = static_cast<unsigned int>(-1);
 	unsigned int normalMapsTotalBytes = static_cast<unsigned int>(-1);
+	unsigned int greyscaleSpecularMapsTotalBytes = static_cast<unsigned int>(-1);
+	unsigned int twoChannelNormalMapsTotalBytes = static_cast<unsigned int>(-1);
+	unsigned int hdrDiffuseMapsTotalBytes = static_cast<unsigned int>(-1);
+	unsigned int packedHdrDiffuseMapsTotalBytes = static_cast<unsigned int>(-1);
+};
+
+// Bytes saved counts the texel data, including mips, that did not have to be
+// decoded and uploaded again because the texture was already loaded
+struct TextureCacheStatistics
+{
+	size_t cacheHits = 0;
+	size_t cacheMisses = 0;
+	size_t bytesSaved = 0;
+};
+
+// Of every mip chain generated on upload since the loader was created. Staged
+// bytes are those of the buffers the loader filtered or packed the levels
+// into, level 0 of BYTE textures is uploaded from where it was decoded and is
+// not staged. Uploaded bytes are those of every level handed to the texture
+// components, which copy them into storage of their own.
+struct MipStagingStatistics
+{
+	size_t nrOfMipChains = 0;
+	size_t stagedBytes = 0;
+	size_t uploadedBytes = 0;
+};
+
+// How sub meshes converted from an imported scene are processed. A mesh cache
+// is only used if it was baked with the same settings.
+struct ConversionSettings
+{
+	bool optimizeVertexOrder = true;
+	bool keepBitangents = false; // Besides the handedness in the tangent w
+	unsigned int nrOfLevelsOfDetail = 0;
+	float maxSimplificationError = DEFAULT_SIMPLIFICATION_ERROR;
+
+	std::uint64_t GetKey() const
+	{
+		std::uint32_t errorBits = 0;
+		if (nrOfLevelsOfDetail > 0)
+			memcpy(&errorBits, &maxSimplificationError, sizeof(float));
+
+		return (static_cast<std::uint64_t>(nrOfLevelsOfDetail) << 34) |
+			(static_cast<std::uint64_t>(keepBitangents ? 1 : 0) << 33) |
+			(static_cast<std::uint64_t>(optimizeVertexOrder ? 1 : 0) << 32) |
+			errorBits;
+	}
+};
+
+enum class MaterialMap
+{
+	DIFFUSE,
+	SPECULAR,
+	NORMAL
+};
+
+// The diffuse alpha below which ModelPS.hlsl clips
+const float ALPHA_CLIP_THRESHOLD = 0.1f;
+
+// How the mips of each material map are filtered. Diffuse and specular maps
+// are averaged as the light the pixel shader decodes them to, the alpha of
+// diffuse maps keeps the share of texels the pixel shader does not clip and
+// normal maps are kept at unit length.
+struct MipFilteringSettings
+{
+	MipKernel kernel = MipKernel::BOX;
+	bool gammaCorrectColour = true;
+	bool preserveAlphaCoverage = true;
+	bool renormalizeNormals = true;
+};
+
+struct MeshCacheStatistics
+{
+	size_t cacheHits = 0;
+	size_t cacheMisses = 0;
+};
+
+// Timings of the most recent load, the import covers either the Assimp import
+// or mapping the mesh cache. Tracked bytes are the CPU memory the loader itself
+// held for the imported scene plus the staging bytes of the converted sub
+// meshes and decoded textures, which is what the memory budget bounds. The
+// working set of the process is only a secondary measure, sampled between
+// phases or batches, it also covers copies held by the resource components
+// and allocator caches.
+// Material map bytes are the texels of the maps the load decoded, mips
+// included, as uploaded. Bytes saved is how much more the narrowed maps among
+// them would have taken as RGBA.
+struct LoadStatistics
+{
+	unsigned int nrOfWorkerThreads = 0;
+	unsigned int nrOfBatches = 0;
+	double importMilliseconds = 0.0;
+	double convertMilliseconds = 0.0;
+	double decodeMilliseconds = 0.0;
+	double uploadMilliseconds = 0.0;
+	size_t peakTrackedBytes = 0;
+	size_t peakStagingBytes = 0;
+	size_t peakWorkingSetBytes = 0;
+	unsigned int nrOfGreyscaleSpecularMaps = 0;
+	unsigned int nrOfTwoChannelNormalMaps = 0;
+	size_t materialMapBytes = 0;
+	size_t materialMapBytesSaved = 0;
+};
+
+// Result of the CPU phase of a load. Everything in here is produced on worker
+// threads, the upload phase only has to create and fill the components.
+struct PreparedMesh
+{
+	std::string file;
+	std::shared_ptr<MeshCache> cache; // Shared by the batches of a streamed load
+	std::vector<SubMeshData> convertedSubMeshes;
+	std::vector<SubMeshStreams> subMeshes;
+	std::vector<std::vector<PackedVertexAttributes>> packedAttributes;
+	std::vector<std::vector<QuantizedVertexAttributes>> quantizedAttributes;
+	std::vector<std::vector<std::uint16_t>> shortIndices; // Empty if too many vertices
+	std::vector<MeshletData> meshlets; // Empty unless meshlets are built
+	std::unordered_map<std::string, DecodedTexture> textures;
+
+	PreparedMesh() = default;
+	~PreparedMesh();
+	PreparedMesh(const PreparedMesh& other) = delete;
+	PreparedMesh& operator=(const PreparedMesh& other) = delete;
+	PreparedMesh(PreparedMesh&& other) = delete;
+	PreparedMesh& operator=(PreparedMesh&& other) = delete;
+};
+
+// The reference count is the number of sub meshes using the texture. The
+// format tells which component of the map type the index belongs to. Streamed
+// textures change index whenever the streamer changes their resident levels.
+struct LoadedTexture
+{
+	ResourceIndex index = ResourceIndex(-1);
+	DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	size_t byteSize = 0;
+	unsigned int referenceCount = 0;
+	StreamedTextureIndex streamedTexture = StreamedTextureIndex(-1);
 };
 
 typedef size_t MeshIndex;
 
+enum class AsyncLoadState
+{
+	LOADING,
+	COMPLETE,
+	FAILED
+};
+
+class AsyncMeshPreparation;
+
 class MeshResourceLoader
 {
 private:
+	friend class AsyncMeshPreparation;
+
+	struct MeshReference
+	{
+		std::string file;
+		unsigned int referenceCount = 0;
+		bool failed = false; // Only set by asynchronous loads
+	};
+
+	// The full mip chain of a streamed texture as uploaded, with the levels
+	// back to back. Level i starts at levelOffsets[i] and the last offset is
+	// the size of the chain.
+	struct StreamedMipChain
+	{
+		MaterialMap map = MaterialMap::DIFFUSE;
+		std::string filepath;
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::vector<size_t> levelOffsets;
+		std::unique_ptr<unsigned char[]> data;
+
+		// Mesh and sub mesh indices of the sub meshes sampling the texture
+		std::vector<std::pair<MeshIndex, size_t>> users;
+	};
+
+	// A streamed texture that was replaced, it is removed from its component
+	// once the frames that may still sample it are done
+	struct RetiredTexture
+	{
+		MaterialMap map = MaterialMap::DIFFUSE;
+		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		ResourceIndex index = ResourceIndex(-1);
+		unsigned int updatesLeft = 0;
+	};
+
+	// Render thread side of an asynchronous load, the current batch is the
+	// one being uploaded and is only released once all its sub meshes are
+	struct AsyncLoad
+	{
+		std::unique_ptr<AsyncMeshPreparation> preparation;
+		std::unique_ptr<PreparedMesh> currentBatch;
+		size_t nextSubMesh = 0;
+		double uploadMilliseconds = 0.0;
+		bool failed = false;
+	};
+
 	StableVector<Mesh> meshes;
 	std::unordered_map<std::string, size_t> loadedFiles;
+	std::unordered_map<MeshIndex, MeshReference> meshReferences;
+	std::unordered_map<std::string, LoadedTexture> loadedDiffuseMaps;
+	std::unordered_map<std::string, LoadedTexture> loadedSpecularMaps;
+	std::unordered_map<std::string, LoadedTexture> loadedNormalMaps;
+	std::unordered_map<MeshIndex, AsyncLoad> asyncLoads;
 
 	Assimp::Importer importer;
 	unsigned int flags = 0;
+	unsigned int nrOfWorkerThreads = 0;
+	VertexLayout vertexLayout = VertexLayout::SEPARATE;
+
+	bool useMeshCache = true;
+	bool useBakedTextures = true;
+	bool buildMeshlets = false;
+	bool narrowMaterialMaps = true;
+	bool packHdrTextures = false;
+	size_t memoryBudget = 0;
+	ConversionSettings conversionSettings;
+	MipFilteringSettings mipFilteringSettings;
+	MeshCacheStatistics meshCacheStatistics;
+	TextureCacheStatistics textureCacheStatistics;
+	MipStagingStatistics mipStagingStatistics;
+	LoadStatistics loadStatistics;
+
+	TextureStreamer textureStreamer;
+	std::unordered_map<StreamedTextureIndex, StreamedMipChain> streamedMipChains;
+	std::vector<RetiredTexture> retiredTextures;
+	std::vector<StreamingChange> streamingChanges;
+
+	// Shared with the preparers of asynchronous loads. The active group is
+	// that of the batch being decoded, so an unload can cancel its decodes.
+	std::shared_ptr<TextureDecodePool> decodePool;
+	std::atomic<DecodeGroup> activeDecodeGroup{ 0 };
+	std::atomic<bool> decodesCancelled{ false };
 
 	DirectoryInformation directories;
 
@@ -79,125 +345,487 @@ private:
 	ComponentIdentifier normalBufferComponent;
 	ComponentIdentifier tangentBufferComponent;
 	ComponentIdentifier bitangentBufferComponent;
+	ComponentIdentifier packedAttributeBufferComponent;
 
 	ComponentIdentifier indicesBufferComponent;
+	ComponentIdentifier shortIndicesBufferComponent;
+
+	ComponentIdentifier meshletBufferComponent;
+	ComponentIdentifier meshletBoundsBufferComponent;
+	ComponentIdentifier meshletVertexBufferComponent;
+	ComponentIdentifier meshletPrimitiveBufferComponent;
 
 	ComponentIdentifier diffuseMapTextureComponent;
 	ComponentIdentifier specularMapTextureComponent;
 	ComponentIdentifier normalMapTextureComponent;
+	ComponentIdentifier greyscaleSpecularMapTextureComponent;
+	ComponentIdentifier twoChannelNormalMapTextureComponent;
+	ComponentIdentifier hdrDiffuseMapTextureComponent;
+	ComponentIdentifier packedHdrDiffuseMapTextureComponent;
 
-	std::vector<unsigned char> CreateMipData(unsigned char* originalData,
+	// Returns the bytes of the mip chain
+	size_t CreateMipData(unsigned char* originalData,
 		std::uint8_t componentsPerTexel, TexelFormat texelFormat,
-		ID3D12Resource* resource, ResourceIndex index,
+		const MipFilterSettings& mipFilter, ID3D12Resource* resource,
+		ResourceIndex index,
 		FrameTexture2DComponent<1>& textureComponent);
 
-	bool ProcessMaterial(aiMaterial* material, aiTextureType textureType,
-		const std::string& textureDirectory, ResourceIndex& toSet,
-		TexelFormat format, std::uint8_t componentsPerTexel,
+	// Same for float RGBA texels, filtered in float and packed to the format
+	// of the resource. Returns the bytes of the packed mip chain.
+	size_t CreateHdrMipData(const float* originalData,
+		const MipFilterSettings& mipFilter, ID3D12Resource* resource,
+		ResourceIndex index,
 		FrameTexture2DComponent<1>& textureComponent);
 
-	bool ProcessVertexComponent2(ResourceIndex& toSet, aiVector3D* data,
-		unsigned int nrOfComponents, FrameBufferComponent<1>& bufferComponent);
-	bool ProcessVertexComponent3(ResourceIndex& toSet, aiVector3D* data,
+	// Full packed mip chain of float RGBA texels, levels back to back. Fills
+	// levelBytes with the size of each level.
+	std::unique_ptr<unsigned char[]> PackHdrMipChain(const float* originalData,
+		unsigned int width, unsigned int height, DXGI_FORMAT format,
+		const MipFilterSettings& mipFilter, std::vector<size_t>& levelBytes);
+
+	StreamedMipChain StageMipChain(const DecodedTexture& texture,
+		DXGI_FORMAT format, TexelFormat texelFormat,
+		const MipFilterSettings& mipFilter);
+
+	// Creates a texture holding the levels of the chain from firstMip on
+	ResourceIndex CreateStreamedTexture(const StreamedMipChain& chain,
+		unsigned int firstMip, FrameTexture2DComponent<1>& textureComponent);
+
+	// Points the sub meshes using a streamed texture at its new index
+	void RetargetTexture(const StreamedMipChain& chain, ResourceIndex to);
+	// Once a sub mesh is part of a stored mesh it is listed as a user of its
+	// streamed textures, so retargeting does not search every mesh
+	void AddStreamedTextureUsers(MeshIndex index, size_t subMeshIndex);
+	void RemoveStreamedTextureUsers(MeshIndex index, size_t subMeshIndex);
+	std::unordered_map<std::string, LoadedTexture>& GetLoadedTextures(
+		MaterialMap map);
+	const ComponentIdentifier& GetMaterialMapComponentIdentifier(
+		MaterialMap map, DXGI_FORMAT format);
+
+	TextureDecodePool& GetDecodePool();
+	bool DecodeTextures(PreparedMesh& preparedMesh);
+	void NarrowMaterialMaps(PreparedMesh& preparedMesh,
+		const std::unordered_map<std::string, MaterialMap>& maps,
+		const std::unordered_set<std::string>& mixedMaps);
+	void CancelTextureDecodes();
+	void PrepareDerivedData(PreparedMesh& preparedMesh);
+
+	void BeginLoad();
+	void RecordMemoryUsage(size_t sceneBytes, size_t stagingBytes);
+	MeshIndex StoreMesh(const std::string& file, Mesh&& toStore);
+
+	// Counts the textures decoded for a batch as loaded, so later batches of
+	// the same asynchronous load do not decode them again
+	void RememberDecodedTextures(const PreparedMesh& batch);
+	void FinishAsyncLoads();
+
+	// Uploads every level of a decoded or baked texture, returns their bytes
+	size_t UploadMipChain(const DecodedTexture& texture, TexelFormat format,
+		const MipFilterSettings& mipFilter, ResourceIndex index,
+		FrameTexture2DComponent<1>& textureComponent);
+
+	// Format the texture is uploaded as, that of the loaded texture if it is
+	// loaded already
+	DXGI_FORMAT GetMaterialMapFormat(const PreparedMesh& preparedMesh,
+		const std::string& filepath,
+		const std::unordered_map<std::string, LoadedTexture>& loadedTextures);
+	bool ProcessTexture(const PreparedMesh& preparedMesh,
+		const std::string& filepath, MaterialMap map,
+		const StreamingBounds& bounds, ResourceIndex& toSet,
+		StreamedTextureIndex& streamedToSet, TexelFormat format,
+		const MipFilterSettings& mipFilter,
+		FrameTexture2DComponent<1>& textureComponent,
+		std::unordered_map<std::string, LoadedTexture>& loadedTextures);
+
+	bool ProcessVertexComponent2(ResourceIndex& toSet,
+		const DirectX::XMFLOAT2* data, unsigned int nrOfComponents,
+		FrameBufferComponent<1>& bufferComponent);
+	bool ProcessVertexComponent3(ResourceIndex& toSet,
+		const DirectX::XMFLOAT3* data, unsigned int nrOfComponents,
+		FrameBufferComponent<1>& bufferComponent);
+	bool ProcessVertexComponent4(ResourceIndex& toSet,
+		const DirectX::XMFLOAT4* data, unsigned int nrOfComponents,
+		FrameBufferComponent<1>& bufferComponent);
+	// Creates a buffer of nrOfComponents elements and sets its data
+	bool ProcessBufferData(ResourceIndex& toSet, const void* data,
 		unsigned int nrOfComponents, FrameBufferComponent<1>& bufferComponent);
 
+	void ReleaseBuffer(ResourceIndex index,
+		FrameBufferComponent<1>& bufferComponent);
+	void ReleaseTexture(ResourceIndex index, DXGI_FORMAT format,
+		const StreamingBounds& bounds,
+		std::unordered_map<std::string, LoadedTexture>& loadedTextures,
+		FrameTexture2DComponent<1>& textureComponent);
+
 	template<FrameType Frames>
-	bool ProcessIndices(SubMesh& subMesh, aiMesh* currentMesh,
+	bool ProcessIndices(SubMesh& subMesh, const SubMeshStreams& streams,
+		const std::vector<std::uint16_t>& shortIndices,
 		ManagedResourceComponents<Frames>& resourceComponents);
 
 	template<FrameType Frames>
-	bool ProcessVertexComponents(SubMesh& subMesh, aiMesh* currentMesh,
+	bool ProcessMeshlets(SubMesh& subMesh, const MeshletData& meshletData,
 		ManagedResourceComponents<Frames>& resourceComponents);
 
 	template<FrameType Frames>
-	bool ProcessMaterials(const aiScene* scene, unsigned int materialIndex,
-		SubMesh& subMesh, ManagedResourceComponents<Frames>& resourceComponents);
+	bool ProcessVertexComponents(SubMesh& subMesh,
+		const SubMeshStreams& streams, const void* packedAttributes,
+		ManagedResourceComponents<Frames>& resourceComponents);
 
 	template<FrameType Frames>
-	bool ProcessNode(aiNode* node, const aiScene* scene,
-		Mesh& mesh, ManagedResourceComponents<Frames>& resourceComponents);
+	bool ProcessMaterials(const PreparedMesh& preparedMesh,
+		const SubMeshStreams& streams, SubMesh& subMesh,
+		ManagedResourceComponents<Frames>& resourceComponents);
 
+	template<FrameType Frames>
+	bool ProcessSubMesh(const PreparedMesh& preparedMesh,
+		size_t subMeshIndex, Mesh& mesh,
+		ManagedResourceComponents<Frames>& resourceComponents);
+
+	static void ConvertMeshes(const aiScene* scene, const aiMesh* const* meshes,
+		size_t nrOfMeshes, unsigned int nrOfThreads,
+		const ConversionSettings& settings, std::vector<SubMeshData>& toFill);
+	static void ConvertScene(const aiScene* scene, unsigned int nrOfThreads,
+		const ConversionSettings& settings, std::vector<SubMeshData>& toFill);
 
 public:
+	MeshResourceLoader() = default;
+	~MeshResourceLoader(); // Cancels asynchronous loads that are still running
 
+	// With the packed layout only the position, packed attribute and indices
+	// buffer components are created, the other vertex components stay unset.
+	// The meshlet components are only created if meshlets are built.
+	// With storeBitangents the separate layout uploads the imported bitangents
+	// to a component of their own, for tangent spaces that are not orthogonal
+	// and so differ from the one ModelVS.hlsl rebuilds from the handedness.
+	// The packed and quantized layouts always rebuild them.
 	template<FrameType Frames>
 	void Initialize(const DirectoryInformation& directoryInformation,
 		ManagedResourceComponents<Frames>& resourceComponents,
-		const MemoryRequirements& neededMemory);
+		const MemoryRequirements& neededMemory,
+		VertexLayout layout = VertexLayout::SEPARATE,
+		bool storeBitangents = false, bool generateMeshlets = false);
+
+	void SetDirectoryInformation(const DirectoryInformation& directoryInformation);
+	// Threads used to convert sub meshes and to decode textures, 0 uses one
+	// per hardware thread
+	void SetNrOfWorkerThreads(unsigned int nrOfThreads);
+
+	bool PrepareMesh(const std::string& file, PreparedMesh& toFill);
+
+	// Prepares the sub meshes of the file in batches that fit the memory
+	// budget and hands each batch to the consumer, which owns it from then on.
+	// Imported meshes are freed as soon as they are no longer needed. Mesh
+	// caches are used if present but never written, as the converted data is
+	// never held at once, so a streamed load stays cold until the cache is
+	// baked or the mesh is loaded without a budget. Returns false if a batch fails to prepare or the
+	// consumer returns false.
+	bool StreamMesh(const std::string& file,
+		const std::function<bool(std::unique_ptr<PreparedMesh> batch)>& consumer);
+
+	// Streams the mesh on a background thread with the current settings of
+	// the loader and returns at once. Without a memory budget the batches are
+	// ASYNC_BATCH_BYTES large. Textures the loader has already loaded are not
+	// decoded again, so they must stay loaded until the batches are uploaded.
+	std::unique_ptr<AsyncMeshPreparation> PrepareMeshAsync(
+		const std::string& file);
+
+	// Returns the index of a mesh without sub meshes at once and prepares it
+	// in the background, the sub meshes are added as they are uploaded by
+	// UploadCompletedSubMeshes. References work as with LoadMesh.
+	MeshIndex LoadMeshAsync(const std::string& file);
+
+	// Called by the render thread, uploads at most maxSubMeshes sub meshes
+	// prepared by asynchronous loads and returns how many were uploaded
+	template<FrameType Frames>
+	size_t UploadCompletedSubMeshes(
+		ManagedResourceComponents<Frames>& resourceComponents,
+		size_t maxSubMeshes);
+
+	// Meshes that were not loaded asynchronously are always complete. A
+	// failed mesh keeps the sub meshes uploaded before the failure until it is
+	// unloaded.
+	AsyncLoadState GetAsyncLoadState(MeshIndex index);
 
+	template<FrameType Frames>
+	MeshIndex UploadPreparedMesh(const PreparedMesh& preparedMesh,
+		ManagedResourceComponents<Frames>& resourceComponents);
+
+	// Loading a file that is already loaded returns the same index and adds a
+	// reference, every LoadMesh should be matched by an UnloadMesh. With a
+	// memory budget the mesh is streamed and uploaded batch by batch.
 	template<FrameType Frames>
 	MeshIndex LoadMesh(const std::string& file,
 		ManagedResourceComponents<Frames>& resourceComponents);
 
+	// Releases one reference, the buffers and textures of the mesh are removed
+	// from their components when the last reference is released. The GPU must
+	// be done with the resources before the last reference is released.
+	template<FrameType Frames>
+	bool UnloadMesh(MeshIndex index,
+		ManagedResourceComponents<Frames>& resourceComponents);
+
 	const Mesh& GetMeshInfo(MeshIndex index);
 
+	void SetMeshCacheUsage(bool enabled);
+
+	// Textures with an up to date baked file are mapped with their baked mips
+	// instead of being decoded and filtered on load, see BakeTexture
+	void SetBakedTextureUsage(bool enabled);
+
+	// Decoded specular maps with equal red, green and blue channels are
+	// uploaded as R8 and normal maps whose z can be rebuilt as R8G8, each in
+	// a component of its own. Baked textures always keep RGBA8.
+	void SetMaterialMapNarrowing(bool enabled);
+
+	// Diffuse maps in HDR files are decoded as float, filtered in float and
+	// uploaded as R16G16B16A16_FLOAT, or as R11G11B10_FLOAT without alpha if
+	// packing is enabled, each in a component of its own. Their texels are
+	// linear, the pixel shader has to skip the gamma decode for them.
+	void SetHdrTexturePacking(bool enabled);
+
+	// Applies to the mips generated on load, baked textures keep the mips
+	// they were baked with
+	void SetMipFiltering(const MipFilteringSettings& settings);
+
+	// Material maps loaded while streaming is enabled are uploaded with only
+	// their mip tail, and the loader keeps a CPU copy of their full mip chain
+	// from which UpdateTextureStreaming recreates each texture with the
+	// levels the streamer decides on. The budget and limits may change at
+	// any time.
+	void SetTextureStreaming(const TextureStreamingSettings& settings);
+
+	// Called by the render thread once per frame with the camera in the object
+	// space of the loaded meshes. Sub meshes are pointed at the recreated
+	// textures at once, the textures they replace are removed Frames updates
+	// later. Changes whose texture cannot be created are undone.
+	template<FrameType Frames>
+	void UpdateTextureStreaming(const StreamingView& view,
+		ManagedResourceComponents<Frames>& resourceComponents);
+
+	// Caps the staging memory of a streamed load, sub meshes are prepared in
+	// batches whose estimated size fits the budget, a batch holds at least
+	// one sub mesh. 0 disables streaming and prepares the whole mesh at once.
+	// Streamed loads do not write mesh caches, see StreamMesh.
+	void SetMemoryBudget(size_t bytes);
+
+	// Reorders triangles and vertices of converted sub meshes for the post
+	// transform cache, overdraw and vertex fetch
+	void SetVertexOrderOptimization(bool enabled);
+
+	// Generates up to nrOfLevels simplified index ranges per converted sub
+	// mesh, see GenerateLevelsOfDetail. 0 disables the simplification.
+	void SetLevelsOfDetail(unsigned int nrOfLevels,
+		float maxRelativeError = DEFAULT_SIMPLIFICATION_ERROR);
+	const ConversionSettings& GetConversionSettings();
+	const MeshCacheStatistics& GetMeshCacheStatistics();
+	const TextureCacheStatistics& GetTextureCacheStatistics();
+	const MipStagingStatistics& GetMipStagingStatistics();
+	const TextureStreamingStatistics& GetTextureStreamingStatistics();
+
+	// Decodes of every load that shared the decode pool, asynchronous ones
+	// included. Empty before the first texture is decoded.
+	TextureDecodeStatistics GetTextureDecodeStatistics();
+	const LoadStatistics& GetLoadStatistics();
+	VertexLayout GetVertexLayout();
+	static unsigned int GetImportFlags();
+	static size_t GetStagingBytes(const PreparedMesh& preparedMesh);
+	static bool BakeMeshCache(const std::string& filepath,
+		const ConversionSettings& settings = ConversionSettings());
+	static MipFilterSettings GetMipFilterSettings(MaterialMap map,
+		const MipFilteringSettings& settings);
+
+	// The mips are filtered for the given map with the default settings
+	static bool BakeTexture(const std::string& filepath,
+		MaterialMap map = MaterialMap::DIFFUSE);
+
 	const ComponentIdentifier& GetPositionComponentIdentifier();
 	const ComponentIdentifier& GetUVComponentIdentifier();
 	const ComponentIdentifier& GetNormalComponentIdentifier();
 	const ComponentIdentifier& GetTangentComponentIdentifier();
 	const ComponentIdentifier& GetBitangentComponentIdentifier();
+	const ComponentIdentifier& GetPackedAttributeComponentIdentifier();
 	const ComponentIdentifier& GetIndicesComponentIdentifier();
+	const ComponentIdentifier& GetShortIndicesComponentIdentifier();
+	const ComponentIdentifier& GetIndicesComponentIdentifier(
+		const SubMesh& subMesh);
+	const ComponentIdentifier& GetMeshletComponentIdentifier();
+	const ComponentIdentifier& GetMeshletBoundsComponentIdentifier();
+	const ComponentIdentifier& GetMeshletVertexComponentIdentifier();
+	const ComponentIdentifier& GetMeshletPrimitiveComponentIdentifier();
 	const ComponentIdentifier& GetDiffuseMapComponentIdentifier();
 	const ComponentIdentifier& GetSpecularMapComponentIdentifier();
 	const ComponentIdentifier& GetNormalMapComponentIdentifier();
+
+	// Greyscale specular maps sample as RRR1. Two channel normal maps sample
+	// with 0 in w and normal maps that store z with 1, so the pixel shader
+	// knows to rebuild z. Packed HDR diffuse maps sample with 1 in w.
+	const ComponentIdentifier& GetDiffuseMapComponentIdentifier(
+		const SubMesh& subMesh);
+	const ComponentIdentifier& GetSpecularMapComponentIdentifier(
+		const SubMesh& subMesh);
+	const ComponentIdentifier& GetNormalMapComponentIdentifier(
+		const SubMesh& subMesh);
 };
 
+// A mesh streamed on a background thread, see PrepareMeshAsync. The batches
+// arrive in file order through a lock free queue, so only one thread may pop
+// them. Destroying the preparation cancels it and waits for the thread.
+class AsyncMeshPreparation
+{
+private:
+	friend class MeshResourceLoader;
+
+	MeshResourceLoader preparer;
+	LockFreeQueue<std::unique_ptr<PreparedMesh>> completedBatches;
+	std::atomic<bool> cancelled;
+	std::atomic<bool> finished;
+	std::atomic<bool> succeeded;
+	std::thread thread;
+
+	void Run(const std::string& file);
+	bool PushBatch(std::unique_ptr<PreparedMesh> batch);
+
+public:
+	AsyncMeshPreparation();
+	~AsyncMeshPreparation();
+	AsyncMeshPreparation(const AsyncMeshPreparation& other) = delete;
+	AsyncMeshPreparation& operator=(const AsyncMeshPreparation& other) = delete;
+	AsyncMeshPreparation(AsyncMeshPreparation&& other) = delete;
+	AsyncMeshPreparation& operator=(AsyncMeshPreparation&& other) = delete;
+
+	bool TryPopBatch(std::unique_ptr<PreparedMesh>& toFill);
+
+	// Set once the last batch is queued or the preparation stopped early,
+	// batches may still be waiting in the queue. Succeeded is only valid then.
+	bool IsFinished() const;
+	bool Succeeded() const;
+
+	// Stops before the next batch is queued and waits for the thread
+	void Cancel();
+
+	// Waits for the thread to finish, so the batches have to be popped or the
+	// preparation cancelled first
+	const LoadStatistics& GetLoadStatistics();
+};
+
+// Sub meshes with 16 bit indices store two indices per element of the short
+// indices component, the index count and ranges count the original indices
 template<FrameType Frames>
-inline bool MeshResourceLoader::ProcessIndices(SubMesh& subMesh, 
-	aiMesh* currentMesh, ManagedResourceComponents<Frames>& resourceComponents)
+inline bool MeshResourceLoader::ProcessIndices(SubMesh& subMesh,
+	const SubMeshStreams& streams,
+	const std::vector<std::uint16_t>& shortIndices,
+	ManagedResourceComponents<Frames>& resourceComponents)
 {
-	std::vector<unsigned int> indices;
-	indices.reserve(static_cast<size_t>(currentMesh->mNumFaces) * 3);
-	for (unsigned int i = 0; i < currentMesh->mNumFaces; i++)
+	subMesh.indexCount = streams.nrOfIndices;
+	if (streams.nrOfLevelsOfDetail == 0)
+	{
+		LevelOfDetail fullDetail;
+		fullDetail.indexCount = streams.nrOfIndices;
+		subMesh.levelsOfDetail.push_back(fullDetail);
+	}
+	else
 	{
-		aiFace face = currentMesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++)
-			indices.push_back(face.mIndices[j]);
+		subMesh.levelsOfDetail.assign(streams.levelsOfDetail,
+			streams.levelsOfDetail + streams.nrOfLevelsOfDetail);
 	}
 
-	subMesh.indices = resourceComponents.GetStaticBufferComponent(
-		indicesBufferComponent).CreateBuffer(indices.size());
+	if (!shortIndices.empty())
+	{
+		auto& bufferComponent = resourceComponents.GetStaticBufferComponent(
+			shortIndicesBufferComponent);
+		subMesh.indexFormat = DXGI_FORMAT_R16_UINT;
+		subMesh.indices = bufferComponent.CreateBuffer(
+			static_cast<unsigned int>(shortIndices.size() / 2));
+
+		if (subMesh.indices == ResourceIndex(-1))
+			return false;
+
+		bufferComponent.SetUpdateData(subMesh.indices,
+			const_cast<std::uint16_t*>(shortIndices.data()));
+		return true;
+	}
+
+	auto& bufferComponent = resourceComponents.GetStaticBufferComponent(
+		indicesBufferComponent);
+	subMesh.indices = bufferComponent.CreateBuffer(
+		streams.GetTotalNrOfIndices());
 
 	if (subMesh.indices == ResourceIndex(-1))
 		return false;
 
-	subMesh.indexCount = static_cast<unsigned int>(indices.size());
-	resourceComponents.GetStaticBufferComponent(
-		indicesBufferComponent).SetUpdateData(subMesh.indices, indices.data());
+	bufferComponent.SetUpdateData(subMesh.indices,
+		const_cast<unsigned int*>(streams.indices));
 
 	return true;
 }
 
+template<FrameType Frames>
+inline bool MeshResourceLoader::ProcessMeshlets(SubMesh& subMesh,
+	const MeshletData& meshletData,
+	ManagedResourceComponents<Frames>& resourceComponents)
+{
+	subMesh.meshletCount = static_cast<unsigned int>(meshletData.meshlets.size());
+	if (subMesh.meshletCount == 0)
+		return true;
+
+	return ProcessBufferData(subMesh.meshlets, meshletData.meshlets.data(),
+		subMesh.meshletCount, resourceComponents.GetStaticBufferComponent(
+			meshletBufferComponent)) &&
+		ProcessBufferData(subMesh.meshletBounds, meshletData.bounds.data(),
+			subMesh.meshletCount, resourceComponents.GetStaticBufferComponent(
+				meshletBoundsBufferComponent)) &&
+		ProcessBufferData(subMesh.meshletVertices, meshletData.vertices.data(),
+			static_cast<unsigned int>(meshletData.vertices.size()),
+			resourceComponents.GetStaticBufferComponent(
+				meshletVertexBufferComponent)) &&
+		ProcessBufferData(subMesh.meshletPrimitives,
+			meshletData.primitives.data(),
+			static_cast<unsigned int>(meshletData.primitives.size()),
+			resourceComponents.GetStaticBufferComponent(
+				meshletPrimitiveBufferComponent));
+}
+
 template<FrameType Frames>
 inline bool MeshResourceLoader::ProcessVertexComponents(SubMesh& subMesh,
-	aiMesh* currentMesh, ManagedResourceComponents<Frames>& resourceComponents)
+	const SubMeshStreams& streams, const void* packedAttributes,
+	ManagedResourceComponents<Frames>& resourceComponents)
 {
-	if (!ProcessVertexComponent3(subMesh.position, currentMesh->mVertices,
-		currentMesh->mNumVertices, resourceComponents.GetStaticBufferComponent(
+	if (!ProcessVertexComponent3(subMesh.position, streams.positions,
+		streams.nrOfVertices, resourceComponents.GetStaticBufferComponent(
 			positionBufferComponent)))
 	{
 		return false;
 	}
-	if (!ProcessVertexComponent2(subMesh.uv, currentMesh->mTextureCoords[0],
-		currentMesh->mNumVertices, resourceComponents.GetStaticBufferComponent(
+
+	if (vertexLayout != VertexLayout::SEPARATE)
+	{
+		return ProcessBufferData(subMesh.packedAttributes,
+			packedAttributes, streams.nrOfVertices,
+			resourceComponents.GetStaticBufferComponent(
+				packedAttributeBufferComponent));
+	}
+
+	if (!ProcessVertexComponent2(subMesh.uv, streams.uvs,
+		streams.nrOfVertices, resourceComponents.GetStaticBufferComponent(
 			uvBufferComponent)))
 	{
 		return false;
 	}
-	if (!ProcessVertexComponent3(subMesh.normal, currentMesh->mNormals,
-		currentMesh->mNumVertices, resourceComponents.GetStaticBufferComponent(
+	if (!ProcessVertexComponent3(subMesh.normal, streams.normals,
+		streams.nrOfVertices, resourceComponents.GetStaticBufferComponent(
 			normalBufferComponent)))
 	{
 		return false;
 	}
-	if (!ProcessVertexComponent3(subMesh.tangent, currentMesh->mTangents,
-		currentMesh->mNumVertices, resourceComponents.GetStaticBufferComponent(
+	if (!ProcessVertexComponent4(subMesh.tangent, streams.tangents,
+		streams.nrOfVertices, resourceComponents.GetStaticBufferComponent(
 			tangentBufferComponent)))
 	{
 		return false;
 	}
-	if (!ProcessVertexComponent3(subMesh.bitangent, currentMesh->mBitangents,
-		currentMesh->mNumVertices, resourceComponents.GetStaticBufferComponent(
+	if (conversionSettings.keepBitangents &&
+		!ProcessVertexComponent3(subMesh.bitangent, streams.bitangents,
+		streams.nrOfVertices, resourceComponents.GetStaticBufferComponent(
 			bitangentBufferComponent)))
 	{
 		return false;
@@ -207,67 +835,105 @@ inline bool MeshResourceLoader::ProcessVertexComponents(SubMesh& subMesh,
 }
 
 template<FrameType Frames>
-inline bool MeshResourceLoader::ProcessMaterials(const aiScene* scene,
-	unsigned int materialIndex, SubMesh& subMesh,
-	ManagedResourceComponents<Frames>& resourceComponents)
+inline bool MeshResourceLoader::ProcessMaterials(
+	const PreparedMesh& preparedMesh, const SubMeshStreams& streams,
+	SubMesh& subMesh, ManagedResourceComponents<Frames>& resourceComponents)
 {
-	if (!ProcessMaterial(scene->mMaterials[materialIndex], aiTextureType_DIFFUSE,
-		directories.diffuseMapDirectory, subMesh.diffuseMap, TexelFormat::BYTE,
-		4, resourceComponents.GetStaticTexture2DComponent(
-			diffuseMapTextureComponent)))
+	if (streams.diffuseMap != nullptr)
 	{
-		return false;
+		std::string filepath =
+			directories.diffuseMapDirectory + streams.diffuseMap;
+		subMesh.diffuseMapFormat = GetMaterialMapFormat(preparedMesh,
+			filepath, loadedDiffuseMaps);
+		if (!ProcessTexture(preparedMesh, filepath, MaterialMap::DIFFUSE,
+			subMesh.bounds, subMesh.diffuseMap, subMesh.streamedDiffuseMap,
+			TexelFormat::BYTE,
+			GetMipFilterSettings(MaterialMap::DIFFUSE, mipFilteringSettings),
+			resourceComponents.GetStaticTexture2DComponent(
+				GetDiffuseMapComponentIdentifier(subMesh)), loadedDiffuseMaps))
+		{
+			return false;
+		}
 	}
 
-	if (!ProcessMaterial(scene->mMaterials[materialIndex], aiTextureType_SPECULAR,
-		directories.specularMapDirectory, subMesh.specularMap, TexelFormat::BYTE,
-		4, resourceComponents.GetStaticTexture2DComponent(
-			specularMapTextureComponent)))
+	if (streams.specularMap != nullptr)
 	{
-		return false;
+		std::string filepath =
+			directories.specularMapDirectory + streams.specularMap;
+		subMesh.specularMapFormat = GetMaterialMapFormat(preparedMesh,
+			filepath, loadedSpecularMaps);
+		if (!ProcessTexture(preparedMesh, filepath, MaterialMap::SPECULAR,
+			subMesh.bounds, subMesh.specularMap, subMesh.streamedSpecularMap,
+			TexelFormat::BYTE,
+			GetMipFilterSettings(MaterialMap::SPECULAR, mipFilteringSettings),
+			resourceComponents.GetStaticTexture2DComponent(
+				GetSpecularMapComponentIdentifier(subMesh)), loadedSpecularMaps))
+		{
+			return false;
+		}
 	}
 
-	if (!ProcessMaterial(scene->mMaterials[materialIndex], aiTextureType_NORMALS,
-		directories.normalMapDirectory, subMesh.normalMap, TexelFormat::BYTE,
-		4, resourceComponents.GetStaticTexture2DComponent(
-			normalMapTextureComponent)))
+	if (streams.normalMap != nullptr)
 	{
-		return false;
+		std::string filepath =
+			directories.normalMapDirectory + streams.normalMap;
+		subMesh.normalMapFormat = GetMaterialMapFormat(preparedMesh,
+			filepath, loadedNormalMaps);
+		if (!ProcessTexture(preparedMesh, filepath, MaterialMap::NORMAL,
+			subMesh.bounds, subMesh.normalMap, subMesh.streamedNormalMap,
+			TexelFormat::BYTE,
+			GetMipFilterSettings(MaterialMap::NORMAL, mipFilteringSettings),
+			resourceComponents.GetStaticTexture2DComponent(
+				GetNormalMapComponentIdentifier(subMesh)), loadedNormalMaps))
+		{
+			return false;
+		}
 	}
 
 	return true;
 }
 
 template<FrameType Frames>
-inline bool MeshResourceLoader::ProcessNode(aiNode* node, const aiScene* scene,
-	Mesh& mesh, ManagedResourceComponents<Frames>& resourceComponents)
+inline bool MeshResourceLoader::ProcessSubMesh(
+	const PreparedMesh& preparedMesh, size_t subMeshIndex, Mesh& mesh,
+	ManagedResourceComponents<Frames>& resourceComponents)
 {
-	for (unsigned int i = 0; i < node->mNumMeshes; i++)
-	{
-		SubMesh subMesh;
-		aiMesh* currentMesh = scene->mMeshes[node->mMeshes[i]];
+	SubMesh subMesh;
+	const SubMeshStreams& streams = preparedMesh.subMeshes[subMeshIndex];
+	const void* packedAttributes = nullptr;
+	if (vertexLayout == VertexLayout::PACKED)
+		packedAttributes = preparedMesh.packedAttributes[subMeshIndex].data();
+	else if (vertexLayout == VertexLayout::QUANTIZED)
+		packedAttributes = preparedMesh.quantizedAttributes[subMeshIndex].data();
 
-		if (!ProcessVertexComponents(subMesh, currentMesh, resourceComponents))
-			return false;
+	if (!ProcessVertexComponents(subMesh, streams, packedAttributes,
+		resourceComponents))
+	{
+		return false;
+	}
 
-		if (!ProcessMaterials(scene, currentMesh->mMaterialIndex, subMesh,
-			resourceComponents))
-		{
-			return false;
-		}
+	if (textureStreamer.GetSettings().enabled)
+	{
+		subMesh.bounds = CalculateStreamingBounds(streams.positions,
+			streams.uvs, streams.nrOfVertices);
+	}
 
-		if (!ProcessIndices(subMesh, currentMesh, resourceComponents))
-			return false;
+	if (!ProcessMaterials(preparedMesh, streams, subMesh, resourceComponents))
+		return false;
 
-		mesh.subMeshes.push_back(subMesh);
+	if (!ProcessIndices(subMesh, streams,
+		preparedMesh.shortIndices[subMeshIndex], resourceComponents))
+	{
+		return false;
 	}
 
-	for (unsigned int i = 0; i < node->mNumChildren; i++)
+	if (buildMeshlets && !ProcessMeshlets(subMesh,
+		preparedMesh.meshlets[subMeshIndex], resourceComponents))
 	{
-		if (!ProcessNode(node->mChildren[i], scene, mesh, resourceComponents))
-			return false;
+		return false;
 	}
 
+	mesh.subMeshes.push_back(subMesh);
 	return true;
 }
 
@@ -275,16 +941,14 @@ template<FrameType Frames>
 inline void MeshResourceLoader::Initialize(
 	const DirectoryInformation& directoryInformation,
 	ManagedResourceComponents<Frames>& resourceComponents,
-	const MemoryRequirements& neededMemory)
+	const MemoryRequirements& neededMemory, VertexLayout layout,
+	bool storeBitangents, bool generateMeshlets)
 {
-	directories = directoryInformation;
-	flags = aiProcess_JoinIdenticalVertices |
-		aiProcess_Triangulate | aiProcess_ConvertToLeftHanded |
-		aiProcess_GenNormals | aiProcess_ValidateDataStructure |
-		aiProcess_ImproveCacheLocality | aiProcess_FindInvalidData |
-		aiProcess_GenUVCoords | aiProcess_TransformUVCoords |
-		aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
-		aiProcess_CalcTangentSpace | 0;
+	SetDirectoryInformation(directoryInformation);
+	vertexLayout = layout;
+	conversionSettings.keepBitangents =
+		storeBitangents && layout == VertexLayout::SEPARATE;
+	buildMeshlets = generateMeshlets;
 
 	unsigned int maximumVertices = neededMemory.nrOfVertices;
 	unsigned int maximumBuffers = neededMemory.nrOfMeshes;
@@ -292,26 +956,75 @@ inline void MeshResourceLoader::Initialize(
 		resourceComponents.CreateBufferComponent<DirectX::XMFLOAT3>(false,
 			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
 			true, false);
-	uvBufferComponent =
-		resourceComponents.CreateBufferComponent<DirectX::XMFLOAT2>(false,
-			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
-			true, false);
-	normalBufferComponent =
-		resourceComponents.CreateBufferComponent<DirectX::XMFLOAT3>(false,
-			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
-			true, false);
-	tangentBufferComponent =
-		resourceComponents.CreateBufferComponent<DirectX::XMFLOAT3>(false,
-			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
-			true, false);
-	bitangentBufferComponent =
-		resourceComponents.CreateBufferComponent<DirectX::XMFLOAT3>(false,
-			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
-			true, false);
+
+	if (vertexLayout == VertexLayout::PACKED)
+	{
+		packedAttributeBufferComponent =
+			resourceComponents.CreateBufferComponent<PackedVertexAttributes>(
+				false, maximumVertices, maximumBuffers,
+				UpdateType::INITIALISE_ONLY, false, true, false);
+	}
+	else if (vertexLayout == VertexLayout::QUANTIZED)
+	{
+		packedAttributeBufferComponent =
+			resourceComponents.CreateBufferComponent<QuantizedVertexAttributes>(
+				false, maximumVertices, maximumBuffers,
+				UpdateType::INITIALISE_ONLY, false, true, false);
+	}
+	else
+	{
+		uvBufferComponent =
+			resourceComponents.CreateBufferComponent<DirectX::XMFLOAT2>(false,
+				maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+		normalBufferComponent =
+			resourceComponents.CreateBufferComponent<DirectX::XMFLOAT3>(false,
+				maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+		tangentBufferComponent =
+			resourceComponents.CreateBufferComponent<DirectX::XMFLOAT4>(false,
+				maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+		if (conversionSettings.keepBitangents)
+		{
+			bitangentBufferComponent =
+				resourceComponents.CreateBufferComponent<DirectX::XMFLOAT3>(
+					false, maximumVertices, maximumBuffers,
+					UpdateType::INITIALISE_ONLY, false, true, false);
+		}
+	}
+
 	indicesBufferComponent =
 		resourceComponents.CreateBufferComponent<unsigned int>(false,
 			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
 			true, false);
+	shortIndicesBufferComponent =
+		resourceComponents.CreateBufferComponent<std::uint32_t>(false,
+			maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY, false,
+			true, false);
+
+	// Every meshlet holds at least one triangle and the vertices of a meshlet
+	// are at most its indices, so the index limit bounds all four components
+	if (buildMeshlets)
+	{
+		unsigned int maximumTriangles = maximumVertices / 3;
+		meshletBufferComponent =
+			resourceComponents.CreateBufferComponent<Meshlet>(false,
+				maximumTriangles, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+		meshletBoundsBufferComponent =
+			resourceComponents.CreateBufferComponent<MeshletBounds>(false,
+				maximumTriangles, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+		meshletVertexBufferComponent =
+			resourceComponents.CreateBufferComponent<std::uint32_t>(false,
+				maximumVertices, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+		meshletPrimitiveBufferComponent =
+			resourceComponents.CreateBufferComponent<std::uint32_t>(false,
+				maximumTriangles, maximumBuffers, UpdateType::INITIALISE_ONLY,
+				false, true, false);
+	}
 
 	diffuseMapTextureComponent =
 		resourceComponents.CreateTexture2DComponent(false,
@@ -323,25 +1036,283 @@ inline void MeshResourceLoader::Initialize(
 			neededMemory.specularMapsTotalBytes, neededMemory.maxNrOfTextures,
 			4, DXGI_FORMAT_R8G8B8A8_UNORM, UpdateType::INITIALISE_ONLY, true,
 			false, false, false);
+
+	Texture2DViewDesc fourChannelNormalView(ViewType::SRV);
+	fourChannelNormalView.sr.componentMapping =
+		D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(0, 1, 2,
+			D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
 	normalMapTextureComponent =
 		resourceComponents.CreateTexture2DComponent(false,
 			neededMemory.normalMapsTotalBytes, neededMemory.maxNrOfTextures,
-			4, DXGI_FORMAT_R8G8B8A8_UNORM, UpdateType::INITIALISE_ONLY, true,
+			4, DXGI_FORMAT_R8G8B8A8_UNORM, UpdateType::INITIALISE_ONLY,
+			fourChannelNormalView, std::nullopt, std::nullopt, std::nullopt);
+
+	Texture2DViewDesc greyscaleView(ViewType::SRV);
+	greyscaleView.sr.componentMapping =
+		D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(0, 0, 0,
+			D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
+	greyscaleSpecularMapTextureComponent =
+		resourceComponents.CreateTexture2DComponent(false,
+			neededMemory.greyscaleSpecularMapsTotalBytes,
+			neededMemory.maxNrOfTextures, 1, DXGI_FORMAT_R8_UNORM,
+			UpdateType::INITIALISE_ONLY, greyscaleView, std::nullopt,
+			std::nullopt, std::nullopt);
+
+	Texture2DViewDesc twoChannelNormalView(ViewType::SRV);
+	twoChannelNormalView.sr.componentMapping =
+		D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(0, 1,
+			D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0,
+			D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0);
+	twoChannelNormalMapTextureComponent =
+		resourceComponents.CreateTexture2DComponent(false,
+			neededMemory.twoChannelNormalMapsTotalBytes,
+			neededMemory.maxNrOfTextures, 2, DXGI_FORMAT_R8G8_UNORM,
+			UpdateType::INITIALISE_ONLY, twoChannelNormalView, std::nullopt,
+			std::nullopt, std::nullopt);
+
+	hdrDiffuseMapTextureComponent =
+		resourceComponents.CreateTexture2DComponent(false,
+			neededMemory.hdrDiffuseMapsTotalBytes, neededMemory.maxNrOfTextures,
+			8, DXGI_FORMAT_R16G16B16A16_FLOAT, UpdateType::INITIALISE_ONLY, true,
 			false, false, false);
+	packedHdrDiffuseMapTextureComponent =
+		resourceComponents.CreateTexture2DComponent(false,
+			neededMemory.packedHdrDiffuseMapsTotalBytes,
+			neededMemory.maxNrOfTextures, 4, DXGI_FORMAT_R11G11B10_FLOAT,
+			UpdateType::INITIALISE_ONLY, true, false, false, false);
+}
+
+template<FrameType Frames>
+inline MeshIndex MeshResourceLoader::UploadPreparedMesh(
+	const PreparedMesh& preparedMesh,
+	ManagedResourceComponents<Frames>& resourceComponents)
+{
+	auto uploadStart = std::chrono::steady_clock::now();
+
+	Mesh toStore;
+	for (size_t i = 0; i < preparedMesh.subMeshes.size(); ++i)
+	{
+		if (!ProcessSubMesh(preparedMesh, i, toStore, resourceComponents))
+			return MeshIndex(-1);
+	}
+
+	std::chrono::duration<double, std::milli> uploadTime =
+		std::chrono::steady_clock::now() - uploadStart;
+	loadStatistics.uploadMilliseconds = uploadTime.count();
+	RecordMemoryUsage(0, GetStagingBytes(preparedMesh));
+
+	return StoreMesh(preparedMesh.file, std::move(toStore));
 }
 
 template<FrameType Frames>
 inline MeshIndex MeshResourceLoader::LoadMesh(const std::string& file,
 	ManagedResourceComponents<Frames>& resourceComponents)
 {
-	std::string filepath = directories.meshDirectory + file;
-	const aiScene* scene = importer.ReadFile(filepath, flags);
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-		return MeshIndex(-1);
+	auto loaded = loadedFiles.find(file);
+	if (loaded != loadedFiles.end())
+	{
+		++meshReferences[loaded->second].referenceCount;
+		return loaded->second;
+	}
+
+	if (memoryBudget == 0)
+	{
+		PreparedMesh preparedMesh;
+		if (!PrepareMesh(file, preparedMesh))
+			return MeshIndex(-1);
+
+		return UploadPreparedMesh(preparedMesh, resourceComponents);
+	}
 
 	Mesh toStore;
-	if (!ProcessNode(scene->mRootNode, scene, toStore, resourceComponents))
+	bool streamed = StreamMesh(file, [&](std::unique_ptr<PreparedMesh> batch)
+		{
+			auto uploadStart = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < batch->subMeshes.size(); ++i)
+			{
+				if (!ProcessSubMesh(*batch, i, toStore, resourceComponents))
+					return false;
+			}
+
+			std::chrono::duration<double, std::milli> uploadTime =
+				std::chrono::steady_clock::now() - uploadStart;
+			loadStatistics.uploadMilliseconds += uploadTime.count();
+			return true;
+		});
+
+	if (!streamed)
 		return MeshIndex(-1);
 
-	return meshes.Add(std::move(toStore));
+	return StoreMesh(file, std::move(toStore));
+}
+
+template<FrameType Frames>
+inline size_t MeshResourceLoader::UploadCompletedSubMeshes(
+	ManagedResourceComponents<Frames>& resourceComponents, size_t maxSubMeshes)
+{
+	size_t uploaded = 0;
+	for (auto& entry : asyncLoads)
+	{
+		AsyncLoad& load = entry.second;
+		auto uploadStart = std::chrono::steady_clock::now();
+		while (!load.failed && uploaded < maxSubMeshes)
+		{
+			if (load.currentBatch == nullptr &&
+				!load.preparation->TryPopBatch(load.currentBatch))
+			{
+				break;
+			}
+
+			if (!ProcessSubMesh(*load.currentBatch, load.nextSubMesh,
+				meshes[entry.first], resourceComponents))
+			{
+				load.failed = true;
+				break;
+			}
+
+			AddStreamedTextureUsers(entry.first,
+				meshes[entry.first].subMeshes.size() - 1);
+			++uploaded;
+			if (++load.nextSubMesh == load.currentBatch->subMeshes.size())
+			{
+				load.currentBatch.reset();
+				load.nextSubMesh = 0;
+			}
+		}
+
+		std::chrono::duration<double, std::milli> uploadTime =
+			std::chrono::steady_clock::now() - uploadStart;
+		load.uploadMilliseconds += uploadTime.count();
+	}
+
+	FinishAsyncLoads();
+	return uploaded;
+}
+
+template<FrameType Frames>
+inline bool MeshResourceLoader::UnloadMesh(MeshIndex index,
+	ManagedResourceComponents<Frames>& resourceComponents)
+{
+	auto reference = meshReferences.find(index);
+	if (reference == meshReferences.end())
+		return false;
+
+	if (--reference->second.referenceCount > 0)
+		return true;
+
+	asyncLoads.erase(index); // Stops the thread, if the load is still running
+	for (size_t i = 0; i < meshes[index].subMeshes.size(); ++i)
+		RemoveStreamedTextureUsers(index, i);
+
+	for (auto& subMesh : meshes[index].subMeshes)
+	{
+		ReleaseBuffer(subMesh.position, resourceComponents.GetStaticBufferComponent(
+			positionBufferComponent));
+		if (vertexLayout != VertexLayout::SEPARATE)
+		{
+			ReleaseBuffer(subMesh.packedAttributes,
+				resourceComponents.GetStaticBufferComponent(
+					packedAttributeBufferComponent));
+		}
+		else
+		{
+			ReleaseBuffer(subMesh.uv, resourceComponents.GetStaticBufferComponent(
+				uvBufferComponent));
+			ReleaseBuffer(subMesh.normal, resourceComponents.GetStaticBufferComponent(
+				normalBufferComponent));
+			ReleaseBuffer(subMesh.tangent, resourceComponents.GetStaticBufferComponent(
+				tangentBufferComponent));
+			if (conversionSettings.keepBitangents)
+			{
+				ReleaseBuffer(subMesh.bitangent,
+					resourceComponents.GetStaticBufferComponent(
+						bitangentBufferComponent));
+			}
+		}
+		ReleaseBuffer(subMesh.indices, resourceComponents.GetStaticBufferComponent(
+			GetIndicesComponentIdentifier(subMesh)));
+
+		if (buildMeshlets)
+		{
+			ReleaseBuffer(subMesh.meshlets, resourceComponents.GetStaticBufferComponent(
+				meshletBufferComponent));
+			ReleaseBuffer(subMesh.meshletBounds,
+				resourceComponents.GetStaticBufferComponent(
+					meshletBoundsBufferComponent));
+			ReleaseBuffer(subMesh.meshletVertices,
+				resourceComponents.GetStaticBufferComponent(
+					meshletVertexBufferComponent));
+			ReleaseBuffer(subMesh.meshletPrimitives,
+				resourceComponents.GetStaticBufferComponent(
+					meshletPrimitiveBufferComponent));
+		}
+
+		ReleaseTexture(subMesh.diffuseMap, subMesh.diffuseMapFormat,
+			subMesh.bounds, loadedDiffuseMaps,
+			resourceComponents.GetStaticTexture2DComponent(
+				GetDiffuseMapComponentIdentifier(subMesh)));
+		ReleaseTexture(subMesh.specularMap, subMesh.specularMapFormat,
+			subMesh.bounds, loadedSpecularMaps,
+			resourceComponents.GetStaticTexture2DComponent(
+				GetSpecularMapComponentIdentifier(subMesh)));
+		ReleaseTexture(subMesh.normalMap, subMesh.normalMapFormat,
+			subMesh.bounds, loadedNormalMaps,
+			resourceComponents.GetStaticTexture2DComponent(
+				GetNormalMapComponentIdentifier(subMesh)));
+	}
+
+	loadedFiles.erase(reference->second.file);
+	meshReferences.erase(reference);
+	meshes[index] = Mesh();
+	meshes.Remove(index);
+
+	return true;
+}
+
+template<FrameType Frames>
+inline void MeshResourceLoader::UpdateTextureStreaming(const StreamingView& view,
+	ManagedResourceComponents<Frames>& resourceComponents)
+{
+	for (auto& retired : retiredTextures)
+	{
+		if (--retired.updatesLeft == 0)
+		{
+			resourceComponents.GetStaticTexture2DComponent(
+				GetMaterialMapComponentIdentifier(retired.map,
+					retired.format)).RemoveComponent(retired.index);
+		}
+	}
+
+	retiredTextures.erase(std::remove_if(retiredTextures.begin(),
+		retiredTextures.end(), [](const RetiredTexture& retired)
+		{
+			return retired.updatesLeft == 0;
+		}), retiredTextures.end());
+
+	if (!textureStreamer.GetSettings().enabled)
+		return;
+
+	textureStreamer.Update(view, streamingChanges);
+	for (auto& change : streamingChanges)
+	{
+		const StreamedMipChain& chain = streamedMipChains.at(change.texture);
+		LoadedTexture& loaded = GetLoadedTextures(chain.map).at(chain.filepath);
+		ResourceIndex index = CreateStreamedTexture(chain, change.firstMip,
+			resourceComponents.GetStaticTexture2DComponent(
+				GetMaterialMapComponentIdentifier(chain.map, loaded.format)));
+		if (index == ResourceIndex(-1))
+		{
+			textureStreamer.CancelChange(change);
+			continue;
+		}
+
+		RetargetTexture(chain, index);
+		RetiredTexture retired;
+		retired.map = chain.map;
+		retired.format = loaded.format;
+		retired.index = loaded.index;
+		retired.updatesLeft = static_cast<unsigned int>(Frames);
+		retiredTextures.push_back(retired);
+		loaded.index = index;
+	}
 }
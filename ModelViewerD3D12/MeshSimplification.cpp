@@ -0,0 +1,551 @@
+#include "MeshSimplification.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "VertexCacheOptimization.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Levels that keep more than this share of the triangles of the previous
+	// level are not worth their index memory
+	const float MIN_LEVEL_REDUCTION = 0.9f;
+	const unsigned int MAX_SIMPLIFICATION_PASSES = 32;
+
+	// A collapse is rejected if a remaining triangle turns further than about
+	// 75 degrees, which also catches triangles that would flip
+	const float MIN_NORMAL_DOT = 0.25f;
+
+	// Sum of the squared distances to the planes of the triangles around a
+	// vertex, weighted by triangle area: p^T A p + 2 b^T p + c with A
+	// symmetric. Dividing by the total weight gives a mean squared distance.
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double weight = 0.0;
+
+		void AddPlane(const double normal[3], double distance, double planeWeight)
+		{
+			a00 += planeWeight * normal[0] * normal[0];
+			a01 += planeWeight * normal[0] * normal[1];
+			a02 += planeWeight * normal[0] * normal[2];
+			a11 += planeWeight * normal[1] * normal[1];
+			a12 += planeWeight * normal[1] * normal[2];
+			a22 += planeWeight * normal[2] * normal[2];
+			b0 += planeWeight * normal[0] * distance;
+			b1 += planeWeight * normal[1] * distance;
+			b2 += planeWeight * normal[2] * distance;
+			c += planeWeight * distance * distance;
+			weight += planeWeight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a00 += other.a00;
+			a01 += other.a01;
+			a02 += other.a02;
+			a11 += other.a11;
+			a12 += other.a12;
+			a22 += other.a22;
+			b0 += other.b0;
+			b1 += other.b1;
+			b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+	};
+
+	double EvaluateQuadrics(const Quadric& first, const Quadric& second,
+		const XMFLOAT3& position)
+	{
+		Quadric sum = first;
+		sum.Add(second);
+		if (sum.weight <= 0.0)
+			return 0.0;
+
+		double x = position.x;
+		double y = position.y;
+		double z = position.z;
+		double error = sum.a00 * x * x + sum.a11 * y * y + sum.a22 * z * z +
+			2.0 * (sum.a01 * x * y + sum.a02 * x * z + sum.a12 * y * z) +
+			2.0 * (sum.b0 * x + sum.b1 * y + sum.b2 * z) + sum.c;
+
+		return std::max(error, 0.0) / sum.weight;
+	}
+
+	struct PositionKey
+	{
+		std::uint32_t x;
+		std::uint32_t y;
+		std::uint32_t z;
+
+		bool operator==(const PositionKey& other) const
+		{
+			return x == other.x && y == other.y && z == other.z;
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return (static_cast<size_t>(key.x) * 73856093u) ^
+				(static_cast<size_t>(key.y) * 19349663u) ^
+				(static_cast<size_t>(key.z) * 83492791u);
+		}
+	};
+
+	// Maps every vertex to the first vertex with the exact same position
+	std::vector<unsigned int> FindPositionRemap(const SubMeshStreams& streams)
+	{
+		std::vector<unsigned int> toReturn(streams.nrOfVertices);
+		std::unordered_map<PositionKey, unsigned int, PositionKeyHash> firstVertices;
+		firstVertices.reserve(streams.nrOfVertices);
+
+		for (unsigned int i = 0; i < streams.nrOfVertices; ++i)
+		{
+			PositionKey key;
+			memcpy(&key.x, &streams.positions[i].x, sizeof(float));
+			memcpy(&key.y, &streams.positions[i].y, sizeof(float));
+			memcpy(&key.z, &streams.positions[i].z, sizeof(float));
+			toReturn[i] = firstVertices.emplace(key, i).first->second;
+		}
+
+		return toReturn;
+	}
+
+	// Vertices sharing their position with another vertex lie on an attribute
+	// seam, vertices on edges not shared by exactly two triangles lie on the
+	// border of the sub mesh, which is also where its material changes
+	std::vector<char> FindLockedVertices(
+		const std::vector<unsigned int>& positionRemap, const unsigned int* indices,
+		size_t nrOfIndices)
+	{
+		size_t nrOfVertices = positionRemap.size();
+		std::vector<char> toReturn(nrOfVertices, 0);
+		for (size_t i = 0; i < nrOfVertices; ++i)
+		{
+			if (positionRemap[i] != i)
+			{
+				toReturn[i] = 1;
+				toReturn[positionRemap[i]] = 1;
+			}
+		}
+
+		std::unordered_map<std::uint64_t, unsigned int> edgeUses;
+		edgeUses.reserve(nrOfIndices);
+		for (size_t i = 0; i + 2 < nrOfIndices; i += 3)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				std::uint64_t first = positionRemap[indices[i + j]];
+				std::uint64_t second = positionRemap[indices[i + (j + 1) % 3]];
+				if (first > second)
+					std::swap(first, second);
+
+				++edgeUses[(first << 32) | second];
+			}
+		}
+
+		for (const auto& edge : edgeUses)
+		{
+			if (edge.second != 2)
+			{
+				toReturn[static_cast<size_t>(edge.first >> 32)] = 1;
+				toReturn[static_cast<size_t>(edge.first & 0xFFFFFFFF)] = 1;
+			}
+		}
+
+		// Locks set on a shared position apply to every vertex at it
+		for (size_t i = 0; i < nrOfVertices; ++i)
+			toReturn[i] = toReturn[i] | toReturn[positionRemap[i]];
+
+		return toReturn;
+	}
+
+	XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1,
+		const XMFLOAT3& p2)
+	{
+		XMVECTOR first = XMLoadFloat3(&p0);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&p1), first),
+			XMVectorSubtract(XMLoadFloat3(&p2), first));
+	}
+
+	// Quadrics are accumulated per position, so the quadric of a seam vertex
+	// covers the triangles on both sides of the seam
+	std::vector<Quadric> CalculateQuadrics(const SubMeshStreams& streams,
+		const std::vector<unsigned int>& positionRemap,
+		const unsigned int* indices, size_t nrOfIndices)
+	{
+		std::vector<Quadric> toReturn(streams.nrOfVertices);
+		for (size_t i = 0; i + 2 < nrOfIndices; i += 3)
+		{
+			const XMFLOAT3& p0 = streams.positions[indices[i]];
+			XMVECTOR normal = TriangleNormal(p0, streams.positions[indices[i + 1]],
+				streams.positions[indices[i + 2]]);
+			float doubleArea = XMVectorGetX(XMVector3Length(normal));
+			if (doubleArea == 0.0f)
+				continue;
+
+			XMFLOAT3 unitNormal;
+			XMStoreFloat3(&unitNormal, XMVectorScale(normal, 1.0f / doubleArea));
+			double planeNormal[3] = { unitNormal.x, unitNormal.y, unitNormal.z };
+			double distance = -(planeNormal[0] * p0.x + planeNormal[1] * p0.y +
+				planeNormal[2] * p0.z);
+
+			Quadric plane;
+			plane.AddPlane(planeNormal, distance, 0.5 * doubleArea);
+			for (size_t j = 0; j < 3; ++j)
+				toReturn[positionRemap[indices[i + j]]].Add(plane);
+		}
+
+		return toReturn;
+	}
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double error;
+	};
+
+	// Triangles around each vertex, stored consecutively per vertex
+	struct TriangleAdjacency
+	{
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> triangles;
+
+		TriangleAdjacency(const std::vector<unsigned int>& indices,
+			unsigned int nrOfVertices) : offsets(nrOfVertices + 1, 0),
+			triangles(indices.size())
+		{
+			for (unsigned int index : indices)
+				++offsets[index + 1];
+
+			for (unsigned int i = 0; i < nrOfVertices; ++i)
+				offsets[i + 1] += offsets[i];
+
+			std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i)
+				triangles[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+	};
+
+	bool CollapseDistortsTriangles(const XMFLOAT3* positions,
+		const std::vector<unsigned int>& indices,
+		const TriangleAdjacency& adjacency, const Collapse& collapse)
+	{
+		for (unsigned int i = adjacency.offsets[collapse.from];
+			i < adjacency.offsets[collapse.from + 1]; ++i)
+		{
+			const unsigned int* triangle = &indices[adjacency.triangles[i] * 3];
+			if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+				triangle[2] == collapse.to)
+			{
+				continue; // Removed by the collapse
+			}
+
+			XMVECTOR before = TriangleNormal(positions[triangle[0]],
+				positions[triangle[1]], positions[triangle[2]]);
+			XMFLOAT3 moved[3];
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				moved[j] = positions[triangle[j] == collapse.from ?
+					collapse.to : triangle[j]];
+			}
+
+			XMVECTOR after = TriangleNormal(moved[0], moved[1], moved[2]);
+			float beforeLength = XMVectorGetX(XMVector3Length(before));
+			float afterLength = XMVectorGetX(XMVector3Length(after));
+			if (beforeLength == 0.0f)
+				continue;
+
+			if (afterLength == 0.0f || XMVectorGetX(XMVector3Dot(before, after)) <
+				MIN_NORMAL_DOT * beforeLength * afterLength)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Performs the cheapest independent collapses of the current triangles.
+	// Every vertex of a triangle around a collapsed vertex is left alone for
+	// the rest of the pass, so the distortion checks stay valid.
+	size_t RunSimplificationPass(const SubMeshStreams& streams,
+		const std::vector<char>& locked,
+		const std::vector<unsigned int>& positionRemap,
+		std::vector<Quadric>& quadrics, std::vector<unsigned int>& indices,
+		size_t targetTriangles, double maxErrorSquared, double& largestError)
+	{
+		std::vector<Collapse> collapses;
+		collapses.reserve(indices.size() * 2);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				unsigned int first = indices[i + j];
+				unsigned int second = indices[i + (j + 1) % 3];
+				const Quadric& firstQuadric = quadrics[positionRemap[first]];
+				const Quadric& secondQuadric = quadrics[positionRemap[second]];
+				if (!locked[first])
+				{
+					collapses.push_back({ first, second, EvaluateQuadrics(
+						firstQuadric, secondQuadric, streams.positions[second]) });
+				}
+				if (!locked[second])
+				{
+					collapses.push_back({ second, first, EvaluateQuadrics(
+						firstQuadric, secondQuadric, streams.positions[first]) });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& first, const Collapse& second)
+			{
+				if (first.error != second.error)
+					return first.error < second.error;
+				if (first.from != second.from)
+					return first.from < second.from;
+				return first.to < second.to;
+			});
+
+		TriangleAdjacency adjacency(indices, streams.nrOfVertices);
+		std::vector<char> touched(streams.nrOfVertices, 0);
+		std::vector<unsigned int> remap(streams.nrOfVertices);
+		for (unsigned int i = 0; i < streams.nrOfVertices; ++i)
+			remap[i] = i;
+
+		size_t triangles = indices.size() / 3;
+		size_t nrOfCollapses = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (triangles <= targetTriangles || collapse.error > maxErrorSquared)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to] ||
+				CollapseDistortsTriangles(streams.positions, indices, adjacency,
+					collapse))
+			{
+				continue;
+			}
+
+			for (unsigned int i = adjacency.offsets[collapse.from];
+				i < adjacency.offsets[collapse.from + 1]; ++i)
+			{
+				const unsigned int* triangle = &indices[adjacency.triangles[i] * 3];
+				bool removed = false;
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					touched[triangle[j]] = 1;
+					removed = removed || triangle[j] == collapse.to;
+				}
+
+				if (removed)
+					--triangles;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[positionRemap[collapse.to]].Add(quadrics[collapse.from]);
+			largestError = std::max(largestError, collapse.error);
+			++nrOfCollapses;
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			unsigned int a = remap[indices[i]];
+			unsigned int b = remap[indices[i + 1]];
+			unsigned int c = remap[indices[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+
+		indices.resize(kept);
+		return nrOfCollapses;
+	}
+
+	float GetMeshExtent(const SubMeshStreams& streams)
+	{
+		if (streams.nrOfVertices == 0)
+			return 0.0f;
+
+		XMVECTOR minimum = XMLoadFloat3(&streams.positions[0]);
+		XMVECTOR maximum = minimum;
+		for (unsigned int i = 1; i < streams.nrOfVertices; ++i)
+		{
+			XMVECTOR position = XMLoadFloat3(&streams.positions[i]);
+			minimum = XMVectorMin(minimum, position);
+			maximum = XMVectorMax(maximum, position);
+		}
+
+		XMFLOAT3 size;
+		XMStoreFloat3(&size, XMVectorSubtract(maximum, minimum));
+		return std::max(size.x, std::max(size.y, size.z));
+	}
+}
+
+float SimplifyIndices(const SubMeshStreams& streams, const unsigned int* indices,
+	size_t nrOfIndices, size_t targetIndexCount, float maxError,
+	std::vector<unsigned int>& toFill)
+{
+	nrOfIndices -= nrOfIndices % 3;
+	toFill.assign(indices, indices + nrOfIndices);
+	if (streams.positions == nullptr || nrOfIndices <= targetIndexCount)
+		return 0.0f;
+
+	std::vector<unsigned int> positionRemap = FindPositionRemap(streams);
+	std::vector<char> locked = FindLockedVertices(positionRemap, indices,
+		nrOfIndices);
+	std::vector<Quadric> quadrics = CalculateQuadrics(streams, positionRemap,
+		indices, nrOfIndices);
+
+	size_t targetTriangles = targetIndexCount / 3;
+	double maxErrorSquared = static_cast<double>(maxError) * maxError;
+	double largestError = 0.0;
+	for (unsigned int pass = 0; pass < MAX_SIMPLIFICATION_PASSES &&
+		toFill.size() / 3 > targetTriangles; ++pass)
+	{
+		if (RunSimplificationPass(streams, locked, positionRemap, quadrics,
+			toFill, targetTriangles, maxErrorSquared, largestError) == 0)
+		{
+			break;
+		}
+	}
+
+	return static_cast<float>(std::sqrt(largestError));
+}
+
+void GenerateLevelsOfDetail(SubMeshData& subMesh, unsigned int nrOfLevels,
+	float maxRelativeError)
+{
+	subMesh.levelsOfDetail.clear();
+	if (nrOfLevels == 0 || subMesh.indices.size() < 3)
+		return;
+
+	SubMeshStreams streams = subMesh.GetStreams();
+	unsigned int nrOfVertices = streams.nrOfVertices;
+	float maxError = maxRelativeError * GetMeshExtent(streams);
+
+	std::vector<std::vector<unsigned int>> levels;
+	std::vector<float> errors;
+	const std::vector<unsigned int>* previous = &subMesh.indices;
+	float error = 0.0f;
+	for (unsigned int i = 0; i < nrOfLevels; ++i)
+	{
+		std::vector<unsigned int> simplified;
+		size_t target = previous->size() / 6 * 3;
+
+		// Every level starts from the previous one, so the distance to the
+		// full detail surface is bounded by the sum of the level errors
+		error += SimplifyIndices(streams, previous->data(), previous->size(),
+			target, maxError, simplified);
+		if (simplified.empty() || static_cast<float>(simplified.size()) >
+			static_cast<float>(previous->size()) * MIN_LEVEL_REDUCTION)
+		{
+			break;
+		}
+
+		OptimizeVertexCache(simplified.data(), simplified.size(), nrOfVertices);
+		levels.push_back(std::move(simplified));
+		errors.push_back(error);
+		previous = &levels.back();
+		maxError *= 2.0f;
+	}
+
+	if (levels.empty())
+		return;
+
+	LevelOfDetail fullDetail;
+	fullDetail.indexCount = static_cast<std::uint32_t>(subMesh.indices.size());
+	subMesh.levelsOfDetail.push_back(fullDetail);
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		LevelOfDetail level;
+		level.firstIndex = static_cast<std::uint32_t>(subMesh.indices.size());
+		level.indexCount = static_cast<std::uint32_t>(levels[i].size());
+		level.error = errors[i];
+		subMesh.indices.insert(subMesh.indices.end(), levels[i].begin(),
+			levels[i].end());
+		subMesh.levelsOfDetail.push_back(level);
+	}
+}
+
+bool ValidateLevelsOfDetail(const SubMeshStreams& streams)
+{
+	if (streams.nrOfLevelsOfDetail == 0)
+		return true;
+
+	const LevelOfDetail* levels = streams.levelsOfDetail;
+	if (levels[0].firstIndex != 0 || levels[0].indexCount != streams.nrOfIndices ||
+		levels[0].error != 0.0f)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 1; i < streams.nrOfLevelsOfDetail; ++i)
+	{
+		const LevelOfDetail& previous = levels[i - 1];
+		const LevelOfDetail& level = levels[i];
+		if (level.firstIndex != previous.firstIndex + previous.indexCount ||
+			level.indexCount % 3 != 0 || level.indexCount >= previous.indexCount ||
+			level.error < previous.error)
+		{
+			return false;
+		}
+
+		const unsigned int* indices = streams.indices + level.firstIndex;
+		for (unsigned int j = 0; j < level.indexCount; j += 3)
+		{
+			if (indices[j] >= streams.nrOfVertices ||
+				indices[j + 1] >= streams.nrOfVertices ||
+				indices[j + 2] >= streams.nrOfVertices ||
+				indices[j] == indices[j + 1] || indices[j + 1] == indices[j + 2] ||
+				indices[j] == indices[j + 2])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+float GetScreenSpaceError(float objectSpaceError, float distance,
+	float verticalFieldOfView, float screenHeight)
+{
+	if (distance <= 0.0f)
+		return FLT_MAX;
+
+	return objectSpaceError * screenHeight /
+		(2.0f * distance * std::tan(verticalFieldOfView * 0.5f));
+}
+
+size_t SelectLevelOfDetail(const LevelOfDetail* levels, size_t nrOfLevels,
+	float distance, float verticalFieldOfView, float screenHeight,
+	float maxPixelError)
+{
+	for (size_t i = nrOfLevels; i > 1; --i)
+	{
+		if (GetScreenSpaceError(levels[i - 1].error, distance,
+			verticalFieldOfView, screenHeight) <= maxPixelError)
+		{
+			return i - 1;
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
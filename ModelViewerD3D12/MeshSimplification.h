@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "SubMeshData.h"
+
+// Error allowed for the first coarser level, relative to the sub mesh size
+const float DEFAULT_SIMPLIFICATION_ERROR = 0.01f;
+
+// Collapses edges of the triangles in indices in order of their quadric error
+// until at most targetIndexCount indices remain or no collapse has an error
+// below maxError. Vertices are only moved onto other vertices, so the result
+// uses the same vertex streams. Vertices on open edges or sharing a position
+// with another vertex, such as along uv seams and hard edges, are never
+// moved. Returns the largest error of a collapse as an object space distance.
+float SimplifyIndices(const SubMeshStreams& streams, const unsigned int* indices,
+	size_t nrOfIndices, size_t targetIndexCount, float maxError,
+	std::vector<unsigned int>& toFill);
+
+// Appends coarser levels of detail to the indices of the sub mesh, each with
+// at most half the triangles of the previous level. maxRelativeError is the
+// allowed error of the first coarser level relative to the size of the sub
+// mesh and doubles for each level after it. Stops early when a level would not
+// remove at least a tenth of the triangles of the previous one.
+void GenerateLevelsOfDetail(SubMeshData& subMesh, unsigned int nrOfLevels,
+	float maxRelativeError);
+
+// Checks that the first level is the full detail indices, that the coarser
+// levels follow it in order with fewer triangles and no larger error, and
+// that they only hold valid, non degenerate triangles
+bool ValidateLevelsOfDetail(const SubMeshStreams& streams);
+
+// Projected size in pixels of an object space error at the given distance
+float GetScreenSpaceError(float objectSpaceError, float distance,
+	float verticalFieldOfView, float screenHeight);
+
+// Coarsest level whose screen space error at the distance is at most
+// maxPixelError, the levels are expected in order from finest to coarsest
+size_t SelectLevelOfDetail(const LevelOfDetail* levels, size_t nrOfLevels,
+	float distance, float verticalFieldOfView, float screenHeight,
+	float maxPixelError);
\ No newline at end of file
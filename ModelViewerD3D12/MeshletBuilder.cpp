@@ -0,0 +1,292 @@
+#include "MeshletBuilder.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int NOT_IN_MESHLET = static_cast<unsigned int>(-1);
+
+	// Cones wider than this are not worth testing against
+	const float MIN_CONE_DOT = 0.1f;
+	const float BOUNDS_TOLERANCE = 1.0e-3f;
+
+	XMVECTOR TriangleNormal(const XMFLOAT3* positions,
+		const unsigned int* triangle)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&positions[triangle[0]]);
+		return XMVector3Cross(
+			XMVectorSubtract(XMLoadFloat3(&positions[triangle[1]]), p0),
+			XMVectorSubtract(XMLoadFloat3(&positions[triangle[2]]), p0));
+	}
+
+	void CalculateSphere(const XMFLOAT3* positions, const std::uint32_t* vertices,
+		std::uint32_t nrOfVertices, MeshletBounds& toSet)
+	{
+		XMVECTOR minimum = XMLoadFloat3(&positions[vertices[0]]);
+		XMVECTOR maximum = minimum;
+		for (std::uint32_t i = 1; i < nrOfVertices; ++i)
+		{
+			XMVECTOR position = XMLoadFloat3(&positions[vertices[i]]);
+			minimum = XMVectorMin(minimum, position);
+			maximum = XMVectorMax(maximum, position);
+		}
+
+		XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+		float radius = 0.0f;
+		for (std::uint32_t i = 0; i < nrOfVertices; ++i)
+		{
+			XMVECTOR offset = XMVectorSubtract(
+				XMLoadFloat3(&positions[vertices[i]]), center);
+			radius = std::max(radius, XMVectorGetX(XMVector3Length(offset)));
+		}
+
+		XMStoreFloat3(&toSet.center, center);
+		toSet.radius = radius;
+	}
+
+	// The apex is moved back along the axis until every triangle plane is in
+	// front of it, which keeps the back facing test conservative
+	void CalculateCone(const SubMeshStreams& streams, const unsigned int* indices,
+		std::uint32_t nrOfTriangles, MeshletBounds& toSet)
+	{
+		toSet.coneAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		toSet.coneCutoff = 1.0f;
+		toSet.coneApex = toSet.center;
+		toSet.padding = 0.0f;
+
+		std::vector<XMFLOAT3> normals;
+		normals.reserve(nrOfTriangles);
+		XMVECTOR axis = XMVectorZero();
+		for (std::uint32_t i = 0; i < nrOfTriangles; ++i)
+		{
+			XMVECTOR normal = TriangleNormal(streams.positions, indices + i * 3);
+			if (XMVectorGetX(XMVector3Length(normal)) == 0.0f)
+				continue;
+
+			normal = XMVector3Normalize(normal);
+			normals.push_back(XMFLOAT3());
+			XMStoreFloat3(&normals.back(), normal);
+			axis = XMVectorAdd(axis, normal);
+		}
+
+		if (normals.empty() || XMVectorGetX(XMVector3Length(axis)) == 0.0f)
+			return;
+
+		axis = XMVector3Normalize(axis);
+		float minimumDot = 1.0f;
+		for (const XMFLOAT3& normal : normals)
+		{
+			minimumDot = std::min(minimumDot,
+				XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normal), axis)));
+		}
+
+		XMStoreFloat3(&toSet.coneAxis, axis);
+		if (minimumDot < MIN_CONE_DOT)
+			return;
+
+		XMVECTOR center = XMLoadFloat3(&toSet.center);
+		float maximumDistance = 0.0f;
+		size_t normalIndex = 0;
+		for (std::uint32_t i = 0; i < nrOfTriangles; ++i)
+		{
+			const unsigned int* triangle = indices + i * 3;
+			if (XMVectorGetX(XMVector3Length(
+				TriangleNormal(streams.positions, triangle))) == 0.0f)
+			{
+				continue;
+			}
+
+			XMVECTOR normal = XMLoadFloat3(&normals[normalIndex++]);
+			XMVECTOR offset = XMVectorSubtract(center,
+				XMLoadFloat3(&streams.positions[triangle[0]]));
+			float distance = XMVectorGetX(XMVector3Dot(offset, normal)) /
+				XMVectorGetX(XMVector3Dot(axis, normal));
+			maximumDistance = std::max(maximumDistance, distance);
+		}
+
+		XMStoreFloat3(&toSet.coneApex, XMVectorSubtract(center,
+			XMVectorScale(axis, maximumDistance)));
+		toSet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+	}
+
+	void FinishMeshlet(const SubMeshStreams& streams, Meshlet& meshlet,
+		std::vector<unsigned int>& localIndices, MeshletData& toFill)
+	{
+		if (meshlet.primitiveCount == 0)
+			return;
+
+		MeshletBounds bounds;
+		CalculateSphere(streams.positions,
+			toFill.vertices.data() + meshlet.vertexOffset, meshlet.vertexCount,
+			bounds);
+
+		// The primitives are consecutive triangles of the sub mesh, so the
+		// cone is built from the source indices directly
+		std::uint32_t firstTriangle = static_cast<std::uint32_t>(
+			meshlet.primitiveOffset);
+		CalculateCone(streams, streams.indices + firstTriangle * 3,
+			meshlet.primitiveCount, bounds);
+
+		for (std::uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			localIndices[toFill.vertices[meshlet.vertexOffset + i]] = NOT_IN_MESHLET;
+
+		toFill.meshlets.push_back(meshlet);
+		toFill.bounds.push_back(bounds);
+	}
+}
+
+void BuildMeshlets(const SubMeshStreams& streams, MeshletData& toFill,
+	unsigned int maxVertices, unsigned int maxTriangles)
+{
+	toFill = MeshletData();
+	if (streams.positions == nullptr || streams.nrOfIndices < 3)
+		return;
+
+	std::vector<unsigned int> localIndices(streams.nrOfVertices, NOT_IN_MESHLET);
+	Meshlet current;
+
+	for (unsigned int i = 0; i + 2 < streams.nrOfIndices; i += 3)
+	{
+		const unsigned int* triangle = streams.indices + i;
+		std::uint32_t newVertices = 0;
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			bool repeated = (j > 0 && triangle[j] == triangle[0]) ||
+				(j > 1 && triangle[j] == triangle[1]);
+			if (localIndices[triangle[j]] == NOT_IN_MESHLET && !repeated)
+				++newVertices;
+		}
+
+		if (current.vertexCount + newVertices > maxVertices ||
+			current.primitiveCount + 1 > maxTriangles)
+		{
+			FinishMeshlet(streams, current, localIndices, toFill);
+			current.vertexOffset = static_cast<std::uint32_t>(toFill.vertices.size());
+			current.primitiveOffset =
+				static_cast<std::uint32_t>(toFill.primitives.size());
+			current.vertexCount = 0;
+			current.primitiveCount = 0;
+		}
+
+		std::uint32_t packed = 0;
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			unsigned int& local = localIndices[triangle[j]];
+			if (local == NOT_IN_MESHLET)
+			{
+				local = current.vertexCount++;
+				toFill.vertices.push_back(triangle[j]);
+			}
+
+			packed |= static_cast<std::uint32_t>(local) << (j * 8);
+		}
+
+		toFill.primitives.push_back(packed);
+		++current.primitiveCount;
+	}
+
+	FinishMeshlet(streams, current, localIndices, toFill);
+}
+
+bool ValidateMeshlets(const SubMeshStreams& streams,
+	const MeshletData& meshlets, unsigned int maxVertices,
+	unsigned int maxTriangles)
+{
+	if (meshlets.meshlets.size() != meshlets.bounds.size())
+		return false;
+
+	size_t nextVertex = 0;
+	size_t nextPrimitive = 0;
+	for (size_t i = 0; i < meshlets.meshlets.size(); ++i)
+	{
+		const Meshlet& meshlet = meshlets.meshlets[i];
+		const MeshletBounds& bounds = meshlets.bounds[i];
+		if (meshlet.vertexOffset != nextVertex ||
+			meshlet.primitiveOffset != nextPrimitive ||
+			meshlet.vertexCount == 0 || meshlet.vertexCount > maxVertices ||
+			meshlet.primitiveCount == 0 || meshlet.primitiveCount > maxTriangles ||
+			nextVertex + meshlet.vertexCount > meshlets.vertices.size() ||
+			nextPrimitive + meshlet.primitiveCount > meshlets.primitives.size())
+		{
+			return false;
+		}
+
+		XMVECTOR center = XMLoadFloat3(&bounds.center);
+		for (std::uint32_t j = 0; j < meshlet.vertexCount; ++j)
+		{
+			std::uint32_t vertex = meshlets.vertices[meshlet.vertexOffset + j];
+			if (vertex >= streams.nrOfVertices)
+				return false;
+
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(
+				XMLoadFloat3(&streams.positions[vertex]), center)));
+			if (distance > bounds.radius * (1.0f + BOUNDS_TOLERANCE) +
+				BOUNDS_TOLERANCE)
+			{
+				return false;
+			}
+		}
+
+		float minimumDot = std::sqrt(std::max(0.0f,
+			1.0f - bounds.coneCutoff * bounds.coneCutoff));
+		for (std::uint32_t j = 0; j < meshlet.primitiveCount; ++j)
+		{
+			std::uint32_t packed = meshlets.primitives[meshlet.primitiveOffset + j];
+			unsigned int triangle[3];
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				std::uint32_t local = (packed >> (k * 8)) & 0xFF;
+				if (local >= meshlet.vertexCount)
+					return false;
+
+				triangle[k] = meshlets.vertices[meshlet.vertexOffset + local];
+				size_t sourceIndex = (nextPrimitive + j) * 3 + k;
+				if (sourceIndex >= streams.nrOfIndices ||
+					streams.indices[sourceIndex] != triangle[k])
+				{
+					return false;
+				}
+			}
+
+			XMVECTOR normal = TriangleNormal(streams.positions, triangle);
+			if (bounds.coneCutoff >= 1.0f ||
+				XMVectorGetX(XMVector3Length(normal)) == 0.0f)
+			{
+				continue;
+			}
+
+			float dot = XMVectorGetX(XMVector3Dot(XMVector3Normalize(normal),
+				XMLoadFloat3(&bounds.coneAxis)));
+			if (dot < minimumDot - BOUNDS_TOLERANCE)
+				return false;
+		}
+
+		nextVertex += meshlet.vertexCount;
+		nextPrimitive += meshlet.primitiveCount;
+	}
+
+	return nextVertex == meshlets.vertices.size() &&
+		nextPrimitive == meshlets.primitives.size() &&
+		nextPrimitive == streams.nrOfIndices / 3;
+}
+
+void AccumulateMeshletStatistics(const MeshletData& meshlets,
+	MeshletStatistics& statistics)
+{
+	statistics.nrOfMeshlets += meshlets.meshlets.size();
+	statistics.nrOfVertices += meshlets.vertices.size();
+	statistics.nrOfPrimitives += meshlets.primitives.size();
+	statistics.usableCones += static_cast<size_t>(std::count_if(
+		meshlets.bounds.begin(), meshlets.bounds.end(),
+		[](const MeshletBounds& bounds)
+		{
+			return bounds.coneCutoff < 1.0f;
+		}));
+	statistics.byteSize += meshlets.meshlets.size() * sizeof(Meshlet) +
+		meshlets.bounds.size() * sizeof(MeshletBounds) +
+		meshlets.vertices.size() * sizeof(std::uint32_t) +
+		meshlets.primitives.size() * sizeof(std::uint32_t);
+}
\ No newline at end of file
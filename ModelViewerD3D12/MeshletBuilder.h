@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+#include "SubMeshData.h"
+
+// Well below the mesh shader maximum of 256, 64 vertices and 124 triangles is
+// a good fit for the thread group sizes of current GPUs
+const unsigned int MAX_MESHLET_VERTICES = 64;
+const unsigned int MAX_MESHLET_TRIANGLES = 124;
+
+// Offsets are into the vertex and primitive arrays of the owning sub mesh
+struct Meshlet
+{
+	std::uint32_t vertexOffset = 0;
+	std::uint32_t primitiveOffset = 0;
+	std::uint32_t vertexCount = 0;
+	std::uint32_t primitiveCount = 0;
+};
+
+// The meshlet is back facing for every position p where
+// dot(normalize(coneApex - p), coneAxis) >= coneCutoff. A cutoff of 1 means
+// the normals spread too much for the cone to be used.
+struct MeshletBounds
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+	DirectX::XMFLOAT3 coneAxis;
+	float coneCutoff;
+	DirectX::XMFLOAT3 coneApex;
+	float padding;
+};
+
+// Each primitive is three 8 bit indices into the vertices of its meshlet, the
+// first vertex in the low byte. Vertices are indices into the sub mesh.
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshletBounds> bounds;
+	std::vector<std::uint32_t> vertices;
+	std::vector<std::uint32_t> primitives;
+};
+
+// Greedily fills meshlets with the triangles in index order, so the result
+// only depends on the input and follows the locality of the index order
+void BuildMeshlets(const SubMeshStreams& streams, MeshletData& toFill,
+	unsigned int maxVertices = MAX_MESHLET_VERTICES,
+	unsigned int maxTriangles = MAX_MESHLET_TRIANGLES);
+
+// Checks the limits and offsets of every meshlet, that the meshlets reproduce
+// the indices of the sub mesh in order, that every vertex is inside the
+// bounding sphere and every triangle normal inside the normal cone
+bool ValidateMeshlets(const SubMeshStreams& streams, const MeshletData& meshlets,
+	unsigned int maxVertices = MAX_MESHLET_VERTICES,
+	unsigned int maxTriangles = MAX_MESHLET_TRIANGLES);
+
+struct MeshletStatistics
+{
+	size_t nrOfMeshlets = 0;
+	size_t nrOfVertices = 0;
+	size_t nrOfPrimitives = 0;
+	size_t usableCones = 0;
+	size_t byteSize = 0;
+};
+
+// Adds the meshlets of one sub mesh to the statistics
+void AccumulateMeshletStatistics(const MeshletData& meshlets,
+	MeshletStatistics& statistics);
\ No newline at end of file
@@ -0,0 +1,1096 @@
+#include "MipGeneration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include <immintrin.h>
+
+#include "ParallelFor.h"
+
+namespace
+{
+	// Levels smaller than this are filtered by the calling thread alone, the
+	// threads would cost more to start than they save
+	const size_t PARALLEL_LEVEL_BYTES = 256 * 1024;
+	const UINT BAND_ROWS = 16;
+
+	// Wide kernels filter the rows they share with the neighbouring bands
+	// twice, taller bands keep that small
+	const UINT FILTER_BAND_ROWS = 64;
+
+	// A level and the previous level it is filtered from
+	struct LevelPair
+	{
+		const unsigned char* source = nullptr;
+		unsigned char* destination = nullptr;
+		size_t sourceRowSize = 0;
+		size_t destinationRowSize = 0;
+		UINT sourceRows = 0;
+		size_t sourceWidth = 0;
+		size_t destinationWidth = 0;
+		unsigned int componentsPerTexel = 0;
+	};
+
+	std::uint8_t Average(std::uint8_t topLeft, std::uint8_t topRight,
+		std::uint8_t bottomLeft, std::uint8_t bottomRight)
+	{
+		return static_cast<std::uint8_t>(
+			(topLeft + topRight + bottomLeft + bottomRight) >> 2);
+	}
+
+	// The vector kernels add in the same order
+	float Average(float topLeft, float topRight, float bottomLeft,
+		float bottomRight)
+	{
+		return ((topLeft + topRight) + (bottomLeft + bottomRight)) * 0.25f;
+	}
+
+	template<typename ComponentType>
+	void FilterRowScalar(const ComponentType* top, const ComponentType* bottom,
+		ComponentType* destination, size_t startTexel, const LevelPair& level)
+	{
+		unsigned int components = level.componentsPerTexel;
+		for (size_t texel = startTexel; texel < level.destinationWidth; ++texel)
+		{
+			const size_t left = texel * 2 * components;
+			const size_t right = std::min(texel * 2 + 1, level.sourceWidth - 1) *
+				components;
+			for (unsigned int component = 0; component < components; ++component)
+			{
+				destination[texel * components + component] = Average(
+					top[left + component], top[right + component],
+					bottom[left + component], bottom[right + component]);
+			}
+		}
+	}
+
+	// Sums the horizontally neighbouring texels of the 16 bit sums of two
+	// rows, low holds the first eight components and high the next eight.
+	// Returns the eight components of the half as many texels.
+	template<unsigned int Components>
+	__m128i AddTexelPairs(__m128i low, __m128i high)
+	{
+		if constexpr (Components == 1)
+		{
+			const __m128i ones = _mm_set1_epi16(1);
+			return _mm_packs_epi32(_mm_madd_epi16(low, ones),
+				_mm_madd_epi16(high, ones));
+		}
+		else if constexpr (Components == 2)
+		{
+			__m128 lowTexels = _mm_castsi128_ps(low);
+			__m128 highTexels = _mm_castsi128_ps(high);
+			__m128i even = _mm_castps_si128(_mm_shuffle_ps(lowTexels, highTexels,
+				_MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i odd = _mm_castps_si128(_mm_shuffle_ps(lowTexels, highTexels,
+				_MM_SHUFFLE(3, 1, 3, 1)));
+			return _mm_add_epi16(even, odd);
+		}
+		else
+		{
+			return _mm_add_epi16(_mm_unpacklo_epi64(low, high),
+				_mm_unpackhi_epi64(low, high));
+		}
+	}
+
+	// Same as the SSE version within each 128 bit lane
+	template<unsigned int Components>
+	__m256i AddTexelPairs(__m256i low, __m256i high)
+	{
+		if constexpr (Components == 1)
+		{
+			const __m256i ones = _mm256_set1_epi16(1);
+			return _mm256_packs_epi32(_mm256_madd_epi16(low, ones),
+				_mm256_madd_epi16(high, ones));
+		}
+		else if constexpr (Components == 2)
+		{
+			__m256 lowTexels = _mm256_castsi256_ps(low);
+			__m256 highTexels = _mm256_castsi256_ps(high);
+			__m256i even = _mm256_castps_si256(_mm256_shuffle_ps(lowTexels,
+				highTexels, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(lowTexels,
+				highTexels, _MM_SHUFFLE(3, 1, 3, 1)));
+			return _mm256_add_epi16(even, odd);
+		}
+		else
+		{
+			return _mm256_add_epi16(_mm256_unpacklo_epi64(low, high),
+				_mm256_unpackhi_epi64(low, high));
+		}
+	}
+
+	// Four sums of horizontally neighbouring texels from eight components
+	template<unsigned int Components>
+	__m128 AddTexelPairs(__m128 first, __m128 second)
+	{
+		if constexpr (Components == 1)
+		{
+			return _mm_add_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		else if constexpr (Components == 2)
+		{
+			return _mm_add_ps(_mm_movelh_ps(first, second),
+				_mm_movehl_ps(second, first));
+		}
+		else
+		{
+			return _mm_add_ps(first, second);
+		}
+	}
+
+	template<unsigned int Components>
+	__m256 AddTexelPairs(__m256 first, __m256 second)
+	{
+		if constexpr (Components == 1)
+		{
+			return _mm256_add_ps(
+				_mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		else if constexpr (Components == 2)
+		{
+			__m256d firstPairs = _mm256_castps_pd(first);
+			__m256d secondPairs = _mm256_castps_pd(second);
+			return _mm256_add_ps(
+				_mm256_castpd_ps(_mm256_unpacklo_pd(firstPairs, secondPairs)),
+				_mm256_castpd_ps(_mm256_unpackhi_pd(firstPairs, secondPairs)));
+		}
+		else
+		{
+			return _mm256_add_ps(first, second);
+		}
+	}
+
+	// Every kernel filters whole groups of destination components and returns
+	// how many it filtered, destination component i is filtered from source
+	// components 2 * i and on. The rest is left to the scalar loop.
+	template<unsigned int Components>
+	size_t FilterBytesSSE(const std::uint8_t* top, const std::uint8_t* bottom,
+		std::uint8_t* destination, size_t nrOfComponents)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		size_t done = 0;
+		for (; done + 16 <= nrOfComponents; done += 16)
+		{
+			__m128i halves[2];
+			for (size_t half = 0; half < 2; ++half)
+			{
+				size_t offset = done * 2 + half * 16;
+				__m128i topTexels = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(top + offset));
+				__m128i bottomTexels = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(bottom + offset));
+				__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(topTexels, zero),
+					_mm_unpacklo_epi8(bottomTexels, zero));
+				__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(topTexels, zero),
+					_mm_unpackhi_epi8(bottomTexels, zero));
+				halves[half] = _mm_srli_epi16(AddTexelPairs<Components>(low, high), 2);
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + done),
+				_mm_packus_epi16(halves[0], halves[1]));
+		}
+
+		return done;
+	}
+
+	__m256i LoadLanes(const std::uint8_t* low, const std::uint8_t* high)
+	{
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(low))), _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(high)), 1);
+	}
+
+	__m256 LoadLanes(const float* low, const float* high)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)),
+			_mm_loadu_ps(high), 1);
+	}
+
+	// Each 128 bit lane runs the SSE kernel on its own 16 components, the
+	// lanes are loaded so no component has to cross between them
+	template<unsigned int Components>
+	size_t FilterBytesAVX2(const std::uint8_t* top, const std::uint8_t* bottom,
+		std::uint8_t* destination, size_t nrOfComponents)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		size_t done = 0;
+		for (; done + 32 <= nrOfComponents; done += 32)
+		{
+			__m256i halves[2];
+			for (size_t half = 0; half < 2; ++half)
+			{
+				size_t offset = done * 2 + half * 16;
+				__m256i topTexels = LoadLanes(top + offset, top + offset + 32);
+				__m256i bottomTexels = LoadLanes(bottom + offset,
+					bottom + offset + 32);
+				__m256i low = _mm256_add_epi16(_mm256_unpacklo_epi8(topTexels, zero),
+					_mm256_unpacklo_epi8(bottomTexels, zero));
+				__m256i high = _mm256_add_epi16(_mm256_unpackhi_epi8(topTexels, zero),
+					_mm256_unpackhi_epi8(bottomTexels, zero));
+				halves[half] = _mm256_srli_epi16(
+					AddTexelPairs<Components>(low, high), 2);
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + done),
+				_mm256_packus_epi16(halves[0], halves[1]));
+		}
+
+		return done + FilterBytesSSE<Components>(top + done * 2,
+			bottom + done * 2, destination + done, nrOfComponents - done);
+	}
+
+	template<unsigned int Components>
+	size_t FilterFloatsSSE(const float* top, const float* bottom,
+		float* destination, size_t nrOfComponents)
+	{
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		size_t done = 0;
+		for (; done + 4 <= nrOfComponents; done += 4)
+		{
+			const float* topTexels = top + done * 2;
+			const float* bottomTexels = bottom + done * 2;
+			__m128 topSum = AddTexelPairs<Components>(_mm_loadu_ps(topTexels),
+				_mm_loadu_ps(topTexels + 4));
+			__m128 bottomSum = AddTexelPairs<Components>(
+				_mm_loadu_ps(bottomTexels), _mm_loadu_ps(bottomTexels + 4));
+			_mm_storeu_ps(destination + done,
+				_mm_mul_ps(_mm_add_ps(topSum, bottomSum), quarter));
+		}
+
+		return done;
+	}
+
+	template<unsigned int Components>
+	size_t FilterFloatsAVX2(const float* top, const float* bottom,
+		float* destination, size_t nrOfComponents)
+	{
+		const __m256 quarter = _mm256_set1_ps(0.25f);
+		size_t done = 0;
+		for (; done + 8 <= nrOfComponents; done += 8)
+		{
+			const float* topTexels = top + done * 2;
+			const float* bottomTexels = bottom + done * 2;
+			__m256 topSum = AddTexelPairs<Components>(
+				LoadLanes(topTexels, topTexels + 8),
+				LoadLanes(topTexels + 4, topTexels + 12));
+			__m256 bottomSum = AddTexelPairs<Components>(
+				LoadLanes(bottomTexels, bottomTexels + 8),
+				LoadLanes(bottomTexels + 4, bottomTexels + 12));
+			_mm256_storeu_ps(destination + done,
+				_mm256_mul_ps(_mm256_add_ps(topSum, bottomSum), quarter));
+		}
+
+		return done + FilterFloatsSSE<Components>(top + done * 2,
+			bottom + done * 2, destination + done, nrOfComponents - done);
+	}
+
+	template<typename ComponentType, unsigned int Components>
+	size_t FilterRowVectorized(const ComponentType* top,
+		const ComponentType* bottom, ComponentType* destination,
+		size_t nrOfComponents, InstructionSet instructionSet)
+	{
+		if constexpr (std::is_same_v<ComponentType, std::uint8_t>)
+		{
+			if (instructionSet == InstructionSet::AVX2)
+			{
+				return FilterBytesAVX2<Components>(top, bottom, destination,
+					nrOfComponents);
+			}
+
+			return FilterBytesSSE<Components>(top, bottom, destination,
+				nrOfComponents);
+		}
+		else
+		{
+			if (instructionSet == InstructionSet::AVX2)
+			{
+				return FilterFloatsAVX2<Components>(top, bottom, destination,
+					nrOfComponents);
+			}
+
+			return FilterFloatsSSE<Components>(top, bottom, destination,
+				nrOfComponents);
+		}
+	}
+
+	// A source level one texel wide has no neighbour to pair with, which
+	// the kernels assume, but then the row is a single texel anyway
+	template<typename ComponentType>
+	void FilterRow(const LevelPair& level, UINT row,
+		InstructionSet instructionSet)
+	{
+		UINT bottomRow = std::min(row * 2 + 1, level.sourceRows - 1);
+		const ComponentType* top = reinterpret_cast<const ComponentType*>(
+			level.source + row * 2 * level.sourceRowSize);
+		const ComponentType* bottom = reinterpret_cast<const ComponentType*>(
+			level.source + bottomRow * level.sourceRowSize);
+		ComponentType* destination = reinterpret_cast<ComponentType*>(
+			level.destination + row * level.destinationRowSize);
+
+		size_t nrOfComponents = level.destinationWidth * level.componentsPerTexel;
+		size_t done = 0;
+		if (instructionSet != InstructionSet::SCALAR && level.sourceWidth > 1)
+		{
+			if (level.componentsPerTexel == 1)
+			{
+				done = FilterRowVectorized<ComponentType, 1>(top, bottom,
+					destination, nrOfComponents, instructionSet);
+			}
+			else if (level.componentsPerTexel == 2)
+			{
+				done = FilterRowVectorized<ComponentType, 2>(top, bottom,
+					destination, nrOfComponents, instructionSet);
+			}
+			else if (level.componentsPerTexel == 4)
+			{
+				done = FilterRowVectorized<ComponentType, 4>(top, bottom,
+					destination, nrOfComponents, instructionSet);
+			}
+		}
+
+		FilterRowScalar(top, bottom, destination,
+			done / level.componentsPerTexel, level);
+	}
+
+	// The power the pixel shader decodes colour maps with
+	const float DISPLAY_GAMMA = 2.2f;
+	const float PI = 3.14159265358979f;
+	const float KERNEL_RADIUS = 3.0f;
+	const double KAISER_ALPHA = 4.0;
+
+	// Linear values are looked up in steps of this, the steps hold the first
+	// byte they encode to
+	const unsigned int ENCODE_STEPS = 4096;
+
+	// Linear value of every gamma encoded byte, and the linear values half way
+	// between neighbouring encoded bytes that encoding rounds at
+	struct GammaTables
+	{
+		float decoded[256];
+		float thresholds[255];
+		std::uint8_t firstEncoded[ENCODE_STEPS + 1];
+	};
+
+	const GammaTables& GetGammaTables()
+	{
+		static const GammaTables toReturn = []()
+			{
+				GammaTables tables;
+				for (unsigned int value = 0; value < 256; ++value)
+					tables.decoded[value] = std::pow(value / 255.0f, DISPLAY_GAMMA);
+
+				for (unsigned int value = 0; value < 255; ++value)
+				{
+					tables.thresholds[value] =
+						std::pow((value + 0.5f) / 255.0f, DISPLAY_GAMMA);
+				}
+
+				for (unsigned int step = 0; step <= ENCODE_STEPS; ++step)
+				{
+					float linear = static_cast<float>(step) / ENCODE_STEPS;
+					tables.firstEncoded[step] = static_cast<std::uint8_t>(
+						std::upper_bound(tables.thresholds, tables.thresholds + 255,
+							linear) - tables.thresholds);
+				}
+
+				return tables;
+			}();
+
+		return toReturn;
+	}
+
+	// Rounds in encoded space, the step only narrows down the thresholds to
+	// compare with, a few near black and one or none elsewhere. The linear
+	// value has to be in [0, 1].
+	std::uint8_t EncodeGamma(float linear, const GammaTables& tables)
+	{
+		unsigned int toReturn =
+			tables.firstEncoded[static_cast<unsigned int>(linear * ENCODE_STEPS)];
+		while (toReturn < 255 && linear >= tables.thresholds[toReturn])
+			++toReturn;
+
+		return static_cast<std::uint8_t>(toReturn);
+	}
+
+	float Sinc(float x)
+	{
+		if (std::fabs(x) < 1e-6f)
+			return 1.0f;
+
+		return std::sin(PI * x) / (PI * x);
+	}
+
+	// Zeroth order modified Bessel function of the first kind, the series
+	// has converged well before the last term for the Kaiser alpha used
+	double BesselI0(double x)
+	{
+		double toReturn = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			double factor = x / (2.0 * k);
+			term *= factor * factor;
+			toReturn += term;
+		}
+
+		return toReturn;
+	}
+
+	// The distance is in texels of the destination level
+	float KernelWeight(MipKernel kernel, float distance)
+	{
+		distance = std::fabs(distance);
+		if (distance >= KERNEL_RADIUS)
+			return 0.0f;
+
+		float window = 0.0f;
+		if (kernel == MipKernel::LANCZOS)
+		{
+			window = Sinc(distance / KERNEL_RADIUS);
+		}
+		else
+		{
+			float t = distance / KERNEL_RADIUS;
+			window = static_cast<float>(BesselI0(KAISER_ALPHA *
+				std::sqrt(1.0 - t * t)) / BesselI0(KAISER_ALPHA));
+		}
+
+		return Sinc(distance) * window;
+	}
+
+	// Source texels and normalized weights of every destination texel along
+	// one axis, those of texel i are from starts[i] up to starts[i + 1]
+	struct AxisTaps
+	{
+		std::vector<size_t> starts;
+		std::vector<size_t> indices;
+		std::vector<float> weights;
+	};
+
+	// The box kernel covers the same texels as the 2x2 mean, the others are
+	// centred on the destination texel whatever the ratio of the sizes
+	AxisTaps CalculateAxisTaps(MipKernel kernel, size_t sourceSize,
+		size_t destinationSize)
+	{
+		AxisTaps toReturn;
+		toReturn.starts.push_back(0);
+		for (size_t texel = 0; texel < destinationSize; ++texel)
+		{
+			if (kernel == MipKernel::BOX)
+			{
+				toReturn.indices.push_back(texel * 2);
+				toReturn.indices.push_back(std::min(texel * 2 + 1, sourceSize - 1));
+				toReturn.weights.push_back(0.5f);
+				toReturn.weights.push_back(0.5f);
+			}
+			else
+			{
+				double scale = static_cast<double>(sourceSize) / destinationSize;
+				double centre = (texel + 0.5) * scale;
+				double radius = KERNEL_RADIUS * scale;
+				std::ptrdiff_t first =
+					static_cast<std::ptrdiff_t>(std::floor(centre - radius));
+				std::ptrdiff_t last =
+					static_cast<std::ptrdiff_t>(std::ceil(centre + radius));
+				size_t start = toReturn.weights.size();
+				float weightSum = 0.0f;
+				for (std::ptrdiff_t source = first; source <= last; ++source)
+				{
+					float weight = KernelWeight(kernel,
+						static_cast<float>((source + 0.5 - centre) / scale));
+					if (weight == 0.0f)
+						continue;
+
+					std::ptrdiff_t clamped = std::clamp<std::ptrdiff_t>(source, 0,
+						static_cast<std::ptrdiff_t>(sourceSize) - 1);
+					toReturn.indices.push_back(static_cast<size_t>(clamped));
+					toReturn.weights.push_back(weight);
+					weightSum += weight;
+				}
+
+				for (size_t tap = start; tap < toReturn.weights.size(); ++tap)
+					toReturn.weights[tap] /= weightSum;
+			}
+
+			toReturn.starts.push_back(toReturn.weights.size());
+		}
+
+		return toReturn;
+	}
+
+	// How the stored components of a texel map to the filtered ones, two
+	// component normals are filtered with their rebuilt z as a third
+	struct FilterLayout
+	{
+		MipFilterSettings settings;
+		TexelFormat texelFormat = TexelFormat::BYTE;
+		unsigned int components = 0;
+		unsigned int workingComponents = 0;
+		unsigned int colourComponents = 0;
+		unsigned int normalComponents = 0;
+		bool hasAlpha = false;
+		float storedAlphaCutoff = 0.0f;
+
+		// Filtered value of every BYTE value of each component
+		float decodedBytes[4][256] = {};
+	};
+
+	FilterLayout CreateFilterLayout(const MipFilterSettings& settings,
+		TexelFormat texelFormat, unsigned int componentsPerTexel)
+	{
+		FilterLayout toReturn;
+		toReturn.settings = settings;
+		toReturn.texelFormat = texelFormat;
+		toReturn.components = componentsPerTexel;
+		toReturn.workingComponents = componentsPerTexel;
+		if (settings.renormalizeNormals && componentsPerTexel >= 2)
+		{
+			toReturn.normalComponents = std::min(componentsPerTexel, 3u);
+			toReturn.workingComponents = std::max(componentsPerTexel, 3u);
+		}
+		else if (settings.gammaCorrect)
+		{
+			toReturn.colourComponents = std::min(componentsPerTexel, 3u);
+		}
+
+		toReturn.hasAlpha = settings.preserveAlphaCoverage &&
+			componentsPerTexel == 4;
+
+		const GammaTables& tables = GetGammaTables();
+		for (unsigned int component = 0; component < componentsPerTexel;
+			++component)
+		{
+			for (unsigned int value = 0; value < 256; ++value)
+			{
+				float decoded = component < toReturn.colourComponents ?
+					tables.decoded[value] : value / 255.0f;
+				if (component < toReturn.normalComponents)
+					decoded = decoded * 2.0f - 1.0f;
+
+				toReturn.decodedBytes[component][value] = decoded;
+			}
+		}
+
+		// Smallest filtered alpha that is stored as an alpha that passes, a
+		// BYTE alpha passes from the first byte at or above the cutoff on and
+		// filtered alphas round to it from half a byte below
+		toReturn.storedAlphaCutoff = settings.alphaCutoff;
+		if (texelFormat == TexelFormat::BYTE)
+		{
+			unsigned int firstPassing = 0;
+			while (firstPassing < 255 &&
+				firstPassing / 255.0f < settings.alphaCutoff)
+			{
+				++firstPassing;
+			}
+
+			toReturn.storedAlphaCutoff = firstPassing == 0 ? 0.0f :
+				(firstPassing - 0.5f) / 255.0f;
+		}
+
+		return toReturn;
+	}
+
+	// Normal components are mapped to [-1, 1] as well
+	void DecodeTexels(const unsigned char* source, size_t nrOfTexels,
+		const FilterLayout& layout, float* toFill)
+	{
+		unsigned int components = layout.components;
+		unsigned int workingComponents = layout.workingComponents;
+		if (layout.texelFormat == TexelFormat::BYTE)
+		{
+			for (size_t texel = 0; texel < nrOfTexels; ++texel)
+			{
+				for (unsigned int component = 0; component < components; ++component)
+				{
+					toFill[texel * workingComponents + component] =
+						layout.decodedBytes[component][source[texel * components +
+						component]];
+				}
+			}
+		}
+		else
+		{
+			const float* texels = reinterpret_cast<const float*>(source);
+			for (size_t texel = 0; texel < nrOfTexels; ++texel)
+			{
+				for (unsigned int component = 0; component < components; ++component)
+				{
+					float value = texels[texel * components + component];
+					if (component < layout.colourComponents)
+						value = std::pow(std::max(value, 0.0f), DISPLAY_GAMMA);
+					else if (component < layout.normalComponents)
+						value = value * 2.0f - 1.0f;
+
+					toFill[texel * workingComponents + component] = value;
+				}
+			}
+		}
+
+		if (layout.normalComponents == 2)
+		{
+			for (size_t texel = 0; texel < nrOfTexels; ++texel)
+			{
+				float* working = toFill + texel * workingComponents;
+				working[2] = std::sqrt(std::max(1.0f -
+					working[0] * working[0] - working[1] * working[1], 0.0f));
+			}
+		}
+	}
+
+	void EncodeTexels(const float* source, size_t nrOfTexels,
+		const FilterLayout& layout, float alphaScale, unsigned char* destination)
+	{
+		const GammaTables& tables = GetGammaTables();
+		unsigned int components = layout.components;
+		for (size_t texel = 0; texel < nrOfTexels; ++texel)
+		{
+			float working[4];
+			std::copy(source + texel * layout.workingComponents,
+				source + (texel + 1) * layout.workingComponents, working);
+			if (layout.normalComponents > 0)
+			{
+				float length = std::sqrt(working[0] * working[0] +
+					working[1] * working[1] + working[2] * working[2]);
+				for (unsigned int component = 0; component < 3; ++component)
+				{
+					float unit = length > 0.0f ? working[component] / length :
+						(component == 2 ? 1.0f : 0.0f);
+					working[component] = unit * 0.5f + 0.5f;
+				}
+			}
+
+			if (layout.hasAlpha)
+				working[3] = std::min(working[3] * alphaScale, 1.0f);
+
+			if (layout.texelFormat == TexelFormat::BYTE)
+			{
+				std::uint8_t* stored = destination + texel * components;
+				for (unsigned int component = 0; component < components; ++component)
+				{
+					float value = std::clamp(working[component], 0.0f, 1.0f);
+					stored[component] = component < layout.colourComponents ?
+						EncodeGamma(value, tables) :
+						static_cast<std::uint8_t>(value * 255.0f + 0.5f);
+				}
+			}
+			else
+			{
+				float* stored = reinterpret_cast<float*>(destination) +
+					texel * components;
+				for (unsigned int component = 0; component < components; ++component)
+				{
+					float value = working[component];
+					stored[component] = component < layout.colourComponents ?
+						std::pow(std::max(value, 0.0f), 1.0f / DISPLAY_GAMMA) : value;
+				}
+			}
+		}
+	}
+
+	// Share of the texels of the stored level 0 whose alpha passes the cutoff
+	float CalculateAlphaCoverage(const unsigned char* data, size_t nrOfTexels,
+		const FilterLayout& layout)
+	{
+		size_t covered = 0;
+		for (size_t texel = 0; texel < nrOfTexels; ++texel)
+		{
+			float alpha = layout.texelFormat == TexelFormat::BYTE ?
+				data[texel * 4 + 3] / 255.0f :
+				reinterpret_cast<const float*>(data)[texel * 4 + 3];
+			covered += alpha >= layout.settings.alphaCutoff ? 1 : 0;
+		}
+
+		return static_cast<float>(covered) / nrOfTexels;
+	}
+
+	// Scale closest to 1 that lets as many texels pass as the coverage asks
+	// for. Texels of equal alpha pass together, so when leaving out those at
+	// the threshold comes closer to the coverage the next larger alpha is the
+	// threshold. Scales at the ends of the range are moved a little inside it
+	// so the stored alpha does not round to the other side of the cutoff.
+	float CalculateAlphaScale(const float* texels, size_t nrOfTexels,
+		const FilterLayout& layout, float coverage)
+	{
+		size_t covered = static_cast<size_t>(coverage * nrOfTexels + 0.5f);
+		if (covered == 0 || layout.storedAlphaCutoff <= 0.0f)
+			return 1.0f;
+
+		std::vector<float> alphas(nrOfTexels);
+		for (size_t texel = 0; texel < nrOfTexels; ++texel)
+			alphas[texel] = texels[texel * layout.workingComponents + 3];
+
+		std::nth_element(alphas.begin(), alphas.begin() + (covered - 1),
+			alphas.end(), std::greater<float>());
+		float threshold = alphas[covered - 1];
+		size_t atOrAbove = 0;
+		size_t above = 0;
+		float nextLarger = std::numeric_limits<float>::max();
+		float nextSmaller = 0.0f;
+		float smallestPositive = std::numeric_limits<float>::max();
+		for (float alpha : alphas)
+		{
+			atOrAbove += alpha >= threshold ? 1 : 0;
+			if (alpha > threshold)
+			{
+				++above;
+				nextLarger = std::min(nextLarger, alpha);
+			}
+			else if (alpha < threshold)
+			{
+				nextSmaller = std::max(nextSmaller, alpha);
+			}
+
+			if (alpha > 0.0f)
+				smallestPositive = std::min(smallestPositive, alpha);
+		}
+
+		float below = nextSmaller;
+		if (above > 0 && covered - above < atOrAbove - covered)
+		{
+			below = threshold;
+			threshold = nextLarger;
+		}
+
+		if (threshold <= 0.0f)
+		{
+			// Fewer texels than asked for have any alpha, all of them pass
+			if (smallestPositive == std::numeric_limits<float>::max())
+				return 1.0f;
+
+			threshold = smallestPositive;
+			below = 0.0f;
+		}
+
+		float smallestScale = layout.storedAlphaCutoff / threshold;
+		if (smallestScale > 1.0f)
+			return smallestScale * 1.0001f;
+
+		if (below > 0.0f && layout.storedAlphaCutoff / below <= 1.0f)
+			return layout.storedAlphaCutoff / below * 0.9999f;
+
+		return 1.0f;
+	}
+
+	// Texels of four components are weighted as a whole
+	template<unsigned int Components>
+	void FilterRowHorizontally(const float* source, const AxisTaps& columns,
+		size_t width, float* toFill)
+	{
+		if constexpr (Components == 4)
+		{
+			for (size_t texel = 0; texel < width; ++texel)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (size_t tap = columns.starts[texel];
+					tap < columns.starts[texel + 1]; ++tap)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(
+						source + columns.indices[tap] * 4),
+						_mm_set1_ps(columns.weights[tap])));
+				}
+
+				_mm_storeu_ps(toFill + texel * 4, sum);
+			}
+
+			return;
+		}
+
+		for (size_t texel = 0; texel < width; ++texel)
+		{
+			float sum[Components] = {};
+			for (size_t tap = columns.starts[texel]; tap < columns.starts[texel + 1];
+				++tap)
+			{
+				const float* sourceTexel = source + columns.indices[tap] * Components;
+				for (unsigned int component = 0; component < Components; ++component)
+					sum[component] += sourceTexel[component] * columns.weights[tap];
+			}
+
+			std::copy(sum, sum + Components, toFill + texel * Components);
+		}
+	}
+
+	void AddWeightedRow(const float* source, float weight, size_t nrOfComponents,
+		bool first, float* destination)
+	{
+		const __m128 weights = _mm_set1_ps(weight);
+		size_t component = 0;
+		for (; component + 4 <= nrOfComponents; component += 4)
+		{
+			__m128 weighted = _mm_mul_ps(_mm_loadu_ps(source + component), weights);
+			if (!first)
+				weighted = _mm_add_ps(weighted, _mm_loadu_ps(destination + component));
+
+			_mm_storeu_ps(destination + component, weighted);
+		}
+
+		for (; component < nrOfComponents; ++component)
+		{
+			destination[component] = source[component] * weight +
+				(first ? 0.0f : destination[component]);
+		}
+	}
+
+	// The previous level is kept unrounded in floats, only level 0 is read
+	// from the stored data. Each band of destination rows filters the source
+	// rows it covers horizontally into a buffer of its own and then those
+	// vertically, the few rows a wide kernel shares with the neighbouring
+	// bands are filtered horizontally by both.
+	void FilterLevel(const unsigned char* storedSource,
+		const std::vector<float>& source, size_t sourceWidth, UINT sourceRows,
+		std::vector<float>& toFill, size_t width, UINT height,
+		const FilterLayout& layout, unsigned int nrOfThreads)
+	{
+		unsigned int components = layout.workingComponents;
+		AxisTaps columns = CalculateAxisTaps(layout.settings.kernel, sourceWidth,
+			width);
+		AxisTaps rows = CalculateAxisTaps(layout.settings.kernel, sourceRows,
+			height);
+		size_t storedRowSize = sourceWidth * layout.components *
+			(layout.texelFormat == TexelFormat::BYTE ? sizeof(std::uint8_t) :
+				sizeof(float));
+		size_t rowSize = width * components;
+		toFill.resize(height * rowSize);
+
+		// Contiguous runs of bands per thread, so each allocates its buffers once
+		size_t nrOfBands = (height + FILTER_BAND_ROWS - 1) / FILTER_BAND_ROWS;
+		size_t nrOfRuns = std::min<size_t>(nrOfThreads, nrOfBands);
+		ParallelFor(nrOfRuns, nrOfThreads, [&](size_t run)
+			{
+				std::vector<float> decodedRow(storedSource != nullptr ?
+					sourceWidth * components : 0);
+				std::vector<float> filteredRows;
+				for (size_t band = nrOfBands * run / nrOfRuns;
+					band < nrOfBands * (run + 1) / nrOfRuns; ++band)
+				{
+					UINT firstRow = static_cast<UINT>(band) * FILTER_BAND_ROWS;
+					UINT endRow = std::min(firstRow + FILTER_BAND_ROWS, height);
+					auto bandTaps = std::minmax_element(
+						rows.indices.begin() + rows.starts[firstRow],
+						rows.indices.begin() + rows.starts[endRow]);
+					size_t firstSourceRow = *bandTaps.first;
+					size_t nrOfSourceRows = *bandTaps.second - firstSourceRow + 1;
+					filteredRows.resize(nrOfSourceRows * rowSize);
+					for (size_t row = 0; row < nrOfSourceRows; ++row)
+					{
+						size_t sourceRow = firstSourceRow + row;
+						const float* texels = nullptr;
+						if (storedSource != nullptr)
+						{
+							DecodeTexels(storedSource + sourceRow * storedRowSize,
+								sourceWidth, layout, decodedRow.data());
+							texels = decodedRow.data();
+						}
+						else
+						{
+							texels = source.data() +
+								sourceRow * sourceWidth * components;
+						}
+
+						float* filtered = filteredRows.data() + row * rowSize;
+						if (components == 1)
+							FilterRowHorizontally<1>(texels, columns, width, filtered);
+						else if (components == 2)
+							FilterRowHorizontally<2>(texels, columns, width, filtered);
+						else if (components == 3)
+							FilterRowHorizontally<3>(texels, columns, width, filtered);
+						else
+							FilterRowHorizontally<4>(texels, columns, width, filtered);
+					}
+
+					for (UINT row = firstRow; row < endRow; ++row)
+					{
+						float* destination = toFill.data() + row * rowSize;
+						for (size_t tap = rows.starts[row]; tap < rows.starts[row + 1];
+							++tap)
+						{
+							const float* filtered = filteredRows.data() +
+								(rows.indices[tap] - firstSourceRow) * rowSize;
+							AddWeightedRow(filtered, rows.weights[tap], rowSize,
+								tap == rows.starts[row], destination);
+						}
+					}
+				}
+			});
+	}
+
+	// Every level is filtered in bands of rows, so the two source rows of
+	// each destination row are read while they are still in the cache
+	void GenerateBoxLevels(const unsigned char* topLevel,
+		unsigned char* lowerLevels, const std::vector<UINT>& rows,
+		const std::vector<UINT64>& rowSizes, std::uint8_t componentsPerTexel,
+		TexelFormat texelFormat, unsigned int nrOfThreads,
+		InstructionSet instructionSet)
+	{
+		if (texelFormat != TexelFormat::BYTE && texelFormat != TexelFormat::FLOAT)
+		{
+			throw std::runtime_error(
+				"Unknown texel format when generating mip maps!");
+		}
+
+		if (rows.size() < 2)
+			return;
+
+		if (nrOfThreads == 0)
+			nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		size_t texelSize = componentsPerTexel * (texelFormat == TexelFormat::BYTE ?
+			sizeof(std::uint8_t) : sizeof(float));
+		const unsigned char* source = topLevel;
+		unsigned char* destination = lowerLevels;
+		for (size_t mipLevel = 1; mipLevel < rows.size(); ++mipLevel)
+		{
+			LevelPair level;
+			level.source = source;
+			level.destination = destination;
+			level.sourceRowSize = static_cast<size_t>(rowSizes[mipLevel - 1]);
+			level.destinationRowSize = static_cast<size_t>(rowSizes[mipLevel]);
+			level.sourceRows = rows[mipLevel - 1];
+			level.sourceWidth = level.sourceRowSize / texelSize;
+			level.destinationWidth = level.destinationRowSize / texelSize;
+			level.componentsPerTexel = componentsPerTexel;
+
+			size_t levelBytes = rows[mipLevel] * level.destinationRowSize;
+			size_t nrOfBands = (rows[mipLevel] + BAND_ROWS - 1) / BAND_ROWS;
+			ParallelFor(nrOfBands,
+				levelBytes < PARALLEL_LEVEL_BYTES ? 1u : nrOfThreads,
+				[&](size_t band)
+				{
+					UINT firstRow = static_cast<UINT>(band) * BAND_ROWS;
+					UINT endRow = std::min(firstRow + BAND_ROWS, rows[mipLevel]);
+					for (UINT row = firstRow; row < endRow; ++row)
+					{
+						if (texelFormat == TexelFormat::BYTE)
+							FilterRow<std::uint8_t>(level, row, instructionSet);
+						else
+							FilterRow<float>(level, row, instructionSet);
+					}
+				});
+
+			source = destination;
+			destination += levelBytes;
+		}
+	}
+}
+
+void CalculateMipChainLayout(unsigned int width, unsigned int height,
+	std::uint8_t texelSize, std::vector<UINT>& rows,
+	std::vector<UINT64>& rowSizes)
+{
+	rows.clear();
+	rowSizes.clear();
+	while (true)
+	{
+		rows.push_back(height);
+		rowSizes.push_back(static_cast<UINT64>(width) * texelSize);
+		if (width == 1 && height == 1)
+			break;
+
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+}
+
+void GenerateMipChain(unsigned char* data, const std::vector<UINT>& rows,
+	const std::vector<UINT64>& rowSizes, std::uint8_t componentsPerTexel,
+	TexelFormat texelFormat, unsigned int nrOfThreads,
+	InstructionSet instructionSet)
+{
+	if (rows.empty())
+		return;
+
+	GenerateBoxLevels(data, data + rows[0] * rowSizes[0], rows, rowSizes,
+		componentsPerTexel, texelFormat, nrOfThreads, instructionSet);
+}
+
+void GenerateMipChain(unsigned char* data, const std::vector<UINT>& rows,
+	const std::vector<UINT64>& rowSizes, std::uint8_t componentsPerTexel,
+	TexelFormat texelFormat, const MipFilterSettings& settings,
+	unsigned int nrOfThreads)
+{
+	if (rows.empty())
+		return;
+
+	GenerateMipChain(data, data + rows[0] * rowSizes[0], rows, rowSizes,
+		componentsPerTexel, texelFormat, settings, nrOfThreads);
+}
+
+void GenerateMipChain(const unsigned char* topLevel, unsigned char* lowerLevels,
+	const std::vector<UINT>& rows, const std::vector<UINT64>& rowSizes,
+	std::uint8_t componentsPerTexel, TexelFormat texelFormat,
+	const MipFilterSettings& settings, unsigned int nrOfThreads)
+{
+	if (settings.kernel == MipKernel::BOX && !settings.gammaCorrect &&
+		!settings.renormalizeNormals && !settings.preserveAlphaCoverage)
+	{
+		GenerateBoxLevels(topLevel, lowerLevels, rows, rowSizes,
+			componentsPerTexel, texelFormat, nrOfThreads,
+			GetSupportedInstructionSet());
+		return;
+	}
+
+	if (texelFormat != TexelFormat::BYTE && texelFormat != TexelFormat::FLOAT)
+		throw std::runtime_error("Unknown texel format when generating mip maps!");
+
+	if (componentsPerTexel > 4)
+		throw std::runtime_error("Too many components to filter mip maps with!");
+
+	if (rows.size() < 2)
+		return;
+
+	if (nrOfThreads == 0)
+		nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	FilterLayout layout = CreateFilterLayout(settings, texelFormat,
+		componentsPerTexel);
+	size_t texelSize = componentsPerTexel *
+		(texelFormat == TexelFormat::BYTE ? sizeof(std::uint8_t) : sizeof(float));
+	size_t sourceWidth = static_cast<size_t>(rowSizes[0]) / texelSize;
+	float coverage = layout.hasAlpha ?
+		CalculateAlphaCoverage(topLevel, sourceWidth * rows[0], layout) : 0.0f;
+
+	// Nothing is clipped, as in opaque textures, so nothing is to be kept
+	if (coverage == 1.0f)
+		layout.hasAlpha = false;
+
+	std::vector<float> source;
+	std::vector<float> filtered;
+	unsigned char* destination = lowerLevels;
+	for (size_t mipLevel = 1; mipLevel < rows.size(); ++mipLevel)
+	{
+		size_t width = static_cast<size_t>(rowSizes[mipLevel]) / texelSize;
+		size_t levelBytes = rows[mipLevel] * static_cast<size_t>(rowSizes[mipLevel]);
+		unsigned int levelThreads =
+			levelBytes < PARALLEL_LEVEL_BYTES ? 1u : nrOfThreads;
+		FilterLevel(mipLevel == 1 ? topLevel : nullptr, source, sourceWidth,
+			rows[mipLevel - 1], filtered, width, rows[mipLevel], layout,
+			levelThreads);
+
+		size_t nrOfTexels = width * rows[mipLevel];
+		float alphaScale = layout.hasAlpha ? CalculateAlphaScale(
+			filtered.data(), nrOfTexels, layout, coverage) : 1.0f;
+		size_t nrOfBands = (rows[mipLevel] + BAND_ROWS - 1) / BAND_ROWS;
+		ParallelFor(nrOfBands, levelThreads, [&](size_t band)
+			{
+				size_t firstTexel = band * BAND_ROWS * width;
+				size_t endTexel = std::min(firstTexel + BAND_ROWS * width, nrOfTexels);
+				EncodeTexels(filtered.data() + firstTexel * layout.workingComponents,
+					endTexel - firstTexel, layout, alphaScale,
+					destination + firstTexel * texelSize);
+			});
+
+		std::swap(source, filtered);
+		sourceWidth = width;
+		destination += levelBytes;
+	}
+}
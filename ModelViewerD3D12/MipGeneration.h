@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "VertexConversion.h"
+
+enum class TexelFormat
+{
+	BYTE,
+	FLOAT
+};
+
+// BOX is the 2x2 mean, KAISER and LANCZOS are windowed sincs three texels
+// of the destination level wide to each side, which keep more detail
+enum class MipKernel
+{
+	BOX,
+	KAISER,
+	LANCZOS
+};
+
+// What the components of a texture hold, the default is plain data
+struct MipFilterSettings
+{
+	MipKernel kernel = MipKernel::BOX;
+
+	// Every component but the fourth is gamma encoded, as the colour maps the
+	// pixel shader raises to 2.2, and is filtered after decoding
+	bool gammaCorrect = false;
+
+	// The first three components hold a normal mapped from [-1, 1] to [0, 1],
+	// or the first two with z rebuilt as sqrt(1 - x * x - y * y), and every
+	// filtered normal is scaled back to unit length
+	bool renormalizeNormals = false;
+
+	// The alpha of every level of a four component texture is scaled so the
+	// same share of its texels is at or above alphaCutoff as in level 0, so
+	// alpha tested geometry keeps its coverage in distant levels
+	bool preserveAlphaCoverage = false;
+	float alphaCutoff = 0.5f;
+};
+
+// Rows and row sizes in bytes of every level of the full mip chain of an
+// uncompressed texture, the same values GetCopyableFootprints reports
+void CalculateMipChainLayout(unsigned int width, unsigned int height,
+	std::uint8_t texelSize, std::vector<UINT>& rows,
+	std::vector<UINT64>& rowSizes);
+
+// The levels of the chain are stored back to back in data, level 0 has to be
+// in place already and every following level is filtered from the previous.
+// Each texel is the mean of the 2x2 texels it covers, the last column or row
+// of a level with an odd width or height is left out and a level that is one
+// texel wide or high has its only column or row repeated. BYTE means are
+// rounded down. The rows of large levels are split in bands between up to
+// nrOfThreads threads, 0 uses one per hardware thread. Texels of 1, 2 or 4
+// components are vectorized and every instruction set gives bit identical
+// levels, other texel sizes are always filtered component by component.
+void GenerateMipChain(unsigned char* data, const std::vector<UINT>& rows,
+	const std::vector<UINT64>& rowSizes, std::uint8_t componentsPerTexel,
+	TexelFormat texelFormat, unsigned int nrOfThreads = 0,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
+
+// Filters the levels as the settings describe. Settings that only hold the box
+// kernel use the function above, any other settings filter every level
+// separably in floats from the unrounded previous level, with the edge
+// texels repeated past the edges, and round BYTE results to nearest.
+void GenerateMipChain(unsigned char* data, const std::vector<UINT>& rows,
+	const std::vector<UINT64>& rowSizes, std::uint8_t componentsPerTexel,
+	TexelFormat texelFormat, const MipFilterSettings& settings,
+	unsigned int nrOfThreads = 0);
+
+// Same as above with level 0 left where it is, such as where it was decoded
+// to, and the following levels stored back to back in lowerLevels
+void GenerateMipChain(const unsigned char* topLevel, unsigned char* lowerLevels,
+	const std::vector<UINT>& rows, const std::vector<UINT64>& rowSizes,
+	std::uint8_t componentsPerTexel, TexelFormat texelFormat,
+	const MipFilterSettings& settings, unsigned int nrOfThreads = 0);
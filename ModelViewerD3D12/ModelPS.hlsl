@@ -3,6 +3,7 @@ cbuffer PerObjectComponentIndexBuffer : register(b0, space0)
 	uint diffuseMapIndex;
 	uint specularMapIndex;
 	uint normalMapIndex;
+	uint diffuseMapIsLinear;
 };
 
 cbuffer PerFrameComponentIndexBuffer : register(b1, space0)
@@ -138,7 +139,8 @@ float4 main(VS_OUT input) : SV_TARGET
 
 		clip(diffuseMaterial.w < 0.1f ? -1 : 1);
 
-		diffuseMaterial = pow(diffuseMaterial, 2.2f.xxxx); // Gamma correction
+		if (diffuseMapIsLinear == 0)
+			diffuseMaterial = pow(diffuseMaterial, 2.2f.xxxx); // Gamma correction
 	}
 
 	if (specularMapIndex != -1)
@@ -154,8 +156,10 @@ float4 main(VS_OUT input) : SV_TARGET
 		float3 bitangent = normalize(input.bitangent);
 		float3x3 tbn = float3x3(tangent, bitangent, normal);
 		Texture2D<float4> normalMap = ResourceDescriptorHeap[normalMapIndex];
-		float3 tsNormal = normalMap.Sample(standardSampler, input.uv).xyz;
-		tsNormal = tsNormal * 2.0f - 1.0f;
+		float4 sampledNormal = normalMap.Sample(standardSampler, input.uv);
+		float3 tsNormal = sampledNormal.xyz * 2.0f - 1.0f;
+		if (sampledNormal.w < 0.5f) // Two channel maps only store x and y
+			tsNormal.z = sqrt(saturate(1.0f - dot(tsNormal.xy, tsNormal.xy)));
 		normal = normalize(mul(tsNormal, tbn));
 	}
 
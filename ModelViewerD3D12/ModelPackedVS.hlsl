@@ -0,0 +1,61 @@
+cbuffer PerObjectComponentIndexBuffer : register(b0, space0)
+{
+	uint positionIndex;
+	uint attributeIndex;
+	uint indicesIndex;
+	uint shortIndices;
+
+	unsigned int worldMatrixIndex;
+	unsigned int vpMatrixIndex;
+};
+
+// Must match PackedVertexAttributes in VertexPacking.h
+struct PackedVertexAttributes
+{
+	float2 uv;
+	float3 normal;
+	float4 tangent;
+};
+
+struct VS_OUT
+{
+	float4 svPosition : SV_POSITION;
+	float3 worldPosition : WORLD_POSITION;
+	float2 uv : UV;
+	float3 normal : NORMAL;
+	float3 tangent : TANGENT;
+	float3 bitangent : BITANGENT;
+};
+
+VS_OUT main(uint vertexID : SV_VertexID)
+{
+	VS_OUT toReturn;
+
+	Buffer<float3> positionBuffer = ResourceDescriptorHeap[positionIndex];
+	StructuredBuffer<PackedVertexAttributes> attributeBuffer =
+		ResourceDescriptorHeap[attributeIndex];
+	Buffer<uint> indicesBuffer = ResourceDescriptorHeap[indicesIndex];
+	StructuredBuffer<float4x4> worldMatrices = 
+		ResourceDescriptorHeap[worldMatrixIndex];
+	StructuredBuffer<float4x4> cameraMatrices = 
+		ResourceDescriptorHeap[vpMatrixIndex];
+
+	// Short indices are stored two per element, the first in the low half
+	unsigned int index = indicesBuffer[shortIndices != 0 ? vertexID / 2 : vertexID];
+	if (shortIndices != 0)
+		index = (vertexID & 1) != 0 ? index >> 16 : index & 0xFFFF;
+	float4 localPos = float4(positionBuffer[index], 1.0f);
+	PackedVertexAttributes attributes = attributeBuffer[index];
+	float4x4 worldMatrix = worldMatrices[0];
+	float4x4 vpMatrix = cameraMatrices[0];
+	toReturn.worldPosition = mul(localPos, worldMatrix);
+	toReturn.svPosition = mul(float4(toReturn.worldPosition, 1.0f), vpMatrix);
+	toReturn.uv = attributes.uv;
+	toReturn.normal = mul(attributes.normal, worldMatrix);
+	float3 bitangent = cross(attributes.normal, attributes.tangent.xyz) *
+		attributes.tangent.w;
+	toReturn.tangent = mul(attributes.tangent.xyz, worldMatrix);
+	toReturn.bitangent = mul(bitangent, worldMatrix);
+
+	return toReturn;
+}
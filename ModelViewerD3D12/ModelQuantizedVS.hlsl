@@ -0,0 +1,84 @@
+cbuffer PerObjectComponentIndexBuffer : register(b0, space0)
+{
+	uint positionIndex;
+	uint attributeIndex;
+	uint indicesIndex;
+	uint shortIndices;
+
+	unsigned int worldMatrixIndex;
+	unsigned int vpMatrixIndex;
+};
+
+// Must match QuantizedVertexAttributes in VertexQuantization.h
+struct QuantizedVertexAttributes
+{
+	uint normal;
+	uint tangent;
+	uint uv;
+};
+
+struct VS_OUT
+{
+	float4 svPosition : SV_POSITION;
+	float3 worldPosition : WORLD_POSITION;
+	float2 uv : UV;
+	float3 normal : NORMAL;
+	float3 tangent : TANGENT;
+	float3 bitangent : BITANGENT;
+};
+
+float2 SignNotZero(float2 value)
+{
+	return float2(value.x >= 0.0f ? 1.0f : -1.0f, value.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+float3 DecodeOctahedral(uint encoded)
+{
+	int2 quantized = int2(int(encoded << 16) >> 16, int(encoded) >> 16);
+	float2 xy = max(float2(quantized) / 32767.0f, -1.0f);
+	float3 toReturn = float3(xy, 1.0f - abs(xy.x) - abs(xy.y));
+	if (toReturn.z < 0.0f)
+		toReturn.xy = (1.0f - abs(toReturn.yx)) * SignNotZero(toReturn.xy);
+
+	return normalize(toReturn);
+}
+
+float2 DecodeUV(uint encoded)
+{
+	return float2(f16tof32(encoded & 0xffff), f16tof32(encoded >> 16));
+}
+
+VS_OUT main(uint vertexID : SV_VertexID)
+{
+	VS_OUT toReturn;
+
+	Buffer<float3> positionBuffer = ResourceDescriptorHeap[positionIndex];
+	StructuredBuffer<QuantizedVertexAttributes> attributeBuffer =
+		ResourceDescriptorHeap[attributeIndex];
+	Buffer<uint> indicesBuffer = ResourceDescriptorHeap[indicesIndex];
+	StructuredBuffer<float4x4> worldMatrices = 
+		ResourceDescriptorHeap[worldMatrixIndex];
+	StructuredBuffer<float4x4> cameraMatrices = 
+		ResourceDescriptorHeap[vpMatrixIndex];
+
+	// Short indices are stored two per element, the first in the low half
+	unsigned int index = indicesBuffer[shortIndices != 0 ? vertexID / 2 : vertexID];
+	if (shortIndices != 0)
+		index = (vertexID & 1) != 0 ? index >> 16 : index & 0xFFFF;
+	float4 localPos = float4(positionBuffer[index], 1.0f);
+	QuantizedVertexAttributes attributes = attributeBuffer[index];
+	float3 normal = DecodeOctahedral(attributes.normal);
+	float3 tangent = DecodeOctahedral(attributes.tangent);
+	float handedness = (attributes.tangent & 0x10000) != 0 ? -1.0f : 1.0f;
+	float3 bitangent = cross(normal, tangent) * handedness;
+	float4x4 worldMatrix = worldMatrices[0];
+	float4x4 vpMatrix = cameraMatrices[0];
+	toReturn.worldPosition = mul(localPos, worldMatrix);
+	toReturn.svPosition = mul(float4(toReturn.worldPosition, 1.0f), vpMatrix);
+	toReturn.uv = DecodeUV(attributes.uv);
+	toReturn.normal = mul(normal, worldMatrix);
+	toReturn.tangent = mul(tangent, worldMatrix);
+	toReturn.bitangent = mul(bitangent, worldMatrix);
+
+	return toReturn;
+}
@@ -5,9 +5,10 @@ cbuffer PerObjectComponentIndexBuffer : register(b0, space0)
 	uint normalIndex;
 
 	uint tangentIndex;
-	uint bitangentIndex;
+	uint bitangentIndex; // Rebuilt from the tangent handedness if not set
 
 	uint indicesIndex;
+	uint shortIndices;
 
 	unsigned int worldMatrixIndex;
 	unsigned int vpMatrixIndex;
@@ -30,27 +31,34 @@ VS_OUT main(uint vertexID : SV_VertexID)
 	Buffer<float3> positionBuffer = ResourceDescriptorHeap[positionIndex];
 	Buffer<float2> uvBuffer = ResourceDescriptorHeap[uvIndex];
 	Buffer<float3> normalBuffer = ResourceDescriptorHeap[normalIndex];
-	Buffer<float3> tangentBuffer = ResourceDescriptorHeap[tangentIndex];
-	Buffer<float3> bitangentBuffer = ResourceDescriptorHeap[bitangentIndex];
+	Buffer<float4> tangentBuffer = ResourceDescriptorHeap[tangentIndex];
 	Buffer<uint> indicesBuffer = ResourceDescriptorHeap[indicesIndex];
 	StructuredBuffer<float4x4> worldMatrices = 
 		ResourceDescriptorHeap[worldMatrixIndex];
 	StructuredBuffer<float4x4> cameraMatrices = 
 		ResourceDescriptorHeap[vpMatrixIndex];
 
-	unsigned int index = indicesBuffer[vertexID];
+	// Short indices are stored two per element, the first in the low half
+	unsigned int index = indicesBuffer[shortIndices != 0 ? vertexID / 2 : vertexID];
+	if (shortIndices != 0)
+		index = (vertexID & 1) != 0 ? index >> 16 : index & 0xFFFF;
 	float4 localPos = float4(positionBuffer[index], 1.0f);
 	float2 uv = uvBuffer[index];
 	float3 normal = normalBuffer[index];
-	float3 tangent = tangentBuffer[index];
-	float3 bitangent = bitangentBuffer[index];
+	float4 tangent = tangentBuffer[index];
+	float3 bitangent = cross(normal, tangent.xyz) * tangent.w;
+	if (bitangentIndex != 0xFFFFFFFF)
+	{
+		Buffer<float3> bitangentBuffer = ResourceDescriptorHeap[bitangentIndex];
+		bitangent = bitangentBuffer[index];
+	}
 	float4x4 worldMatrix = worldMatrices[0];
 	float4x4 vpMatrix = cameraMatrices[0];
 	toReturn.worldPosition = mul(localPos, worldMatrix);
 	toReturn.svPosition = mul(float4(toReturn.worldPosition, 1.0f), vpMatrix);
 	toReturn.uv = uv;
 	toReturn.normal = mul(normal, worldMatrix);
-	toReturn.tangent = mul(tangent, worldMatrix);
+	toReturn.tangent = mul(tangent.xyz, worldMatrix);
 	toReturn.bitangent = mul(bitangent, worldMatrix);
 
 	return toReturn;
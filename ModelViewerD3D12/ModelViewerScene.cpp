@@ -1,49 +1,110 @@
 #include "ModelViewerScene.h"
 
+#include <algorithm>
+
 #include "imgui.h"
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx12.h"
 
 using namespace DirectX;
 
-void ModelViewerScene::UpdatePerObjectBuffers()
+namespace
 {
-	const Mesh& mesh = meshLoader.GetMeshInfo(0); // We only have one mesh
-	for (auto& object : objects)
+	// Shaders are compiled to $(OutDir), the directory of the executable
+	std::string GetShaderDirectory()
 	{
-		const SubMesh& submesh = mesh.subMeshes[object.subMeshIndex];
-		VertexShaderPerObjectIndices vsUpload;
-		vsUpload.positionIndex = static_cast<unsigned int>(submesh.position +
-				resourceComponents.GetComponentDescriptorStart(
-				meshLoader.GetPositionComponentIdentifier(), ViewType::SRV));
-		vsUpload.uvIndex = static_cast<unsigned int>(submesh.uv +
-				resourceComponents.GetComponentDescriptorStart(
-					meshLoader.GetUVComponentIdentifier(), ViewType::SRV));
-		vsUpload.normalIndex = static_cast<unsigned int>(submesh.normal +
-				resourceComponents.GetComponentDescriptorStart(
-					meshLoader.GetNormalComponentIdentifier(), ViewType::SRV));
+		char path[MAX_PATH];
+		DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+		std::string toReturn(path, length);
+		return toReturn.substr(0, toReturn.find_last_of("\\/") + 1);
+	}
 
-		vsUpload.tangentIndex = static_cast<unsigned int>(submesh.tangent +
+	std::string GetVertexShaderName(VertexLayout layout)
+	{
+		switch (layout)
+		{
+		case VertexLayout::PACKED:
+			return "ModelPackedVS.cso";
+		case VertexLayout::QUANTIZED:
+			return "ModelQuantizedVS.cso";
+		default:
+			return "ModelVS.cso";
+		}
+	}
+}
+
+void ModelViewerScene::UpdateVertexShaderIndices(const SubMesh& submesh,
+	ResourceIndex vertexShaderBuffer)
+{
+	unsigned int positionIndex = static_cast<unsigned int>(submesh.position +
+		resourceComponents.GetComponentDescriptorStart(
+			meshLoader.GetPositionComponentIdentifier(), ViewType::SRV));
+	unsigned int indicesIndex = static_cast<unsigned int>(submesh.indices +
+		resourceComponents.GetComponentDescriptorStart(
+			meshLoader.GetIndicesComponentIdentifier(submesh), ViewType::SRV));
+	unsigned int shortIndices =
+		submesh.indexFormat == DXGI_FORMAT_R16_UINT ? 1 : 0;
+	unsigned int worldMatrixIndex = static_cast<unsigned int>(worldMatrix +
+		resourceComponents.GetComponentDescriptorStart(
+			worldMatrixComponent, ViewType::SRV));
+	unsigned int vpMatrixIndex = static_cast<unsigned int>(frontCameraMatrix +
+		resourceComponents.GetComponentDescriptorStart(
+			cameraMatrixComponent, ViewType::SRV));
+
+	if (meshLoader.GetVertexLayout() != VertexLayout::SEPARATE)
+	{
+		PackedVertexShaderPerObjectIndices vsUpload;
+		vsUpload.positionIndex = positionIndex;
+		vsUpload.attributeIndex = static_cast<unsigned int>(
+			submesh.packedAttributes +
 			resourceComponents.GetComponentDescriptorStart(
-				meshLoader.GetTangentComponentIdentifier(), ViewType::SRV));
+				meshLoader.GetPackedAttributeComponentIdentifier(), ViewType::SRV));
+		vsUpload.indicesIndex = indicesIndex;
+		vsUpload.shortIndices = shortIndices;
+		vsUpload.worldMatrix = worldMatrixIndex;
+		vsUpload.vpMatrix = vpMatrixIndex;
+
+		resourceComponents.GetDynamicBufferComponent(
+			vertexShaderPerObjectComponent).SetUpdateData(
+				vertexShaderBuffer, &vsUpload);
+		return;
+	}
+
+	VertexShaderPerObjectIndices vsUpload;
+	vsUpload.positionIndex = positionIndex;
+	vsUpload.uvIndex = static_cast<unsigned int>(submesh.uv +
+		resourceComponents.GetComponentDescriptorStart(
+			meshLoader.GetUVComponentIdentifier(), ViewType::SRV));
+	vsUpload.normalIndex = static_cast<unsigned int>(submesh.normal +
+		resourceComponents.GetComponentDescriptorStart(
+			meshLoader.GetNormalComponentIdentifier(), ViewType::SRV));
+	vsUpload.tangentIndex = static_cast<unsigned int>(submesh.tangent +
+		resourceComponents.GetComponentDescriptorStart(
+			meshLoader.GetTangentComponentIdentifier(), ViewType::SRV));
+	if (submesh.bitangent != ResourceIndex(-1))
+	{
 		vsUpload.bitangentIndex = static_cast<unsigned int>(submesh.bitangent +
 			resourceComponents.GetComponentDescriptorStart(
 				meshLoader.GetBitangentComponentIdentifier(), ViewType::SRV));
+	}
 
-		vsUpload.indicesIndex = static_cast<unsigned int>(submesh.indices +
-			resourceComponents.GetComponentDescriptorStart(
-				meshLoader.GetIndicesComponentIdentifier(), ViewType::SRV));
+	vsUpload.indicesIndex = indicesIndex;
+	vsUpload.shortIndices = shortIndices;
+	vsUpload.worldMatrix = worldMatrixIndex;
+	vsUpload.vpMatrix = vpMatrixIndex;
 
-		vsUpload.worldMatrix = static_cast<unsigned int>(worldMatrix +
-			resourceComponents.GetComponentDescriptorStart(
-				worldMatrixComponent, ViewType::SRV));
-		vsUpload.vpMatrix = static_cast<unsigned int>(frontCameraMatrix +
-			resourceComponents.GetComponentDescriptorStart(
-				cameraMatrixComponent, ViewType::SRV));
+	resourceComponents.GetDynamicBufferComponent(
+		vertexShaderPerObjectComponent).SetUpdateData(
+			vertexShaderBuffer, &vsUpload);
+}
 
-		resourceComponents.GetDynamicBufferComponent(
-			vertexShaderPerObjectComponent).SetUpdateData(
-				object.vertexShaderBuffer, &vsUpload);
+void ModelViewerScene::UpdatePerObjectBuffers()
+{
+	const Mesh& mesh = meshLoader.GetMeshInfo(0); // We only have one mesh
+	for (auto& object : objects)
+	{
+		const SubMesh& submesh = mesh.subMeshes[object.subMeshIndex];
+		UpdateVertexShaderIndices(submesh, object.vertexShaderBuffer);
 
 		PixelShaderPerObjectIndices psUpload;
 		if (submesh.diffuseMap != ResourceIndex(-1))
@@ -51,7 +112,10 @@ void ModelViewerScene::UpdatePerObjectBuffers()
 			psUpload.diffuseMapIndex = static_cast<unsigned int>(
 				submesh.diffuseMap +
 				resourceComponents.GetComponentDescriptorStart(
-					meshLoader.GetDiffuseMapComponentIdentifier(), ViewType::SRV));
+					meshLoader.GetDiffuseMapComponentIdentifier(submesh),
+					ViewType::SRV));
+			psUpload.diffuseMapIsLinear =
+				submesh.diffuseMapFormat != DXGI_FORMAT_R8G8B8A8_UNORM ? 1 : 0;
 		}
 
 		if (submesh.specularMap != ResourceIndex(-1))
@@ -59,7 +123,8 @@ void ModelViewerScene::UpdatePerObjectBuffers()
 			psUpload.specularMapIndex = static_cast<unsigned int>(
 				submesh.specularMap +
 				resourceComponents.GetComponentDescriptorStart(
-					meshLoader.GetSpecularMapComponentIdentifier(), ViewType::SRV));
+					meshLoader.GetSpecularMapComponentIdentifier(submesh),
+					ViewType::SRV));
 		}
 
 		if (submesh.normalMap != ResourceIndex(-1))
@@ -67,13 +132,10 @@ void ModelViewerScene::UpdatePerObjectBuffers()
 			psUpload.normalMapIndex = static_cast<unsigned int>(
 				submesh.normalMap +
 				resourceComponents.GetComponentDescriptorStart(
-					meshLoader.GetNormalMapComponentIdentifier(), ViewType::SRV));
+					meshLoader.GetNormalMapComponentIdentifier(submesh),
+					ViewType::SRV));
 		}
 
-		resourceComponents.GetDynamicBufferComponent(
-			vertexShaderPerObjectComponent).SetUpdateData(
-				object.vertexShaderBuffer, &vsUpload);
-
 		resourceComponents.GetDynamicBufferComponent(
 			pixelShaderPerObjectComponent).SetUpdateData(
 				object.pixelShaderBuffer, &psUpload);
@@ -119,6 +181,60 @@ void ModelViewerScene::UpdateAccelerationStructure(
 		list, toUpload);
 }
 
+// The structure of the active frame is rebuilt in its own list, the GPU is
+// done with the frame so nothing has to be flushed. Sub meshes uploaded after
+// the first build are drawn without casting shadows until the load is over.
+// The sub meshes in the mesh were uploaded by an earlier frame, so they are
+// on the GPU.
+void ModelViewerScene::UpdateRaytracingStructures(
+	ID3D12GraphicsCommandList* list)
+{
+	size_t nrOfSubMeshes = meshLoader.GetMeshInfo(
+		loadedMeshIndex).subMeshes.size();
+	if (subMeshesToRaytrace == 0 || meshLoader.GetAsyncLoadState(
+		loadedMeshIndex) != AsyncLoadState::LOADING)
+	{
+		subMeshesToRaytrace = nrOfSubMeshes;
+	}
+
+	AccelerationStructure& structure = meshAccelerationStructures.Active();
+	if (structure.nrOfSubMeshes == subMeshesToRaytrace)
+		return;
+
+	structure = CreateAccelerationStructure(device, list, loadedMeshIndex,
+		subMeshesToRaytrace, meshLoader,
+		resourceComponents.GetStaticBufferComponent(
+			meshLoader.GetPositionComponentIdentifier()),
+		resourceComponents.GetStaticBufferComponent(
+			meshLoader.GetIndicesComponentIdentifier()),
+		resourceComponents.GetStaticBufferComponent(
+			meshLoader.GetShortIndicesComponentIdentifier()));
+}
+
+void ModelViewerScene::UploadLoadedSubMeshes()
+{
+	meshLoader.UploadCompletedSubMeshes(resourceComponents,
+		SUB_MESHES_PER_FRAME);
+	CreatePerObjectBuffers(static_cast<unsigned int>(
+		meshLoader.GetMeshInfo(loadedMeshIndex).subMeshes.size()));
+}
+
+// The streamer works in the object space of the mesh, so the camera is moved
+// there instead of the sub meshes to world space
+void ModelViewerScene::UpdateTextureStreaming()
+{
+	XMMATRIX transformMatrix = XMMatrixRotationY(rotation);
+	transformMatrix *= XMMatrixScaling(scaling, scaling, scaling);
+	XMMATRIX inverseMatrix = XMMatrixInverse(nullptr, transformMatrix);
+
+	StreamingView view;
+	XMStoreFloat3(&view.cameraPosition, XMVector3TransformCoord(
+		XMLoadFloat3(&CAMERA_POSITION), inverseMatrix));
+	view.verticalFieldOfView = CAMERA_FIELD_OF_VIEW;
+	view.screenHeight = screenHeight;
+	meshLoader.UpdateTextureStreaming(view, resourceComponents);
+}
+
 void ModelViewerScene::CreateBufferComponents()
 {
 	worldMatrixComponent =
@@ -183,19 +299,20 @@ void ModelViewerScene::CreateCameras()
 	if (frontCameraInfo == ResourceIndex(-1))
 		throw std::runtime_error("Could not create camera info component");
 
-	float position[3] = { 0.0f, 10.0f, -10.0f };
-	XMVECTOR mainPos = { position[0], position[1], position[2]};
+	XMFLOAT3 position = CAMERA_POSITION;
+	XMVECTOR mainPos = XMLoadFloat3(&position);
 	XMVECTOR lookAt = mainPos + XMVECTOR({ 0.0f, -1.0f, 1.0f });
 	XMMATRIX matrix = XMMatrixLookAtLH(mainPos, lookAt, { 0.0f, 1.0f, 0.0f });
 	float aspectRatio = static_cast<float>(screenWidth) / screenHeight;
-	matrix *= XMMatrixPerspectiveFovLH(XM_PIDIV2, aspectRatio, 0.1f, 50.0f);
+	matrix *= XMMatrixPerspectiveFovLH(CAMERA_FIELD_OF_VIEW, aspectRatio, 0.1f,
+		50.0f);
 
 	XMFLOAT4X4 matrixToUpload;
 	XMStoreFloat4x4(&matrixToUpload, XMMatrixTranspose(matrix));
 	resourceComponents.GetDynamicBufferComponent(
 		cameraMatrixComponent).SetUpdateData(frontCameraMatrix, &matrixToUpload);
 
-	CameraInfo infoToUpload = { {position[0], position[1], position[2]} };
+	CameraInfo infoToUpload = { {position.x, position.y, position.z} };
 	resourceComponents.GetDynamicBufferComponent(
 		cameraInfoComponent).SetUpdateData(frontCameraInfo, &infoToUpload);
 }
@@ -213,9 +330,10 @@ void ModelViewerScene::CreatePointlights()
 		pointlightComponent).SetUpdateData(light, &toUpload);
 }
 
+// Only creates the buffers of sub meshes that do not have any yet
 void ModelViewerScene::CreatePerObjectBuffers(unsigned int nrOfSubmeshes)
 {
-	for (unsigned int i = 0; i < nrOfSubmeshes; ++i)
+	for (size_t i = objects.size(); i < nrOfSubmeshes; ++i)
 	{
 		DrawableObject toStore;
 
@@ -255,29 +373,6 @@ void ModelViewerScene::CreateDepthBuffer()
 		throw std::runtime_error("Could not create depth map");
 }
 
-void ModelViewerScene::CreateRaytracingStructures()
-{
-	directAllocators.Active().Reset();
-	auto directList = directAllocators.Active().ActiveList();
-
-	auto lambda = [&](AccelerationStructure& structure)
-	{
-		structure = std::move(CreateAccelerationStructure(device, directList,
-			loadedMeshIndex, meshLoader,
-			resourceComponents.GetStaticBufferComponent(
-				meshLoader.GetPositionComponentIdentifier()),
-			resourceComponents.GetStaticBufferComponent(
-				meshLoader.GetIndicesComponentIdentifier())));
-	};
-
-	meshAccelerationStructures.Initialize(lambda);
-
-	directAllocators.Active().FinishActiveList();
-	directAllocators.Active().ExecuteCommands(directQueue);
-	endOfFrameFences.Active().Signal(directQueue);
-	endOfFrameFences.Active().WaitGPU(directQueue);
-}
-
 D3D12_STATIC_SAMPLER_DESC ModelViewerScene::CreateStaticSampler()
 {
 	D3D12_STATIC_SAMPLER_DESC toReturn;
@@ -331,6 +426,12 @@ void ModelViewerScene::DrawImgui(ID3D12GraphicsCommandList* list)
 	ImGui::SliderFloat("Rotation", &rotation, -XM_PI, XM_PI);
 	ImGui::InputFloat("Scaling", &scaling, 0.001f);
 	ImGui::InputInt("Sub mesh to render (-1 == all)", &subMeshToRender);
+	ImGui::InputInt("Level of detail to render", &levelOfDetailToRender);
+	if (meshLoader.GetAsyncLoadState(loadedMeshIndex) ==
+		AsyncLoadState::FAILED)
+	{
+		ImGui::Text("Could not load the rest of the mesh");
+	}
 	ImGui::End();
 
 	ImGui::Render();
@@ -376,12 +477,40 @@ void ModelViewerScene::Initialize(HWND windowHandle, bool fullscreen,
 	neededMemory.diffuseMapsTotalBytes = 1000000000;
 	neededMemory.specularMapsTotalBytes = 1000000000;
 	neededMemory.normalMapsTotalBytes = 1000000000;
+	neededMemory.greyscaleSpecularMapsTotalBytes = 250000000;
+	neededMemory.twoChannelNormalMapsTotalBytes = 500000000;
+	neededMemory.hdrDiffuseMapsTotalBytes = 250000000;
+	neededMemory.packedHdrDiffuseMapsTotalBytes = 250000000;
+
+	// Streamed material map components only have to hold what the budget
+	// keeps resident, plus the textures replaced by the frames in flight
+	TextureStreamingSettings streamingSettings;
+	streamingSettings.enabled = STREAM_TEXTURES;
+	streamingSettings.budgetBytes = TEXTURE_STREAMING_BUDGET;
+	if (streamingSettings.enabled)
+	{
+		unsigned int streamedMapBytes = static_cast<unsigned int>(
+			TEXTURE_STREAMING_BUDGET +
+			FRAMES * streamingSettings.maxUploadBytesPerUpdate);
+		neededMemory.diffuseMapsTotalBytes = streamedMapBytes;
+		neededMemory.specularMapsTotalBytes = streamedMapBytes;
+		neededMemory.normalMapsTotalBytes = streamedMapBytes;
+		neededMemory.greyscaleSpecularMapsTotalBytes = streamedMapBytes;
+		neededMemory.twoChannelNormalMapsTotalBytes = streamedMapBytes;
+		neededMemory.hdrDiffuseMapsTotalBytes = streamedMapBytes;
+		neededMemory.packedHdrDiffuseMapsTotalBytes = streamedMapBytes;
+	}
+
 	meshLoader.Initialize(directoryInformation, resourceComponents,
-		neededMemory);
+		neededMemory, VERTEX_LAYOUT);
+	meshLoader.SetLevelsOfDetail(NR_OF_LEVELS_OF_DETAIL);
+	meshLoader.SetTextureStreaming(streamingSettings);
 
 	GraphicsPipelineData pipelineData;
-	pipelineData.shaderPaths[0] = "../x64/Debug/ModelVS.cso";
-	pipelineData.shaderPaths[4] = "../x64/Debug/ModelPS.cso";
+	std::string shaderDirectory = GetShaderDirectory();
+	pipelineData.shaderPaths[0] = shaderDirectory +
+		GetVertexShaderName(VERTEX_LAYOUT);
+	pipelineData.shaderPaths[4] = shaderDirectory + "ModelPS.cso";
 	pipelineData.rendertargetWidth = backbufferWidth;
 	pipelineData.rendertargetHeight = backbufferHeight;
 	pipelineData.rootBufferBindings.push_back(
@@ -395,9 +524,8 @@ void ModelViewerScene::Initialize(HWND windowHandle, bool fullscreen,
 	pipelineData.staticSamplers.push_back(CreateStaticSampler());
 	pipelineState.Initialize(device, pipelineData);
 
-	loadedMeshIndex = meshLoader.LoadMesh("Sponza.gltf", resourceComponents);
-	if (loadedMeshIndex == MeshIndex(-1))
-		throw std::runtime_error("Could not load mesh");
+	// The sub meshes are added by Render as they finish loading
+	loadedMeshIndex = meshLoader.LoadMeshAsync("Sponza.gltf");
 
 	copyAllocators.Initialize(&ManagedCommandAllocator::Initialize,
 		device.Get(), D3D12_COMMAND_LIST_TYPE_COPY);
@@ -410,8 +538,6 @@ void ModelViewerScene::Initialize(HWND windowHandle, bool fullscreen,
 	CreateWorldMatrix();
 	CreateCameras();
 	CreatePointlights();
-	auto& mesh = meshLoader.GetMeshInfo(loadedMeshIndex);
-	CreatePerObjectBuffers(static_cast<unsigned int>(mesh.subMeshes.size()));
 	CreatePerFrameBuffers();
 	CreateDepthBuffer();
 	resourceComponents.FinalizeComponents();
@@ -422,7 +548,6 @@ void ModelViewerScene::Initialize(HWND windowHandle, bool fullscreen,
 	copyAllocators.Active().ExecuteCommands(copyQueue);
 	updateCopyFence.Active().Signal(copyQueue);
 	updateCopyFence.Active().WaitCPU();
-	CreateRaytracingStructures();
 
 	SetupImgui(windowHandle);
 }
@@ -453,9 +578,13 @@ void ModelViewerScene::Render()
 	directAllocators.Active().Reset();
 	auto directList = directAllocators.Active().ActiveList();
 	resourceComponents.BindComponents(directList);
+	UpdateRaytracingStructures(directList);
+	UploadLoadedSubMeshes();
+	UpdateTextureStreaming();
 	UpdatePerObjectBuffers();
 	UpdatePerFrameBuffers();
-	UpdateAccelerationStructure(directList);
+	if (meshAccelerationStructures.Active().nrOfSubMeshes > 0)
+		UpdateAccelerationStructure(directList);
 
 	copyAllocators.Active().Reset();
 	resourceComponents.UpdateComponents(copyAllocators.Active().ActiveList());
@@ -488,8 +617,13 @@ void ModelViewerScene::Render()
 		resourceComponents.GetDynamicBufferComponent(
 			pixelShaderPerFrameComponent).GetVirtualAdress(
 				pixelShaderPerFrame));
+
+	// Before the first build a null structure is bound, shadow rays traced
+	// against it miss so the sub meshes are drawn without shadows
+	ID3D12Resource* topLevel =
+		meshAccelerationStructures.Active().topLevel.resultBuffer;
 	directList->SetGraphicsRootShaderResourceView(3,
-		meshAccelerationStructures.Active().topLevel.resultBuffer->GetGPUVirtualAddress());
+		topLevel != nullptr ? topLevel->GetGPUVirtualAddress() : 0);
 
 	const Mesh& mesh = meshLoader.GetMeshInfo(0); // We only have one mesh
 	for (auto& object : objects)
@@ -506,8 +640,14 @@ void ModelViewerScene::Render()
 				pixelShaderPerObjectComponent).GetVirtualAdress(
 					object.pixelShaderBuffer));
 		
-		directList->DrawInstanced(mesh.subMeshes[object.subMeshIndex].indexCount,
-			1, 0, 0);
+		// Sub meshes without enough levels are drawn at their coarsest one,
+		// the vertex ID starts at the first index of the level
+		const std::vector<LevelOfDetail>& levels =
+			mesh.subMeshes[object.subMeshIndex].levelsOfDetail;
+		size_t level = std::min(static_cast<size_t>(
+			std::max(levelOfDetailToRender, 0)), levels.size() - 1);
+		directList->DrawInstanced(levels[level].indexCount, 1,
+			levels[level].firstIndex, 0);
 	}
 
 	DrawImgui(directAllocators.Active().ActiveList());
@@ -9,6 +9,15 @@
 #include "RaytracingHelper.h"
 
 static const short FRAMES = 2;
+static const VertexLayout VERTEX_LAYOUT = VertexLayout::SEPARATE;
+static const unsigned int NR_OF_LEVELS_OF_DETAIL = 4;
+static const size_t SUB_MESHES_PER_FRAME = 8; // Uploaded while loading
+// Experimental, every streamed change recreates its whole texture and that
+// has not been measured on the target scenes yet
+static const bool STREAM_TEXTURES = false;
+static const size_t TEXTURE_STREAMING_BUDGET = 384 * 1024 * 1024;
+static const DirectX::XMFLOAT3 CAMERA_POSITION = { 0.0f, 10.0f, -10.0f };
+static const float CAMERA_FIELD_OF_VIEW = DirectX::XM_PIDIV2;
 
 class ModelViewerScene : public BaseScene<FRAMES>
 {
@@ -23,11 +32,27 @@ private:
 		unsigned int bitangentIndex = static_cast<unsigned int>(-1);
 
 		unsigned int indicesIndex = static_cast<unsigned int>(-1);
+		unsigned int shortIndices = 0; // Two 16 bit indices per element if set
 
 		unsigned int worldMatrix = static_cast<unsigned int>(-1);
 		unsigned int vpMatrix = static_cast<unsigned int>(-1);
 
-		char padding[256 - 32];
+		char padding[256 - 36];
+	};
+
+	// Used instead of VertexShaderPerObjectIndices with the packed and the
+	// quantized layout
+	struct PackedVertexShaderPerObjectIndices
+	{
+		unsigned int positionIndex = static_cast<unsigned int>(-1);
+		unsigned int attributeIndex = static_cast<unsigned int>(-1);
+		unsigned int indicesIndex = static_cast<unsigned int>(-1);
+		unsigned int shortIndices = 0;
+
+		unsigned int worldMatrix = static_cast<unsigned int>(-1);
+		unsigned int vpMatrix = static_cast<unsigned int>(-1);
+
+		char padding[256 - 24];
 	};
 
 	struct PixelShaderPerObjectIndices
@@ -35,8 +60,9 @@ private:
 		unsigned int diffuseMapIndex = static_cast<unsigned int>(-1);
 		unsigned int specularMapIndex = static_cast<unsigned int>(-1);
 		unsigned int normalMapIndex = static_cast<unsigned int>(-1);
+		unsigned int diffuseMapIsLinear = 0; // HDR diffuse maps
 
-		char padding[256 - 12];
+		char padding[256 - 16];
 	};
 
 	struct PixelShaderPerFrameIndices
@@ -97,16 +123,23 @@ private:
 	MeshResourceLoader meshLoader;
 	MeshIndex loadedMeshIndex = MeshIndex(-1);
 	FrameObject<AccelerationStructure, FRAMES> meshAccelerationStructures;
+	size_t subMeshesToRaytrace = 0; // Every frame builds its own structure
 
 	D3DPtr<ID3D12DescriptorHeap> imguiHeap;
 	float rotation = 0.0f;
 	float scaling = 1.01f;
 	int subMeshToRender = -1;
+	int levelOfDetailToRender = 0;
 
+	void UpdateVertexShaderIndices(const SubMesh& submesh,
+		ResourceIndex vertexShaderBuffer);
 	void UpdatePerObjectBuffers();
 	void UpdatePerFrameBuffers();
 	void UpdateWorldMatrix();
 	void UpdateAccelerationStructure(ID3D12GraphicsCommandList* list);
+	void UpdateRaytracingStructures(ID3D12GraphicsCommandList* list);
+	void UploadLoadedSubMeshes();
+	void UpdateTextureStreaming();
 
 	void CreateBufferComponents();
 	void CreateTexture2DComponents();
@@ -116,7 +149,6 @@ private:
 	void CreatePerObjectBuffers(unsigned int nrOfSubmeshes);
 	void CreatePerFrameBuffers();
 	void CreateDepthBuffer();
-	void CreateRaytracingStructures();
 
 	D3D12_STATIC_SAMPLER_DESC CreateStaticSampler();
 
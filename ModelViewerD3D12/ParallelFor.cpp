@@ -0,0 +1,68 @@
+#include "ParallelFor.h"
+
+void ParallelForJob::Process()
+{
+	for (size_t index = nextIndex++; index < count; index = nextIndex++)
+		invoke(function, index);
+}
+
+ParallelForPool::~ParallelForPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	jobAdded.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+ParallelForPool& ParallelForPool::Get()
+{
+	static ParallelForPool pool;
+	return pool;
+}
+
+void ParallelForPool::Work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		jobAdded.wait(lock, [this]() { return stopping || !jobs.empty(); });
+		if (stopping)
+			return;
+
+		ParallelForJob& job = *jobs.front();
+		++job.activeHelpers;
+		if (--job.helpersWanted == 0)
+			jobs.pop_front();
+
+		lock.unlock();
+		job.Process();
+		lock.lock();
+
+		if (--job.activeHelpers == 0)
+			helperFinished.notify_all();
+	}
+}
+
+void ParallelForPool::Run(ParallelForJob& job, unsigned int nrOfHelpers)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (threads.size() < nrOfHelpers)
+			threads.emplace_back(&ParallelForPool::Work, this);
+
+		job.helpersWanted = nrOfHelpers;
+		jobs.push_back(&job);
+	}
+
+	jobAdded.notify_all();
+	job.Process();
+
+	// Helpers that have not joined yet would find every index taken
+	std::unique_lock<std::mutex> lock(mutex);
+	jobs.erase(std::remove(jobs.begin(), jobs.end(), &job), jobs.end());
+	helperFinished.wait(lock, [&job]() { return job.activeHelpers == 0; });
+}
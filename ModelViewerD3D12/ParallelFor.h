@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+// Indices of one ParallelFor call, it lives on the stack of the caller. The
+// helper counts are guarded by the mutex of the pool.
+struct ParallelForJob
+{
+	void (*invoke)(const void* function, size_t index) = nullptr;
+	const void* function = nullptr;
+	size_t count = 0;
+	std::atomic<size_t> nextIndex{ 0 };
+	unsigned int helpersWanted = 0;
+	unsigned int activeHelpers = 0;
+
+	void Process();
+};
+
+// Worker threads shared by every ParallelFor call, so a call does not start
+// threads of its own. Threads are started the first time a call asks for more
+// helpers than there are and live until the process ends. A caller only
+// waits for the helpers already working on its indices, so calls nested in
+// the function of another call do not deadlock.
+class ParallelForPool
+{
+private:
+	std::mutex mutex;
+	std::condition_variable jobAdded;
+	std::condition_variable helperFinished;
+	std::deque<ParallelForJob*> jobs; // Jobs that still take helpers
+	std::vector<std::thread> threads;
+	bool stopping = false;
+
+	ParallelForPool() = default;
+	void Work();
+
+public:
+	~ParallelForPool();
+	ParallelForPool(const ParallelForPool& other) = delete;
+	ParallelForPool& operator=(const ParallelForPool& other) = delete;
+	ParallelForPool(ParallelForPool&& other) = delete;
+	ParallelForPool& operator=(ParallelForPool&& other) = delete;
+
+	static ParallelForPool& Get();
+
+	// Processes the job with the calling thread and up to nrOfHelpers pool
+	// threads, returns once every index has been processed
+	void Run(ParallelForJob& job, unsigned int nrOfHelpers);
+};
+
+// Calls function(index) for every index in [0, count) using up to nrOfThreads
+// threads. The calling thread takes part in the work and the call returns
+// when every index has been processed. Indices are handed out one at a time
+// so uneven work per index is balanced between the threads.
+template<typename Function>
+void ParallelFor(size_t count, unsigned int nrOfThreads, const Function& function)
+{
+	ParallelForJob job;
+	job.invoke = [](const void* toCall, size_t index)
+	{
+		(*static_cast<const Function*>(toCall))(index);
+	};
+	job.function = &function;
+	job.count = count;
+
+	size_t threadsToUse = std::min<size_t>(std::max(nrOfThreads, 1u), count);
+	if (threadsToUse <= 1)
+	{
+		job.Process();
+		return;
+	}
+
+	ParallelForPool::Get().Run(job, static_cast<unsigned int>(threadsToUse - 1));
+}
@@ -84,6 +84,7 @@ bool BuildBottomLevelAccelerationStructure(ID3D12Device5* device,
 	ID3D12GraphicsCommandList4* list,
 	std::vector<std::pair<D3D12_GPU_VIRTUAL_ADDRESS, UINT>> positions,
 	std::vector<std::pair<D3D12_GPU_VIRTUAL_ADDRESS, UINT>> indices,
+	std::vector<DXGI_FORMAT> indexFormats,
 	ID3D12Resource*& resultAccelerationStructureBuffer,
 	ID3D12Resource*& scratchAccelerationStructureBuffer)
 {
@@ -101,7 +102,7 @@ bool BuildBottomLevelAccelerationStructure(ID3D12Device5* device,
 		geometryDescs[i].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
 		geometryDescs[i].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
 		geometryDescs[i].Triangles.Transform3x4 = NULL;
-		geometryDescs[i].Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+		geometryDescs[i].Triangles.IndexFormat = indexFormats[i];
 		geometryDescs[i].Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
 		geometryDescs[i].Triangles.IndexCount = indices[i].second;
 		geometryDescs[i].Triangles.VertexCount = positions[i].second;
@@ -172,9 +173,11 @@ bool BuildTopLevelAccelerationStructure(ID3D12Device5* device,
 
 
 AccelerationStructure CreateAccelerationStructure(ID3D12Device* device,
-	ID3D12GraphicsCommandList* list, MeshIndex meshIndex, 
-	MeshResourceLoader& resourceLoader, FrameBufferComponent<1>& positionComponents,
-	FrameBufferComponent<1>& indexComponents)
+	ID3D12GraphicsCommandList* list, MeshIndex meshIndex,
+	size_t nrOfSubMeshes, MeshResourceLoader& resourceLoader,
+	FrameBufferComponent<1>& positionComponents,
+	FrameBufferComponent<1>& indexComponents,
+	FrameBufferComponent<1>& shortIndexComponents)
 {
     ID3D12Device5* device5;
     ID3D12GraphicsCommandList4* list4;
@@ -182,26 +185,33 @@ AccelerationStructure CreateAccelerationStructure(ID3D12Device* device,
 
 	std::vector<std::pair<D3D12_GPU_VIRTUAL_ADDRESS, UINT>> positions;
 	std::vector<std::pair<D3D12_GPU_VIRTUAL_ADDRESS, UINT>> indices;
+	std::vector<DXGI_FORMAT> indexFormats;
 
 	auto& mesh = resourceLoader.GetMeshInfo(meshIndex);
 	
-	for (auto& submesh : mesh.subMeshes)
+	for (size_t i = 0; i < nrOfSubMeshes; ++i)
 	{
+		auto& submesh = mesh.subMeshes[i];
 		auto positionHandle = positionComponents.GetBufferHandle(submesh.position);
-		auto indexHandle = indexComponents.GetBufferHandle(submesh.indices);
+		bool shortIndices = submesh.indexFormat == DXGI_FORMAT_R16_UINT;
+		auto indexHandle = (shortIndices ? shortIndexComponents :
+			indexComponents).GetBufferHandle(submesh.indices);
 
 		positions.push_back(std::make_pair(
 			positionHandle.resource->GetGPUVirtualAddress() + positionHandle.startOffset,
 			static_cast<UINT>(positionHandle.nrOfElements)));
+		// Short index elements hold two indices, so use the sub mesh count
 		indices.push_back(std::make_pair(
 			indexHandle.resource->GetGPUVirtualAddress() + indexHandle.startOffset,
-			static_cast<UINT>(indexHandle.nrOfElements)));
+			static_cast<UINT>(submesh.indexCount)));
+		indexFormats.push_back(submesh.indexFormat);
 	}
 
 	AccelerationStructure toReturn;
+	toReturn.nrOfSubMeshes = nrOfSubMeshes;
 
 	if (!BuildBottomLevelAccelerationStructure(device5, list4,
-		positions, indices, toReturn.bottomLevel.resultBuffer,
+		positions, indices, indexFormats, toReturn.bottomLevel.resultBuffer,
 		toReturn.bottomLevel.scratchBuffer))
 	{
 		throw std::runtime_error("Could not create bottom level acceleration structure");
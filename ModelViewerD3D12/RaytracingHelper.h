@@ -27,6 +27,13 @@ struct AccelerationStructureBuffers
 	{
 		if (this != &other)
 		{
+			// Rebuilt structures replace ones that are still held
+			if (resultBuffer != nullptr)
+				resultBuffer->Release();
+
+			if (scratchBuffer != nullptr)
+				scratchBuffer->Release();
+
 			this->resultBuffer = other.resultBuffer;
 			this->scratchBuffer = other.scratchBuffer;
 			other.resultBuffer = nullptr;
@@ -51,15 +58,17 @@ struct AccelerationStructure
 	ID3D12Resource* instanceBuffer = nullptr;
 	AccelerationStructureBuffers topLevel;
 	AccelerationStructureBuffers bottomLevel;
+	size_t nrOfSubMeshes = 0; // The first sub meshes of the mesh that are built
 
 	AccelerationStructure() = default;
 	AccelerationStructure(const AccelerationStructure&) = delete;
 	AccelerationStructure& operator=(const AccelerationStructure&) = delete;
 
 	AccelerationStructure(AccelerationStructure&& other) :
-		instanceBuffer(other.instanceBuffer)
+		instanceBuffer(other.instanceBuffer), nrOfSubMeshes(other.nrOfSubMeshes)
 	{
 		other.instanceBuffer = nullptr;
+		other.nrOfSubMeshes = 0;
 		this->topLevel = std::move(other.topLevel);
 		this->bottomLevel = std::move(other.bottomLevel);
 	}
@@ -68,8 +77,13 @@ struct AccelerationStructure
 	{
 		if (this != &other)
 		{
+			if (instanceBuffer != nullptr)
+				instanceBuffer->Release();
+
 			this->instanceBuffer = other.instanceBuffer;
 			other.instanceBuffer = nullptr;
+			this->nrOfSubMeshes = other.nrOfSubMeshes;
+			other.nrOfSubMeshes = 0;
 			this->topLevel = std::move(other.topLevel);
 			this->bottomLevel = std::move(other.bottomLevel);
 		}
@@ -86,8 +100,10 @@ struct AccelerationStructure
 
 AccelerationStructure CreateAccelerationStructure(ID3D12Device* device,
 	ID3D12GraphicsCommandList* list, MeshIndex meshIndex,
-	MeshResourceLoader& resourceLoader, FrameBufferComponent<1>& positionComponents,
-	FrameBufferComponent<1>& indexComponents);
+	size_t nrOfSubMeshes, MeshResourceLoader& resourceLoader,
+	FrameBufferComponent<1>& positionComponents,
+	FrameBufferComponent<1>& indexComponents,
+	FrameBufferComponent<1>& shortIndexComponents);
 
 bool SetTopLevelTransform(AccelerationStructure& structure, 
 	ID3D12GraphicsCommandList* list, DirectX::XMFLOAT3X4& transform);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+// A range of the index stream of a sub mesh that draws it at reduced detail.
+// The error is the largest object space distance the surface moved when the
+// range was simplified, 0 for the full detail range.
+struct LevelOfDetail
+{
+	std::uint32_t firstIndex = 0;
+	std::uint32_t indexCount = 0;
+	float error = 0.0f;
+};
+
+// Non owning view of the CPU side data of a sub mesh, pointing either into a
+// mapped mesh cache or into a SubMeshData. Absent streams are nullptr. The
+// tangent w holds the handedness, the bitangent is cross(normal, tangent) * w.
+// The imported bitangents are only kept if the conversion asked for them.
+// If levels of detail were generated, the first one is the nrOfIndices indices
+// of the full detail mesh and the coarser ones follow it in the index stream.
+struct SubMeshStreams
+{
+	unsigned int nrOfVertices = 0;
+	unsigned int nrOfIndices = 0;
+	unsigned int nrOfLevelsOfDetail = 0;
+
+	const DirectX::XMFLOAT3* positions = nullptr;
+	const DirectX::XMFLOAT2* uvs = nullptr;
+	const DirectX::XMFLOAT3* normals = nullptr;
+	const DirectX::XMFLOAT4* tangents = nullptr;
+	const DirectX::XMFLOAT3* bitangents = nullptr;
+	const unsigned int* indices = nullptr;
+	const LevelOfDetail* levelsOfDetail = nullptr;
+
+	const char* diffuseMap = nullptr;
+	const char* specularMap = nullptr;
+	const char* normalMap = nullptr;
+
+	// Indices of every level of detail
+	unsigned int GetTotalNrOfIndices() const
+	{
+		if (nrOfLevelsOfDetail == 0)
+			return nrOfIndices;
+
+		const LevelOfDetail& last = levelsOfDetail[nrOfLevelsOfDetail - 1];
+		return last.firstIndex + last.indexCount;
+	}
+};
+
+// Owning storage for a sub mesh converted from an imported scene
+struct SubMeshData
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT4> tangents;
+	std::vector<DirectX::XMFLOAT3> bitangents;
+	std::vector<unsigned int> indices;
+	std::vector<LevelOfDetail> levelsOfDetail;
+
+	std::string diffuseMap;
+	std::string specularMap;
+	std::string normalMap;
+
+	SubMeshStreams GetStreams() const
+	{
+		SubMeshStreams toReturn;
+		toReturn.nrOfVertices = static_cast<unsigned int>(positions.size());
+		toReturn.nrOfIndices = static_cast<unsigned int>(levelsOfDetail.empty() ?
+			indices.size() : levelsOfDetail.front().indexCount);
+		toReturn.nrOfLevelsOfDetail =
+			static_cast<unsigned int>(levelsOfDetail.size());
+
+		toReturn.positions = positions.empty() ? nullptr : positions.data();
+		toReturn.uvs = uvs.empty() ? nullptr : uvs.data();
+		toReturn.normals = normals.empty() ? nullptr : normals.data();
+		toReturn.tangents = tangents.empty() ? nullptr : tangents.data();
+		toReturn.bitangents = bitangents.empty() ? nullptr : bitangents.data();
+		toReturn.indices = indices.data();
+		toReturn.levelsOfDetail =
+			levelsOfDetail.empty() ? nullptr : levelsOfDetail.data();
+
+		toReturn.diffuseMap = diffuseMap.empty() ? nullptr : diffuseMap.c_str();
+		toReturn.specularMap = specularMap.empty() ? nullptr : specularMap.c_str();
+		toReturn.normalMap = normalMap.empty() ? nullptr : normalMap.c_str();
+
+		return toReturn;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "TextureDecodePool.h"
+
+#include <algorithm>
+
+#include "MeshCache.h"
+
+#pragma warning(disable:4996)
+#include "stb_image.h"
+
+TextureDecodePool::TextureDecodePool(unsigned int nrOfThreads)
+{
+	if (nrOfThreads == 0)
+		nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	statistics.nrOfThreads = nrOfThreads;
+	for (unsigned int i = 0; i < nrOfThreads; ++i)
+		threads.emplace_back(&TextureDecodePool::Work, this);
+}
+
+TextureDecodePool::~TextureDecodePool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	requestAdded.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// Baked textures are only used if they are RGBA like the decoded ones
+bool TextureDecodePool::OpenBakedTexture(const std::string& filepath,
+	DecodedTexture& toFill)
+{
+	std::uint64_t sourceHash = 0;
+	auto baked = std::make_shared<BakedTexture>();
+	if (!MeshCache::HashFile(filepath, sourceHash) ||
+		!baked->Open(BakedTexture::GetBakedPath(filepath), sourceHash) ||
+		baked->GetFormat() != DXGI_FORMAT_R8G8B8A8_UNORM)
+	{
+		return false;
+	}
+
+	toFill.width = static_cast<int>(baked->GetWidth());
+	toFill.height = static_cast<int>(baked->GetHeight());
+	toFill.baked = std::move(baked);
+
+	return true;
+}
+
+bool TextureDecodePool::HasLowerPriority(const DecodeRequest& first,
+	const DecodeRequest& second)
+{
+	if (first.priority != second.priority)
+		return first.priority < second.priority;
+
+	return first.order > second.order;
+}
+
+void TextureDecodePool::Work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		requestAdded.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if (stopping)
+			return;
+
+		std::pop_heap(queue.begin(), queue.end(), HasLowerPriority);
+		DecodeRequest request = std::move(queue.back());
+		queue.pop_back();
+		lock.unlock();
+
+		auto decodeStart = std::chrono::steady_clock::now();
+		DecodedTexture& decoded = *request.toFill;
+		decoded.hdr = request.keepHdr && stbi_is_hdr(request.filepath.c_str());
+		bool baked = request.useBakedTexture && !decoded.hdr &&
+			OpenBakedTexture(request.filepath, decoded);
+		if (decoded.hdr)
+		{
+			decoded.data = stbi_loadf(request.filepath.c_str(), &decoded.width,
+				&decoded.height, nullptr, 4);
+		}
+		else if (!baked)
+		{
+			decoded.data = stbi_load(request.filepath.c_str(), &decoded.width,
+				&decoded.height, nullptr, 4); // All other maps are BYTE RGBA
+		}
+		auto decodeEnd = std::chrono::steady_clock::now();
+		bool succeeded = baked || decoded.data != nullptr;
+
+		TextureDecodeTiming timing;
+		timing.filepath = std::move(request.filepath);
+		timing.priority = request.priority;
+		timing.waitMilliseconds = std::chrono::duration<double, std::milli>(
+			decodeStart - request.submitted).count();
+		timing.decodeMilliseconds = std::chrono::duration<double, std::milli>(
+			decodeEnd - decodeStart).count();
+		timing.succeeded = succeeded;
+		timing.baked = baked;
+
+		lock.lock();
+		++statistics.nrOfDecodes;
+		statistics.nrOfFailures += timing.succeeded ? 0 : 1;
+		statistics.totalDecodeMilliseconds += timing.decodeMilliseconds;
+		statistics.longestDecodeMilliseconds = std::max(
+			statistics.longestDecodeMilliseconds, timing.decodeMilliseconds);
+		statistics.timings.push_back(std::move(timing));
+
+		GroupState& group = groups[request.group];
+		group.failed |= !succeeded;
+		if (--group.pending == 0)
+			requestFinished.notify_all();
+	}
+}
+
+DecodeGroup TextureDecodePool::CreateGroup()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	DecodeGroup toReturn = nextGroup++;
+	groups[toReturn] = GroupState();
+
+	return toReturn;
+}
+
+void TextureDecodePool::Submit(DecodeGroup group, const std::string& filepath,
+	float priority, DecodedTexture* toFill, bool useBakedTexture, bool keepHdr)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto state = groups.find(group);
+		if (state == groups.end() || state->second.cancelled)
+		{
+			++statistics.nrOfCancellations;
+			return;
+		}
+
+		DecodeRequest request;
+		request.filepath = filepath;
+		request.priority = priority;
+		request.order = nextOrder++;
+		request.group = group;
+		request.toFill = toFill;
+		request.useBakedTexture = useBakedTexture;
+		request.keepHdr = keepHdr;
+		request.submitted = std::chrono::steady_clock::now();
+		queue.push_back(std::move(request));
+		std::push_heap(queue.begin(), queue.end(), HasLowerPriority);
+
+		++state->second.pending;
+		statistics.peakQueueDepth = std::max(statistics.peakQueueDepth,
+			queue.size());
+	}
+
+	requestAdded.notify_one();
+}
+
+bool TextureDecodePool::Wait(DecodeGroup group)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto state = groups.find(group);
+	if (state == groups.end())
+		return false;
+
+	requestFinished.wait(lock, [state]() { return state->second.pending == 0; });
+	bool toReturn = !state->second.failed && !state->second.cancelled;
+	groups.erase(state);
+
+	return toReturn;
+}
+
+void TextureDecodePool::Cancel(DecodeGroup group)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto state = groups.find(group);
+		if (state == groups.end())
+			return;
+
+		state->second.cancelled = true;
+		auto cancelled = std::remove_if(queue.begin(), queue.end(),
+			[group](const DecodeRequest& request) { return request.group == group; });
+		size_t nrOfCancelled = queue.end() - cancelled;
+		queue.erase(cancelled, queue.end());
+		std::make_heap(queue.begin(), queue.end(), HasLowerPriority);
+
+		state->second.pending -= nrOfCancelled;
+		statistics.nrOfCancellations += nrOfCancelled;
+	}
+
+	requestFinished.notify_all();
+}
+
+unsigned int TextureDecodePool::GetNrOfThreads() const
+{
+	return statistics.nrOfThreads;
+}
+
+TextureDecodeStatistics TextureDecodePool::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	TextureDecodeStatistics toReturn = statistics;
+	toReturn.queueDepth = queue.size();
+
+	return toReturn;
+}
+
+void TextureDecodePool::ResetStatistics()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int nrOfThreads = statistics.nrOfThreads;
+	statistics = TextureDecodeStatistics();
+	statistics.nrOfThreads = nrOfThreads;
+}
\ No newline at end of file
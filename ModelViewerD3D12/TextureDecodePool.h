@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+
+#include "BakedTexture.h"
+
+// Texels are decoded as BYTE RGBA, or as float RGBA for HDR files decoded as
+// such, the data is allocated by stb_image and has to be freed with STBI_FREE
+// by the owner. The owner may narrow BYTE texels in place to fewer components.
+// A texture with an up to date baked file is not decoded, the baked texture
+// is set instead and holds every mip.
+struct DecodedTexture
+{
+	int width = 0;
+	int height = 0;
+	unsigned int componentsPerTexel = 4;
+	bool hdr = false;
+	void* data = nullptr;
+	std::shared_ptr<BakedTexture> baked;
+};
+
+typedef std::uint64_t DecodeGroup;
+
+// Wait is the time a decode spent queued, decode the time stbi_load or
+// opening the baked texture took
+struct TextureDecodeTiming
+{
+	std::string filepath;
+	float priority = 0.0f;
+	double waitMilliseconds = 0.0;
+	double decodeMilliseconds = 0.0;
+	bool succeeded = false;
+	bool baked = false;
+};
+
+// The queue depth is the number of decodes waiting for a thread when the
+// statistics were taken. The timings are those of every finished decode since
+// the statistics were last reset, in the order the decodes finished.
+struct TextureDecodeStatistics
+{
+	unsigned int nrOfThreads = 0;
+	size_t queueDepth = 0;
+	size_t peakQueueDepth = 0;
+	size_t nrOfDecodes = 0;
+	size_t nrOfFailures = 0;
+	size_t nrOfCancellations = 0;
+	double totalDecodeMilliseconds = 0.0;
+	double longestDecodeMilliseconds = 0.0;
+	std::vector<TextureDecodeTiming> timings;
+};
+
+// Worker threads that decode material textures, highest priority first.
+// Decodes are submitted in groups, typically one per prepared batch, so the
+// decodes of a mesh that is unloaded while loading can be cancelled together.
+// Every function may be called from any thread.
+class TextureDecodePool
+{
+private:
+	struct DecodeRequest
+	{
+		std::string filepath;
+		float priority = 0.0f;
+		std::uint64_t order = 0; // Equal priorities are decoded first come first
+		DecodeGroup group = 0;
+		DecodedTexture* toFill = nullptr;
+		bool useBakedTexture = false;
+		bool keepHdr = false;
+		std::chrono::steady_clock::time_point submitted;
+	};
+
+	// Pending counts both queued and running decodes of the group
+	struct GroupState
+	{
+		size_t pending = 0;
+		bool failed = false;
+		bool cancelled = false;
+	};
+
+	std::mutex mutex;
+	std::condition_variable requestAdded;
+	std::condition_variable requestFinished;
+	std::vector<DecodeRequest> queue; // A heap ordered by HasLowerPriority
+	std::unordered_map<DecodeGroup, GroupState> groups;
+	std::vector<std::thread> threads;
+	TextureDecodeStatistics statistics;
+	DecodeGroup nextGroup = 1;
+	std::uint64_t nextOrder = 0;
+	bool stopping = false;
+
+	static bool OpenBakedTexture(const std::string& filepath,
+		DecodedTexture& toFill);
+	static bool HasLowerPriority(const DecodeRequest& first,
+		const DecodeRequest& second);
+	void Work();
+
+public:
+	// 0 threads uses one per hardware thread
+	explicit TextureDecodePool(unsigned int nrOfThreads);
+	~TextureDecodePool(); // No group may still be waited for
+	TextureDecodePool(const TextureDecodePool& other) = delete;
+	TextureDecodePool& operator=(const TextureDecodePool& other) = delete;
+	TextureDecodePool(TextureDecodePool&& other) = delete;
+	TextureDecodePool& operator=(TextureDecodePool&& other) = delete;
+
+	DecodeGroup CreateGroup();
+
+	// Decodes the file into toFill, which has to stay valid until the group
+	// is waited for. Decodes submitted to a cancelled group are dropped. If
+	// baked textures are used, an up to date baked file is mapped instead.
+	// HDR files are decoded as float if keepHdr is set, their baked files,
+	// which are always BYTE, are not used then.
+	void Submit(DecodeGroup group, const std::string& filepath, float priority,
+		DecodedTexture* toFill, bool useBakedTexture = false,
+		bool keepHdr = false);
+
+	// Blocks until every decode submitted to the group has finished or was
+	// cancelled and releases the group. Returns false if any decode failed or
+	// the group was cancelled, textures that did decode are still filled in.
+	bool Wait(DecodeGroup group);
+
+	// Drops the queued decodes of the group, running ones finish as usual
+	void Cancel(DecodeGroup group);
+
+	unsigned int GetNrOfThreads() const;
+	TextureDecodeStatistics GetStatistics();
+	void ResetStatistics();
+};
@@ -0,0 +1,135 @@
+#include "TextureFootprint.h"
+
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <d3d12.h>
+
+namespace
+{
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool IsBlockCompressed(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_BC1_UNORM ||
+			format == DXGI_FORMAT_BC3_UNORM || format == DXGI_FORMAT_BC4_UNORM ||
+			format == DXGI_FORMAT_BC5_UNORM || format == DXGI_FORMAT_BC7_UNORM;
+	}
+
+	struct FootprintKey
+	{
+		UINT width;
+		UINT height;
+		DXGI_FORMAT format;
+		UINT16 nrOfMipLevels;
+
+		bool operator==(const FootprintKey& other) const
+		{
+			return width == other.width && height == other.height &&
+				format == other.format && nrOfMipLevels == other.nrOfMipLevels;
+		}
+	};
+
+	struct FootprintKeyHash
+	{
+		size_t operator()(const FootprintKey& key) const
+		{
+			std::uint64_t toReturn = key.width;
+			toReturn = toReturn * 0x9E3779B97F4A7C15ull + key.height;
+			toReturn = toReturn * 0x9E3779B97F4A7C15ull + key.format;
+			toReturn = toReturn * 0x9E3779B97F4A7C15ull + key.nrOfMipLevels;
+			return static_cast<size_t>(toReturn ^ (toReturn >> 32));
+		}
+	};
+
+	TextureFootprint CalculateTextureFootprint(UINT width, UINT height,
+		DXGI_FORMAT format, UINT16 nrOfMipLevels)
+	{
+		UINT elementSize = GetFootprintElementSize(format);
+		if (elementSize == 0 || width == 0 || height == 0)
+			throw std::runtime_error("Could not calculate texture footprint");
+
+		bool blockCompressed = IsBlockCompressed(format);
+		TextureFootprint toReturn;
+		UINT64 offset = 0;
+		while (true)
+		{
+			SubresourceFootprint footprint;
+			footprint.offset = AlignUp(offset,
+				D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			footprint.width = width;
+			footprint.height = height;
+			footprint.rows = blockCompressed ? (height + 3) / 4 : height;
+			footprint.rowSize = static_cast<UINT64>(
+				blockCompressed ? (width + 3) / 4 : width) * elementSize;
+			footprint.rowPitch = static_cast<UINT>(AlignUp(footprint.rowSize,
+				D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+			toReturn.subresources.push_back(footprint);
+
+			offset = footprint.offset +
+				static_cast<UINT64>(footprint.rowPitch) * (footprint.rows - 1) +
+				footprint.rowSize;
+
+			bool lastLevel = nrOfMipLevels == 0 ? width == 1 && height == 1 :
+				toReturn.subresources.size() == nrOfMipLevels;
+			if (lastLevel)
+				break;
+
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+
+		toReturn.totalBytes = offset;
+		return toReturn;
+	}
+}
+
+UINT GetFootprintElementSize(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8_UNORM:
+		return 1;
+	case DXGI_FORMAT_R8G8_UNORM:
+		return 2;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+		return 4;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 16;
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC4_UNORM:
+		return 8;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+// Textures share a handful of sizes and formats, so the cache stays small.
+// Nodes of an unordered map never move, which keeps returned references valid.
+const TextureFootprint& GetTextureFootprint(UINT width, UINT height,
+	DXGI_FORMAT format, UINT16 nrOfMipLevels)
+{
+	static std::mutex mutex;
+	static std::unordered_map<FootprintKey, TextureFootprint,
+		FootprintKeyHash> footprints;
+
+	FootprintKey key = { width, height, format, nrOfMipLevels };
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = footprints.find(key);
+	if (found != footprints.end())
+		return found->second;
+
+	return footprints.emplace(key, CalculateTextureFootprint(width, height,
+		format, nrOfMipLevels)).first->second;
+}
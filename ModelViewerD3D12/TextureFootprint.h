@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <Windows.h>
+#include <dxgiformat.h>
+
+// Where one mip of a 2D texture lies in an upload buffer, as
+// GetCopyableFootprints gives it for a base offset of 0. Rows are texel rows,
+// or rows of 4x4 blocks for block compressed formats.
+struct SubresourceFootprint
+{
+	UINT64 offset = 0;
+	UINT width = 0;
+	UINT height = 0;
+	UINT rows = 0;
+	UINT64 rowSize = 0;
+	UINT rowPitch = 0;
+};
+
+struct TextureFootprint
+{
+	std::vector<SubresourceFootprint> subresources;
+
+	// The last row of the last mip is not padded to the row pitch
+	UINT64 totalBytes = 0;
+};
+
+// Bytes of a texel, or of a 4x4 block for block compressed formats, 0 for
+// formats the viewer does not create
+UINT GetFootprintElementSize(DXGI_FORMAT format);
+
+// Footprint of the first nrOfMipLevels mips of a 2D texture with a single
+// array slice and plane, 0 mips gives the full chain. Row pitches are aligned
+// to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and mips are placed at
+// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, without asking a device. Footprints
+// are calculated once per width, height, format and number of mips and the
+// reference stays valid for the lifetime of the program. Throws for formats
+// GetFootprintElementSize does not know.
+const TextureFootprint& GetTextureFootprint(UINT width, UINT height,
+	DXGI_FORMAT format, UINT16 nrOfMipLevels = 0);
@@ -0,0 +1,474 @@
+#include "TextureStreaming.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "TextureFootprint.h"
+
+using namespace DirectX;
+
+bool StreamingBounds::operator==(const StreamingBounds& other) const
+{
+	return center.x == other.center.x && center.y == other.center.y &&
+		center.z == other.center.z && radius == other.radius &&
+		uvSpan == other.uvSpan;
+}
+
+StreamingBounds CalculateStreamingBounds(const XMFLOAT3* positions,
+	const XMFLOAT2* uvs, unsigned int nrOfVertices)
+{
+	StreamingBounds toReturn;
+	if (positions == nullptr || nrOfVertices == 0)
+		return toReturn;
+
+	XMVECTOR minimum = XMLoadFloat3(&positions[0]);
+	XMVECTOR maximum = minimum;
+	for (unsigned int i = 1; i < nrOfVertices; ++i)
+	{
+		XMVECTOR position = XMLoadFloat3(&positions[i]);
+		minimum = XMVectorMin(minimum, position);
+		maximum = XMVectorMax(maximum, position);
+	}
+
+	XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+	XMVECTOR radius = XMVectorZero();
+	for (unsigned int i = 0; i < nrOfVertices; ++i)
+	{
+		radius = XMVectorMax(radius, XMVector3LengthSq(
+			XMVectorSubtract(XMLoadFloat3(&positions[i]), center)));
+	}
+
+	XMStoreFloat3(&toReturn.center, center);
+	toReturn.radius = std::sqrt(XMVectorGetX(radius));
+	if (uvs == nullptr)
+		return toReturn;
+
+	XMFLOAT2 uvMinimum = uvs[0];
+	XMFLOAT2 uvMaximum = uvs[0];
+	for (unsigned int i = 1; i < nrOfVertices; ++i)
+	{
+		uvMinimum.x = std::min(uvMinimum.x, uvs[i].x);
+		uvMinimum.y = std::min(uvMinimum.y, uvs[i].y);
+		uvMaximum.x = std::max(uvMaximum.x, uvs[i].x);
+		uvMaximum.y = std::max(uvMaximum.y, uvs[i].y);
+	}
+
+	// Equal coordinates everywhere sample a single texel, which the mip tail
+	// holds anyway
+	float span = std::max(uvMaximum.x - uvMinimum.x, uvMaximum.y - uvMinimum.y);
+	toReturn.uvSpan = span > 0.0f ? span : 1.0f;
+	return toReturn;
+}
+
+void TextureStreamer::UpdateWantedMip(StreamedTexture& texture,
+	const StreamingView& view)
+{
+	// Pixels a unit long line covers at a distance of 1
+	float focalLength = view.screenHeight /
+		(2.0f * std::tan(view.verticalFieldOfView * 0.5f));
+	XMVECTOR camera = XMLoadFloat3(&view.cameraPosition);
+
+	texture.texelsWanted = 0.0f;
+	for (auto& user : texture.users)
+	{
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(
+			camera, XMLoadFloat3(&user.center)))) - user.radius;
+		if (distance <= 0.0f)
+		{
+			texture.texelsWanted = std::numeric_limits<float>::max();
+			break;
+		}
+
+		float projectedDiameter = 2.0f * user.radius * focalLength / distance;
+		texture.texelsWanted = std::max(texture.texelsWanted,
+			projectedDiameter / user.uvSpan);
+	}
+
+	float largestDimension = static_cast<float>(
+		std::max(texture.width, texture.height));
+	if (texture.texelsWanted >= largestDimension)
+	{
+		texture.wantedMip = 0;
+	}
+	else if (texture.texelsWanted <= 0.0f)
+	{
+		texture.wantedMip = texture.tailMip;
+	}
+	else
+	{
+		// The least detailed level that is still at least as large
+		float level = std::floor(std::log2(largestDimension /
+			texture.texelsWanted));
+		texture.wantedMip = std::min(static_cast<unsigned int>(level),
+			texture.tailMip);
+	}
+}
+
+unsigned int TextureStreamer::GetMissingMips(
+	const StreamedTexture& texture) const
+{
+	return texture.firstMip > texture.wantedMip ?
+		texture.firstMip - texture.wantedMip : 0;
+}
+
+// Textures with levels they do not want cost nothing to evict from, ties go
+// to the texture that covers the fewest texels on screen
+size_t TextureStreamer::FindEvictionVictim(size_t streamedIn,
+	unsigned int missingMips) const
+{
+	size_t toReturn = textures.size();
+	unsigned int lowestCost = 0;
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		const StreamedTexture& texture = textures[i];
+		if (!texture.active || i == streamedIn ||
+			texture.firstMip >= texture.tailMip)
+		{
+			continue;
+		}
+
+		unsigned int cost = texture.firstMip + 1 > texture.wantedMip ?
+			texture.firstMip + 1 - texture.wantedMip : 0;
+		if (cost >= missingMips)
+			continue;
+
+		if (toReturn == textures.size() || cost < lowestCost ||
+			(cost == lowestCost &&
+				texture.texelsWanted < textures[toReturn].texelsWanted))
+		{
+			toReturn = i;
+			lowestCost = cost;
+		}
+	}
+
+	return toReturn;
+}
+
+void TextureStreamer::SetFirstMip(StreamedTexture& texture,
+	unsigned int firstMip)
+{
+	statistics.residentBytes -= texture.chainBytes[texture.firstMip];
+	statistics.residentBytes += texture.chainBytes[firstMip];
+	texture.firstMip = firstMip;
+}
+
+void TextureStreamer::SetSettings(const TextureStreamingSettings& settingsToUse)
+{
+	settings = settingsToUse;
+}
+
+const TextureStreamingSettings& TextureStreamer::GetSettings() const
+{
+	return settings;
+}
+
+StreamedTextureIndex TextureStreamer::AddTexture(unsigned int width,
+	unsigned int height, DXGI_FORMAT format)
+{
+	StreamedTexture toAdd;
+	toAdd.width = width;
+	toAdd.height = height;
+	toAdd.tailMip = static_cast<unsigned int>(-1);
+	unsigned int levelWidth = width;
+	unsigned int levelHeight = height;
+	while (true)
+	{
+		unsigned int level = static_cast<unsigned int>(toAdd.chainBytes.size());
+		toAdd.chainBytes.push_back(static_cast<size_t>(GetTextureFootprint(
+			levelWidth, levelHeight, format).totalBytes));
+		if (toAdd.tailMip == static_cast<unsigned int>(-1) &&
+			std::max(levelWidth, levelHeight) <= settings.mipTailSize)
+		{
+			toAdd.tailMip = level;
+		}
+
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	// A tail size of 0 leaves only the last level
+	if (toAdd.tailMip == static_cast<unsigned int>(-1))
+		toAdd.tailMip = static_cast<unsigned int>(toAdd.chainBytes.size() - 1);
+	toAdd.firstMip = toAdd.tailMip;
+	toAdd.wantedMip = toAdd.tailMip;
+	toAdd.firstMipBeforeUpdate = toAdd.tailMip;
+	toAdd.active = true;
+
+	statistics.residentBytes += toAdd.chainBytes[toAdd.firstMip];
+	statistics.peakResidentBytes = std::max(statistics.peakResidentBytes,
+		statistics.residentBytes);
+
+	if (freeIndices.empty())
+	{
+		textures.push_back(std::move(toAdd));
+		return textures.size() - 1;
+	}
+
+	StreamedTextureIndex toReturn = freeIndices.back();
+	freeIndices.pop_back();
+	textures[toReturn] = std::move(toAdd);
+	return toReturn;
+}
+
+void TextureStreamer::RemoveTexture(StreamedTextureIndex index)
+{
+	StreamedTexture& texture = textures[index];
+	statistics.residentBytes -= texture.chainBytes[texture.firstMip];
+	texture = StreamedTexture();
+	freeIndices.push_back(index);
+}
+
+void TextureStreamer::AddTextureUser(StreamedTextureIndex index,
+	const StreamingBounds& bounds)
+{
+	textures[index].users.push_back(bounds);
+}
+
+void TextureStreamer::RemoveTextureUser(StreamedTextureIndex index,
+	const StreamingBounds& bounds)
+{
+	std::vector<StreamingBounds>& users = textures[index].users;
+	auto user = std::find(users.begin(), users.end(), bounds);
+	if (user != users.end())
+		users.erase(user);
+}
+
+void TextureStreamer::Update(const StreamingView& view,
+	std::vector<StreamingChange>& toFill)
+{
+	toFill.clear();
+	++statistics.nrOfUpdates;
+	for (auto& texture : textures)
+	{
+		if (!texture.active)
+			continue;
+
+		texture.firstMipBeforeUpdate = texture.firstMip;
+		UpdateWantedMip(texture, view);
+	}
+
+	// A lowered budget is met before anything is streamed in
+	while (statistics.residentBytes > settings.budgetBytes)
+	{
+		size_t victim = FindEvictionVictim(textures.size(),
+			std::numeric_limits<unsigned int>::max());
+		if (victim == textures.size())
+			break;
+
+		SetFirstMip(textures[victim], textures[victim].firstMip + 1);
+	}
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		if (textures[i].active && GetMissingMips(textures[i]) > 0)
+			candidates.push_back(i);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+		{
+			unsigned int missingA = GetMissingMips(textures[a]);
+			unsigned int missingB = GetMissingMips(textures[b]);
+			if (missingA != missingB)
+				return missingA > missingB;
+			if (textures[a].texelsWanted != textures[b].texelsWanted)
+				return textures[a].texelsWanted > textures[b].texelsWanted;
+			return a < b;
+		});
+
+	size_t uploadLeft = settings.maxUploadBytesPerUpdate;
+	bool uploaded = false;
+	std::vector<std::pair<size_t, unsigned int>> evictions;
+	for (size_t index : candidates)
+	{
+		StreamedTexture& texture = textures[index];
+		unsigned int target = texture.wantedMip;
+		while (target < texture.firstMip &&
+			texture.chainBytes[target] > uploadLeft)
+		{
+			++target;
+		}
+
+		// The first texture of an update always gets a level, so chains
+		// larger than the upload limit do not stall streaming
+		if (target == texture.firstMip)
+		{
+			if (uploaded)
+				continue;
+
+			target = texture.firstMip - 1;
+		}
+
+		evictions.clear();
+		while (target < texture.firstMip)
+		{
+			size_t extraBytes = texture.chainBytes[target] -
+				texture.chainBytes[texture.firstMip];
+			if (statistics.residentBytes + extraBytes <= settings.budgetBytes)
+				break;
+
+			size_t victim = FindEvictionVictim(index, GetMissingMips(texture));
+			if (victim == textures.size())
+			{
+				++target;
+				continue;
+			}
+
+			evictions.emplace_back(victim, textures[victim].firstMip);
+			SetFirstMip(textures[victim], textures[victim].firstMip + 1);
+		}
+
+		// Nothing was streamed in, so whatever was evicted for it stays
+		if (target == texture.firstMip)
+		{
+			for (auto eviction = evictions.rbegin();
+				eviction != evictions.rend(); ++eviction)
+			{
+				SetFirstMip(textures[eviction->first], eviction->second);
+			}
+
+			continue;
+		}
+
+		uploadLeft -= std::min(uploadLeft, texture.chainBytes[target]);
+		uploaded = true;
+		SetFirstMip(texture, target);
+	}
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		StreamedTexture& texture = textures[i];
+		if (!texture.active)
+			continue;
+
+		statistics.missingMips += GetMissingMips(texture);
+		if (texture.firstMip == texture.firstMipBeforeUpdate)
+			continue;
+
+		StreamingChange change;
+		change.texture = i;
+		change.previousFirstMip = texture.firstMipBeforeUpdate;
+		change.firstMip = texture.firstMip;
+		toFill.push_back(change);
+
+		++statistics.nrOfChanges;
+		statistics.uploadedBytes += texture.chainBytes[texture.firstMip];
+		if (change.firstMip < change.previousFirstMip)
+			statistics.mipsStreamedIn += change.previousFirstMip - change.firstMip;
+		else
+			statistics.mipsEvicted += change.firstMip - change.previousFirstMip;
+	}
+
+	statistics.peakResidentBytes = std::max(statistics.peakResidentBytes,
+		statistics.residentBytes);
+}
+
+void TextureStreamer::CancelChange(const StreamingChange& change)
+{
+	StreamedTexture& texture = textures[change.texture];
+	--statistics.nrOfChanges;
+	statistics.uploadedBytes -= texture.chainBytes[change.firstMip];
+	if (change.firstMip < change.previousFirstMip)
+		statistics.mipsStreamedIn -= change.previousFirstMip - change.firstMip;
+	else
+		statistics.mipsEvicted -= change.firstMip - change.previousFirstMip;
+
+	SetFirstMip(texture, change.previousFirstMip);
+	texture.firstMipBeforeUpdate = change.previousFirstMip;
+}
+
+unsigned int TextureStreamer::GetFirstResidentMip(
+	StreamedTextureIndex index) const
+{
+	return textures[index].firstMip;
+}
+
+unsigned int TextureStreamer::GetWantedMip(StreamedTextureIndex index) const
+{
+	return textures[index].wantedMip;
+}
+
+unsigned int TextureStreamer::GetNrOfMipLevels(StreamedTextureIndex index) const
+{
+	return static_cast<unsigned int>(textures[index].chainBytes.size());
+}
+
+const TextureStreamingStatistics& TextureStreamer::GetStatistics() const
+{
+	return statistics;
+}
+
+std::vector<StreamingSimulationFrame> SimulateTextureStreaming(
+	TextureStreamer& streamer, const std::vector<StreamingView>& path)
+{
+	std::vector<StreamingSimulationFrame> toReturn;
+	toReturn.reserve(path.size());
+	std::vector<StreamingChange> changes;
+	for (auto& view : path)
+	{
+		TextureStreamingStatistics before = streamer.GetStatistics();
+		auto updateStart = std::chrono::steady_clock::now();
+		streamer.Update(view, changes);
+		std::chrono::duration<double, std::milli> updateTime =
+			std::chrono::steady_clock::now() - updateStart;
+
+		const TextureStreamingStatistics& after = streamer.GetStatistics();
+		StreamingSimulationFrame frame;
+		frame.nrOfChanges = changes.size();
+		frame.uploadedBytes = after.uploadedBytes - before.uploadedBytes;
+		frame.residentBytes = after.residentBytes;
+		frame.missingMips = after.missingMips - before.missingMips;
+		frame.updateMilliseconds = updateTime.count();
+		toReturn.push_back(frame);
+	}
+
+	return toReturn;
+}
+
+bool LoadCameraPath(const std::string& file, std::vector<XMFLOAT3>& toFill)
+{
+	std::ifstream stream(file);
+	if (!stream)
+		return false;
+
+	toFill.clear();
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		std::istringstream values(line);
+		XMFLOAT3 position;
+		std::string rest;
+		if (!(values >> position.x >> position.y >> position.z) ||
+			(values >> rest))
+		{
+			return false;
+		}
+
+		toFill.push_back(position);
+	}
+
+	return !toFill.empty();
+}
+
+bool SaveCameraPath(const std::string& file, const std::vector<XMFLOAT3>& path)
+{
+	std::ofstream stream(file, std::ios::trunc);
+	if (!stream)
+		return false;
+
+	stream.precision(9);
+	for (auto& position : path)
+		stream << position.x << " " << position.y << " " << position.z << "\n";
+
+	return static_cast<bool>(stream);
+}
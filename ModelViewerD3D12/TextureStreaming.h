@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <Windows.h>
+#include <dxgiformat.h>
+#include <DirectXMath.h>
+
+typedef size_t StreamedTextureIndex;
+
+// Bounding sphere of a sub mesh in object space and how many times its
+// texture coordinates repeat across it, the larger of the u and v extents
+struct StreamingBounds
+{
+	DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.0f;
+	float uvSpan = 1.0f;
+
+	bool operator==(const StreamingBounds& other) const;
+};
+
+// Sub meshes without texture coordinates get a span of 1
+StreamingBounds CalculateStreamingBounds(const DirectX::XMFLOAT3* positions,
+	const DirectX::XMFLOAT2* uvs, unsigned int nrOfVertices);
+
+// Camera in the object space of the sub meshes with a perspective projection
+struct StreamingView
+{
+	DirectX::XMFLOAT3 cameraPosition = { 0.0f, 0.0f, 0.0f };
+	float verticalFieldOfView = DirectX::XM_PIDIV2;
+	unsigned int screenHeight = 1080;
+};
+
+// Levels no larger than the mip tail size in either dimension are resident
+// from the moment a texture is added until it is removed. The budget covers
+// the resident levels of every streamed texture, tails included, and the
+// upload limit the chains recreated per update for streamed in levels.
+struct TextureStreamingSettings
+{
+	bool enabled = false;
+	size_t budgetBytes = 256 * 1024 * 1024;
+	size_t maxUploadBytesPerUpdate = 16 * 1024 * 1024;
+	unsigned int mipTailSize = 64;
+};
+
+// The most detailed resident level of a texture moved from previousFirstMip
+// to firstMip, lower is more detailed
+struct StreamingChange
+{
+	StreamedTextureIndex texture = 0;
+	unsigned int previousFirstMip = 0;
+	unsigned int firstMip = 0;
+};
+
+// Cumulative over every update. A change recreates the texture, so uploaded
+// bytes are those of every chain a change leaves resident. Missing mips are
+// summed over updates, the levels between the wanted and the resident most
+// detailed level of every texture once the update is done.
+struct TextureStreamingStatistics
+{
+	size_t nrOfUpdates = 0;
+	size_t nrOfChanges = 0;
+	size_t uploadedBytes = 0;
+	size_t mipsStreamedIn = 0;
+	size_t mipsEvicted = 0;
+	size_t missingMips = 0;
+	size_t residentBytes = 0;
+	size_t peakResidentBytes = 0;
+};
+
+// Decides which levels of each texture are resident, without a device. The
+// level a texture wants is the one whose size matches the largest projected
+// size among the sub meshes using it. Each update streams the textures
+// missing the most levels first, straight to their wanted level if the chain
+// fits in what is left of the upload limit and progressively otherwise, and
+// makes room under the budget by evicting the most detailed level of the
+// texture that would miss the fewest levels without it. A level is only
+// evicted for a texture missing more levels than its owner would, so the
+// policy settles instead of trading levels back and forth. Updates only
+// depend on the textures, users and views, which keeps them deterministic.
+class TextureStreamer
+{
+private:
+	struct StreamedTexture
+	{
+		// Resident bytes with each level as the most detailed one
+		std::vector<size_t> chainBytes;
+		std::vector<StreamingBounds> users;
+		unsigned int width = 0;
+		unsigned int height = 0;
+		unsigned int tailMip = 0;
+		unsigned int firstMip = 0;
+		unsigned int wantedMip = 0;
+		unsigned int firstMipBeforeUpdate = 0;
+		float texelsWanted = 0.0f; // Across the largest projected user
+		bool active = false;
+	};
+
+	std::vector<StreamedTexture> textures;
+	std::vector<StreamedTextureIndex> freeIndices;
+	TextureStreamingSettings settings;
+	TextureStreamingStatistics statistics;
+
+	void UpdateWantedMip(StreamedTexture& texture, const StreamingView& view);
+	unsigned int GetMissingMips(const StreamedTexture& texture) const;
+
+	// The texture to evict a level of for one that misses the given number
+	// of levels, textures.size() if no texture would miss fewer
+	size_t FindEvictionVictim(size_t streamedIn, unsigned int missingMips) const;
+	void SetFirstMip(StreamedTexture& texture, unsigned int firstMip);
+
+public:
+	TextureStreamer() = default;
+
+	void SetSettings(const TextureStreamingSettings& settingsToUse);
+	const TextureStreamingSettings& GetSettings() const;
+
+	// Only the mip tail is resident at first. Throws for formats without a
+	// known footprint, see GetFootprintElementSize.
+	StreamedTextureIndex AddTexture(unsigned int width, unsigned int height,
+		DXGI_FORMAT format);
+	void RemoveTexture(StreamedTextureIndex index);
+
+	// Users with equal bounds want the same level, so removing one removes
+	// any of them
+	void AddTextureUser(StreamedTextureIndex index,
+		const StreamingBounds& bounds);
+	void RemoveTextureUser(StreamedTextureIndex index,
+		const StreamingBounds& bounds);
+
+	// Fills toFill with the change of every texture whose resident levels
+	// changed, at most one per texture
+	void Update(const StreamingView& view, std::vector<StreamingChange>& toFill);
+
+	// Undoes a change of the last update that could not be applied, such as
+	// when its texture could not be recreated
+	void CancelChange(const StreamingChange& change);
+
+	unsigned int GetFirstResidentMip(StreamedTextureIndex index) const;
+	unsigned int GetWantedMip(StreamedTextureIndex index) const;
+	unsigned int GetNrOfMipLevels(StreamedTextureIndex index) const;
+	const TextureStreamingStatistics& GetStatistics() const;
+};
+
+// One update of a simulated camera path
+struct StreamingSimulationFrame
+{
+	size_t nrOfChanges = 0;
+	size_t uploadedBytes = 0;
+	size_t residentBytes = 0;
+	size_t missingMips = 0;
+	double updateMilliseconds = 0.0;
+};
+
+// Updates the streamer once per view as if every change was applied. The same
+// textures, users and views always give the same frames, timings aside.
+std::vector<StreamingSimulationFrame> SimulateTextureStreaming(
+	TextureStreamer& streamer, const std::vector<StreamingView>& path);
+
+// Camera paths are text files with the x, y and z of one camera position per
+// line, in the object space of the streamed sub meshes
+bool LoadCameraPath(const std::string& file,
+	std::vector<DirectX::XMFLOAT3>& toFill);
+bool SaveCameraPath(const std::string& file,
+	const std::vector<DirectX::XMFLOAT3>& path);
@@ -0,0 +1,415 @@
+#include "VertexCacheOptimization.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int INVALID_INDEX = static_cast<unsigned int>(-1);
+
+	// Scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	float VertexScore(int cachePosition, unsigned int remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0 && cachePosition < 3)
+		{
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else if (cachePosition >= 3)
+		{
+			float scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler,
+				CACHE_DECAY_POWER);
+		}
+
+		return score + VALENCE_BOOST_SCALE * std::pow(
+			static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+	}
+
+	// Triangles of every vertex, the first remaining[v] entries of a vertex are
+	// the triangles that have not been emitted yet
+	struct VertexAdjacency
+	{
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> remaining;
+		std::vector<unsigned int> triangles;
+
+		VertexAdjacency(const unsigned int* indices, size_t nrOfIndices,
+			unsigned int nrOfVertices) : offsets(nrOfVertices + 1, 0),
+			remaining(nrOfVertices, 0), triangles(nrOfIndices)
+		{
+			for (size_t i = 0; i < nrOfIndices; ++i)
+				++remaining[indices[i]];
+
+			for (unsigned int i = 0; i < nrOfVertices; ++i)
+				offsets[i + 1] = offsets[i] + remaining[i];
+
+			std::vector<unsigned int> written(nrOfVertices, 0);
+			for (size_t i = 0; i < nrOfIndices; ++i)
+			{
+				unsigned int vertex = indices[i];
+				triangles[offsets[vertex] + written[vertex]++] =
+					static_cast<unsigned int>(i / 3);
+			}
+		}
+
+		void RemoveTriangle(unsigned int vertex, unsigned int triangle)
+		{
+			unsigned int* start = triangles.data() + offsets[vertex];
+			unsigned int* end = start + remaining[vertex];
+			unsigned int* found = std::find(start, end, triangle);
+			if (found == end)
+				return;
+
+			std::swap(*found, *(end - 1));
+			--remaining[vertex];
+		}
+	};
+
+	float TriangleArea(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c,
+		XMFLOAT3& normal)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&a);
+		XMVECTOR cross = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&b), p0),
+			XMVectorSubtract(XMLoadFloat3(&c), p0));
+		XMStoreFloat3(&normal, cross);
+
+		return 0.5f * XMVectorGetX(XMVector3Length(cross));
+	}
+
+	struct Cluster
+	{
+		size_t firstIndex = 0;
+		size_t nrOfIndices = 0;
+		float sortKey = 0.0f;
+	};
+
+	// Walks the triangles with a FIFO cache and returns the number of misses
+	// of one triangle, the cache is reset by increasing the time past its size
+	unsigned int SimulateTriangle(const unsigned int* triangle,
+		std::vector<unsigned int>& timestamps, unsigned int& time)
+	{
+		unsigned int misses = 0;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			unsigned int vertex = triangle[i];
+			if (time - timestamps[vertex] > VERTEX_CACHE_SIZE)
+			{
+				timestamps[vertex] = time++;
+				++misses;
+			}
+		}
+
+		return misses;
+	}
+
+	// Hard boundaries are triangles where every vertex misses, so starting a
+	// cluster there costs nothing. Hard clusters are then cut further where the
+	// running ACMR is within the threshold of the ACMR of the whole cluster.
+	std::vector<Cluster> FindClusters(const unsigned int* indices,
+		size_t nrOfIndices, unsigned int nrOfVertices, float threshold)
+	{
+		size_t nrOfTriangles = nrOfIndices / 3;
+		std::vector<size_t> hardBoundaries;
+		std::vector<unsigned int> timestamps(nrOfVertices, 0);
+		unsigned int time = VERTEX_CACHE_SIZE + 1;
+
+		for (size_t i = 0; i < nrOfTriangles; ++i)
+		{
+			if (SimulateTriangle(indices + i * 3, timestamps, time) == 3)
+				hardBoundaries.push_back(i);
+		}
+		hardBoundaries.push_back(nrOfTriangles);
+
+		std::vector<Cluster> toReturn;
+		for (size_t boundary = 0; boundary + 1 < hardBoundaries.size(); ++boundary)
+		{
+			size_t start = hardBoundaries[boundary];
+			size_t end = hardBoundaries[boundary + 1];
+
+			time += VERTEX_CACHE_SIZE + 1;
+			size_t clusterMisses = 0;
+			for (size_t i = start; i < end; ++i)
+				clusterMisses += SimulateTriangle(indices + i * 3, timestamps, time);
+			float clusterThreshold = threshold *
+				static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+			time += VERTEX_CACHE_SIZE + 1;
+			size_t clusterStart = start;
+			size_t runningMisses = 0;
+			for (size_t i = start; i < end; ++i)
+			{
+				runningMisses += SimulateTriangle(indices + i * 3, timestamps, time);
+				float runningAcmr = static_cast<float>(runningMisses) /
+					static_cast<float>(i + 1 - clusterStart);
+
+				if (i + 1 < end && runningAcmr <= clusterThreshold)
+				{
+					toReturn.push_back({ clusterStart * 3, (i + 1 - clusterStart) * 3 });
+					clusterStart = i + 1;
+					runningMisses = 0;
+					time += VERTEX_CACHE_SIZE + 1;
+				}
+			}
+
+			toReturn.push_back({ clusterStart * 3, (end - clusterStart) * 3 });
+		}
+
+		return toReturn;
+	}
+
+	template<typename T>
+	void ReorderStream(std::vector<T>& stream,
+		const std::vector<unsigned int>& remap)
+	{
+		if (stream.empty())
+			return;
+
+		std::vector<T> reordered(stream.size());
+		for (size_t i = 0; i < stream.size(); ++i)
+			reordered[remap[i]] = stream[i];
+
+		stream.swap(reordered);
+	}
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const unsigned int* indices,
+	size_t nrOfIndices, unsigned int nrOfVertices, unsigned int cacheSize)
+{
+	VertexCacheStatistics toReturn;
+	if (nrOfIndices < 3 || nrOfVertices == 0)
+		return toReturn;
+
+	std::vector<unsigned int> timestamps(nrOfVertices, 0);
+	unsigned int time = cacheSize + 1;
+
+	for (size_t i = 0; i < nrOfIndices; ++i)
+	{
+		unsigned int vertex = indices[i];
+		if (time - timestamps[vertex] > cacheSize)
+		{
+			timestamps[vertex] = time++;
+			++toReturn.cacheMisses;
+		}
+	}
+
+	toReturn.acmr = static_cast<double>(toReturn.cacheMisses) /
+		static_cast<double>(nrOfIndices / 3);
+	toReturn.atvr = static_cast<double>(toReturn.cacheMisses) / nrOfVertices;
+
+	return toReturn;
+}
+
+void OptimizeVertexCache(unsigned int* indices, size_t nrOfIndices,
+	unsigned int nrOfVertices)
+{
+	size_t nrOfTriangles = nrOfIndices / 3;
+	if (nrOfTriangles == 0)
+		return;
+
+	VertexAdjacency adjacency(indices, nrOfTriangles * 3, nrOfVertices);
+	std::vector<float> vertexScores(nrOfVertices);
+	for (unsigned int i = 0; i < nrOfVertices; ++i)
+		vertexScores[i] = VertexScore(-1, adjacency.remaining[i]);
+
+	std::vector<float> triangleScores(nrOfTriangles);
+	std::vector<bool> emitted(nrOfTriangles, false);
+	unsigned int bestTriangle = 0;
+	for (size_t i = 0; i < nrOfTriangles; ++i)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3]] +
+			vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		if (triangleScores[i] > triangleScores[bestTriangle])
+			bestTriangle = static_cast<unsigned int>(i);
+	}
+
+	std::vector<unsigned int> output;
+	output.reserve(nrOfTriangles * 3);
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	size_t nextUnemitted = 0;
+
+	while (output.size() < nrOfTriangles * 3)
+	{
+		// Nothing in the cache has triangles left, continue with the first
+		// triangle not yet emitted instead of scanning for the best one
+		if (bestTriangle == INVALID_INDEX)
+		{
+			while (emitted[nextUnemitted])
+				++nextUnemitted;
+			bestTriangle = static_cast<unsigned int>(nextUnemitted);
+		}
+
+		emitted[bestTriangle] = true;
+		const unsigned int* triangle = indices + bestTriangle * 3;
+		newCache.clear();
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			output.push_back(triangle[i]);
+			adjacency.RemoveTriangle(triangle[i], bestTriangle);
+			if (std::find(newCache.begin(), newCache.end(), triangle[i]) ==
+				newCache.end())
+			{
+				newCache.push_back(triangle[i]);
+			}
+		}
+
+		for (unsigned int vertex : cache)
+		{
+			if (std::find(newCache.begin(), newCache.end(), vertex) ==
+				newCache.end())
+			{
+				newCache.push_back(vertex);
+			}
+		}
+
+		// Entries past the cache size were evicted and only get their scores
+		// updated, every triangle of a changed vertex changes by the same delta
+		bestTriangle = INVALID_INDEX;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < newCache.size(); ++i)
+		{
+			unsigned int vertex = newCache[i];
+			int position = i < VERTEX_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+			float score = VertexScore(position, adjacency.remaining[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			unsigned int* triangles = adjacency.triangles.data() +
+				adjacency.offsets[vertex];
+			for (unsigned int j = 0; j < adjacency.remaining[vertex]; ++j)
+			{
+				unsigned int adjacent = triangles[j];
+				triangleScores[adjacent] += delta;
+				if (position >= 0 && triangleScores[adjacent] > bestScore)
+				{
+					bestScore = triangleScores[adjacent];
+					bestTriangle = adjacent;
+				}
+			}
+		}
+
+		newCache.resize(std::min<size_t>(newCache.size(), VERTEX_CACHE_SIZE));
+		cache.swap(newCache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(unsigned int* indices, size_t nrOfIndices,
+	const XMFLOAT3* positions, unsigned int nrOfVertices, float threshold)
+{
+	nrOfIndices -= nrOfIndices % 3;
+	if (nrOfIndices == 0 || positions == nullptr)
+		return;
+
+	std::vector<Cluster> clusters = FindClusters(indices, nrOfIndices,
+		nrOfVertices, threshold);
+	if (clusters.size() < 2)
+		return;
+
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	std::vector<XMFLOAT3> clusterCentroids(clusters.size());
+	std::vector<XMFLOAT3> clusterNormals(clusters.size());
+
+	for (size_t i = 0; i < clusters.size(); ++i)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float clusterArea = 0.0f;
+
+		const Cluster& cluster = clusters[i];
+		for (size_t j = 0; j < cluster.nrOfIndices; j += 3)
+		{
+			const unsigned int* triangle = indices + cluster.firstIndex + j;
+			const XMFLOAT3& a = positions[triangle[0]];
+			const XMFLOAT3& b = positions[triangle[1]];
+			const XMFLOAT3& c = positions[triangle[2]];
+
+			XMFLOAT3 triangleNormal;
+			float area = TriangleArea(a, b, c, triangleNormal);
+			XMVECTOR triangleCentroid = XMVectorScale(XMVectorAdd(XMVectorAdd(
+				XMLoadFloat3(&a), XMLoadFloat3(&b)), XMLoadFloat3(&c)), 1.0f / 3.0f);
+
+			centroid = XMVectorAdd(centroid, XMVectorScale(triangleCentroid, area));
+			normal = XMVectorAdd(normal, XMLoadFloat3(&triangleNormal));
+			clusterArea += area;
+		}
+
+		meshCentroid = XMVectorAdd(meshCentroid, centroid);
+		meshArea += clusterArea;
+
+		centroid = clusterArea > 0.0f ?
+			XMVectorScale(centroid, 1.0f / clusterArea) : XMVectorZero();
+		XMStoreFloat3(&clusterCentroids[i], centroid);
+		XMStoreFloat3(&clusterNormals[i], XMVector3Normalize(normal));
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+	// Clusters far out along their normal are likely to occlude the rest
+	for (size_t i = 0; i < clusters.size(); ++i)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&clusterCentroids[i]),
+			meshCentroid);
+		clusters[i].sortKey = XMVectorGetX(XMVector3Dot(offset,
+			XMLoadFloat3(&clusterNormals[i])));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& a, const Cluster& b)
+		{
+			return a.sortKey > b.sortKey;
+		});
+
+	std::vector<unsigned int> output;
+	output.reserve(nrOfIndices);
+	for (const Cluster& cluster : clusters)
+	{
+		output.insert(output.end(), indices + cluster.firstIndex,
+			indices + cluster.firstIndex + cluster.nrOfIndices);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(SubMeshData& subMesh)
+{
+	unsigned int nrOfVertices =
+		static_cast<unsigned int>(subMesh.positions.size());
+	std::vector<unsigned int> remap(nrOfVertices, INVALID_INDEX);
+	unsigned int nextVertex = 0;
+
+	for (unsigned int& index : subMesh.indices)
+	{
+		if (remap[index] == INVALID_INDEX)
+			remap[index] = nextVertex++;
+
+		index = remap[index];
+	}
+
+	for (unsigned int& newIndex : remap)
+	{
+		if (newIndex == INVALID_INDEX)
+			newIndex = nextVertex++;
+	}
+
+	ReorderStream(subMesh.positions, remap);
+	ReorderStream(subMesh.uvs, remap);
+	ReorderStream(subMesh.normals, remap);
+	ReorderStream(subMesh.tangents, remap);
+	ReorderStream(subMesh.bitangents, remap);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "SubMeshData.h"
+
+// Size of the FIFO cache the optimizer targets and the analysis defaults to
+const unsigned int VERTEX_CACHE_SIZE = 32;
+
+// Clusters may be cut where their ACMR stays within this factor of the ACMR of
+// the unsplit cluster, higher values give more clusters to sort for overdraw
+const float OVERDRAW_CACHE_THRESHOLD = 1.05f;
+
+// ACMR is the number of cache misses per triangle and ATVR the number per
+// vertex. Lower is better, ATVR is at best 1.0 and ACMR around 0.5 for large
+// regular meshes.
+struct VertexCacheStatistics
+{
+	size_t cacheMisses = 0;
+	double acmr = 0.0;
+	double atvr = 0.0;
+};
+
+// Simulates a FIFO post transform cache of the given size over the indices
+VertexCacheStatistics AnalyzeVertexCache(const unsigned int* indices,
+	size_t nrOfIndices, unsigned int nrOfVertices,
+	unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders the triangles for the post transform cache with Forsyth's linear
+// speed algorithm. The vertices are not changed.
+void OptimizeVertexCache(unsigned int* indices, size_t nrOfIndices,
+	unsigned int nrOfVertices);
+
+// Splits cache optimized triangles into clusters at points where the cache is
+// cold anyway and sorts the clusters so outward facing ones are drawn first
+void OptimizeOverdraw(unsigned int* indices, size_t nrOfIndices,
+	const DirectX::XMFLOAT3* positions, unsigned int nrOfVertices,
+	float threshold = OVERDRAW_CACHE_THRESHOLD);
+
+// Renumbers and reorders the vertices in the order the indices first use them,
+// unreferenced vertices are moved to the end
+void OptimizeVertexFetch(SubMeshData& subMesh);
\ No newline at end of file
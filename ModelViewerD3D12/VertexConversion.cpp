@@ -0,0 +1,292 @@
+#include "VertexConversion.h"
+
+#include <cstring>
+
+#include <intrin.h>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	InstructionSet DetectInstructionSet()
+	{
+		int info[4] = {};
+		__cpuid(info, 0);
+		int highestLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool osSavesAvxState = (info[2] & (1 << 27)) != 0;
+		bool hasAvx = (info[2] & (1 << 28)) != 0;
+		if (highestLeaf < 7 || !osSavesAvxState || !hasAvx)
+			return InstructionSet::SSE;
+
+		// The OS has to save both the SSE and the AVX registers on switches
+		if ((_xgetbv(0) & 0x6) != 0x6)
+			return InstructionSet::SSE;
+
+		__cpuidex(info, 7, 0);
+		bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+
+		return hasAvx2 ? InstructionSet::AVX2 : InstructionSet::SSE;
+	}
+
+	float CalculateHandedness(const float* normal, const float* tangent,
+		const float* bitangent)
+	{
+		float crossX = normal[1] * tangent[2] - normal[2] * tangent[1];
+		float crossY = normal[2] * tangent[0] - normal[0] * tangent[2];
+		float crossZ = normal[0] * tangent[1] - normal[1] * tangent[0];
+		float dot = crossX * bitangent[0] + crossY * bitangent[1] +
+			crossZ * bitangent[2];
+
+		return dot < 0.0f ? -1.0f : 1.0f;
+	}
+
+	void ConvertTangentsScalar(const float* tangents, const float* normals,
+		const float* bitangents, size_t start, size_t end, XMFLOAT4* toFill)
+	{
+		for (size_t i = start; i < end; ++i)
+		{
+			const float* tangent = tangents + i * 3;
+			float handedness = normals != nullptr && bitangents != nullptr ?
+				CalculateHandedness(normals + i * 3, tangent, bitangents + i * 3) :
+				1.0f;
+			toFill[i] = XMFLOAT4(tangent[0], tangent[1], tangent[2], handedness);
+		}
+	}
+
+	// Loads four xyz triples and transposes them so each register holds one
+	// component of all four
+	void LoadTransposed(const float* source, __m128& x, __m128& y, __m128& z)
+	{
+		__m128 a = _mm_loadu_ps(source); // x0 y0 z0 x1
+		__m128 b = _mm_loadu_ps(source + 4); // y1 z1 x2 y2
+		__m128 c = _mm_loadu_ps(source + 8); // z2 x3 y3 z3
+
+		__m128 xs = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+		x = _mm_shuffle_ps(a, xs, _MM_SHUFFLE(2, 0, 3, 0));
+
+		__m128 ys0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+		__m128 ys1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+		y = _mm_shuffle_ps(ys0, ys1, _MM_SHUFFLE(2, 0, 2, 0));
+
+		__m128 zs0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 zs1 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+		z = _mm_shuffle_ps(zs0, zs1, _MM_SHUFFLE(2, 0, 2, 0));
+	}
+
+	// 1 or -1 depending on the sign of dot(cross(n, t), b), 0 counts as 1
+	__m128 CalculateHandedness(__m128 nx, __m128 ny, __m128 nz, __m128 tx,
+		__m128 ty, __m128 tz, __m128 bx, __m128 by, __m128 bz)
+	{
+		__m128 crossX = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+		__m128 crossY = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+		__m128 crossZ = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(crossX, bx),
+			_mm_mul_ps(crossY, by)), _mm_mul_ps(crossZ, bz));
+
+		__m128 negative = _mm_cmplt_ps(dot, _mm_setzero_ps());
+		return _mm_or_ps(_mm_and_ps(negative, _mm_set1_ps(-0.0f)),
+			_mm_set1_ps(1.0f));
+	}
+
+	__m256 CalculateHandedness(__m256 nx, __m256 ny, __m256 nz, __m256 tx,
+		__m256 ty, __m256 tz, __m256 bx, __m256 by, __m256 bz)
+	{
+		__m256 crossX = _mm256_sub_ps(_mm256_mul_ps(ny, tz), _mm256_mul_ps(nz, ty));
+		__m256 crossY = _mm256_sub_ps(_mm256_mul_ps(nz, tx), _mm256_mul_ps(nx, tz));
+		__m256 crossZ = _mm256_sub_ps(_mm256_mul_ps(nx, ty), _mm256_mul_ps(ny, tx));
+		__m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(crossX, bx),
+			_mm256_mul_ps(crossY, by)), _mm256_mul_ps(crossZ, bz));
+
+		__m256 negative = _mm256_cmp_ps(dot, _mm256_setzero_ps(), _CMP_LT_OQ);
+		return _mm256_or_ps(_mm256_and_ps(negative, _mm256_set1_ps(-0.0f)),
+			_mm256_set1_ps(1.0f));
+	}
+
+	// The tangents are written straight from the source, only w is computed
+	void StoreTangents(const float* tangents, __m128 handedness,
+		XMFLOAT4* toFill)
+	{
+		alignas(16) float w[4];
+		_mm_store_ps(w, handedness);
+		for (size_t i = 0; i < 4; ++i)
+		{
+			toFill[i] = XMFLOAT4(tangents[i * 3], tangents[i * 3 + 1],
+				tangents[i * 3 + 2], w[i]);
+		}
+	}
+
+	size_t ConvertTangentsSse(const float* tangents, const float* normals,
+		const float* bitangents, size_t nrOfElements, XMFLOAT4* toFill)
+	{
+		size_t batchedElements = nrOfElements & ~size_t(3);
+		for (size_t i = 0; i < batchedElements; i += 4)
+		{
+			__m128 nx, ny, nz, tx, ty, tz, bx, by, bz;
+			LoadTransposed(normals + i * 3, nx, ny, nz);
+			LoadTransposed(tangents + i * 3, tx, ty, tz);
+			LoadTransposed(bitangents + i * 3, bx, by, bz);
+
+			__m128 tw = CalculateHandedness(nx, ny, nz, tx, ty, tz, bx, by, bz);
+			_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+			_mm_storeu_ps(&toFill[i].x, tx);
+			_mm_storeu_ps(&toFill[i + 1].x, ty);
+			_mm_storeu_ps(&toFill[i + 2].x, tz);
+			_mm_storeu_ps(&toFill[i + 3].x, tw);
+		}
+
+		return batchedElements;
+	}
+
+	size_t ConvertTangentsAvx2(const float* tangents, const float* normals,
+		const float* bitangents, size_t nrOfElements, XMFLOAT4* toFill)
+	{
+		size_t batchedElements = nrOfElements & ~size_t(7);
+		for (size_t i = 0; i < batchedElements; i += 8)
+		{
+			__m128 lanes[2][9];
+			for (size_t half = 0; half < 2; ++half)
+			{
+				size_t offset = (i + half * 4) * 3;
+				__m128* lane = lanes[half];
+				LoadTransposed(normals + offset, lane[0], lane[1], lane[2]);
+				LoadTransposed(tangents + offset, lane[3], lane[4], lane[5]);
+				LoadTransposed(bitangents + offset, lane[6], lane[7], lane[8]);
+			}
+
+			__m256 wide[9];
+			for (size_t j = 0; j < 9; ++j)
+				wide[j] = _mm256_set_m128(lanes[1][j], lanes[0][j]);
+
+			__m256 tw = CalculateHandedness(wide[0], wide[1], wide[2], wide[3],
+				wide[4], wide[5], wide[6], wide[7], wide[8]);
+			StoreTangents(tangents + i * 3, _mm256_castps256_ps128(tw), toFill + i);
+			StoreTangents(tangents + (i + 4) * 3, _mm256_extractf128_ps(tw, 1),
+				toFill + i + 4);
+		}
+
+		return batchedElements;
+	}
+}
+
+InstructionSet GetSupportedInstructionSet()
+{
+	static const InstructionSet supported = DetectInstructionSet();
+	return supported;
+}
+
+const char* GetInstructionSetName(InstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case InstructionSet::SCALAR:
+		return "scalar";
+	case InstructionSet::SSE:
+		return "SSE";
+	case InstructionSet::AVX2:
+		return "AVX2";
+	}
+
+	return "unknown";
+}
+
+void ConvertVector2Stream(const float* source, size_t nrOfElements,
+	XMFLOAT2* toFill, InstructionSet instructionSet)
+{
+	size_t converted = 0;
+	float* destination = &toFill->x;
+
+	if (instructionSet == InstructionSet::AVX2)
+	{
+		// Gathers the x and y of eight elements from three loads
+		const __m256i firstLow = _mm256_setr_epi32(0, 1, 3, 4, 6, 7, 0, 0);
+		const __m256i firstHigh = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 1, 2);
+		const __m256i secondLow = _mm256_setr_epi32(4, 5, 7, 0, 0, 0, 0, 0);
+		const __m256i secondHigh = _mm256_setr_epi32(0, 0, 0, 0, 2, 3, 5, 6);
+		size_t batchedElements = nrOfElements & ~size_t(7);
+
+		for (; converted < batchedElements; converted += 8)
+		{
+			const float* elements = source + converted * 3;
+			__m256 a = _mm256_loadu_ps(elements);
+			__m256 b = _mm256_loadu_ps(elements + 8);
+			__m256 c = _mm256_loadu_ps(elements + 16);
+
+			__m256 first = _mm256_blend_ps(_mm256_permutevar8x32_ps(a, firstLow),
+				_mm256_permutevar8x32_ps(b, firstHigh), 0xC0);
+			__m256 second = _mm256_blend_ps(
+				_mm256_permutevar8x32_ps(b, secondLow),
+				_mm256_permutevar8x32_ps(c, secondHigh), 0xF8);
+
+			_mm256_storeu_ps(destination + converted * 2, first);
+			_mm256_storeu_ps(destination + converted * 2 + 8, second);
+		}
+	}
+
+	if (instructionSet != InstructionSet::SCALAR)
+	{
+		size_t batchedElements = nrOfElements & ~size_t(3);
+		for (; converted < batchedElements; converted += 4)
+		{
+			const float* elements = source + converted * 3;
+			__m128 a = _mm_loadu_ps(elements); // x0 y0 z0 x1
+			__m128 b = _mm_loadu_ps(elements + 4); // y1 z1 x2 y2
+			__m128 c = _mm_loadu_ps(elements + 8); // z2 x3 y3 z3
+
+			__m128 split = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 3));
+			__m128 first = _mm_shuffle_ps(a, split, _MM_SHUFFLE(2, 0, 1, 0));
+			__m128 second = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+
+			_mm_storeu_ps(destination + converted * 2, first);
+			_mm_storeu_ps(destination + converted * 2 + 4, second);
+		}
+	}
+
+	for (size_t i = converted; i < nrOfElements; ++i)
+		toFill[i] = XMFLOAT2(source[i * 3], source[i * 3 + 1]);
+}
+
+void ConvertVector3Stream(const float* source, size_t nrOfElements,
+	XMFLOAT3* toFill, InstructionSet instructionSet)
+{
+	// The source layout already matches XMFLOAT3, so the wide paths leave the
+	// copy to memcpy, which picks its own vector width
+	if (instructionSet != InstructionSet::SCALAR)
+	{
+		memcpy(toFill, source, nrOfElements * sizeof(XMFLOAT3));
+		return;
+	}
+
+	for (size_t i = 0; i < nrOfElements; ++i)
+	{
+		toFill[i] = XMFLOAT3(source[i * 3], source[i * 3 + 1],
+			source[i * 3 + 2]);
+	}
+}
+
+void ConvertTangentStream(const float* tangents, const float* normals,
+	const float* bitangents, size_t nrOfElements, XMFLOAT4* toFill,
+	InstructionSet instructionSet)
+{
+	size_t converted = 0;
+	if (normals != nullptr && bitangents != nullptr)
+	{
+		if (instructionSet == InstructionSet::AVX2)
+		{
+			converted = ConvertTangentsAvx2(tangents, normals, bitangents,
+				nrOfElements, toFill);
+		}
+
+		if (instructionSet != InstructionSet::SCALAR)
+		{
+			converted += ConvertTangentsSse(tangents + converted * 3,
+				normals + converted * 3, bitangents + converted * 3,
+				nrOfElements - converted, toFill + converted);
+		}
+	}
+
+	ConvertTangentsScalar(tangents, normals, bitangents, converted,
+		nrOfElements, toFill);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+#include <DirectXMath.h>
+
+enum class InstructionSet
+{
+	SCALAR, // Component by component, kept as the reference for the others
+	SSE,
+	AVX2
+};
+
+// Widest instruction set supported by both the processor and the OS, SSE is
+// part of every processor the viewer runs on. Detected once and then cached.
+InstructionSet GetSupportedInstructionSet();
+const char* GetInstructionSetName(InstructionSet instructionSet);
+
+// The sources are tightly packed xyz float triples, such as the aiVector3D
+// streams of an imported mesh, and toFill has to have room for nrOfElements
+// elements. Every instruction set gives bit identical results.
+
+// Drops the z of every element, as needed for texture coordinates
+void ConvertVector2Stream(const float* source, size_t nrOfElements,
+	DirectX::XMFLOAT2* toFill,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
+
+void ConvertVector3Stream(const float* source, size_t nrOfElements,
+	DirectX::XMFLOAT3* toFill,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
+
+// Writes the tangents with the handedness of the tangent space in w, -1 when
+// the bitangent points away from cross(normal, tangent) and 1 otherwise.
+// Without normals or bitangents the handedness is always 1.
+void ConvertTangentStream(const float* tangents, const float* normals,
+	const float* bitangents, size_t nrOfElements, DirectX::XMFLOAT4* toFill,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
\ No newline at end of file
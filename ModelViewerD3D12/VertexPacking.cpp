@@ -0,0 +1,61 @@
+#include "VertexPacking.h"
+
+using namespace DirectX;
+
+namespace
+{
+	template<typename T>
+	T GetOrZero(const T* stream, unsigned int index)
+	{
+		return stream == nullptr ? T() : stream[index];
+	}
+
+	bool Equal(const XMFLOAT2& a, const XMFLOAT2& b)
+	{
+		return a.x == b.x && a.y == b.y;
+	}
+
+	bool Equal(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	bool Equal(const XMFLOAT4& a, const XMFLOAT4& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+	}
+}
+
+void PackVertexAttributes(const SubMeshStreams& streams,
+	std::vector<PackedVertexAttributes>& toFill)
+{
+	toFill.resize(streams.nrOfVertices);
+
+	for (unsigned int i = 0; i < streams.nrOfVertices; ++i)
+	{
+		PackedVertexAttributes& vertex = toFill[i];
+		vertex.uv = GetOrZero(streams.uvs, i);
+		vertex.normal = GetOrZero(streams.normals, i);
+		vertex.tangent = GetOrZero(streams.tangents, i);
+	}
+}
+
+bool ValidatePackedVertexAttributes(const SubMeshStreams& streams,
+	const std::vector<PackedVertexAttributes>& packed)
+{
+	if (packed.size() != streams.nrOfVertices)
+		return false;
+
+	for (unsigned int i = 0; i < streams.nrOfVertices; ++i)
+	{
+		const PackedVertexAttributes& vertex = packed[i];
+		if (!Equal(vertex.uv, GetOrZero(streams.uvs, i)) ||
+			!Equal(vertex.normal, GetOrZero(streams.normals, i)) ||
+			!Equal(vertex.tangent, GetOrZero(streams.tangents, i)))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
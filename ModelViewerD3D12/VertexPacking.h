@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "SubMeshData.h"
+
+enum class VertexLayout
+{
+	SEPARATE, // One buffer per attribute
+	PACKED, // Positions in one buffer, every other attribute interleaved in one
+	QUANTIZED // As packed, but with the attributes in QuantizedVertexAttributes
+};
+
+// Attributes of one vertex in the packed layout, must match the struct in
+// ModelPackedVS.hlsl. Positions are kept in their own buffer so acceleration
+// structures can still be built from a tightly packed float3 stream.
+struct PackedVertexAttributes
+{
+	DirectX::XMFLOAT2 uv;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT4 tangent; // w is the handedness of the tangent space
+};
+
+// Interleaves the non position streams, absent streams are stored as zero
+void PackVertexAttributes(const SubMeshStreams& streams,
+	std::vector<PackedVertexAttributes>& toFill);
+
+// Checks that every attribute of the packed data matches the source streams
+bool ValidatePackedVertexAttributes(const SubMeshStreams& streams,
+	const std::vector<PackedVertexAttributes>& packed);
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "VertexQuantization.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <emmintrin.h>
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	const std::uint32_t TANGENT_SIGN_BIT = 1u << 16;
+
+	std::uint32_t QuantizeSnorm16(float value)
+	{
+		value = std::min(std::max(value, -1.0f), 1.0f);
+		int quantized = static_cast<int>(std::nearbyint(value * 32767.0f));
+		return static_cast<std::uint32_t>(quantized) & 0xffff;
+	}
+
+	float DequantizeSnorm16(std::uint32_t value)
+	{
+		float toReturn = static_cast<std::int16_t>(value & 0xffff) / 32767.0f;
+		return std::max(toReturn, -1.0f);
+	}
+
+	// Encodes four directions given as separate x, y and z lanes, every step
+	// matches EncodeOctahedral so both paths give identical results
+	__m128i EncodeOctahedral4(__m128 x, __m128 y, __m128 z)
+	{
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_and_ps(x, absMask),
+			_mm_and_ps(y, absMask)), _mm_and_ps(z, absMask));
+		__m128 zeroLength = _mm_cmpeq_ps(sum, zero);
+		x = _mm_div_ps(x, sum);
+		y = _mm_div_ps(y, sum);
+
+		__m128 signX = _mm_or_ps(_mm_and_ps(x, signMask), one);
+		__m128 signY = _mm_or_ps(_mm_and_ps(y, signMask), one);
+		__m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(y, absMask)), signX);
+		__m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_and_ps(x, absMask)), signY);
+		__m128 lowerHemisphere = _mm_cmplt_ps(z, zero);
+		x = _mm_or_ps(_mm_and_ps(lowerHemisphere, foldedX),
+			_mm_andnot_ps(lowerHemisphere, x));
+		y = _mm_or_ps(_mm_and_ps(lowerHemisphere, foldedY),
+			_mm_andnot_ps(lowerHemisphere, y));
+		x = _mm_andnot_ps(zeroLength, x);
+		y = _mm_andnot_ps(zeroLength, y);
+
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		const __m128 scale = _mm_set1_ps(32767.0f);
+		__m128i quantizedX = _mm_cvtps_epi32(_mm_mul_ps(
+			_mm_min_ps(_mm_max_ps(x, minusOne), one), scale));
+		__m128i quantizedY = _mm_cvtps_epi32(_mm_mul_ps(
+			_mm_min_ps(_mm_max_ps(y, minusOne), one), scale));
+
+		return _mm_or_si128(_mm_and_si128(quantizedX, _mm_set1_epi32(0xffff)),
+			_mm_slli_epi32(quantizedY, 16));
+	}
+
+	// Loads x, y and z of four consecutive elements into separate registers
+	template<typename T>
+	void LoadLanes(const T* data, unsigned int start, __m128& x, __m128& y,
+		__m128& z)
+	{
+		if (data == nullptr)
+		{
+			x = y = z = _mm_setzero_ps();
+			return;
+		}
+
+		x = _mm_setr_ps(data[start].x, data[start + 1].x, data[start + 2].x,
+			data[start + 3].x);
+		y = _mm_setr_ps(data[start].y, data[start + 1].y, data[start + 2].y,
+			data[start + 3].y);
+		z = _mm_setr_ps(data[start].z, data[start + 1].z, data[start + 2].z,
+			data[start + 3].z);
+	}
+
+	__m128 LoadHandedness(const XMFLOAT4* data, unsigned int start)
+	{
+		if (data == nullptr)
+			return _mm_setzero_ps();
+
+		return _mm_setr_ps(data[start].w, data[start + 1].w, data[start + 2].w,
+			data[start + 3].w);
+	}
+
+	template<typename T>
+	T GetOrZero(const T* stream, unsigned int index)
+	{
+		return stream == nullptr ? T() : stream[index];
+	}
+
+	XMFLOAT3 GetDirection(const XMFLOAT4& vector)
+	{
+		return XMFLOAT3(vector.x, vector.y, vector.z);
+	}
+
+	void QuantizeVertex(const SubMeshStreams& streams, unsigned int index,
+		QuantizedVertexAttributes& toSet)
+	{
+		toSet.normal = EncodeOctahedral(GetOrZero(streams.normals, index));
+		toSet.tangent = EncodeTangent(GetOrZero(streams.tangents, index));
+		toSet.uv = streams.uvs == nullptr ? 0 : EncodeUV(streams.uvs[index]);
+	}
+
+	float MaxComponentError(const XMFLOAT3& original, const XMFLOAT3& decoded)
+	{
+		XMVECTOR difference = XMVectorAbs(XMVectorSubtract(
+			XMVector3Normalize(XMLoadFloat3(&original)), XMLoadFloat3(&decoded)));
+
+		XMFLOAT3 toReturn;
+		XMStoreFloat3(&toReturn, difference);
+		return std::max(toReturn.x, std::max(toReturn.y, toReturn.z));
+	}
+
+	bool IsZero(const XMFLOAT3& vector)
+	{
+		return vector.x == 0.0f && vector.y == 0.0f && vector.z == 0.0f;
+	}
+
+	float RelativeError(float original, float decoded)
+	{
+		// Below the smallest normal half the absolute error is what is bounded
+		const float smallestNormalHalf = 1.0f / 16384.0f;
+		return std::abs(decoded - original) /
+			std::max(std::abs(original), smallestNormalHalf);
+	}
+}
+
+std::uint32_t EncodeOctahedral(const XMFLOAT3& direction)
+{
+	float sum = std::abs(direction.x) + std::abs(direction.y) +
+		std::abs(direction.z);
+	if (sum == 0.0f)
+		return 0;
+
+	float x = direction.x / sum;
+	float y = direction.y / sum;
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - std::abs(y)) * std::copysign(1.0f, x);
+		float foldedY = (1.0f - std::abs(x)) * std::copysign(1.0f, y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return QuantizeSnorm16(x) | (QuantizeSnorm16(y) << 16);
+}
+
+XMFLOAT3 DecodeOctahedral(std::uint32_t encoded)
+{
+	float x = DequantizeSnorm16(encoded);
+	float y = DequantizeSnorm16(encoded >> 16);
+	float z = 1.0f - std::abs(x) - std::abs(y);
+	if (z < 0.0f)
+	{
+		float unfoldedX = (1.0f - std::abs(y)) * std::copysign(1.0f, x);
+		float unfoldedY = (1.0f - std::abs(x)) * std::copysign(1.0f, y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	XMFLOAT3 toReturn(x, y, z);
+	XMStoreFloat3(&toReturn, XMVector3Normalize(XMLoadFloat3(&toReturn)));
+	return toReturn;
+}
+
+std::uint32_t EncodeTangent(const XMFLOAT4& tangent)
+{
+	std::uint32_t toReturn = EncodeOctahedral(GetDirection(tangent)) &
+		~TANGENT_SIGN_BIT;
+	return toReturn | (tangent.w < 0.0f ? TANGENT_SIGN_BIT : 0);
+}
+
+XMFLOAT4 DecodeTangent(std::uint32_t encoded)
+{
+	XMFLOAT3 direction = DecodeOctahedral(encoded);
+	float handedness = (encoded & TANGENT_SIGN_BIT) != 0 ? -1.0f : 1.0f;
+	return XMFLOAT4(direction.x, direction.y, direction.z, handedness);
+}
+
+std::uint32_t EncodeUV(const XMFLOAT2& uv)
+{
+	return static_cast<std::uint32_t>(XMConvertFloatToHalf(uv.x)) |
+		(static_cast<std::uint32_t>(XMConvertFloatToHalf(uv.y)) << 16);
+}
+
+XMFLOAT2 DecodeUV(std::uint32_t encoded)
+{
+	return XMFLOAT2(XMConvertHalfToFloat(static_cast<HALF>(encoded & 0xffff)),
+		XMConvertHalfToFloat(static_cast<HALF>(encoded >> 16)));
+}
+
+void QuantizeVertexAttributes(const SubMeshStreams& streams,
+	std::vector<QuantizedVertexAttributes>& toFill)
+{
+	toFill.resize(streams.nrOfVertices);
+	unsigned int batchedVertices = streams.nrOfVertices & ~3u;
+	alignas(16) std::uint32_t normals[4];
+	alignas(16) std::uint32_t tangents[4];
+
+	for (unsigned int i = 0; i < batchedVertices; i += 4)
+	{
+		__m128 nx, ny, nz, tx, ty, tz;
+		LoadLanes(streams.normals, i, nx, ny, nz);
+		LoadLanes(streams.tangents, i, tx, ty, tz);
+		__m128i negative = _mm_castps_si128(_mm_cmplt_ps(
+			LoadHandedness(streams.tangents, i), _mm_setzero_ps()));
+
+		__m128i encodedTangents = _mm_andnot_si128(
+			_mm_set1_epi32(TANGENT_SIGN_BIT), EncodeOctahedral4(tx, ty, tz));
+		encodedTangents = _mm_or_si128(encodedTangents,
+			_mm_and_si128(negative, _mm_set1_epi32(TANGENT_SIGN_BIT)));
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(normals),
+			EncodeOctahedral4(nx, ny, nz));
+		_mm_store_si128(reinterpret_cast<__m128i*>(tangents), encodedTangents);
+
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			toFill[i + lane].normal = normals[lane];
+			toFill[i + lane].tangent = tangents[lane];
+		}
+	}
+
+	for (unsigned int i = batchedVertices; i < streams.nrOfVertices; ++i)
+		QuantizeVertex(streams, i, toFill[i]);
+
+	if (streams.uvs == nullptr || toFill.empty())
+	{
+		for (auto& vertex : toFill)
+			vertex.uv = 0;
+
+		return;
+	}
+
+	// u and v are written straight into the low and high half of each uv
+	HALF* uvOutput = reinterpret_cast<HALF*>(&toFill[0].uv);
+	XMConvertFloatToHalfStream(uvOutput, sizeof(QuantizedVertexAttributes),
+		&streams.uvs[0].x, sizeof(XMFLOAT2), streams.nrOfVertices);
+	XMConvertFloatToHalfStream(uvOutput + 1, sizeof(QuantizedVertexAttributes),
+		&streams.uvs[0].y, sizeof(XMFLOAT2), streams.nrOfVertices);
+}
+
+void QuantizeVertexAttributesScalar(const SubMeshStreams& streams,
+	std::vector<QuantizedVertexAttributes>& toFill)
+{
+	toFill.resize(streams.nrOfVertices);
+
+	for (unsigned int i = 0; i < streams.nrOfVertices; ++i)
+		QuantizeVertex(streams, i, toFill[i]);
+}
+
+QuantizationError MeasureQuantizationError(const SubMeshStreams& streams,
+	const std::vector<QuantizedVertexAttributes>& quantized)
+{
+	QuantizationError toReturn;
+	if (quantized.size() != streams.nrOfVertices)
+	{
+		toReturn.withinBounds = false;
+		return toReturn;
+	}
+
+	for (unsigned int i = 0; i < streams.nrOfVertices; ++i)
+	{
+		XMFLOAT3 normal = GetOrZero(streams.normals, i);
+		XMFLOAT4 tangent = GetOrZero(streams.tangents, i);
+		const QuantizedVertexAttributes& vertex = quantized[i];
+
+		if (!IsZero(normal))
+		{
+			toReturn.maxNormalError = std::max(toReturn.maxNormalError,
+				MaxComponentError(normal, DecodeOctahedral(vertex.normal)));
+		}
+
+		XMFLOAT4 decodedTangent = DecodeTangent(vertex.tangent);
+		if (!IsZero(GetDirection(tangent)))
+		{
+			toReturn.maxTangentError = std::max(toReturn.maxTangentError,
+				MaxComponentError(GetDirection(tangent),
+					GetDirection(decodedTangent)));
+		}
+
+		if ((decodedTangent.w < 0.0f) != (tangent.w < 0.0f))
+			++toReturn.handednessMismatches;
+
+		if (streams.uvs != nullptr)
+		{
+			XMFLOAT2 decodedUV = DecodeUV(vertex.uv);
+			toReturn.maxUVRelativeError = std::max(toReturn.maxUVRelativeError,
+				std::max(RelativeError(streams.uvs[i].x, decodedUV.x),
+					RelativeError(streams.uvs[i].y, decodedUV.y)));
+		}
+	}
+
+	toReturn.withinBounds = toReturn.maxNormalError <= MAX_OCTAHEDRAL_ERROR &&
+		toReturn.maxTangentError <= MAX_TANGENT_ERROR &&
+		toReturn.maxUVRelativeError <= MAX_HALF_RELATIVE_ERROR &&
+		toReturn.handednessMismatches == 0;
+
+	return toReturn;
+}
\ No newline at end of file
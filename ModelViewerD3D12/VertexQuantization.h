@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+#include "SubMeshData.h"
+
+// Attributes of one vertex in the quantized layout, must match the decoding
+// in ModelQuantizedVS.hlsl. Normal and tangent are octahedral encoded as two
+// 16 bit snorm values, x in the low and y in the high half. The lowest bit of
+// the tangent y value holds the tangent handedness, set meaning negative. The
+// uv is stored as two half floats, u in the low and v in the high half.
+struct QuantizedVertexAttributes
+{
+	std::uint32_t normal;
+	std::uint32_t tangent;
+	std::uint32_t uv;
+};
+
+// Largest difference per component between a unit vector and its decoded
+// octahedral encoding, the tangent bound is looser as it loses one bit to the
+// handedness. Half float uvs are bounded by their relative rounding error.
+const float MAX_OCTAHEDRAL_ERROR = 1.0e-4f;
+const float MAX_TANGENT_ERROR = 2.0e-4f;
+const float MAX_HALF_RELATIVE_ERROR = 1.0f / 2048.0f;
+
+std::uint32_t EncodeOctahedral(const DirectX::XMFLOAT3& direction);
+DirectX::XMFLOAT3 DecodeOctahedral(std::uint32_t encoded);
+
+// The handedness is taken from the sign of w and decoded as 1 or -1
+std::uint32_t EncodeTangent(const DirectX::XMFLOAT4& tangent);
+DirectX::XMFLOAT4 DecodeTangent(std::uint32_t encoded);
+
+std::uint32_t EncodeUV(const DirectX::XMFLOAT2& uv);
+DirectX::XMFLOAT2 DecodeUV(std::uint32_t encoded);
+
+// Encodes every vertex of the sub mesh, four vertices at a time with SSE.
+// Absent streams are encoded as zero, which decodes to +Z for directions.
+void QuantizeVertexAttributes(const SubMeshStreams& streams,
+	std::vector<QuantizedVertexAttributes>& toFill);
+
+// One vertex at a time reference of QuantizeVertexAttributes
+void QuantizeVertexAttributesScalar(const SubMeshStreams& streams,
+	std::vector<QuantizedVertexAttributes>& toFill);
+
+struct QuantizationError
+{
+	float maxNormalError = 0.0f;
+	float maxTangentError = 0.0f;
+	float maxUVRelativeError = 0.0f;
+	size_t handednessMismatches = 0;
+	bool withinBounds = true;
+};
+
+// Decodes the quantized data and compares it against the source streams
+QuantizationError MeasureQuantizationError(const SubMeshStreams& streams,
+	const std::vector<QuantizedVertexAttributes>& quantized);
\ No newline at end of file
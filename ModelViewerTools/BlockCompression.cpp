@@ -0,0 +1,901 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include <immintrin.h>
+
+#include "ParallelFor.h"
+
+namespace
+{
+	const unsigned int BLOCK_TEXELS = 16;
+
+	// Weights of the 4 bit indices of BC7, out of 64
+	const std::uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34,
+		38, 43, 47, 51, 55, 60, 64 };
+
+	// The texels of a block as BYTE RGBA in row order
+	struct Block
+	{
+		unsigned char texels[BLOCK_TEXELS * 4];
+	};
+
+	// Blocks are written and read as a little endian stream of bits
+	class BlockBits
+	{
+	private:
+		std::uint64_t bits[2] = {};
+		unsigned int position = 0;
+
+	public:
+		BlockBits() = default;
+
+		explicit BlockBits(const unsigned char* source)
+		{
+			memcpy(bits, source, sizeof(bits));
+		}
+
+		void Write(std::uint32_t value, unsigned int nrOfBits)
+		{
+			for (unsigned int i = 0; i < nrOfBits; ++i, ++position)
+			{
+				std::uint64_t bit = (value >> i) & 1;
+				bits[position / 64] |= bit << (position % 64);
+			}
+		}
+
+		std::uint32_t Read(unsigned int nrOfBits)
+		{
+			std::uint32_t toReturn = 0;
+			for (unsigned int i = 0; i < nrOfBits; ++i, ++position)
+			{
+				std::uint64_t bit = (bits[position / 64] >> (position % 64)) & 1;
+				toReturn |= static_cast<std::uint32_t>(bit) << i;
+			}
+
+			return toReturn;
+		}
+
+		void Store(unsigned char* toFill) const
+		{
+			memcpy(toFill, bits, sizeof(bits));
+		}
+	};
+
+	void LoadBlock(const unsigned char* source, unsigned int width,
+		unsigned int height, unsigned int blockX, unsigned int blockY,
+		Block& toFill)
+	{
+		for (unsigned int y = 0; y < 4; ++y)
+		{
+			size_t sourceY = std::min(blockY * 4 + y, height - 1);
+			for (unsigned int x = 0; x < 4; ++x)
+			{
+				size_t sourceX = std::min(blockX * 4 + x, width - 1);
+				memcpy(toFill.texels + (y * 4 + x) * 4,
+					source + (sourceY * width + sourceX) * 4, 4);
+			}
+		}
+	}
+
+	// Picks the palette entry closest to every texel by squared RGBA distance,
+	// the first one on ties, and returns the summed error of the block
+	std::uint32_t SelectColourIndicesScalar(const unsigned char* texels,
+		const unsigned char* palette, unsigned int paletteSize,
+		std::uint8_t* indices)
+	{
+		std::uint32_t toReturn = 0;
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			std::int32_t bestError = std::numeric_limits<std::int32_t>::max();
+			for (unsigned int entry = 0; entry < paletteSize; ++entry)
+			{
+				std::int32_t error = 0;
+				for (unsigned int component = 0; component < 4; ++component)
+				{
+					std::int32_t difference = texels[i * 4 + component] -
+						palette[entry * 4 + component];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					indices[i] = static_cast<std::uint8_t>(entry);
+				}
+			}
+
+			toReturn += bestError;
+		}
+
+		return toReturn;
+	}
+
+	// Four texels at a time, widened to 16 bits so madd squares and pairs up
+	// the components. The errors are exact, so the choices match the scalar.
+	std::uint32_t SelectColourIndicesSSE(const unsigned char* texels,
+		const unsigned char* palette, unsigned int paletteSize,
+		std::uint8_t* indices)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		std::uint32_t toReturn = 0;
+		for (unsigned int group = 0; group < BLOCK_TEXELS / 4; ++group)
+		{
+			__m128i texels8 = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(texels + group * 16));
+			__m128i low = _mm_unpacklo_epi8(texels8, zero); // Texels 0 and 1
+			__m128i high = _mm_unpackhi_epi8(texels8, zero); // Texels 2 and 3
+			__m128i bestError = _mm_set1_epi32(std::numeric_limits<std::int32_t>::max());
+			__m128i bestIndex = zero;
+
+			for (unsigned int entry = 0; entry < paletteSize; ++entry)
+			{
+				std::int32_t packedEntry = 0;
+				memcpy(&packedEntry, palette + entry * 4, 4);
+				__m128i entry16 = _mm_unpacklo_epi8(_mm_set1_epi32(packedEntry), zero);
+
+				__m128i lowDifference = _mm_sub_epi16(low, entry16);
+				__m128i highDifference = _mm_sub_epi16(high, entry16);
+				__m128 lowSquares = _mm_castsi128_ps(
+					_mm_madd_epi16(lowDifference, lowDifference)); // rg ba rg ba
+				__m128 highSquares = _mm_castsi128_ps(
+					_mm_madd_epi16(highDifference, highDifference));
+				__m128i error = _mm_add_epi32(
+					_mm_castps_si128(_mm_shuffle_ps(lowSquares, highSquares,
+						_MM_SHUFFLE(2, 0, 2, 0))),
+					_mm_castps_si128(_mm_shuffle_ps(lowSquares, highSquares,
+						_MM_SHUFFLE(3, 1, 3, 1))));
+
+				__m128i closer = _mm_cmplt_epi32(error, bestError);
+				bestError = _mm_or_si128(_mm_and_si128(closer, error),
+					_mm_andnot_si128(closer, bestError));
+				bestIndex = _mm_or_si128(_mm_and_si128(closer,
+					_mm_set1_epi32(static_cast<int>(entry))),
+					_mm_andnot_si128(closer, bestIndex));
+			}
+
+			alignas(16) std::int32_t errors[4];
+			alignas(16) std::int32_t chosen[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(errors), bestError);
+			_mm_store_si128(reinterpret_cast<__m128i*>(chosen), bestIndex);
+			for (unsigned int i = 0; i < 4; ++i)
+			{
+				indices[group * 4 + i] = static_cast<std::uint8_t>(chosen[i]);
+				toReturn += errors[i];
+			}
+		}
+
+		return toReturn;
+	}
+
+	std::uint32_t SelectColourIndices(const unsigned char* texels,
+		const unsigned char* palette, unsigned int paletteSize,
+		std::uint8_t* indices, InstructionSet instructionSet)
+	{
+		if (instructionSet == InstructionSet::SCALAR)
+			return SelectColourIndicesScalar(texels, palette, paletteSize, indices);
+
+		return SelectColourIndicesSSE(texels, palette, paletteSize, indices);
+	}
+
+	// Same as the colour selection for the 8 entry palettes of single channel
+	// blocks, the closest entry by absolute difference
+	void SelectChannelIndicesScalar(const unsigned char* values,
+		const unsigned char* palette, std::uint8_t* indices)
+	{
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			int bestDifference = std::numeric_limits<int>::max();
+			for (unsigned int entry = 0; entry < 8; ++entry)
+			{
+				int difference = std::abs(values[i] - palette[entry]);
+				if (difference < bestDifference)
+				{
+					bestDifference = difference;
+					indices[i] = static_cast<std::uint8_t>(entry);
+				}
+			}
+		}
+	}
+
+	void SelectChannelIndicesSSE(const unsigned char* values,
+		const unsigned char* palette, std::uint8_t* indices)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i values8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+		__m128i halves[2] = { _mm_unpacklo_epi8(values8, zero),
+			_mm_unpackhi_epi8(values8, zero) };
+
+		for (unsigned int half = 0; half < 2; ++half)
+		{
+			__m128i bestDifference = _mm_set1_epi16(std::numeric_limits<std::int16_t>::max());
+			__m128i bestIndex = zero;
+			for (unsigned int entry = 0; entry < 8; ++entry)
+			{
+				__m128i difference = _mm_sub_epi16(halves[half],
+					_mm_set1_epi16(palette[entry]));
+				difference = _mm_max_epi16(difference,
+					_mm_sub_epi16(zero, difference));
+
+				__m128i closer = _mm_cmplt_epi16(difference, bestDifference);
+				bestDifference = _mm_min_epi16(difference, bestDifference);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer,
+					_mm_set1_epi16(static_cast<short>(entry))),
+					_mm_andnot_si128(closer, bestIndex));
+			}
+
+			alignas(16) std::int16_t chosen[8];
+			_mm_store_si128(reinterpret_cast<__m128i*>(chosen), bestIndex);
+			for (unsigned int i = 0; i < 8; ++i)
+				indices[half * 8 + i] = static_cast<std::uint8_t>(chosen[i]);
+		}
+	}
+
+	// Principal axis of the first nrOfChannels channels of the texels, by power
+	// iteration on their covariance. The axis is left at 0 for flat blocks.
+	void FindPrincipalAxis(const unsigned char* texels, unsigned int nrOfChannels,
+		float* mean, float* axis)
+	{
+		float minimum[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+		float maximum[4] = {};
+		for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+		{
+			mean[channel] = 0.0f;
+			for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			{
+				float value = texels[i * 4 + channel];
+				mean[channel] += value;
+				minimum[channel] = std::min(minimum[channel], value);
+				maximum[channel] = std::max(maximum[channel], value);
+			}
+
+			mean[channel] /= BLOCK_TEXELS;
+			axis[channel] = maximum[channel] - minimum[channel];
+		}
+
+		float covariance[4][4] = {};
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			for (unsigned int row = 0; row < nrOfChannels; ++row)
+			{
+				float rowValue = texels[i * 4 + row] - mean[row];
+				for (unsigned int column = 0; column < nrOfChannels; ++column)
+					covariance[row][column] += rowValue * (texels[i * 4 + column] - mean[column]);
+			}
+		}
+
+		for (unsigned int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (unsigned int row = 0; row < nrOfChannels; ++row)
+			{
+				for (unsigned int column = 0; column < nrOfChannels; ++column)
+					next[row] += covariance[row][column] * axis[column];
+
+				largest = std::max(largest, std::abs(next[row]));
+			}
+
+			if (largest == 0.0f)
+				break;
+
+			for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+				axis[channel] = next[channel] / largest;
+		}
+	}
+
+	// The extremes of the texels projected on the principal axis, clamped to
+	// the range of a byte. Start is the lower end along the axis.
+	void FindEndpoints(const unsigned char* texels, unsigned int nrOfChannels,
+		float* start, float* end)
+	{
+		float mean[4];
+		float axis[4];
+		FindPrincipalAxis(texels, nrOfChannels, mean, axis);
+
+		float lengthSquared = 0.0f;
+		for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+			lengthSquared += axis[channel] * axis[channel];
+
+		float lowest = 0.0f;
+		float highest = 0.0f;
+		if (lengthSquared > 0.0f)
+		{
+			lowest = std::numeric_limits<float>::max();
+			highest = -std::numeric_limits<float>::max();
+			for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			{
+				float projection = 0.0f;
+				for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+					projection += (texels[i * 4 + channel] - mean[channel]) * axis[channel];
+
+				lowest = std::min(lowest, projection / lengthSquared);
+				highest = std::max(highest, projection / lengthSquared);
+			}
+		}
+
+		for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+		{
+			start[channel] = std::min(std::max(mean[channel] + axis[channel] * lowest, 0.0f), 255.0f);
+			end[channel] = std::min(std::max(mean[channel] + axis[channel] * highest, 0.0f), 255.0f);
+		}
+	}
+
+	std::uint16_t PackRGB565(const float* colour)
+	{
+		auto quantize = [](float value, float maximum)
+		{
+			return static_cast<std::uint16_t>(std::min(std::max(
+				std::floor(value * maximum / 255.0f + 0.5f), 0.0f), maximum));
+		};
+
+		return static_cast<std::uint16_t>((quantize(colour[0], 31.0f) << 11) |
+			(quantize(colour[1], 63.0f) << 5) | quantize(colour[2], 31.0f));
+	}
+
+	void UnpackRGB565(std::uint16_t packed, unsigned char* toFill)
+	{
+		unsigned int red = (packed >> 11) & 31;
+		unsigned int green = (packed >> 5) & 63;
+		unsigned int blue = packed & 31;
+		toFill[0] = static_cast<unsigned char>((red << 3) | (red >> 2));
+		toFill[1] = static_cast<unsigned char>((green << 2) | (green >> 4));
+		toFill[2] = static_cast<unsigned char>((blue << 3) | (blue >> 2));
+	}
+
+	// The palette of the four colour mode, alpha is left at 0 to match the
+	// texels the colour indices are selected for
+	void BuildColourPalette(std::uint16_t colour0, std::uint16_t colour1,
+		unsigned char* toFill)
+	{
+		memset(toFill, 0, 16);
+		UnpackRGB565(colour0, toFill);
+		UnpackRGB565(colour1, toFill + 4);
+		for (unsigned int channel = 0; channel < 3; ++channel)
+		{
+			unsigned int first = toFill[channel];
+			unsigned int second = toFill[4 + channel];
+			toFill[8 + channel] = static_cast<unsigned char>((2 * first + second) / 3);
+			toFill[12 + channel] = static_cast<unsigned char>((first + 2 * second) / 3);
+		}
+	}
+
+	std::uint32_t SelectColourEndpointIndices(const unsigned char* texels,
+		std::uint16_t colour0, std::uint16_t colour1, std::uint8_t* indices,
+		InstructionSet instructionSet)
+	{
+		unsigned char palette[16];
+		BuildColourPalette(colour0, colour1, palette);
+		return SelectColourIndices(texels, palette, 4, indices, instructionSet);
+	}
+
+	// Least squares endpoints for the chosen indices, false if the indices do
+	// not determine two endpoints
+	bool RefineColourEndpoints(const unsigned char* texels,
+		const std::uint8_t* indices, std::uint16_t& colour0,
+		std::uint16_t& colour1)
+	{
+		const float FIRST_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float firstFirst = 0.0f;
+		float firstSecond = 0.0f;
+		float secondSecond = 0.0f;
+		float firstSums[3] = {};
+		float secondSums[3] = {};
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			float first = FIRST_WEIGHTS[indices[i]];
+			float second = 1.0f - first;
+			firstFirst += first * first;
+			firstSecond += first * second;
+			secondSecond += second * second;
+			for (unsigned int channel = 0; channel < 3; ++channel)
+			{
+				firstSums[channel] += first * texels[i * 4 + channel];
+				secondSums[channel] += second * texels[i * 4 + channel];
+			}
+		}
+
+		float determinant = firstFirst * secondSecond - firstSecond * firstSecond;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		float first[3];
+		float second[3];
+		for (unsigned int channel = 0; channel < 3; ++channel)
+		{
+			first[channel] = (firstSums[channel] * secondSecond -
+				secondSums[channel] * firstSecond) / determinant;
+			second[channel] = (secondSums[channel] * firstFirst -
+				firstSums[channel] * firstSecond) / determinant;
+		}
+
+		colour0 = PackRGB565(first);
+		colour1 = PackRGB565(second);
+		return true;
+	}
+
+	// The RGB part of BC1 and BC3 blocks. Colour 0 is kept above colour 1 so
+	// BC1 decodes the block in four colour mode, equal colours only use index 0.
+	void EncodeColourBlock(const Block& block, InstructionSet instructionSet,
+		unsigned char* toFill)
+	{
+		unsigned char texels[BLOCK_TEXELS * 4];
+		memcpy(texels, block.texels, sizeof(texels));
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			texels[i * 4 + 3] = 0;
+
+		float start[3];
+		float end[3];
+		FindEndpoints(texels, 3, start, end);
+		std::uint16_t colour0 = PackRGB565(end);
+		std::uint16_t colour1 = PackRGB565(start);
+		std::uint8_t indices[BLOCK_TEXELS];
+		std::uint32_t error = SelectColourEndpointIndices(texels, colour0,
+			colour1, indices, instructionSet);
+
+		std::uint16_t refined0 = colour0;
+		std::uint16_t refined1 = colour1;
+		std::uint8_t refinedIndices[BLOCK_TEXELS];
+		if (error > 0 && RefineColourEndpoints(texels, indices, refined0, refined1) &&
+			SelectColourEndpointIndices(texels, refined0, refined1, refinedIndices,
+				instructionSet) < error)
+		{
+			colour0 = refined0;
+			colour1 = refined1;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+
+		if (colour0 < colour1)
+		{
+			std::swap(colour0, colour1);
+			for (auto& index : indices)
+				index ^= 1; // 0 and 1 swap, as do 2 and 3
+		}
+		else if (colour0 == colour1)
+		{
+			memset(indices, 0, sizeof(indices));
+		}
+
+		std::uint32_t packedIndices = 0;
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			packedIndices |= static_cast<std::uint32_t>(indices[i]) << (i * 2);
+
+		memcpy(toFill, &colour0, 2);
+		memcpy(toFill + 2, &colour1, 2);
+		memcpy(toFill + 4, &packedIndices, 4);
+	}
+
+	void BuildChannelPalette(unsigned char first, unsigned char second,
+		unsigned char* toFill)
+	{
+		toFill[0] = first;
+		toFill[1] = second;
+		if (first > second)
+		{
+			for (unsigned int i = 2; i < 8; ++i)
+				toFill[i] = static_cast<unsigned char>(((8 - i) * first + (i - 1) * second + 3) / 7);
+		}
+		else
+		{
+			for (unsigned int i = 2; i < 6; ++i)
+				toFill[i] = static_cast<unsigned char>(((6 - i) * first + (i - 1) * second + 2) / 5);
+			toFill[6] = 0;
+			toFill[7] = 255;
+		}
+	}
+
+	// The alpha part of BC3 blocks and the blocks of BC4 and BC5, always in the
+	// eight value mode unless the whole block has one value
+	void EncodeChannelBlock(const Block& block, unsigned int channel,
+		InstructionSet instructionSet, unsigned char* toFill)
+	{
+		unsigned char values[BLOCK_TEXELS];
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			values[i] = block.texels[i * 4 + channel];
+
+		unsigned char minimum = *std::min_element(values, values + BLOCK_TEXELS);
+		unsigned char maximum = *std::max_element(values, values + BLOCK_TEXELS);
+		std::uint8_t indices[BLOCK_TEXELS] = {};
+		if (minimum != maximum)
+		{
+			unsigned char palette[8];
+			BuildChannelPalette(maximum, minimum, palette);
+			if (instructionSet == InstructionSet::SCALAR)
+				SelectChannelIndicesScalar(values, palette, indices);
+			else
+				SelectChannelIndicesSSE(values, palette, indices);
+		}
+
+		std::uint64_t packedIndices = 0;
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			packedIndices |= static_cast<std::uint64_t>(indices[i]) << (i * 3);
+
+		toFill[0] = maximum;
+		toFill[1] = minimum;
+		memcpy(toFill + 2, &packedIndices, 6);
+	}
+
+	void QuantizeBC7Endpoint(const float* endpoint, std::uint32_t pBit,
+		std::uint32_t* quantized, unsigned char* expanded)
+	{
+		for (unsigned int channel = 0; channel < 4; ++channel)
+		{
+			float value = std::floor((endpoint[channel] - pBit) / 2.0f + 0.5f);
+			quantized[channel] = static_cast<std::uint32_t>(
+				std::min(std::max(value, 0.0f), 127.0f));
+			expanded[channel] = static_cast<unsigned char>(
+				(quantized[channel] << 1) | pBit);
+		}
+	}
+
+	void BuildBC7Palette(const unsigned char* first, const unsigned char* second,
+		unsigned char* toFill)
+	{
+		for (unsigned int entry = 0; entry < 16; ++entry)
+		{
+			for (unsigned int channel = 0; channel < 4; ++channel)
+			{
+				toFill[entry * 4 + channel] = static_cast<unsigned char>(
+					((64 - BC7_WEIGHTS[entry]) * first[channel] +
+						BC7_WEIGHTS[entry] * second[channel] + 32) >> 6);
+			}
+		}
+	}
+
+	// Mode 6 with the combination of p bits that gives the lowest error
+	void EncodeBC7Block(const Block& block, InstructionSet instructionSet,
+		unsigned char* toFill)
+	{
+		float start[4];
+		float end[4];
+		FindEndpoints(block.texels, 4, start, end);
+
+		std::uint32_t bestError = std::numeric_limits<std::uint32_t>::max();
+		std::uint32_t endpoints[2][4] = {};
+		std::uint32_t pBits[2] = {};
+		std::uint8_t indices[BLOCK_TEXELS] = {};
+		for (std::uint32_t combination = 0; combination < 4; ++combination)
+		{
+			std::uint32_t quantized[2][4];
+			unsigned char expanded[2][4];
+			QuantizeBC7Endpoint(start, combination & 1, quantized[0], expanded[0]);
+			QuantizeBC7Endpoint(end, combination >> 1, quantized[1], expanded[1]);
+
+			unsigned char palette[16 * 4];
+			std::uint8_t candidateIndices[BLOCK_TEXELS];
+			BuildBC7Palette(expanded[0], expanded[1], palette);
+			std::uint32_t error = SelectColourIndices(block.texels, palette, 16,
+				candidateIndices, instructionSet);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(endpoints, quantized, sizeof(endpoints));
+				pBits[0] = combination & 1;
+				pBits[1] = combination >> 1;
+				memcpy(indices, candidateIndices, sizeof(indices));
+			}
+		}
+
+		// The top bit of the first index is implied to be 0, the weights are
+		// symmetric so swapping the endpoints and mirroring the indices decodes
+		// to the same texels
+		if (indices[0] & 8)
+		{
+			std::swap(endpoints[0], endpoints[1]);
+			std::swap(pBits[0], pBits[1]);
+			for (auto& index : indices)
+				index = static_cast<std::uint8_t>(15 - index);
+		}
+
+		BlockBits bits;
+		bits.Write(1 << 6, 7);
+		for (unsigned int channel = 0; channel < 4; ++channel)
+		{
+			bits.Write(endpoints[0][channel], 7);
+			bits.Write(endpoints[1][channel], 7);
+		}
+
+		bits.Write(pBits[0], 1);
+		bits.Write(pBits[1], 1);
+		bits.Write(indices[0], 3);
+		for (unsigned int i = 1; i < BLOCK_TEXELS; ++i)
+			bits.Write(indices[i], 4);
+
+		bits.Store(toFill);
+	}
+
+	void EncodeBlock(const Block& block, BlockFormat format,
+		InstructionSet instructionSet, unsigned char* toFill)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			EncodeColourBlock(block, instructionSet, toFill);
+			break;
+		case BlockFormat::BC3:
+			EncodeChannelBlock(block, 3, instructionSet, toFill);
+			EncodeColourBlock(block, instructionSet, toFill + 8);
+			break;
+		case BlockFormat::BC4:
+			EncodeChannelBlock(block, 0, instructionSet, toFill);
+			break;
+		case BlockFormat::BC5:
+			EncodeChannelBlock(block, 0, instructionSet, toFill);
+			EncodeChannelBlock(block, 1, instructionSet, toFill + 8);
+			break;
+		case BlockFormat::BC7:
+			EncodeBC7Block(block, instructionSet, toFill);
+			break;
+		}
+	}
+
+	// BC3 colour is always in the four colour mode, only BC1 has the three
+	// colour mode with transparent black
+	void DecodeColourBlock(const unsigned char* source, bool allowThreeColours,
+		Block& toFill)
+	{
+		std::uint16_t colour0 = 0;
+		std::uint16_t colour1 = 0;
+		std::uint32_t packedIndices = 0;
+		memcpy(&colour0, source, 2);
+		memcpy(&colour1, source + 2, 2);
+		memcpy(&packedIndices, source + 4, 4);
+
+		unsigned char palette[16];
+		BuildColourPalette(colour0, colour1, palette);
+		for (unsigned int entry = 0; entry < 4; ++entry)
+			palette[entry * 4 + 3] = 255;
+
+		if (allowThreeColours && colour0 <= colour1)
+		{
+			for (unsigned int channel = 0; channel < 3; ++channel)
+			{
+				palette[8 + channel] = static_cast<unsigned char>(
+					(palette[channel] + palette[4 + channel]) / 2);
+			}
+
+			memset(palette + 12, 0, 4);
+		}
+
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			memcpy(toFill.texels + i * 4, palette + ((packedIndices >> (i * 2)) & 3) * 4, 4);
+	}
+
+	void DecodeChannelBlock(const unsigned char* source, unsigned int channel,
+		Block& toFill)
+	{
+		unsigned char palette[8];
+		BuildChannelPalette(source[0], source[1], palette);
+		std::uint64_t packedIndices = 0;
+		memcpy(&packedIndices, source + 2, 6);
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			toFill.texels[i * 4 + channel] = palette[(packedIndices >> (i * 3)) & 7];
+	}
+
+	// Only mode 6 is decoded, as that is the only mode CompressTexture writes,
+	// blocks of other modes decode to 0 like reserved modes do on the GPU
+	void DecodeBC7Block(const unsigned char* source, Block& toFill)
+	{
+		memset(toFill.texels, 0, sizeof(toFill.texels));
+		BlockBits bits(source);
+		if (bits.Read(7) != (1 << 6))
+			return;
+
+		unsigned char endpoints[2][4];
+		std::uint32_t quantized[2][4];
+		for (unsigned int channel = 0; channel < 4; ++channel)
+		{
+			quantized[0][channel] = bits.Read(7);
+			quantized[1][channel] = bits.Read(7);
+		}
+
+		std::uint32_t pBits[2] = { bits.Read(1), bits.Read(1) };
+		for (unsigned int endpoint = 0; endpoint < 2; ++endpoint)
+		{
+			for (unsigned int channel = 0; channel < 4; ++channel)
+			{
+				endpoints[endpoint][channel] = static_cast<unsigned char>(
+					(quantized[endpoint][channel] << 1) | pBits[endpoint]);
+			}
+		}
+
+		unsigned char palette[16 * 4];
+		BuildBC7Palette(endpoints[0], endpoints[1], palette);
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			std::uint32_t index = bits.Read(i == 0 ? 3 : 4);
+			memcpy(toFill.texels + i * 4, palette + index * 4, 4);
+		}
+	}
+
+	// Black and opaque, for the channels single and two channel formats lack
+	void ClearBlock(Block& toFill)
+	{
+		memset(toFill.texels, 0, sizeof(toFill.texels));
+		for (unsigned int i = 0; i < BLOCK_TEXELS; ++i)
+			toFill.texels[i * 4 + 3] = 255;
+	}
+
+	void DecodeBlock(const unsigned char* source, BlockFormat format,
+		Block& toFill)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			DecodeColourBlock(source, true, toFill);
+			break;
+		case BlockFormat::BC3:
+			DecodeColourBlock(source + 8, false, toFill);
+			DecodeChannelBlock(source, 3, toFill);
+			break;
+		case BlockFormat::BC4:
+			ClearBlock(toFill);
+			DecodeChannelBlock(source, 0, toFill);
+			break;
+		case BlockFormat::BC5:
+			ClearBlock(toFill);
+			DecodeChannelBlock(source, 0, toFill);
+			DecodeChannelBlock(source + 8, 1, toFill);
+			break;
+		case BlockFormat::BC7:
+			DecodeBC7Block(source, toFill);
+			break;
+		}
+	}
+
+	unsigned int GetNrOfStoredChannels(BlockFormat format)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			return 3;
+		case BlockFormat::BC4:
+			return 1;
+		case BlockFormat::BC5:
+			return 2;
+		default:
+			return 4;
+		}
+	}
+}
+
+const char* GetBlockFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1:
+		return "BC1";
+	case BlockFormat::BC3:
+		return "BC3";
+	case BlockFormat::BC4:
+		return "BC4";
+	case BlockFormat::BC5:
+		return "BC5";
+	case BlockFormat::BC7:
+		return "BC7";
+	}
+
+	return "unknown";
+}
+
+DXGI_FORMAT GetDXGIFormat(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1:
+		return DXGI_FORMAT_BC1_UNORM;
+	case BlockFormat::BC3:
+		return DXGI_FORMAT_BC3_UNORM;
+	case BlockFormat::BC4:
+		return DXGI_FORMAT_BC4_UNORM;
+	case BlockFormat::BC5:
+		return DXGI_FORMAT_BC5_UNORM;
+	case BlockFormat::BC7:
+		return DXGI_FORMAT_BC7_UNORM;
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+unsigned int GetBlockByteSize(BlockFormat format)
+{
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t GetCompressedByteSize(unsigned int width, unsigned int height,
+	BlockFormat format)
+{
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) *
+		GetBlockByteSize(format);
+}
+
+bool IsOpaque(const unsigned char* source, size_t nrOfTexels)
+{
+	for (size_t i = 0; i < nrOfTexels; ++i)
+	{
+		if (source[i * 4 + 3] != 255)
+			return false;
+	}
+
+	return true;
+}
+
+void CompressTexture(const unsigned char* source, unsigned int width,
+	unsigned int height, BlockFormat format, unsigned char* toFill,
+	unsigned int nrOfThreads, InstructionSet instructionSet)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	if (nrOfThreads == 0)
+		nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	unsigned int blocksPerRow = (width + 3) / 4;
+	unsigned int blockRows = (height + 3) / 4;
+	unsigned int blockSize = GetBlockByteSize(format);
+	ParallelFor(blockRows, nrOfThreads, [&](size_t blockY)
+		{
+			Block block;
+			unsigned char* destination = toFill + blockY * blocksPerRow * blockSize;
+			for (unsigned int blockX = 0; blockX < blocksPerRow; ++blockX)
+			{
+				LoadBlock(source, width, height, blockX,
+					static_cast<unsigned int>(blockY), block);
+				EncodeBlock(block, format, instructionSet,
+					destination + blockX * blockSize);
+			}
+		});
+}
+
+void DecompressTexture(const unsigned char* source, unsigned int width,
+	unsigned int height, BlockFormat format, unsigned char* toFill)
+{
+	unsigned int blocksPerRow = (width + 3) / 4;
+	unsigned int blockSize = GetBlockByteSize(format);
+	for (unsigned int blockY = 0; blockY * 4 < height; ++blockY)
+	{
+		for (unsigned int blockX = 0; blockX < blocksPerRow; ++blockX)
+		{
+			Block block;
+			DecodeBlock(source + (static_cast<size_t>(blockY) * blocksPerRow +
+				blockX) * blockSize, format, block);
+
+			unsigned int rows = std::min(4u, height - blockY * 4);
+			unsigned int columns = std::min(4u, width - blockX * 4);
+			for (unsigned int y = 0; y < rows; ++y)
+			{
+				size_t texel = static_cast<size_t>(blockY * 4 + y) * width +
+					blockX * 4;
+				memcpy(toFill + texel * 4, block.texels + y * 16, columns * 4);
+			}
+		}
+	}
+}
+
+double CalculatePSNR(const unsigned char* reference,
+	const unsigned char* decompressed, unsigned int width, unsigned int height,
+	BlockFormat format)
+{
+	unsigned int nrOfChannels = GetNrOfStoredChannels(format);
+	size_t nrOfTexels = static_cast<size_t>(width) * height;
+	double squaredError = 0.0;
+	for (size_t i = 0; i < nrOfTexels; ++i)
+	{
+		for (unsigned int channel = 0; channel < nrOfChannels; ++channel)
+		{
+			double difference = static_cast<double>(reference[i * 4 + channel]) -
+				decompressed[i * 4 + channel];
+			squaredError += difference * difference;
+		}
+	}
+
+	if (squaredError == 0.0 || nrOfTexels == 0)
+		return std::numeric_limits<double>::infinity();
+
+	double meanSquaredError = squaredError / (nrOfTexels * nrOfChannels);
+	return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
\ No newline at end of file
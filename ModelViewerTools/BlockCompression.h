@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Windows.h>
+#include <dxgiformat.h>
+
+#include "VertexConversion.h"
+
+// Only used by the -bcreport and -bcbenchmark tools. Uploading the blocks is
+// out of scope for the viewer, the texture components of the core only take
+// uncompressed uploads, so material maps stay uncompressed on the GPU.
+
+// BC1 stores opaque RGB, BC3 and BC7 RGBA, BC4 the red channel and BC5 the
+// red and green channels. Only mode 6 of BC7 is encoded, one subset with RGBA
+// endpoints and 4 bit indices, which covers alpha tested material maps well.
+enum class BlockFormat
+{
+	BC1,
+	BC3,
+	BC4,
+	BC5,
+	BC7
+};
+
+const char* GetBlockFormatName(BlockFormat format);
+DXGI_FORMAT GetDXGIFormat(BlockFormat format);
+unsigned int GetBlockByteSize(BlockFormat format); // Of one 4x4 block
+size_t GetCompressedByteSize(unsigned int width, unsigned int height,
+	BlockFormat format);
+
+// True if every texel of the BYTE RGBA data has an alpha of 255
+bool IsOpaque(const unsigned char* source, size_t nrOfTexels);
+
+// Encodes BYTE RGBA texels into 4x4 blocks, toFill has to have room for
+// GetCompressedByteSize bytes. Blocks at the right and bottom edges of sizes
+// that are not multiples of 4 repeat the last column and row. The rows of
+// blocks are split between up to nrOfThreads threads, 0 uses one per hardware
+// thread. Endpoints are chosen the same way with every instruction set and
+// the indices are selected with integer math, so every instruction set gives
+// bit identical blocks. AVX2 uses the SSE kernels, a block of 16 texels does
+// not fill wider registers.
+void CompressTexture(const unsigned char* source, unsigned int width,
+	unsigned int height, BlockFormat format, unsigned char* toFill,
+	unsigned int nrOfThreads = 0,
+	InstructionSet instructionSet = GetSupportedInstructionSet());
+
+// Decodes blocks written by CompressTexture into BYTE RGBA texels the way the
+// GPU samples them, channels the format does not store are 0 and alpha 255
+void DecompressTexture(const unsigned char* source, unsigned int width,
+	unsigned int height, BlockFormat format, unsigned char* toFill);
+
+// Peak signal to noise ratio in dB between two BYTE RGBA images over the
+// channels the format stores, infinite if they are identical
+double CalculatePSNR(const unsigned char* reference,
+	const unsigned char* decompressed, unsigned int width, unsigned int height,
+	BlockFormat format);
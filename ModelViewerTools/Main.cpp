@@ -0,0 +1,18 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "OfflineTools.h"
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> arguments(argv, argv + argc);
+	if (arguments.size() < 2)
+	{
+		std::cout << "Usage: ModelViewerTools -<tool> [arguments]" <<
+			std::endl;
+		return 1;
+	}
+
+	return RunTool(arguments, std::cout);
+}
@@ -0,0 +1,3056 @@
+#include "OfflineTools.h"
+
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <type_traits>
+#include <cmath>
+#include <array>
+#include <limits>
+#include <fstream>
+#include <unordered_set>
+#include <stdexcept>
+#include <cctype>
+
+#include "MeshResourceLoader.h"
+#include "ParallelFor.h"
+#include "VertexConversion.h"
+#include "BakedTexture.h"
+#include "MipGeneration.h"
+#include "TextureFootprint.h"
+#include "FloatPacking.h"
+#include "BlockCompression.h"
+#include "TextureStreaming.h"
+#include "VirtualTexturing.h"
+#include "stb_image.h"
+
+namespace
+{
+	// Points every directory of the loader at the directory of the given file
+	// and returns the file name relative to it
+	std::string SetupToolLoader(MeshResourceLoader& loader,
+		const std::string& file)
+	{
+		size_t separator = file.find_last_of("\\/");
+		std::string directory = separator == std::string::npos ? "" :
+			file.substr(0, separator + 1);
+
+		DirectoryInformation directoryInformation;
+		directoryInformation.meshDirectory = directory;
+		directoryInformation.diffuseMapDirectory = directory;
+		directoryInformation.specularMapDirectory = directory;
+		directoryInformation.normalMapDirectory = directory;
+		loader.SetDirectoryInformation(directoryInformation);
+
+		return file.substr(directory.size());
+	}
+
+	int BakeMeshCaches(const std::vector<std::string>& files,
+		std::ostream& output)
+	{
+		int failures = 0;
+		for (auto& file : files)
+		{
+			bool baked = MeshResourceLoader::BakeMeshCache(file);
+			output << (baked ? "Baked " : "Failed to bake ") << file;
+			if (baked)
+				output << " -> " << MeshCache::GetCachePath(file);
+			output << std::endl;
+
+			failures += baked ? 0 : 1;
+		}
+
+		return failures;
+	}
+
+	// Tools that filter mips for a material map take the map as an optional
+	// first argument, the rest are files
+	MaterialMap ParseMaterialMap(std::vector<std::string>& toolArguments)
+	{
+		const std::pair<const char*, MaterialMap> MAPS[] = {
+			{ "diffuse", MaterialMap::DIFFUSE },
+			{ "specular", MaterialMap::SPECULAR },
+			{ "normal", MaterialMap::NORMAL } };
+		for (auto& map : MAPS)
+		{
+			if (!toolArguments.empty() && toolArguments.front() == map.first)
+			{
+				toolArguments.erase(toolArguments.begin());
+				return map.second;
+			}
+		}
+
+		return MaterialMap::DIFFUSE;
+	}
+
+	int BakeTextures(const std::vector<std::string>& files, MaterialMap map,
+		std::ostream& output)
+	{
+		int failures = 0;
+		for (auto& file : files)
+		{
+			bool baked = MeshResourceLoader::BakeTexture(file, map);
+			output << (baked ? "Baked " : "Failed to bake ") << file;
+			if (baked)
+				output << " -> " << BakedTexture::GetBakedPath(file);
+			output << std::endl;
+
+			failures += baked ? 0 : 1;
+		}
+
+		return failures;
+	}
+
+	// Compares every level of a baked texture with the mip chain the loader
+	// generates from the source for the map when no baked texture is used
+	bool ValidateBakedTexture(const std::string& file, MaterialMap map,
+		std::ostream& output)
+	{
+		std::uint64_t sourceHash = 0;
+		BakedTexture baked;
+		if (!MeshCache::HashFile(file, sourceHash) ||
+			!baked.Open(BakedTexture::GetBakedPath(file), sourceHash))
+		{
+			output << file << ": no up to date baked texture" << std::endl;
+			return false;
+		}
+
+		int width = 0;
+		int height = 0;
+		stbi_uc* decoded = stbi_load(file.c_str(), &width, &height, nullptr, 4);
+		if (decoded == nullptr)
+		{
+			output << file << ": could not decode the source" << std::endl;
+			return false;
+		}
+
+		std::vector<UINT> rows;
+		std::vector<UINT64> rowSizes;
+		CalculateMipChainLayout(width, height, 4, rows, rowSizes);
+		size_t totalSize = 0;
+		for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+			totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+		std::vector<unsigned char> generated(totalSize);
+		memcpy(generated.data(), decoded, rows[0] * rowSizes[0]);
+		stbi_image_free(decoded);
+		GenerateMipChain(generated.data(), rows, rowSizes, 4, TexelFormat::BYTE,
+			MeshResourceLoader::GetMipFilterSettings(map, MipFilteringSettings()));
+
+		bool sameLayout = baked.GetWidth() == static_cast<unsigned int>(width) &&
+			baked.GetHeight() == static_cast<unsigned int>(height) &&
+			baked.GetNrOfMipLevels() == rows.size();
+		size_t mismatchedLevels = 0;
+		size_t offset = 0;
+		for (unsigned int mipLevel = 0; sameLayout && mipLevel < rows.size();
+			++mipLevel)
+		{
+			size_t byteSize = rows[mipLevel] * rowSizes[mipLevel];
+			if (baked.GetMipByteSize(mipLevel) != byteSize || memcmp(
+				baked.GetMipData(mipLevel), generated.data() + offset, byteSize) != 0)
+			{
+				++mismatchedLevels;
+			}
+
+			offset += byteSize;
+		}
+
+		bool valid = sameLayout && mismatchedLevels == 0;
+		output << file << ": " << width << "x" << height << ", " <<
+			rows.size() << " levels, " << baked.GetTotalByteSize() << " bytes, ";
+		if (!sameLayout)
+			output << "layout differs from the source" << std::endl;
+		else
+			output << mismatchedLevels << " levels differ" << std::endl;
+
+		return valid;
+	}
+
+	// Runs only the CPU phase of a load with an increasing number of worker
+	// threads, the mesh cache is skipped so the conversion is always measured
+	int BenchmarkLoad(const std::string& file, unsigned int maxThreads,
+		std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetMeshCacheUsage(false);
+
+		double singleThreadedTotal = 0.0;
+		for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			loader.SetNrOfWorkerThreads(threads);
+			PreparedMesh preparedMesh;
+			if (!loader.PrepareMesh(fileName, preparedMesh))
+			{
+				output << "Failed to load " << file << std::endl;
+				return 1;
+			}
+
+			const LoadStatistics& statistics = loader.GetLoadStatistics();
+			double total = statistics.importMilliseconds +
+				statistics.convertMilliseconds + statistics.decodeMilliseconds;
+			if (threads == 1)
+				singleThreadedTotal = total;
+
+			output << threads << " threads: import " <<
+				statistics.importMilliseconds << " ms, convert " <<
+				statistics.convertMilliseconds << " ms, decode " <<
+				statistics.decodeMilliseconds << " ms, total " << total <<
+				" ms, speedup " << singleThreadedTotal / total << "x" << std::endl;
+		}
+
+		return 0;
+	}
+
+	void PrintMemoryStatistics(const char* name, const LoadStatistics& statistics,
+		std::ostream& output)
+	{
+		output << name << ": " << statistics.nrOfBatches << " batches, peak " <<
+			"tracked " << statistics.peakTrackedBytes << " bytes (staging " <<
+			statistics.peakStagingBytes << "), peak working set " <<
+			statistics.peakWorkingSetBytes << " bytes, " <<
+			statistics.importMilliseconds + statistics.convertMilliseconds +
+			statistics.decodeMilliseconds << " ms" << std::endl;
+	}
+
+	// Streams a mesh within the memory budget and prepares it at once, the
+	// streamed run goes first so its working set peak is not raised by the
+	// other. The tracked bytes are what the budget is compared against.
+	// Nothing is uploaded, the streamed batches are only counted.
+	int ReportLoadMemory(const std::string& file, size_t budget,
+		std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetMeshCacheUsage(false);
+		loader.SetMemoryBudget(budget);
+
+		size_t streamedSubMeshes = 0;
+		bool loaded = loader.StreamMesh(fileName,
+			[&](std::unique_ptr<PreparedMesh> batch)
+			{
+				streamedSubMeshes += batch->subMeshes.size();
+				return true;
+			});
+		LoadStatistics streamedStatistics = loader.GetLoadStatistics();
+
+		PreparedMesh preparedMesh;
+		loaded = loaded && loader.PrepareMesh(fileName, preparedMesh);
+		if (!loaded)
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		output << file << " with a budget of " << budget << " bytes" << std::endl;
+		PrintMemoryStatistics("Streamed", streamedStatistics, output);
+		PrintMemoryStatistics("At once", loader.GetLoadStatistics(), output);
+		output << streamedSubMeshes << " of " << preparedMesh.subMeshes.size() <<
+			" sub meshes streamed" << std::endl;
+
+		return streamedSubMeshes == preparedMesh.subMeshes.size() ? 0 : 1;
+	}
+
+	bool SameSubMesh(const SubMeshStreams& first, const SubMeshStreams& second)
+	{
+		return first.nrOfVertices == second.nrOfVertices &&
+			first.GetTotalNrOfIndices() == second.GetTotalNrOfIndices() &&
+			memcmp(first.positions, second.positions,
+				first.nrOfVertices * sizeof(DirectX::XMFLOAT3)) == 0 &&
+			memcmp(first.indices, second.indices,
+				first.GetTotalNrOfIndices() * sizeof(unsigned int)) == 0;
+	}
+
+	// Drains an asynchronous load the way the viewer does, a fixed number of
+	// sub meshes per simulated frame, and checks that they arrive complete
+	// and in the same order as from a blocking load
+	int ReportAsyncLoad(const std::string& file, size_t subMeshesPerFrame,
+		std::ostream& output)
+	{
+		const std::chrono::milliseconds FRAME_TIME(16);
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		PreparedMesh reference;
+		if (!loader.PrepareMesh(fileName, reference))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		auto millisecondsSince = [](std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start).count();
+		};
+
+		auto loadStart = std::chrono::steady_clock::now();
+		std::unique_ptr<AsyncMeshPreparation> preparation =
+			loader.PrepareMeshAsync(fileName);
+		double startMilliseconds = millisecondsSince(loadStart);
+		double firstSubMeshMilliseconds = 0.0;
+		double longestFrameMilliseconds = 0.0;
+		size_t frames = 0;
+		size_t received = 0;
+		size_t mismatches = 0;
+
+		std::unique_ptr<PreparedMesh> batch;
+		size_t nextSubMesh = 0;
+		bool drained = false;
+		while (!drained)
+		{
+			auto frameStart = std::chrono::steady_clock::now();
+			bool finished = preparation->IsFinished();
+			size_t frameSubMeshes = 0;
+			while (frameSubMeshes < subMeshesPerFrame)
+			{
+				if (batch == nullptr && !preparation->TryPopBatch(batch))
+				{
+					drained = finished;
+					break;
+				}
+
+				if (received >= reference.subMeshes.size() ||
+					!SameSubMesh(batch->subMeshes[nextSubMesh],
+						reference.subMeshes[received]))
+				{
+					++mismatches;
+				}
+
+				if (received++ == 0)
+					firstSubMeshMilliseconds = millisecondsSince(loadStart);
+
+				++frameSubMeshes;
+				if (++nextSubMesh == batch->subMeshes.size())
+				{
+					batch.reset();
+					nextSubMesh = 0;
+				}
+			}
+
+			longestFrameMilliseconds = std::max(longestFrameMilliseconds,
+				millisecondsSince(frameStart));
+			++frames;
+			std::this_thread::sleep_until(frameStart + FRAME_TIME);
+		}
+
+		double totalMilliseconds = millisecondsSince(loadStart);
+		bool succeeded = preparation->Succeeded();
+		const LoadStatistics& statistics = preparation->GetLoadStatistics();
+		output << file << ": started in " << startMilliseconds <<
+			" ms, first sub mesh after " << firstSubMeshMilliseconds <<
+			" ms, " << received << " of " << reference.subMeshes.size() <<
+			" sub meshes in " << totalMilliseconds << " ms over " << frames <<
+			" frames of " << FRAME_TIME.count() << " ms" << std::endl;
+		output << statistics.nrOfBatches << " batches, at most " <<
+			longestFrameMilliseconds << " ms per frame spent taking sub meshes, " <<
+			mismatches << " differ from the blocking load" << std::endl;
+
+		return succeeded && mismatches == 0 &&
+			received == reference.subMeshes.size() ? 0 : 1;
+	}
+
+	// Decodes the textures of a mesh through the decode pool and lists every
+	// decode in the order it finished, then starts an asynchronous load and
+	// unloads it at once to check that its queued decodes are cancelled
+	int ReportTextureDecodes(const std::string& file, unsigned int nrOfThreads,
+		std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetNrOfWorkerThreads(nrOfThreads);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		TextureDecodeStatistics statistics = loader.GetTextureDecodeStatistics();
+		for (auto& timing : statistics.timings)
+		{
+			output << timing.filepath << ": priority " << timing.priority <<
+				", queued " << timing.waitMilliseconds << " ms, decoded in " <<
+				timing.decodeMilliseconds << " ms" <<
+				(timing.succeeded ? "" : ", failed") << std::endl;
+		}
+
+		output << statistics.nrOfDecodes << " decodes on " <<
+			statistics.nrOfThreads << " threads, peak queue depth " <<
+			statistics.peakQueueDepth << ", " <<
+			statistics.totalDecodeMilliseconds << " ms decoding, longest " <<
+			statistics.longestDecodeMilliseconds << " ms, decode phase " <<
+			loader.GetLoadStatistics().decodeMilliseconds << " ms" << std::endl;
+
+		// The cancelled load shares the pool, so its decodes show up in the
+		// statistics of this loader
+		MeshResourceLoader cancelledLoader;
+		SetupToolLoader(cancelledLoader, file);
+		cancelledLoader.SetNrOfWorkerThreads(1);
+		cancelledLoader.SetMeshCacheUsage(false);
+		std::unique_ptr<AsyncMeshPreparation> preparation =
+			cancelledLoader.PrepareMeshAsync(fileName);
+		while (!preparation->IsFinished() &&
+			cancelledLoader.GetTextureDecodeStatistics().peakQueueDepth == 0)
+		{
+			std::this_thread::yield();
+		}
+		preparation.reset();
+
+		TextureDecodeStatistics cancelledStatistics =
+			cancelledLoader.GetTextureDecodeStatistics();
+		output << "Unloading while decoding: " <<
+			cancelledStatistics.nrOfDecodes << " decoded, " <<
+			cancelledStatistics.nrOfCancellations << " cancelled, " <<
+			cancelledStatistics.queueDepth << " left queued" << std::endl;
+
+		return statistics.nrOfFailures == 0 &&
+			cancelledStatistics.queueDepth == 0 ? 0 : 1;
+	}
+
+	// Compares the separate and packed vertex layouts for a mesh, the packed
+	// data is verified against the source streams as part of the report
+	int ReportVertexLayouts(const std::string& file, std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		size_t nrOfVertices = 0;
+		size_t separateBytes = 0;
+		size_t separateBuffers = 0;
+		size_t packedBytes = 0;
+		size_t packedBuffers = 0;
+		size_t mismatchingSubMeshes = 0;
+		std::vector<PackedVertexAttributes> packed;
+
+		for (auto& streams : preparedMesh.subMeshes)
+		{
+			size_t vertices = streams.nrOfVertices;
+			nrOfVertices += vertices;
+
+			const void* separateStreams[] = { streams.positions, streams.uvs,
+				streams.normals, streams.tangents };
+			const size_t separateSizes[] = { sizeof(DirectX::XMFLOAT3),
+				sizeof(DirectX::XMFLOAT2), sizeof(DirectX::XMFLOAT3),
+				sizeof(DirectX::XMFLOAT4) };
+			for (size_t i = 0; i < 4; ++i)
+			{
+				if (separateStreams[i] == nullptr)
+					continue;
+
+				separateBytes += vertices * separateSizes[i];
+				++separateBuffers;
+			}
+
+			packedBytes += vertices *
+				(sizeof(DirectX::XMFLOAT3) + sizeof(PackedVertexAttributes));
+			packedBuffers += 2;
+
+			PackVertexAttributes(streams, packed);
+			if (!ValidatePackedVertexAttributes(streams, packed))
+				++mismatchingSubMeshes;
+		}
+
+		// Each vertex fetches its index and then one element per vertex buffer
+		double subMeshes = static_cast<double>(
+			std::max<size_t>(preparedMesh.subMeshes.size(), 1));
+		output << file << ": " << preparedMesh.subMeshes.size() <<
+			" sub meshes, " << nrOfVertices << " vertices" << std::endl;
+		output << "Separate: " << separateBytes << " bytes, " <<
+			separateBuffers << " vertex buffer views, " <<
+			1.0 + separateBuffers / subMeshes << " fetches per vertex" <<
+			std::endl;
+		output << "Packed: " << packedBytes << " bytes, " << packedBuffers <<
+			" vertex buffer views, " << 1.0 + packedBuffers / subMeshes <<
+			" fetches per vertex" << std::endl;
+
+		if (mismatchingSubMeshes != 0)
+		{
+			output << "Packed data differs from the source streams in " <<
+				mismatchingSubMeshes << " sub meshes" << std::endl;
+			return 1;
+		}
+
+		output << "Packed data matches the source streams" << std::endl;
+		return 0;
+	}
+
+	// Quantizes every sub mesh of a mesh with both the SSE and the scalar
+	// path, checks that they agree and that the decoded data is within the
+	// error bounds, and reports the memory saved over the packed float layout
+	int ReportQuantization(const std::string& file, std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		size_t floatBytes = 0;
+		size_t quantizedBytes = 0;
+		size_t pathMismatches = 0;
+		size_t failedSubMeshes = 0;
+		QuantizationError worst;
+		std::vector<QuantizedVertexAttributes> batched;
+		std::vector<QuantizedVertexAttributes> scalar;
+
+		for (size_t i = 0; i < preparedMesh.subMeshes.size(); ++i)
+		{
+			const SubMeshStreams& streams = preparedMesh.subMeshes[i];
+			floatBytes += streams.nrOfVertices * sizeof(PackedVertexAttributes);
+			quantizedBytes += streams.nrOfVertices *
+				sizeof(QuantizedVertexAttributes);
+
+			QuantizeVertexAttributes(streams, batched);
+			QuantizeVertexAttributesScalar(streams, scalar);
+			if (!batched.empty() && memcmp(batched.data(), scalar.data(),
+				batched.size() * sizeof(QuantizedVertexAttributes)) != 0)
+			{
+				++pathMismatches;
+			}
+
+			QuantizationError error = MeasureQuantizationError(streams, batched);
+			worst.maxNormalError = std::max(worst.maxNormalError,
+				error.maxNormalError);
+			worst.maxTangentError = std::max(worst.maxTangentError,
+				error.maxTangentError);
+			worst.maxUVRelativeError = std::max(worst.maxUVRelativeError,
+				error.maxUVRelativeError);
+			worst.handednessMismatches += error.handednessMismatches;
+
+			if (!error.withinBounds)
+			{
+				++failedSubMeshes;
+				output << "Sub mesh " << i << " exceeds the error bounds" <<
+					std::endl;
+			}
+		}
+
+		output << file << ": " << floatBytes << " bytes as floats, " <<
+			quantizedBytes << " bytes quantized, " <<
+			floatBytes - quantizedBytes << " bytes saved" << std::endl;
+		output << "Max normal error " << worst.maxNormalError <<
+			" (bound " << MAX_OCTAHEDRAL_ERROR << "), max tangent error " <<
+			worst.maxTangentError << " (bound " << MAX_TANGENT_ERROR <<
+			"), max uv relative error " << worst.maxUVRelativeError <<
+			" (bound " << MAX_HALF_RELATIVE_ERROR << "), " <<
+			worst.handednessMismatches << " handedness mismatches" <<
+			std::endl;
+		output << pathMismatches << " sub meshes differ between the SSE and " <<
+			"scalar paths, " << failedSubMeshes << " exceed the error bounds" <<
+			std::endl;
+
+		return pathMismatches == 0 && failedSubMeshes == 0 ? 0 : 1;
+	}
+
+	// Measures how far the bitangents rebuilt from the tangent handedness turn
+	// away from the imported ones. Only the direction is compared, as the
+	// pixel shader normalizes the interpolated bitangent.
+	int ReportBitangents(const std::string& file, std::ostream& output)
+	{
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(file,
+			MeshResourceLoader::GetImportFlags());
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		const double DEGREES_PER_RADIAN = 180.0 / 3.14159265358979323846;
+		size_t nrOfVertices = 0;
+		size_t over1Degree = 0;
+		size_t over10Degrees = 0;
+		double angleSum = 0.0;
+		double maxAngle = 0.0;
+
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+		{
+			const aiMesh* mesh = scene->mMeshes[i];
+			if (mesh->mNormals == nullptr || mesh->mTangents == nullptr ||
+				mesh->mBitangents == nullptr)
+			{
+				continue;
+			}
+
+			for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
+			{
+				aiVector3D rebuilt = mesh->mNormals[j] ^ mesh->mTangents[j];
+				const aiVector3D& imported = mesh->mBitangents[j];
+				if (rebuilt * imported < 0.0f)
+					rebuilt = -rebuilt;
+
+				double lengths = static_cast<double>(rebuilt.Length()) *
+					imported.Length();
+				if (lengths == 0.0)
+					continue;
+
+				double cosine = std::min(std::max(
+					rebuilt * imported / lengths, -1.0), 1.0);
+				double angle = std::acos(cosine) * DEGREES_PER_RADIAN;
+				++nrOfVertices;
+				angleSum += angle;
+				maxAngle = std::max(maxAngle, angle);
+				over1Degree += angle > 1.0 ? 1 : 0;
+				over10Degrees += angle > 10.0 ? 1 : 0;
+			}
+		}
+
+		output << file << ": " << nrOfVertices << " vertices with a tangent " <<
+			"space, storing their bitangents takes " <<
+			nrOfVertices * sizeof(DirectX::XMFLOAT3) << " bytes" << std::endl;
+		output << "Rebuilt bitangents: " << (nrOfVertices > 0 ?
+			angleSum / nrOfVertices : 0.0) << " degrees mean, " << maxAngle <<
+			" degrees max, " << over1Degree << " vertices over 1 degree, " <<
+			over10Degrees << " over 10 degrees" << std::endl;
+
+		return 0;
+	}
+
+	// Checks that the 16 bit indices chosen by the loader widen back to the
+	// source indices and reports the index memory saved by them
+	int ReportIndices(const std::string& file, std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		size_t shortSubMeshes = 0;
+		size_t mismatchingSubMeshes = 0;
+		size_t wideBytes = 0;
+		size_t bytesSaved = 0;
+
+		for (size_t i = 0; i < preparedMesh.subMeshes.size(); ++i)
+		{
+			const SubMeshStreams& streams = preparedMesh.subMeshes[i];
+			const std::vector<std::uint16_t>& narrowed =
+				preparedMesh.shortIndices[i];
+			wideBytes += streams.GetTotalNrOfIndices() * sizeof(unsigned int);
+
+			if (narrowed.empty() == CanUseShortIndices(streams))
+			{
+				++mismatchingSubMeshes;
+				output << "Sub mesh " << i << " has the wrong index width" <<
+					std::endl;
+				continue;
+			}
+
+			if (narrowed.empty())
+				continue;
+
+			++shortSubMeshes;
+			bytesSaved += GetShortIndexBytesSaved(streams);
+			if (!ValidateShortIndices(streams, narrowed))
+			{
+				++mismatchingSubMeshes;
+				output << "Sub mesh " << i << " does not round trip its " <<
+					"indices" << std::endl;
+			}
+		}
+
+		output << file << ": " << shortSubMeshes << " of " <<
+			preparedMesh.subMeshes.size() << " sub meshes use 16 bit indices" <<
+			std::endl;
+		output << wideBytes << " bytes with 32 bit indices, " <<
+			wideBytes - bytesSaved << " bytes as loaded, " << bytesSaved <<
+			" bytes saved" << std::endl;
+		output << mismatchingSubMeshes << " sub meshes failed validation" <<
+			std::endl;
+
+		return mismatchingSubMeshes == 0 ? 0 : 1;
+	}
+
+	// Converts a mesh with and without the vertex order optimization and
+	// reports the simulated ACMR and ATVR of every sub mesh for both
+	int ReportVertexCache(const std::string& file, unsigned int cacheSize,
+		std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetMeshCacheUsage(false);
+
+		PreparedMesh original;
+		loader.SetVertexOrderOptimization(false);
+		bool loaded = loader.PrepareMesh(fileName, original);
+
+		PreparedMesh optimized;
+		loader.SetVertexOrderOptimization(true);
+		loaded = loaded && loader.PrepareMesh(fileName, optimized);
+
+		if (!loaded || original.subMeshes.size() != optimized.subMeshes.size())
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		size_t triangles = 0;
+		size_t vertices = 0;
+		size_t originalMisses = 0;
+		size_t optimizedMisses = 0;
+
+		for (size_t i = 0; i < original.subMeshes.size(); ++i)
+		{
+			const SubMeshStreams& before = original.subMeshes[i];
+			const SubMeshStreams& after = optimized.subMeshes[i];
+			VertexCacheStatistics beforeStatistics = AnalyzeVertexCache(
+				before.indices, before.nrOfIndices, before.nrOfVertices, cacheSize);
+			VertexCacheStatistics afterStatistics = AnalyzeVertexCache(
+				after.indices, after.nrOfIndices, after.nrOfVertices, cacheSize);
+
+			output << "Sub mesh " << i << ": " << before.nrOfIndices / 3 <<
+				" triangles, ACMR " << beforeStatistics.acmr << " -> " <<
+				afterStatistics.acmr << ", ATVR " << beforeStatistics.atvr <<
+				" -> " << afterStatistics.atvr << std::endl;
+
+			triangles += before.nrOfIndices / 3;
+			vertices += before.nrOfVertices;
+			originalMisses += beforeStatistics.cacheMisses;
+			optimizedMisses += afterStatistics.cacheMisses;
+		}
+
+		double triangleCount = static_cast<double>(std::max<size_t>(triangles, 1));
+		double vertexCount = static_cast<double>(std::max<size_t>(vertices, 1));
+		output << file << " with a " << cacheSize << " entry cache: ACMR " <<
+			originalMisses / triangleCount << " -> " <<
+			optimizedMisses / triangleCount << ", ATVR " <<
+			originalMisses / vertexCount << " -> " <<
+			optimizedMisses / vertexCount << std::endl;
+		output << "Conversion took " <<
+			loader.GetLoadStatistics().convertMilliseconds <<
+			" ms with the optimization" << std::endl;
+
+		return 0;
+	}
+
+	// Converts a mesh without and with levels of detail, so the difference in
+	// conversion time is the cost of the simplification, and reports the
+	// triangles and error of each level over all sub meshes. Sub meshes with
+	// fewer levels count with their coarsest one.
+	int ReportLevelsOfDetail(const std::string& file, unsigned int nrOfLevels,
+		std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetMeshCacheUsage(false);
+
+		PreparedMesh fullDetail;
+		bool loaded = loader.PrepareMesh(fileName, fullDetail);
+		double fullDetailMilliseconds =
+			loader.GetLoadStatistics().convertMilliseconds;
+
+		PreparedMesh simplified;
+		loader.SetLevelsOfDetail(nrOfLevels);
+		loaded = loaded && loader.PrepareMesh(fileName, simplified);
+		if (!loaded)
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		std::vector<size_t> triangles(nrOfLevels + 1, 0);
+		std::vector<size_t> subMeshesAtLevel(nrOfLevels + 1, 0);
+		std::vector<float> maxErrors(nrOfLevels + 1, 0.0f);
+		size_t addedIndices = 0;
+		size_t invalid = 0;
+
+		for (size_t i = 0; i < simplified.subMeshes.size(); ++i)
+		{
+			const SubMeshStreams& streams = simplified.subMeshes[i];
+			if (!ValidateLevelsOfDetail(streams))
+			{
+				++invalid;
+				output << "Sub mesh " << i << " has invalid levels of detail" <<
+					std::endl;
+			}
+
+			addedIndices += streams.GetTotalNrOfIndices() - streams.nrOfIndices;
+			for (unsigned int j = 0; j <= nrOfLevels; ++j)
+			{
+				LevelOfDetail level;
+				level.indexCount = streams.nrOfIndices;
+				if (streams.nrOfLevelsOfDetail > 0)
+				{
+					level = streams.levelsOfDetail[std::min(j,
+						streams.nrOfLevelsOfDetail - 1)];
+				}
+
+				triangles[j] += level.indexCount / 3;
+				maxErrors[j] = std::max(maxErrors[j], level.error);
+				if (j < std::max(streams.nrOfLevelsOfDetail, 1u))
+					++subMeshesAtLevel[j];
+			}
+		}
+
+		// Distance at which the largest error of a level projects to a pixel
+		// on a 1080 pixel high screen with a 60 degree field of view
+		const float fieldOfView = 3.14159265f / 3.0f;
+		const float screenHeight = 1080.0f;
+		double fullTriangles = static_cast<double>(std::max<size_t>(triangles[0], 1));
+		for (unsigned int i = 0; i <= nrOfLevels; ++i)
+		{
+			output << "Level " << i << ": " << triangles[i] << " triangles (" <<
+				100.0 * static_cast<double>(triangles[i]) / fullTriangles <<
+				"%), " << subMeshesAtLevel[i] << " sub meshes, max error " <<
+				maxErrors[i] << ", below a pixel from distance " <<
+				GetScreenSpaceError(maxErrors[i], 1.0f, fieldOfView,
+					screenHeight) << std::endl;
+		}
+
+		output << file << ": " << addedIndices * sizeof(unsigned int) <<
+			" bytes of 32 bit indices added for " << nrOfLevels << " levels" <<
+			std::endl;
+		output << "Conversion took " << fullDetailMilliseconds << " ms, " <<
+			loader.GetLoadStatistics().convertMilliseconds <<
+			" ms with levels of detail" << std::endl;
+		output << invalid << " sub meshes failed validation" << std::endl;
+
+		return invalid == 0 ? 0 : 1;
+	}
+
+	bool SameMeshlets(const MeshletData& first, const MeshletData& second)
+	{
+		return first.meshlets.size() == second.meshlets.size() &&
+			first.vertices == second.vertices &&
+			first.primitives == second.primitives &&
+			(first.meshlets.empty() || (memcmp(first.meshlets.data(),
+				second.meshlets.data(), first.meshlets.size() * sizeof(Meshlet)) == 0 &&
+			memcmp(first.bounds.data(), second.bounds.data(),
+				first.bounds.size() * sizeof(MeshletBounds)) == 0));
+	}
+
+	// Builds the meshlets of every sub mesh on one thread and on every thread,
+	// checks that both builds are identical and valid and dumps statistics
+	int ReportMeshlets(const std::string& file, std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		size_t nrOfSubMeshes = preparedMesh.subMeshes.size();
+		std::vector<MeshletData> serial(nrOfSubMeshes);
+		std::vector<MeshletData> parallel(nrOfSubMeshes);
+		ParallelFor(nrOfSubMeshes, 1, [&](size_t index)
+			{
+				BuildMeshlets(preparedMesh.subMeshes[index], serial[index]);
+			});
+		ParallelFor(nrOfSubMeshes, std::thread::hardware_concurrency(),
+			[&](size_t index)
+			{
+				BuildMeshlets(preparedMesh.subMeshes[index], parallel[index]);
+			});
+
+		size_t nondeterministic = 0;
+		size_t invalid = 0;
+		MeshletStatistics statistics;
+		for (size_t i = 0; i < nrOfSubMeshes; ++i)
+		{
+			if (!SameMeshlets(serial[i], parallel[i]))
+			{
+				++nondeterministic;
+				output << "Sub mesh " << i << " differs between builds" <<
+					std::endl;
+			}
+
+			if (!ValidateMeshlets(preparedMesh.subMeshes[i], parallel[i]))
+			{
+				++invalid;
+				output << "Sub mesh " << i << " has invalid meshlets" << std::endl;
+			}
+
+			AccumulateMeshletStatistics(parallel[i], statistics);
+		}
+
+		double meshlets = static_cast<double>(
+			std::max<size_t>(statistics.nrOfMeshlets, 1));
+		output << file << ": " << statistics.nrOfMeshlets << " meshlets in " <<
+			nrOfSubMeshes << " sub meshes, " << statistics.byteSize <<
+			" bytes" << std::endl;
+		output << statistics.nrOfVertices / meshlets << " of " <<
+			MAX_MESHLET_VERTICES << " vertices and " <<
+			statistics.nrOfPrimitives / meshlets << " of " <<
+			MAX_MESHLET_TRIANGLES << " triangles per meshlet on average, " <<
+			statistics.usableCones << " usable normal cones" << std::endl;
+		output << nondeterministic << " sub meshes differ between builds, " <<
+			invalid << " failed validation" << std::endl;
+
+		return nondeterministic == 0 && invalid == 0 ? 0 : 1;
+	}
+
+	// Best time of several runs, the first run also faults in the output
+	template<typename Function>
+	double TimeKernel(Function&& kernel)
+	{
+		const unsigned int NR_OF_RUNS = 10;
+		double best = 0.0;
+		for (unsigned int i = 0; i < NR_OF_RUNS; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			kernel();
+			std::chrono::duration<double, std::milli> time =
+				std::chrono::steady_clock::now() - start;
+			best = i == 0 ? time.count() : std::min(best, time.count());
+		}
+
+		return best;
+	}
+
+	// Times the vertex conversion kernels on random streams with every
+	// instruction set the processor supports, against the scalar loop, and
+	// checks that every instruction set gives the same bytes
+	int BenchmarkConversion(size_t nrOfVertices, std::ostream& output)
+	{
+		std::mt19937 generator(0);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+		std::vector<float> sources[3];
+		for (auto& source : sources)
+		{
+			source.resize(nrOfVertices * 3);
+			for (float& component : source)
+				component = distribution(generator);
+		}
+
+		const float* tangents = sources[0].data();
+		const float* normals = sources[1].data();
+		const float* bitangents = sources[2].data();
+		std::vector<DirectX::XMFLOAT2> vector2References(nrOfVertices);
+		std::vector<DirectX::XMFLOAT3> vector3References(nrOfVertices);
+		std::vector<DirectX::XMFLOAT4> tangentReferences(nrOfVertices);
+		std::vector<DirectX::XMFLOAT2> vector2Results(nrOfVertices);
+		std::vector<DirectX::XMFLOAT3> vector3Results(nrOfVertices);
+		std::vector<DirectX::XMFLOAT4> tangentResults(nrOfVertices);
+
+		double scalarMilliseconds[3] = {};
+		int mismatches = 0;
+		InstructionSet supported = GetSupportedInstructionSet();
+		output << nrOfVertices << " vertices, " <<
+			GetInstructionSetName(supported) << " supported" << std::endl;
+
+		for (InstructionSet instructionSet : { InstructionSet::SCALAR,
+			InstructionSet::SSE, InstructionSet::AVX2 })
+		{
+			if (instructionSet > supported)
+				break;
+
+			bool scalar = instructionSet == InstructionSet::SCALAR;
+			DirectX::XMFLOAT2* vector2s = scalar ? vector2References.data() :
+				vector2Results.data();
+			DirectX::XMFLOAT3* vector3s = scalar ? vector3References.data() :
+				vector3Results.data();
+			DirectX::XMFLOAT4* tangentStream = scalar ? tangentReferences.data() :
+				tangentResults.data();
+
+			double milliseconds[3];
+			milliseconds[0] = TimeKernel([&]()
+				{
+					ConvertVector2Stream(tangents, nrOfVertices, vector2s,
+						instructionSet);
+				});
+			milliseconds[1] = TimeKernel([&]()
+				{
+					ConvertVector3Stream(tangents, nrOfVertices, vector3s,
+						instructionSet);
+				});
+			milliseconds[2] = TimeKernel([&]()
+				{
+					ConvertTangentStream(tangents, normals, bitangents,
+						nrOfVertices, tangentStream, instructionSet);
+				});
+
+			if (scalar)
+				std::copy(milliseconds, milliseconds + 3, scalarMilliseconds);
+
+			bool identical = scalar || nrOfVertices == 0 ||
+				(memcmp(vector2s, vector2References.data(),
+					nrOfVertices * sizeof(DirectX::XMFLOAT2)) == 0 &&
+				memcmp(vector3s, vector3References.data(),
+					nrOfVertices * sizeof(DirectX::XMFLOAT3)) == 0 &&
+				memcmp(tangentStream, tangentReferences.data(),
+					nrOfVertices * sizeof(DirectX::XMFLOAT4)) == 0);
+			if (!identical)
+				++mismatches;
+
+			const char* kernelNames[3] = { "vector2", "vector3", "tangent" };
+			output << GetInstructionSetName(instructionSet) << ":";
+			for (size_t i = 0; i < 3; ++i)
+			{
+				output << " " << kernelNames[i] << " " << milliseconds[i] <<
+					" ms (" << scalarMilliseconds[i] / milliseconds[i] << "x)";
+			}
+
+			output << (identical ? "" : ", differs from scalar") << std::endl;
+		}
+
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	const char* GetMaterialMapName(MaterialMap map)
+	{
+		switch (map)
+		{
+		case MaterialMap::DIFFUSE:
+			return "diffuse";
+		case MaterialMap::SPECULAR:
+			return "specular";
+		case MaterialMap::NORMAL:
+			return "normal";
+		}
+
+		return "unknown";
+	}
+
+	// Prepares a mesh and encodes the top level of every material map with the
+	// block format chosen for it. Opaque diffuse maps are encoded as BC1 and
+	// diffuse maps with alpha as BC3, or BC7 if preferred. Normal maps are
+	// encoded as BC5 and specular maps as BC4 from their first channel. The
+	// encoder only runs offline, as the core texture components stage rows by
+	// texel size and have no way to take rows of 4x4 blocks.
+	int ReportBlockCompression(const std::string& file, bool useBC7ForAlpha,
+		std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetMaterialMapNarrowing(false);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		// Files used as more than one kind of map are encoded as the first
+		std::string directory = file.substr(0, file.size() - fileName.size());
+		std::vector<std::pair<std::string, MaterialMap>> maps;
+		std::unordered_set<std::string> added;
+		for (auto& streams : preparedMesh.subMeshes)
+		{
+			const char* names[3] = { streams.diffuseMap, streams.specularMap,
+				streams.normalMap };
+			const MaterialMap types[3] = { MaterialMap::DIFFUSE,
+				MaterialMap::SPECULAR, MaterialMap::NORMAL };
+			for (size_t i = 0; i < 3; ++i)
+			{
+				if (names[i] != nullptr && added.insert(directory + names[i]).second)
+					maps.emplace_back(directory + names[i], types[i]);
+			}
+		}
+
+		unsigned int nrOfThreads = loader.GetLoadStatistics().nrOfWorkerThreads;
+		size_t nrOfMaps = 0;
+		size_t uncompressedBytes = 0;
+		size_t compressedBytes = 0;
+		double encodeMilliseconds = 0.0;
+		for (auto& entry : maps)
+		{
+			auto decoded = preparedMesh.textures.find(entry.first);
+			if (decoded == preparedMesh.textures.end() || decoded->second.hdr)
+				continue;
+
+			const DecodedTexture& texture = decoded->second;
+			const unsigned char* texels = static_cast<const unsigned char*>(
+				texture.baked != nullptr ? texture.baked->GetMipData(0) :
+				texture.data);
+			if (texels == nullptr)
+				continue;
+
+			unsigned int width = static_cast<unsigned int>(texture.width);
+			unsigned int height = static_cast<unsigned int>(texture.height);
+			size_t nrOfTexels = static_cast<size_t>(width) * height;
+			BlockFormat format = BlockFormat::BC1;
+			if (entry.second == MaterialMap::SPECULAR)
+				format = BlockFormat::BC4;
+			else if (entry.second == MaterialMap::NORMAL)
+				format = BlockFormat::BC5;
+			else if (!IsOpaque(texels, nrOfTexels))
+				format = useBC7ForAlpha ? BlockFormat::BC7 : BlockFormat::BC3;
+
+			std::vector<unsigned char> blocks(GetCompressedByteSize(width, height,
+				format));
+			auto encodeStart = std::chrono::steady_clock::now();
+			CompressTexture(texels, width, height, format, blocks.data(),
+				nrOfThreads);
+			std::chrono::duration<double, std::milli> encodeTime =
+				std::chrono::steady_clock::now() - encodeStart;
+
+			std::vector<unsigned char> decompressed(nrOfTexels * 4);
+			DecompressTexture(blocks.data(), width, height, format,
+				decompressed.data());
+			output << entry.first << ": " << GetMaterialMapName(entry.second) <<
+				", " << width << "x" << height << " as " <<
+				GetBlockFormatName(format) << ", " << nrOfTexels * 4 << " -> " <<
+				blocks.size() << " bytes, PSNR " << CalculatePSNR(texels,
+					decompressed.data(), width, height, format) <<
+				" dB, encoded in " << encodeTime.count() << " ms" << std::endl;
+
+			++nrOfMaps;
+			uncompressedBytes += nrOfTexels * 4;
+			compressedBytes += blocks.size();
+			encodeMilliseconds += encodeTime.count();
+		}
+
+		output << nrOfMaps << " maps, " << uncompressedBytes << " -> " <<
+			compressedBytes << " bytes, " << encodeMilliseconds <<
+			" ms encoding on " << nrOfThreads << " threads" << std::endl;
+
+		return 0;
+	}
+
+	// Encodes a texture in every block format with every instruction set the
+	// processor supports and checks that they all give the same blocks
+	int BenchmarkBlockCompression(const std::string& file,
+		unsigned int nrOfThreads, std::ostream& output)
+	{
+		int width = 0;
+		int height = 0;
+		stbi_uc* decoded = stbi_load(file.c_str(), &width, &height, nullptr, 4);
+		if (decoded == nullptr)
+		{
+			output << "Could not decode " << file << std::endl;
+			return 1;
+		}
+
+		std::vector<unsigned char> texels(decoded,
+			decoded + static_cast<size_t>(width) * height * 4);
+		stbi_image_free(decoded);
+
+		if (nrOfThreads == 0)
+			nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		unsigned int textureWidth = static_cast<unsigned int>(width);
+		unsigned int textureHeight = static_cast<unsigned int>(height);
+		double megabytes = texels.size() / (1024.0 * 1024.0);
+		InstructionSet supported = GetSupportedInstructionSet();
+		output << file << ": " << width << "x" << height << ", " <<
+			nrOfThreads << " threads, " << GetInstructionSetName(supported) <<
+			" supported" << std::endl;
+
+		int mismatches = 0;
+		std::vector<unsigned char> decompressed(texels.size());
+		for (BlockFormat format : { BlockFormat::BC1, BlockFormat::BC3,
+			BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 })
+		{
+			size_t byteSize = GetCompressedByteSize(textureWidth, textureHeight,
+				format);
+			std::vector<unsigned char> reference(byteSize);
+			std::vector<unsigned char> blocks(byteSize);
+			double scalarMilliseconds = 0.0;
+			for (InstructionSet instructionSet : { InstructionSet::SCALAR,
+				InstructionSet::SSE, InstructionSet::AVX2 })
+			{
+				if (instructionSet > supported)
+					break;
+
+				bool scalar = instructionSet == InstructionSet::SCALAR;
+				unsigned char* destination = scalar ? reference.data() :
+					blocks.data();
+				double milliseconds = TimeKernel([&]()
+					{
+						CompressTexture(texels.data(), textureWidth, textureHeight,
+							format, destination, nrOfThreads, instructionSet);
+					});
+
+				if (scalar)
+					scalarMilliseconds = milliseconds;
+
+				bool identical = scalar ||
+					memcmp(blocks.data(), reference.data(), byteSize) == 0;
+				if (!identical)
+					++mismatches;
+
+				output << GetBlockFormatName(format) << " " <<
+					GetInstructionSetName(instructionSet) << ": " << milliseconds <<
+					" ms, " << megabytes / (milliseconds / 1000.0) << " MB/s (" <<
+					scalarMilliseconds / milliseconds << "x)" <<
+					(identical ? "" : ", differs from scalar") << std::endl;
+			}
+
+			DecompressTexture(reference.data(), textureWidth, textureHeight, format,
+				decompressed.data());
+			output << GetBlockFormatName(format) << ": " << texels.size() <<
+				" -> " << byteSize << " bytes, PSNR " << CalculatePSNR(
+					texels.data(), decompressed.data(), textureWidth, textureHeight,
+					format) << " dB" << std::endl;
+		}
+
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	// Straightforward 2x2 box filter of one level, the definition of what
+	// GenerateMipChain computes with every instruction set
+	template<typename ComponentType>
+	void FilterReferenceLevel(const ComponentType* source, size_t sourceWidth,
+		size_t sourceHeight, ComponentType* toFill, size_t width, size_t height,
+		unsigned int componentsPerTexel)
+	{
+		for (size_t y = 0; y < height; ++y)
+		{
+			size_t top = y * 2;
+			size_t bottom = std::min(y * 2 + 1, sourceHeight - 1);
+			for (size_t x = 0; x < width; ++x)
+			{
+				size_t left = x * 2;
+				size_t right = std::min(x * 2 + 1, sourceWidth - 1);
+				for (unsigned int component = 0; component < componentsPerTexel;
+					++component)
+				{
+					auto texel = [&](size_t row, size_t column)
+					{
+						return source[(row * sourceWidth + column) *
+							componentsPerTexel + component];
+					};
+
+					ComponentType& destination =
+						toFill[(y * width + x) * componentsPerTexel + component];
+					if constexpr (std::is_same_v<ComponentType, float>)
+					{
+						destination = ((texel(top, left) + texel(top, right)) +
+							(texel(bottom, left) + texel(bottom, right))) * 0.25f;
+					}
+					else
+					{
+						destination = static_cast<ComponentType>((texel(top, left) +
+							texel(top, right) + texel(bottom, left) +
+							texel(bottom, right)) >> 2);
+					}
+				}
+			}
+		}
+	}
+
+	// Random textures of odd, even and single texel sizes in every supported
+	// texel layout, filtered with every instruction set on one and several
+	// threads and compared to the reference filter level by level
+	int CheckMipGeneration(std::ostream& output)
+	{
+		const unsigned int SIZES[][2] = { { 1, 1 }, { 1, 7 }, { 7, 1 }, { 3, 5 },
+			{ 17, 9 }, { 33, 65 }, { 64, 64 }, { 255, 127 }, { 257, 129 },
+			{ 1023, 769 } };
+		std::mt19937 generator(0);
+		std::uniform_int_distribution<int> byteDistribution(0, 255);
+		std::uniform_real_distribution<float> floatDistribution(0.0f, 1.0f);
+		InstructionSet supported = GetSupportedInstructionSet();
+		unsigned int nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		size_t nrOfChecks = 0;
+		size_t nrOfFailures = 0;
+		for (auto& size : SIZES)
+		{
+			for (TexelFormat texelFormat : { TexelFormat::BYTE, TexelFormat::FLOAT })
+			{
+				bool isFloat = texelFormat == TexelFormat::FLOAT;
+				size_t componentSize = isFloat ? sizeof(float) : 1;
+				for (unsigned int components : { 1u, 2u, 3u, 4u })
+				{
+					std::vector<UINT> rows;
+					std::vector<UINT64> rowSizes;
+					CalculateMipChainLayout(size[0], size[1],
+						static_cast<std::uint8_t>(components * componentSize), rows,
+						rowSizes);
+					size_t totalSize = 0;
+					for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+						totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+					std::vector<unsigned char> reference(totalSize);
+					size_t topLevelComponents = rows[0] * rowSizes[0] / componentSize;
+					for (size_t i = 0; i < topLevelComponents; ++i)
+					{
+						if (isFloat)
+						{
+							float value = floatDistribution(generator);
+							memcpy(reference.data() + i * sizeof(float), &value,
+								sizeof(float));
+						}
+						else
+						{
+							reference[i] = static_cast<unsigned char>(
+								byteDistribution(generator));
+						}
+					}
+
+					std::vector<unsigned char> topLevel(reference.begin(),
+						reference.begin() + rows[0] * rowSizes[0]);
+					size_t offset = 0;
+					for (size_t mipLevel = 1; mipLevel < rows.size(); ++mipLevel)
+					{
+						size_t nextOffset = offset +
+							rows[mipLevel - 1] * rowSizes[mipLevel - 1];
+						size_t texelSize = components * componentSize;
+						size_t sourceWidth = rowSizes[mipLevel - 1] / texelSize;
+						size_t width = rowSizes[mipLevel] / texelSize;
+						if (isFloat)
+						{
+							FilterReferenceLevel(
+								reinterpret_cast<const float*>(&reference[offset]),
+								sourceWidth, rows[mipLevel - 1],
+								reinterpret_cast<float*>(&reference[nextOffset]),
+								width, rows[mipLevel], components);
+						}
+						else
+						{
+							FilterReferenceLevel(&reference[offset], sourceWidth,
+								rows[mipLevel - 1], &reference[nextOffset], width,
+								rows[mipLevel], components);
+						}
+
+						offset = nextOffset;
+					}
+
+					for (InstructionSet instructionSet : { InstructionSet::SCALAR,
+						InstructionSet::SSE, InstructionSet::AVX2 })
+					{
+						if (instructionSet > supported)
+							break;
+
+						for (unsigned int threads : { 1u, nrOfThreads })
+						{
+							std::vector<unsigned char> generated(totalSize);
+							std::copy(topLevel.begin(), topLevel.end(),
+								generated.begin());
+							GenerateMipChain(generated.data(), rows, rowSizes,
+								static_cast<std::uint8_t>(components), texelFormat,
+								threads, instructionSet);
+
+							++nrOfChecks;
+							if (generated != reference)
+							{
+								++nrOfFailures;
+								output << size[0] << "x" << size[1] << " " <<
+									(isFloat ? "FLOAT" : "BYTE") << " x" <<
+									components << ", " <<
+									GetInstructionSetName(instructionSet) << ", " <<
+									threads << " threads: differs from the reference" <<
+									std::endl;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		output << nrOfChecks << " mip chains checked, " << nrOfFailures <<
+			" differ from the reference" << std::endl;
+		return nrOfFailures == 0 ? 0 : 1;
+	}
+
+	struct KnownFootprint
+	{
+		UINT width;
+		UINT height;
+		DXGI_FORMAT format;
+		UINT16 nrOfMipLevels;
+		UINT64 totalBytes;
+
+		// Offset, rows, row size and row pitch of every mip
+		std::vector<std::array<UINT64, 4>> subresources;
+	};
+
+	// Footprints GetCopyableFootprints gives for textures of padded and
+	// unpadded rows, block compressed mips smaller than a block and partial
+	// chains, and the calculated layout of every uncompressed format compared
+	// to the one the mip generator uses for many sizes
+	int CheckTextureFootprints(std::ostream& output)
+	{
+		const KnownFootprint KNOWN[] = {
+			{ 256, 256, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 359940, {
+				{ 0, 256, 1024, 1024 }, { 262144, 128, 512, 512 },
+				{ 327680, 64, 256, 256 }, { 344064, 32, 128, 256 },
+				{ 352256, 16, 64, 256 }, { 356352, 8, 32, 256 },
+				{ 358400, 4, 16, 256 }, { 359424, 2, 8, 256 },
+				{ 359936, 1, 4, 256 } } },
+			{ 100, 60, DXGI_FORMAT_R8_UNORM, 3, 26649, {
+				{ 0, 60, 100, 256 }, { 15360, 30, 50, 256 },
+				{ 23040, 15, 25, 256 } } },
+			{ 64, 64, DXGI_FORMAT_BC1_UNORM, 0, 8712, {
+				{ 0, 16, 128, 256 }, { 4096, 8, 64, 256 }, { 6144, 4, 32, 256 },
+				{ 7168, 2, 16, 256 }, { 7680, 1, 8, 256 }, { 8192, 1, 8, 256 },
+				{ 8704, 1, 8, 256 } } },
+			{ 8, 4, DXGI_FORMAT_BC7_UNORM, 0, 1552, {
+				{ 0, 1, 32, 256 }, { 512, 1, 16, 256 }, { 1024, 1, 16, 256 },
+				{ 1536, 1, 16, 256 } } },
+			{ 33, 17, DXGI_FORMAT_R16G16B16A16_FLOAT, 2, 10624, {
+				{ 0, 17, 264, 512 }, { 8704, 8, 128, 256 } } },
+			{ 3, 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 528, {
+				{ 0, 2, 48, 256 }, { 512, 1, 16, 256 } } } };
+
+		size_t nrOfChecks = 0;
+		size_t nrOfFailures = 0;
+		for (const KnownFootprint& known : KNOWN)
+		{
+			const TextureFootprint& footprint = GetTextureFootprint(known.width,
+				known.height, known.format, known.nrOfMipLevels);
+			bool matches = footprint.totalBytes == known.totalBytes &&
+				footprint.subresources.size() == known.subresources.size();
+			for (size_t i = 0; matches && i < known.subresources.size(); ++i)
+			{
+				const SubresourceFootprint& subresource = footprint.subresources[i];
+				matches = subresource.offset == known.subresources[i][0] &&
+					subresource.rows == known.subresources[i][1] &&
+					subresource.rowSize == known.subresources[i][2] &&
+					subresource.rowPitch == known.subresources[i][3];
+			}
+
+			// A second lookup has to give the memoized footprint
+			matches = matches && &footprint == &GetTextureFootprint(known.width,
+				known.height, known.format, known.nrOfMipLevels);
+
+			++nrOfChecks;
+			if (!matches)
+			{
+				++nrOfFailures;
+				output << known.width << "x" << known.height << " format " <<
+					known.format << ": differs from the known footprint" << std::endl;
+			}
+		}
+
+		const std::pair<DXGI_FORMAT, std::uint8_t> FORMATS[] = {
+			{ DXGI_FORMAT_R8_UNORM, 1 }, { DXGI_FORMAT_R8G8_UNORM, 2 },
+			{ DXGI_FORMAT_R8G8B8A8_UNORM, 4 },
+			{ DXGI_FORMAT_R16G16B16A16_FLOAT, 8 },
+			{ DXGI_FORMAT_R32G32B32A32_FLOAT, 16 } };
+		std::mt19937 generator(0);
+		std::uniform_int_distribution<UINT> sizeDistribution(1, 4096);
+		for (unsigned int i = 0; i < 200; ++i)
+		{
+			UINT width = sizeDistribution(generator);
+			UINT height = sizeDistribution(generator);
+			for (auto& format : FORMATS)
+			{
+				std::vector<UINT> rows;
+				std::vector<UINT64> rowSizes;
+				CalculateMipChainLayout(width, height, format.second, rows,
+					rowSizes);
+				const TextureFootprint& footprint = GetTextureFootprint(width,
+					height, format.first);
+
+				bool matches = footprint.subresources.size() == rows.size();
+				UINT64 end = 0;
+				for (size_t level = 0; matches && level < rows.size(); ++level)
+				{
+					const SubresourceFootprint& subresource =
+						footprint.subresources[level];
+					UINT64 placement = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+					UINT pitch = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+					matches = subresource.rows == rows[level] &&
+						subresource.rowSize == rowSizes[level] &&
+						subresource.offset >= end && subresource.offset % placement == 0 &&
+						subresource.rowPitch % pitch == 0 &&
+						subresource.rowPitch - subresource.rowSize < pitch;
+					end = subresource.offset + static_cast<UINT64>(
+						subresource.rowPitch) * (subresource.rows - 1) +
+						subresource.rowSize;
+				}
+
+				++nrOfChecks;
+				if (!matches || footprint.totalBytes != end)
+				{
+					++nrOfFailures;
+					output << width << "x" << height << " format " << format.first <<
+						": differs from the mip chain layout" << std::endl;
+				}
+			}
+		}
+
+		output << nrOfChecks << " footprints checked, " << nrOfFailures <<
+			" differ" << std::endl;
+		return nrOfFailures == 0 ? 0 : 1;
+	}
+
+	// Filters a BYTE texture with the settings and returns every level,
+	// level 0 included, as a vector of its own
+	std::vector<std::vector<unsigned char>> FilterSyntheticTexture(
+		const std::vector<unsigned char>& topLevel, unsigned int width,
+		unsigned int height, unsigned int components,
+		const MipFilterSettings& settings, unsigned int nrOfThreads = 0)
+	{
+		std::vector<UINT> rows;
+		std::vector<UINT64> rowSizes;
+		CalculateMipChainLayout(width, height,
+			static_cast<std::uint8_t>(components), rows, rowSizes);
+		std::vector<unsigned char> chain(
+			GetMipChainByteSize(width, height, components));
+		std::copy(topLevel.begin(), topLevel.end(), chain.begin());
+		GenerateMipChain(chain.data(), rows, rowSizes,
+			static_cast<std::uint8_t>(components), TexelFormat::BYTE, settings,
+			nrOfThreads);
+
+		std::vector<std::vector<unsigned char>> toReturn;
+		size_t offset = 0;
+		for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+		{
+			size_t byteSize = rows[mipLevel] * rowSizes[mipLevel];
+			toReturn.emplace_back(chain.begin() + offset,
+				chain.begin() + offset + byteSize);
+			offset += byteSize;
+		}
+
+		return toReturn;
+	}
+
+	// Share of the RGBA texels the pixel shader does not clip
+	float CalculateCoverage(const std::vector<unsigned char>& texels,
+		float alphaCutoff)
+	{
+		size_t covered = 0;
+		for (size_t texel = 3; texel < texels.size(); texel += 4)
+			covered += texels[texel] / 255.0f >= alphaCutoff ? 1 : 0;
+
+		return static_cast<float>(covered) / (texels.size() / 4);
+	}
+
+	// Synthetic textures with a known answer for each of the filter settings
+	int CheckMipFiltering(std::ostream& output)
+	{
+		const float ALPHA_CUTOFF = 0.1f;
+		size_t nrOfFailures = 0;
+		auto report = [&](bool passed, const std::string& description)
+			{
+				output << (passed ? "Passed: " : "Failed: ") << description <<
+					std::endl;
+				nrOfFailures += passed ? 0 : 1;
+			};
+
+		// Black and white texels average to half the light, which is 186 gamma
+		// encoded, where averaging the bytes gives 127
+		{
+			const unsigned int SIZE = 64;
+			std::vector<unsigned char> checkerboard(SIZE * SIZE * 4, 255);
+			for (unsigned int texel = 0; texel < SIZE * SIZE; ++texel)
+			{
+				unsigned char value =
+					(texel % SIZE + texel / SIZE) % 2 == 0 ? 0 : 255;
+				std::fill_n(&checkerboard[texel * 4], 3, value);
+			}
+
+			MipFilterSettings settings;
+			settings.gammaCorrect = true;
+			auto levels = FilterSyntheticTexture(checkerboard, SIZE, SIZE, 4,
+				settings);
+			auto boxLevels = FilterSyntheticTexture(checkerboard, SIZE, SIZE, 4,
+				MipFilterSettings());
+			unsigned char expected = static_cast<unsigned char>(
+				std::pow(0.5f, 1.0f / 2.2f) * 255.0f + 0.5f);
+			bool passed = true;
+			for (size_t mipLevel = 1; mipLevel < levels.size(); ++mipLevel)
+			{
+				for (size_t texel = 0; texel < levels[mipLevel].size(); ++texel)
+				{
+					passed = passed && levels[mipLevel][texel] ==
+						(texel % 4 == 3 ? 255 : expected);
+				}
+			}
+
+			report(passed, "gamma correct checkerboard, level 1 holds " +
+				std::to_string(levels[1][0]) + " where the box filter gives " +
+				std::to_string(boxLevels[1][0]));
+		}
+
+		// Blades of grass about a texel wide with soft edges over a transparent
+		// background, the alpha of averaged levels falls below the cutoff and
+		// the blades fade
+		{
+			const unsigned int SIZE = 512;
+			std::vector<unsigned char> foliage(SIZE * SIZE * 4, 0);
+			for (unsigned int texel = 0; texel < SIZE * SIZE; ++texel)
+			{
+				foliage[texel * 4] = 40;
+				foliage[texel * 4 + 1] = 160;
+				foliage[texel * 4 + 2] = 50;
+			}
+
+			std::mt19937 generator(0);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			for (unsigned int blade = 0; blade < 60; ++blade)
+			{
+				float x = unit(generator) * SIZE;
+				float y = unit(generator) * SIZE;
+				float angle = unit(generator) * 3.14159265f;
+				float length = 20.0f + unit(generator) * 60.0f;
+				for (float step = 0.0f; step < length; step += 0.25f)
+				{
+					float pointX = x + std::cos(angle) * step;
+					float pointY = y + std::sin(angle) * step;
+					for (int row = static_cast<int>(pointY) - 1;
+						row <= static_cast<int>(pointY) + 1; ++row)
+					{
+						for (int column = static_cast<int>(pointX) - 1;
+							column <= static_cast<int>(pointX) + 1; ++column)
+						{
+							if (column < 0 || row < 0 ||
+								column >= static_cast<int>(SIZE) ||
+								row >= static_cast<int>(SIZE))
+							{
+								continue;
+							}
+
+							float distance = std::hypot(column + 0.5f - pointX,
+								row + 0.5f - pointY);
+							unsigned char alpha = static_cast<unsigned char>(
+								std::clamp(1.2f - distance, 0.0f, 1.0f) * 255.0f);
+							unsigned char& stored =
+								foliage[(row * SIZE + column) * 4 + 3];
+							stored = std::max(stored, alpha);
+						}
+					}
+				}
+			}
+
+			MipFilterSettings settings;
+			settings.gammaCorrect = true;
+			settings.preserveAlphaCoverage = true;
+			settings.alphaCutoff = ALPHA_CUTOFF;
+			auto levels = FilterSyntheticTexture(foliage, SIZE, SIZE, 4, settings);
+			auto boxLevels = FilterSyntheticTexture(foliage, SIZE, SIZE, 4,
+				MipFilterSettings());
+			float topCoverage = CalculateCoverage(levels[0], ALPHA_CUTOFF);
+			bool passed = true;
+			output << "Foliage coverage, level 0 " << topCoverage << std::endl;
+			for (size_t mipLevel = 1; mipLevel < levels.size(); ++mipLevel)
+			{
+				float coverage = CalculateCoverage(levels[mipLevel], ALPHA_CUTOFF);
+				output << "  level " << mipLevel << ": " << coverage << ", box " <<
+					CalculateCoverage(boxLevels[mipLevel], ALPHA_CUTOFF) << std::endl;
+
+				// Smaller levels have too few texels to match it closely
+				if (levels[mipLevel].size() / 4 >= 256)
+					passed = passed && std::fabs(coverage - topCoverage) <= 0.005f;
+			}
+
+			report(passed, "alpha coverage within 0.005 of level 0 down to 16x16");
+
+			std::vector<std::vector<unsigned char>> threadedLevels[2];
+			settings.kernel = MipKernel::LANCZOS;
+			threadedLevels[0] = FilterSyntheticTexture(foliage, SIZE, SIZE, 4,
+				settings, 1);
+			threadedLevels[1] = FilterSyntheticTexture(foliage, SIZE, SIZE, 4,
+				settings, 4);
+			report(threadedLevels[0] == threadedLevels[1],
+				"filtered levels equal on one and on four threads");
+		}
+
+		// Random normals tilted up to 60 degrees, averaged they are shorter
+		// than unit length unless renormalized
+		{
+			const unsigned int SIZE = 128;
+			std::vector<unsigned char> normals(SIZE * SIZE * 4, 255);
+			std::vector<unsigned char> twoChannelNormals(SIZE * SIZE * 2);
+			std::mt19937 generator(1);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			for (unsigned int texel = 0; texel < SIZE * SIZE; ++texel)
+			{
+				float tilt = unit(generator) * 3.14159265f / 3.0f;
+				float direction = unit(generator) * 2.0f * 3.14159265f;
+				float normal[3] = { std::sin(tilt) * std::cos(direction),
+					std::sin(tilt) * std::sin(direction), std::cos(tilt) };
+				for (unsigned int component = 0; component < 3; ++component)
+				{
+					normals[texel * 4 + component] = static_cast<unsigned char>(
+						(normal[component] * 0.5f + 0.5f) * 255.0f + 0.5f);
+				}
+
+				twoChannelNormals[texel * 2] = normals[texel * 4];
+				twoChannelNormals[texel * 2 + 1] = normals[texel * 4 + 1];
+			}
+
+			auto length = [](const unsigned char* texel)
+				{
+					float squared = 0.0f;
+					for (unsigned int component = 0; component < 3; ++component)
+					{
+						float value = texel[component] / 127.5f - 1.0f;
+						squared += value * value;
+					}
+
+					return std::sqrt(squared);
+				};
+
+			MipFilterSettings settings;
+			settings.renormalizeNormals = true;
+			auto levels = FilterSyntheticTexture(normals, SIZE, SIZE, 4, settings);
+			auto boxLevels = FilterSyntheticTexture(normals, SIZE, SIZE, 4,
+				MipFilterSettings());
+			auto twoChannelLevels = FilterSyntheticTexture(twoChannelNormals, SIZE,
+				SIZE, 2, settings);
+			float largestError = 0.0f;
+			float boxLengthSum = 0.0f;
+			int largestDifference = 0;
+			for (size_t mipLevel = 1; mipLevel < levels.size(); ++mipLevel)
+			{
+				for (size_t texel = 0; texel < levels[mipLevel].size() / 4; ++texel)
+				{
+					largestError = std::max(largestError,
+						std::fabs(length(&levels[mipLevel][texel * 4]) - 1.0f));
+					for (unsigned int component = 0; component < 2; ++component)
+					{
+						largestDifference = std::max(largestDifference, std::abs(
+							levels[mipLevel][texel * 4 + component] -
+							twoChannelLevels[mipLevel][texel * 2 + component]));
+					}
+				}
+			}
+
+			for (size_t texel = 0; texel < boxLevels[1].size() / 4; ++texel)
+				boxLengthSum += length(&boxLevels[1][texel * 4]);
+
+			report(largestError <= 0.02f, "renormalized normals within 0.02 of "
+				"unit length, largest error " + std::to_string(largestError) +
+				", box filtered level 1 mean length " +
+				std::to_string(boxLengthSum / (boxLevels[1].size() / 4)));
+			report(largestDifference <= 2, "two channel normals within 2 of the "
+				"x and y of the same normals with z, largest difference " +
+				std::to_string(largestDifference));
+		}
+
+		// Every kernel keeps a constant texture constant and the inside of a
+		// ramp a ramp, on odd and even sizes alike
+		const std::pair<MipKernel, const char*> KERNELS[] = {
+			{ MipKernel::BOX, "box" }, { MipKernel::KAISER, "Kaiser" },
+			{ MipKernel::LANCZOS, "Lanczos" } };
+		for (auto& kernel : KERNELS)
+		{
+			bool constant = true;
+			for (bool gammaCorrect : { false, true })
+			{
+				for (auto& size : { std::make_pair(37u, 23u),
+					std::make_pair(64u, 64u), std::make_pair(1u, 9u) })
+				{
+					const unsigned char VALUE[4] = { 77, 140, 200, 255 };
+					std::vector<unsigned char> flat(size.first * size.second * 4);
+					for (size_t component = 0; component < flat.size(); ++component)
+						flat[component] = VALUE[component % 4];
+
+					MipFilterSettings settings;
+					settings.kernel = kernel.first;
+					settings.gammaCorrect = gammaCorrect;
+					settings.preserveAlphaCoverage = true;
+					for (auto& level : FilterSyntheticTexture(flat, size.first,
+						size.second, 4, settings))
+					{
+						for (size_t component = 0; component < level.size();
+							++component)
+						{
+							constant = constant &&
+								level[component] == VALUE[component % 4];
+						}
+					}
+				}
+			}
+
+			const unsigned int RAMP_WIDTH = 256;
+			const unsigned int RAMP_HEIGHT = 16;
+			std::vector<unsigned char> ramp(RAMP_WIDTH * RAMP_HEIGHT);
+			std::vector<unsigned char> sine(RAMP_WIDTH * RAMP_HEIGHT);
+			for (size_t texel = 0; texel < ramp.size(); ++texel)
+			{
+				ramp[texel] = static_cast<unsigned char>(texel % RAMP_WIDTH);
+				sine[texel] = static_cast<unsigned char>(127.5f + 127.0f *
+					std::sin((texel % RAMP_WIDTH) * 2.0f * 3.14159265f / 6.0f));
+			}
+
+			MipFilterSettings settings;
+			settings.kernel = kernel.first;
+			settings.preserveAlphaCoverage = true; // Not the plain box path
+			auto rampLevels = FilterSyntheticTexture(ramp, RAMP_WIDTH, RAMP_HEIGHT,
+				1, settings);
+			bool linear = true;
+			for (unsigned int texel = 4; texel < RAMP_WIDTH / 2 - 4; ++texel)
+			{
+				linear = linear &&
+					std::fabs(rampLevels[1][texel] - (texel * 2.0f + 0.5f)) <= 1.0f;
+			}
+
+			auto sineLevels = FilterSyntheticTexture(sine, RAMP_WIDTH, RAMP_HEIGHT,
+				1, settings);
+			auto extremes = std::minmax_element(sineLevels[1].begin() + 8,
+				sineLevels[1].begin() + RAMP_WIDTH / 2 - 8);
+			report(constant && linear, std::string(kernel.second) +
+				" keeps constants and ramps, a sine of a six texel period keeps " +
+				std::to_string((*extremes.second - *extremes.first) / 254.0f) +
+				" of its contrast in level 1");
+		}
+
+		return nrOfFailures == 0 ? 0 : 1;
+	}
+
+	// Filters the full mip chain of a texture as BYTE and as FLOAT RGBA with
+	// every instruction set the processor supports, on one and on nrOfThreads
+	// threads. The throughput is that of the top level.
+	int BenchmarkMipGeneration(const std::string& file, unsigned int nrOfThreads,
+		std::ostream& output)
+	{
+		int width = 0;
+		int height = 0;
+		stbi_uc* decoded = stbi_load(file.c_str(), &width, &height, nullptr, 4);
+		if (decoded == nullptr)
+		{
+			output << "Could not decode " << file << std::endl;
+			return 1;
+		}
+
+		if (nrOfThreads == 0)
+			nrOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		size_t nrOfComponents = static_cast<size_t>(width) * height * 4;
+		InstructionSet supported = GetSupportedInstructionSet();
+		output << file << ": " << width << "x" << height << ", " <<
+			GetInstructionSetName(supported) << " supported" << std::endl;
+
+		int mismatches = 0;
+		for (TexelFormat texelFormat : { TexelFormat::BYTE, TexelFormat::FLOAT })
+		{
+			bool isFloat = texelFormat == TexelFormat::FLOAT;
+			size_t componentSize = isFloat ? sizeof(float) : 1;
+			std::vector<UINT> rows;
+			std::vector<UINT64> rowSizes;
+			CalculateMipChainLayout(width, height,
+				static_cast<std::uint8_t>(4 * componentSize), rows, rowSizes);
+			size_t totalSize = 0;
+			for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+				totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+			std::vector<unsigned char> reference(totalSize);
+			for (size_t i = 0; i < nrOfComponents; ++i)
+			{
+				if (isFloat)
+				{
+					float value = decoded[i] / 255.0f;
+					memcpy(reference.data() + i * sizeof(float), &value,
+						sizeof(float));
+				}
+				else
+				{
+					reference[i] = decoded[i];
+				}
+			}
+
+			std::vector<unsigned char> generated(reference);
+			double megabytes = rows[0] * rowSizes[0] / (1024.0 * 1024.0);
+			double scalarMilliseconds = 0.0;
+			for (InstructionSet instructionSet : { InstructionSet::SCALAR,
+				InstructionSet::SSE, InstructionSet::AVX2 })
+			{
+				if (instructionSet > supported)
+					break;
+
+				for (unsigned int threads : { 1u, nrOfThreads })
+				{
+					bool scalar = instructionSet == InstructionSet::SCALAR &&
+						threads == 1;
+					unsigned char* chain = scalar ? reference.data() :
+						generated.data();
+					double milliseconds = TimeKernel([&]()
+						{
+							GenerateMipChain(chain, rows, rowSizes, 4, texelFormat,
+								threads, instructionSet);
+						});
+
+					if (scalar)
+						scalarMilliseconds = milliseconds;
+
+					bool identical = scalar || generated == reference;
+					if (!identical)
+						++mismatches;
+
+					output << (isFloat ? "FLOAT " : "BYTE ") <<
+						GetInstructionSetName(instructionSet) << ", " << threads <<
+						" threads: " << milliseconds << " ms, " <<
+						megabytes / (milliseconds / 1000.0) << " MB/s (" <<
+						scalarMilliseconds / milliseconds << "x)" <<
+						(identical ? "" : ", differs from scalar") << std::endl;
+
+					if (nrOfThreads == 1)
+						break;
+				}
+			}
+		}
+
+		stbi_image_free(decoded);
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	// Largest relative error of a packed value from the value itself, over
+	// values in the normal range of the format
+	struct PackingError
+	{
+		double half = 0.0;
+		double red = 0.0;
+		double blue = 0.0;
+	};
+
+	// Every value of each format has to survive unpacking and packing, values
+	// between them have to be rounded to within half a unit in the last place
+	// and every instruction set has to give the same bits as the scalar path
+	// for a sweep over every sign, exponent and mantissa of a float
+	int CheckFloatPacking(std::ostream& output)
+	{
+		size_t nrOfFailures = 0;
+		for (std::uint32_t half = 0; half < 0x10000; ++half)
+		{
+			bool nan = (half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0;
+			float value = UnpackHalf(static_cast<std::uint16_t>(half));
+			std::uint16_t packed = 0;
+			PackHalfStream(&value, 1, &packed, InstructionSet::SCALAR);
+			nrOfFailures += !nan && packed != half ? 1 : 0;
+		}
+
+		for (std::uint32_t value = 0; value < 0x7C0; ++value)
+		{
+			std::uint32_t packed = value | (value << 11) | ((value >> 1) << 22);
+			float texel[4] = {};
+			UnpackR11G11B10(packed, texel);
+			std::uint32_t repacked = 0;
+			PackR11G11B10Stream(texel, 1, &repacked, InstructionSet::SCALAR);
+			nrOfFailures += repacked != packed ? 1 : 0;
+		}
+
+		output << "Round trips: " << nrOfFailures << " values changed" <<
+			std::endl;
+
+		// Values from the smallest normal value to the largest finite one
+		std::mt19937 generator(0);
+		std::uniform_real_distribution<float> exponentDistribution(-14.0f,
+			15.9f);
+		const size_t NR_OF_VALUES = 1 << 20;
+		std::vector<float> values(NR_OF_VALUES);
+		for (float& value : values)
+			value = std::exp2(exponentDistribution(generator));
+
+		std::vector<std::uint16_t> halves(NR_OF_VALUES);
+		std::vector<std::uint32_t> packed(NR_OF_VALUES / 4);
+		PackHalfStream(values.data(), NR_OF_VALUES, halves.data());
+		PackR11G11B10Stream(values.data(), NR_OF_VALUES / 4, packed.data());
+
+		PackingError error;
+		for (size_t i = 0; i < NR_OF_VALUES; ++i)
+		{
+			double value = values[i];
+			error.half = std::max(error.half,
+				std::fabs(UnpackHalf(halves[i]) - value) / value);
+			if (i % 4 == 0 || i % 4 == 2)
+			{
+				float texel[3];
+				UnpackR11G11B10(packed[i / 4], texel);
+				double& channelError = i % 4 == 0 ? error.red : error.blue;
+				channelError = std::max(channelError,
+					std::fabs(texel[i % 4] - value) / value);
+			}
+		}
+
+		bool accurate = error.half <= std::ldexp(1.0, -11) &&
+			error.red <= std::ldexp(1.0, -7) && error.blue <= std::ldexp(1.0, -6);
+		nrOfFailures += accurate ? 0 : 1;
+		output << "Largest relative error: half " << error.half << ", 11 bit " <<
+			error.red << ", 10 bit " << error.blue <<
+			(accurate ? "" : ", more than half a unit in the last place") <<
+			std::endl;
+
+		// Specials and values past the ends of the ranges
+		const float infinity = std::numeric_limits<float>::infinity();
+		const float SPECIALS[] = { 0.0f, -0.0f, 65504.0f, 65520.0f, 1e10f,
+			infinity, -infinity, -1.0f, std::ldexp(1.0f, -25),
+			std::ldexp(1.0f, -24), std::numeric_limits<float>::quiet_NaN() };
+		const std::uint16_t EXPECTED_HALVES[] = { 0x0000, 0x8000, 0x7BFF,
+			0x7C00, 0x7C00, 0x7C00, 0xFC00, 0xBC00, 0x0000, 0x0001, 0x7E00 };
+		const std::uint32_t EXPECTED_RED[] = { 0x000, 0x000, 0x7BF, 0x7BF,
+			0x7BF, 0x7C0, 0x000, 0x000, 0x000, 0x000, 0x7E0 };
+		size_t nrOfWrongSpecials = 0;
+		for (size_t i = 0; i < std::size(SPECIALS); ++i)
+		{
+			std::uint16_t half = 0;
+			std::uint32_t texel = 0;
+			float source[4] = { SPECIALS[i], 0.0f, 0.0f, 0.0f };
+			PackHalfStream(source, 1, &half);
+			PackR11G11B10Stream(source, 1, &texel);
+			if (half != EXPECTED_HALVES[i] || (texel & 0x7FF) != EXPECTED_RED[i])
+				++nrOfWrongSpecials;
+		}
+
+		nrOfFailures += nrOfWrongSpecials;
+		output << "Special values: " << nrOfWrongSpecials << " wrong" <<
+			std::endl;
+
+		// Every 251st bit pattern, which steps through every exponent and
+		// mantissa bit of both signs
+		const std::uint64_t STEP = 251;
+		const size_t BATCH = 1 << 20;
+		std::vector<float> sweep(BATCH);
+		std::vector<std::uint16_t> halfReference(BATCH);
+		std::vector<std::uint16_t> halfResult(BATCH);
+		std::vector<std::uint32_t> packedReference(BATCH / 4);
+		std::vector<std::uint32_t> packedResult(BATCH / 4);
+		InstructionSet supported = GetSupportedInstructionSet();
+		size_t nrOfMismatches = 0;
+		for (std::uint64_t start = 0; start < (1ull << 32); start += STEP * BATCH)
+		{
+			for (size_t i = 0; i < BATCH; ++i)
+			{
+				std::uint32_t bits = static_cast<std::uint32_t>(start + i * STEP);
+				memcpy(&sweep[i], &bits, sizeof(float));
+			}
+
+			PackHalfStream(sweep.data(), BATCH, halfReference.data(),
+				InstructionSet::SCALAR);
+			PackR11G11B10Stream(sweep.data(), BATCH / 4, packedReference.data(),
+				InstructionSet::SCALAR);
+			for (InstructionSet instructionSet : { InstructionSet::SSE,
+				InstructionSet::AVX2 })
+			{
+				if (instructionSet > supported)
+					break;
+
+				PackHalfStream(sweep.data(), BATCH, halfResult.data(),
+					instructionSet);
+				PackR11G11B10Stream(sweep.data(), BATCH / 4, packedResult.data(),
+					instructionSet);
+				nrOfMismatches += halfResult != halfReference ? 1 : 0;
+				nrOfMismatches += packedResult != packedReference ? 1 : 0;
+			}
+		}
+
+		nrOfFailures += nrOfMismatches;
+		output << "Instruction sets: " << nrOfMismatches <<
+			" batches differ from scalar" << std::endl;
+
+		return nrOfFailures == 0 ? 0 : 1;
+	}
+
+	// Times the float mip chain of an HDR file and packing it to both upload
+	// formats with every instruction set the processor supports, and reports
+	// how far the packed level 0 is from the decoded one
+	int BenchmarkHdrTexture(const std::string& file, unsigned int nrOfThreads,
+		std::ostream& output)
+	{
+		int width = 0;
+		int height = 0;
+		float* decoded = stbi_loadf(file.c_str(), &width, &height, nullptr, 4);
+		if (decoded == nullptr)
+		{
+			output << "Could not decode " << file << std::endl;
+			return 1;
+		}
+
+		std::vector<UINT> rows;
+		std::vector<UINT64> rowSizes;
+		CalculateMipChainLayout(width, height, 4 * sizeof(float), rows,
+			rowSizes);
+		size_t topLevelSize = rows[0] * rowSizes[0];
+		size_t totalSize = 0;
+		for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+			totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+		std::vector<unsigned char> lowerLevels(totalSize - topLevelSize);
+		MipFilterSettings settings = MeshResourceLoader::GetMipFilterSettings(
+			MaterialMap::DIFFUSE, MipFilteringSettings());
+		settings.gammaCorrect = false;
+		double mipMilliseconds = TimeKernel([&]()
+			{
+				GenerateMipChain(reinterpret_cast<unsigned char*>(decoded),
+					lowerLevels.data(), rows, rowSizes, 4, TexelFormat::FLOAT,
+					settings, nrOfThreads);
+			});
+
+		size_t nrOfTexels = static_cast<size_t>(width) * height;
+		double megabytes = topLevelSize / (1024.0 * 1024.0);
+		InstructionSet supported = GetSupportedInstructionSet();
+		output << file << ": " << width << "x" << height << ", float mips " <<
+			mipMilliseconds << " ms, " << GetInstructionSetName(supported) <<
+			" supported" << std::endl;
+
+		std::vector<std::uint16_t> halves(nrOfTexels * 4);
+		std::vector<std::uint32_t> packed(nrOfTexels);
+		std::vector<std::uint16_t> halfReference;
+		std::vector<std::uint32_t> packedReference;
+		double scalarMilliseconds[2] = {};
+		int mismatches = 0;
+		for (InstructionSet instructionSet : { InstructionSet::SCALAR,
+			InstructionSet::SSE, InstructionSet::AVX2 })
+		{
+			if (instructionSet > supported)
+				break;
+
+			double milliseconds[2];
+			milliseconds[0] = TimeKernel([&]()
+				{
+					PackHalfStream(decoded, nrOfTexels * 4, halves.data(),
+						instructionSet);
+				});
+			milliseconds[1] = TimeKernel([&]()
+				{
+					PackR11G11B10Stream(decoded, nrOfTexels, packed.data(),
+						instructionSet);
+				});
+
+			bool scalar = instructionSet == InstructionSet::SCALAR;
+			if (scalar)
+			{
+				std::copy(milliseconds, milliseconds + 2, scalarMilliseconds);
+				halfReference = halves;
+				packedReference = packed;
+			}
+
+			bool identical = halves == halfReference && packed == packedReference;
+			if (!identical)
+				++mismatches;
+
+			const char* formatNames[2] = { "R16G16B16A16", "R11G11B10" };
+			output << GetInstructionSetName(instructionSet) << ":";
+			for (size_t i = 0; i < 2; ++i)
+			{
+				output << " " << formatNames[i] << " " << milliseconds[i] <<
+					" ms, " << megabytes / (milliseconds[i] / 1000.0) << " MB/s (" <<
+					scalarMilliseconds[i] / milliseconds[i] << "x)";
+			}
+
+			output << (identical ? "" : ", differs from scalar") << std::endl;
+		}
+
+		// Relative to the brightest channel of the texel, so dark channels
+		// next to bright ones do not dominate
+		double meanError[2] = {};
+		double maxError[2] = {};
+		for (size_t texel = 0; texel < nrOfTexels; ++texel)
+		{
+			const float* source = decoded + texel * 4;
+			float unpacked[3];
+			UnpackR11G11B10(packed[texel], unpacked);
+			double brightest = std::max({ source[0], source[1], source[2] });
+			if (brightest <= 0.0)
+				continue;
+
+			for (unsigned int channel = 0; channel < 3; ++channel)
+			{
+				double errors[2] = {
+					std::fabs(UnpackHalf(halves[texel * 4 + channel]) -
+						source[channel]) / brightest,
+					std::fabs(unpacked[channel] - source[channel]) / brightest };
+				for (size_t i = 0; i < 2; ++i)
+				{
+					meanError[i] += errors[i] / (nrOfTexels * 3);
+					maxError[i] = std::max(maxError[i], errors[i]);
+				}
+			}
+		}
+
+		output << "Relative error, R16G16B16A16: mean " << meanError[0] <<
+			", max " << maxError[0] << "; R11G11B10: mean " << meanError[1] <<
+			", max " << maxError[1] << std::endl;
+
+		stbi_image_free(decoded);
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	// Stages the mip chain of a decoded texture as the loader did before, the
+	// full chain in a zero filled buffer with level 0 copied in, and as it does
+	// now, only the levels below level 0, and checks both give the same levels
+	int ReportMipStaging(const std::string& file, MaterialMap map,
+		unsigned int nrOfThreads, std::ostream& output)
+	{
+		int width = 0;
+		int height = 0;
+		stbi_uc* decoded = stbi_load(file.c_str(), &width, &height, nullptr, 4);
+		if (decoded == nullptr)
+		{
+			output << "Could not decode " << file << std::endl;
+			return 1;
+		}
+
+		MipFilterSettings settings = MeshResourceLoader::GetMipFilterSettings(map,
+			MipFilteringSettings());
+		std::vector<UINT> rows;
+		std::vector<UINT64> rowSizes;
+		CalculateMipChainLayout(width, height, 4, rows, rowSizes);
+		size_t topLevelSize = rows[0] * rowSizes[0];
+		size_t totalSize = 0;
+		for (size_t mipLevel = 0; mipLevel < rows.size(); ++mipLevel)
+			totalSize += rows[mipLevel] * rowSizes[mipLevel];
+
+		std::vector<unsigned char> fullChain;
+		double fullChainMilliseconds = TimeKernel([&]()
+			{
+				fullChain = std::vector<unsigned char>(totalSize);
+				memcpy(fullChain.data(), decoded, topLevelSize);
+				GenerateMipChain(fullChain.data(), rows, rowSizes, 4,
+					TexelFormat::BYTE, settings, nrOfThreads);
+			});
+
+		std::unique_ptr<unsigned char[]> lowerLevels;
+		double lowerLevelsMilliseconds = TimeKernel([&]()
+			{
+				lowerLevels.reset(new unsigned char[totalSize - topLevelSize]);
+				GenerateMipChain(decoded, lowerLevels.get(), rows, rowSizes, 4,
+					TexelFormat::BYTE, settings, nrOfThreads);
+			});
+
+		bool identical = memcmp(fullChain.data() + topLevelSize,
+			lowerLevels.get(), totalSize - topLevelSize) == 0;
+		stbi_image_free(decoded);
+
+		output << file << ": " << width << "x" << height << ", " <<
+			GetMaterialMapName(map) << ", " << rows.size() << " levels, " <<
+			totalSize << " bytes uploaded" << std::endl;
+		output << "Full chain: " << totalSize << " bytes staged, " <<
+			topLevelSize << " bytes copied, " << fullChainMilliseconds << " ms" <<
+			std::endl;
+		output << "Lower levels: " << totalSize - topLevelSize <<
+			" bytes staged, 0 bytes copied, " << lowerLevelsMilliseconds <<
+			" ms" << (identical ? "" : ", levels differ") << std::endl;
+
+		return identical ? 0 : 1;
+	}
+
+	// Baked textures are not used, as they always keep four channels
+	int ReportMaterialMapNarrowing(const std::string& file, std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		loader.SetBakedTextureUsage(false);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		for (auto& entry : preparedMesh.textures)
+		{
+			const DecodedTexture& texture = entry.second;
+			output << entry.first << ": " << texture.width << "x" <<
+				texture.height << ", " << texture.componentsPerTexel <<
+				(texture.componentsPerTexel == 1 ? " channel, " : " channels, ") <<
+				GetMipChainByteSize(static_cast<unsigned int>(texture.width),
+					static_cast<unsigned int>(texture.height),
+					texture.componentsPerTexel) << " bytes with mips" << std::endl;
+		}
+
+		const LoadStatistics& statistics = loader.GetLoadStatistics();
+		size_t rgbaBytes = statistics.materialMapBytes +
+			statistics.materialMapBytesSaved;
+		output << preparedMesh.textures.size() << " maps, " <<
+			statistics.nrOfGreyscaleSpecularMaps << " greyscale specular, " <<
+			statistics.nrOfTwoChannelNormalMaps << " two channel normal, " <<
+			rgbaBytes << " -> " << statistics.materialMapBytes << " bytes, " <<
+			statistics.materialMapBytesSaved << " bytes saved (" <<
+			(rgbaBytes == 0 ? 0.0 :
+				100.0 * statistics.materialMapBytesSaved / rgbaBytes) << "%)" <<
+			std::endl;
+
+		return 0;
+	}
+
+	// Circles the mesh once while moving in close to it halfway and back out,
+	// always at the same height above its center
+	std::vector<DirectX::XMFLOAT3> GenerateStreamingPath(
+		const StreamingBounds& bounds, size_t nrOfFrames)
+	{
+		std::vector<DirectX::XMFLOAT3> toReturn;
+		toReturn.reserve(nrOfFrames);
+		float radius = std::max(bounds.radius, 0.001f);
+		for (size_t frame = 0; frame < nrOfFrames; ++frame)
+		{
+			float t = nrOfFrames > 1 ?
+				static_cast<float>(frame) / (nrOfFrames - 1) : 0.0f;
+			float angle = DirectX::XM_2PI * t;
+			float distance = radius * (1.2f + 1.8f * (0.5f + 0.5f * std::cos(angle)));
+			toReturn.push_back({ bounds.center.x + std::sin(angle) * distance,
+				bounds.center.y + 0.5f * radius,
+				bounds.center.z - std::cos(angle) * distance });
+		}
+
+		return toReturn;
+	}
+
+	// Registers every material map of the mesh with the streamer, with the
+	// same formats and users the loader gives them, and returns the bounds of
+	// the whole mesh
+	StreamingBounds AddStreamedTextures(const PreparedMesh& preparedMesh,
+		const std::string& directory, TextureStreamer& streamer)
+	{
+		std::unordered_map<std::string, StreamedTextureIndex> added[3];
+		float minimum[3] = { std::numeric_limits<float>::max(),
+			std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		float maximum[3] = { -minimum[0], -minimum[1], -minimum[2] };
+		for (auto& streams : preparedMesh.subMeshes)
+		{
+			StreamingBounds bounds = CalculateStreamingBounds(streams.positions,
+				streams.uvs, streams.nrOfVertices);
+			const float center[3] = { bounds.center.x, bounds.center.y,
+				bounds.center.z };
+			for (size_t axis = 0; axis < 3; ++axis)
+			{
+				minimum[axis] = std::min(minimum[axis], center[axis] - bounds.radius);
+				maximum[axis] = std::max(maximum[axis], center[axis] + bounds.radius);
+			}
+
+			const char* maps[3] = { streams.diffuseMap, streams.specularMap,
+				streams.normalMap };
+			for (size_t map = 0; map < 3; ++map)
+			{
+				if (maps[map] == nullptr)
+					continue;
+
+				std::string filepath = directory + maps[map];
+				auto decoded = preparedMesh.textures.find(filepath);
+				if (decoded == preparedMesh.textures.end())
+					continue;
+
+				auto texture = added[map].find(filepath);
+				if (texture == added[map].end())
+				{
+					const DecodedTexture& decodedTexture = decoded->second;
+					DXGI_FORMAT format = decodedTexture.hdr ?
+						DXGI_FORMAT_R16G16B16A16_FLOAT :
+						GetNarrowedFormat(decodedTexture.componentsPerTexel);
+					StreamedTextureIndex index = streamer.AddTexture(
+						static_cast<unsigned int>(decodedTexture.width),
+						static_cast<unsigned int>(decodedTexture.height), format);
+					texture = added[map].emplace(filepath, index).first;
+				}
+
+				streamer.AddTextureUser(texture->second, bounds);
+			}
+		}
+
+		StreamingBounds toReturn;
+		if (preparedMesh.subMeshes.empty())
+			return toReturn;
+
+		toReturn.center = { 0.5f * (minimum[0] + maximum[0]),
+			0.5f * (minimum[1] + maximum[1]), 0.5f * (minimum[2] + maximum[2]) };
+		toReturn.radius = 0.5f * std::sqrt(
+			(maximum[0] - minimum[0]) * (maximum[0] - minimum[0]) +
+			(maximum[1] - minimum[1]) * (maximum[1] - minimum[1]) +
+			(maximum[2] - minimum[2]) * (maximum[2] - minimum[2]));
+		return toReturn;
+	}
+
+	// Streams the material maps of a mesh along a camera path without a
+	// device, twice to check that the same path gives the same changes. A
+	// path is generated and saved if the path file does not exist. Updates
+	// over budget are only reported, as mip tails stay resident regardless.
+	int SimulateMeshTextureStreaming(const std::string& file,
+		const std::string& pathFile, size_t budget, std::ostream& output)
+	{
+		MeshResourceLoader loader;
+		std::string fileName = SetupToolLoader(loader, file);
+		PreparedMesh preparedMesh;
+		if (!loader.PrepareMesh(fileName, preparedMesh))
+		{
+			output << "Failed to load " << file << std::endl;
+			return 1;
+		}
+
+		TextureStreamingSettings settings;
+		settings.enabled = true;
+		settings.budgetBytes = budget;
+		std::string directory = file.substr(0, file.size() - fileName.size());
+		TextureStreamer streamers[2];
+		StreamingBounds meshBounds;
+		for (auto& streamer : streamers)
+		{
+			streamer.SetSettings(settings);
+			meshBounds = AddStreamedTextures(preparedMesh, directory, streamer);
+		}
+
+		std::vector<DirectX::XMFLOAT3> positions;
+		if (!pathFile.empty() && std::ifstream(pathFile))
+		{
+			if (!LoadCameraPath(pathFile, positions))
+			{
+				output << "Could not read the camera path " << pathFile << std::endl;
+				return 1;
+			}
+
+			output << "Loaded " << positions.size() << " positions from " <<
+				pathFile << std::endl;
+		}
+		else
+		{
+			positions = GenerateStreamingPath(meshBounds, 600);
+			if (!pathFile.empty() && !SaveCameraPath(pathFile, positions))
+			{
+				output << "Could not save the camera path to " << pathFile <<
+					std::endl;
+				return 1;
+			}
+
+			output << "Generated " << positions.size() << " positions" <<
+				(pathFile.empty() ? "" : ", saved to " + pathFile) << std::endl;
+		}
+
+		std::vector<StreamingView> path(positions.size());
+		for (size_t i = 0; i < positions.size(); ++i)
+			path[i].cameraPosition = positions[i];
+
+		std::vector<StreamingSimulationFrame> frames =
+			SimulateTextureStreaming(streamers[0], path);
+		std::vector<StreamingSimulationFrame> repeated =
+			SimulateTextureStreaming(streamers[1], path);
+
+		bool identical = true;
+		double totalMilliseconds = 0.0;
+		double maxMilliseconds = 0.0;
+		size_t maxUploadedBytes = 0;
+		size_t framesOverBudget = 0;
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			const StreamingSimulationFrame& frame = frames[i];
+			identical = identical &&
+				frame.nrOfChanges == repeated[i].nrOfChanges &&
+				frame.uploadedBytes == repeated[i].uploadedBytes &&
+				frame.residentBytes == repeated[i].residentBytes &&
+				frame.missingMips == repeated[i].missingMips;
+			totalMilliseconds += frame.updateMilliseconds;
+			maxMilliseconds = std::max(maxMilliseconds, frame.updateMilliseconds);
+			maxUploadedBytes = std::max(maxUploadedBytes, frame.uploadedBytes);
+			framesOverBudget += frame.residentBytes > budget ? 1 : 0;
+		}
+
+		const TextureStreamingStatistics& statistics =
+			streamers[0].GetStatistics();
+		size_t nrOfFrames = std::max<size_t>(frames.size(), 1);
+		output << preparedMesh.textures.size() << " maps, " <<
+			frames.size() << " updates, " << statistics.nrOfChanges <<
+			" changes, " << statistics.mipsStreamedIn << " levels streamed in, " <<
+			statistics.mipsEvicted << " evicted" << std::endl;
+		output << "Update: " << totalMilliseconds / nrOfFrames << " ms mean, " <<
+			maxMilliseconds << " ms max" << std::endl;
+		output << "Uploaded: " << statistics.uploadedBytes << " bytes, " <<
+			maxUploadedBytes << " bytes peak per update" << std::endl;
+		output << "Resident: " << statistics.peakResidentBytes <<
+			" bytes peak of a " << budget << " byte budget, " <<
+			framesOverBudget << " updates over budget" << std::endl;
+		output << "Missing levels: " <<
+			static_cast<double>(statistics.missingMips) / nrOfFrames <<
+			" per update" << (identical ? "" : ", runs differ") << std::endl;
+
+		return identical ? 0 : 1;
+	}
+
+	// Writes the feedback of a camera flying low over a ground plane tiled
+	// with a grid of virtual textures, one per unit square. Rows near the
+	// horizon sample coarse mips far away and the bottom rows fine mips up
+	// close, and the sample positions are jittered every frame the way a
+	// feedback pass at a fraction of the resolution would be.
+	void GenerateTerrainFeedback(size_t frame, unsigned int gridSize,
+		unsigned int textureSize, unsigned int tileSize,
+		unsigned int nrOfMipLevels, unsigned int width, unsigned int height,
+		std::vector<std::uint32_t>& toFill)
+	{
+		const float PI = 3.14159265f;
+		const float HORIZONTAL_FIELD_OF_VIEW = PI / 2.0f;
+		const float VERTICAL_FIELD_OF_VIEW = PI / 3.0f;
+		const float PITCH = PI / 6.0f;
+
+		float time = static_cast<float>(frame);
+		float cameraX = gridSize * 0.5f + 1.5f * std::sin(time * 0.005f);
+		float cameraZ = time * 0.004f;
+		float cameraHeight = 0.065f + 0.035f * std::sin(time * 0.013f);
+		float yaw = 0.3f * std::sin(time * 0.01f);
+		float jitterX = ((frame * 3) % 4 + 0.5f) / 4.0f;
+		float jitterY = ((frame * 5) % 4 + 0.5f) / 4.0f;
+		float screenScale = 2.0f * std::tan(HORIZONTAL_FIELD_OF_VIEW / 2.0f);
+
+		toFill.resize(static_cast<size_t>(width) * height);
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			float v = (y + jitterY) / height;
+			float angle = std::max(PITCH + (v - 0.5f) * VERTICAL_FIELD_OF_VIEW,
+				PI / 90.0f);
+			float slantDistance = cameraHeight / std::sin(angle);
+			float forward = cameraHeight / std::tan(angle);
+
+			// Ground footprint of a pixel, stretched along the view direction
+			float footprint = slantDistance * screenScale / width /
+				std::sin(angle);
+			float mip = std::floor(std::log2(std::max(footprint * textureSize,
+				1.0f)));
+			unsigned int level = std::min(static_cast<unsigned int>(mip),
+				nrOfMipLevels - 1);
+
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				float side = ((x + jitterX) / width - 0.5f) * screenScale *
+					slantDistance;
+				float worldX = cameraX + std::sin(yaw) * forward +
+					std::cos(yaw) * side;
+				float worldZ = cameraZ + std::cos(yaw) * forward -
+					std::sin(yaw) * side;
+				float cellX = std::floor(worldX);
+				float cellZ = std::floor(worldZ);
+				unsigned int gridX = static_cast<unsigned int>(
+					static_cast<int>(cellX) % static_cast<int>(gridSize) + gridSize) %
+					gridSize;
+				unsigned int gridZ = static_cast<unsigned int>(
+					static_cast<int>(cellZ) % static_cast<int>(gridSize) + gridSize) %
+					gridSize;
+
+				unsigned int levelSize = std::max(textureSize >> level, 1u);
+				unsigned int levelTiles = (levelSize + tileSize - 1) / tileSize;
+				TileAddress tile;
+				tile.texture = gridX + gridZ * gridSize;
+				tile.mip = level;
+				tile.x = std::min(static_cast<unsigned int>(
+					(worldX - cellX) * levelSize) / tileSize, levelTiles - 1);
+				tile.y = std::min(static_cast<unsigned int>(
+					(worldZ - cellZ) * levelSize) / tileSize, levelTiles - 1);
+				toFill[y * static_cast<size_t>(width) + x] = PackTileFeedback(tile);
+			}
+		}
+	}
+
+	// Counts the feedback entries whose page table entry does not point at
+	// the tile itself or one of its ancestors
+	size_t CountPageTableErrors(const VirtualTextureCache& cache,
+		const std::vector<std::uint32_t>& feedback)
+	{
+		size_t toReturn = 0;
+		for (std::uint32_t value : feedback)
+		{
+			TileAddress tile = UnpackTileFeedback(value);
+			PageTableEntry entry = cache.GetPageTableEntry(tile);
+			const TileAddress& sampled = cache.GetSlotTile(
+				GetPageTableSlot(entry));
+			unsigned int sampledMip = GetPageTableMip(entry);
+			while (tile.mip < sampledMip)
+			{
+				++tile.mip;
+				tile.x = std::min(tile.x / 2,
+					cache.GetNrOfTilesX(tile.texture, tile.mip) - 1);
+				tile.y = std::min(tile.y / 2,
+					cache.GetNrOfTilesY(tile.texture, tile.mip) - 1);
+			}
+
+			bool valid = sampled.texture == tile.texture &&
+				sampled.mip == tile.mip && sampled.x == tile.x &&
+				sampled.y == tile.y;
+			toReturn += valid ? 0 : 1;
+		}
+
+		return toReturn;
+	}
+
+	// Runs the cache over synthetic terrain feedback twice, to check that the
+	// same feedback loads the same tiles, and reports how many sampled tiles
+	// were resident and the bandwidth of the tiles uploaded
+	int SimulateVirtualTexturing(size_t nrOfFrames,
+		const VirtualTextureSettings& settings, std::ostream& output)
+	{
+		const unsigned int GRID_SIZE = 4;
+		const unsigned int TEXTURE_SIZE = 8192;
+		const unsigned int FEEDBACK_WIDTH = 240;
+		const unsigned int FEEDBACK_HEIGHT = 135;
+
+		std::vector<size_t> uploadsPerFrame[2];
+		std::vector<std::uint32_t> feedback;
+		std::vector<TileUpload> uploads;
+		size_t pageTableErrors = 0;
+		double totalMilliseconds = 0.0;
+		double maxMilliseconds = 0.0;
+		VirtualTextureStatistics statistics;
+		size_t tileBytes = 0;
+		unsigned int nrOfMipLevels = 0;
+		for (size_t run = 0; run < 2; ++run)
+		{
+			VirtualTextureCache cache(settings);
+			for (unsigned int i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+			{
+				if (cache.AddTexture(TEXTURE_SIZE, TEXTURE_SIZE) ==
+					VirtualTextureIndex(-1))
+				{
+					output << "The pool is too small for the coarsest tiles" <<
+						std::endl;
+					return 1;
+				}
+			}
+
+			nrOfMipLevels = cache.GetNrOfMipLevels(0);
+			for (size_t frame = 0; frame < nrOfFrames; ++frame)
+			{
+				GenerateTerrainFeedback(frame, GRID_SIZE, TEXTURE_SIZE,
+					settings.tileSize, nrOfMipLevels, FEEDBACK_WIDTH,
+					FEEDBACK_HEIGHT, feedback);
+
+				auto updateStart = std::chrono::steady_clock::now();
+				cache.ProcessFeedback(feedback.data(), feedback.size(), uploads);
+				std::chrono::duration<double, std::milli> updateTime =
+					std::chrono::steady_clock::now() - updateStart;
+
+				uploadsPerFrame[run].push_back(uploads.size());
+				if (run == 0)
+				{
+					totalMilliseconds += updateTime.count();
+					maxMilliseconds = std::max(maxMilliseconds, updateTime.count());
+					pageTableErrors += CountPageTableErrors(cache, feedback);
+				}
+			}
+
+			statistics = run == 0 ? cache.GetStatistics() : statistics;
+			tileBytes = cache.GetTileBytes();
+		}
+
+		bool identical = uploadsPerFrame[0] == uploadsPerFrame[1];
+		size_t maxUploads = uploadsPerFrame[0].empty() ? 0 :
+			*std::max_element(uploadsPerFrame[0].begin(),
+				uploadsPerFrame[0].end());
+		size_t nrOfUpdates = std::max<size_t>(statistics.nrOfUpdates, 1);
+		unsigned int layerSize = settings.tileSize + 2 * settings.tileBorder;
+		output << GRID_SIZE * GRID_SIZE << " textures of " << TEXTURE_SIZE <<
+			"x" << TEXTURE_SIZE << " with " << nrOfMipLevels << " tiled levels, " <<
+			settings.poolTiles << " tile pool of " << layerSize << "x" <<
+			layerSize << " texel layers, " << FEEDBACK_WIDTH << "x" <<
+			FEEDBACK_HEIGHT << " feedback" << std::endl;
+		output << "Hit rate: " << (statistics.tileRequests == 0 ? 0.0 :
+			100.0 * statistics.tileHits / statistics.tileRequests) <<
+			"% of tiles, " << (statistics.feedbackEntries == 0 ? 0.0 :
+				100.0 * statistics.feedbackHits / statistics.feedbackEntries) <<
+			"% of samples" << std::endl;
+		output << "Uploaded: " << statistics.tilesUploaded << " tiles, " <<
+			statistics.uploadedBytes << " bytes, " <<
+			statistics.uploadedBytes / (1024.0 * 1024.0) / nrOfUpdates <<
+			" MiB per update, " << maxUploads << " tiles (" <<
+			maxUploads * tileBytes << " bytes) peak per update" << std::endl;
+		output << "Evicted: " << statistics.tilesEvicted << " tiles, " <<
+			statistics.tilesDeferred << " deferred, " <<
+			statistics.peakResidentTiles << " peak resident" << std::endl;
+		output << "Update: " << totalMilliseconds / nrOfUpdates << " ms mean, " <<
+			maxMilliseconds << " ms max, " << pageTableErrors <<
+			" page table errors" << (identical ? "" : ", runs differ") << std::endl;
+
+		return identical && pageTableErrors == 0 ? 0 : 1;
+	}
+
+	// Numeric tool arguments have to be whole unsigned numbers that fit the
+	// type, std::stoul alone would accept "-1" or "8x"
+	template<typename T>
+	T ParseCount(const std::string& text)
+	{
+		size_t parsed = 0;
+		unsigned long long value = 0;
+		try
+		{
+			if (!text.empty() && std::isdigit(static_cast<unsigned char>(text[0])))
+				value = std::stoull(text, &parsed);
+		}
+		catch (const std::out_of_range&)
+		{
+			throw std::out_of_range("Number out of range: " + text);
+		}
+
+		if (parsed == 0 || parsed != text.size())
+			throw std::invalid_argument("Invalid number: " + text);
+
+		if (value > std::numeric_limits<T>::max())
+			throw std::out_of_range("Number out of range: " + text);
+
+		return static_cast<T>(value);
+	}
+
+	int DispatchTool(const std::string& tool,
+		std::vector<std::string>& toolArguments, std::ostream& output)
+	{
+		if (tool == "-bakemeshcache")
+		{
+			if (toolArguments.empty())
+			{
+				output << "Usage: -bakemeshcache <mesh file> [<mesh file>...]" <<
+					std::endl;
+				return 1;
+			}
+
+			return BakeMeshCaches(toolArguments, output);
+		}
+
+		if (tool == "-baketextures")
+		{
+			MaterialMap map = ParseMaterialMap(toolArguments);
+			if (toolArguments.empty())
+			{
+				output << "Usage: -baketextures [diffuse|specular|normal] " <<
+					"<texture file> [<texture file>...]" << std::endl;
+				return 1;
+			}
+
+			return BakeTextures(toolArguments, map, output);
+		}
+
+		if (tool == "-validatebakedtextures")
+		{
+			MaterialMap map = ParseMaterialMap(toolArguments);
+			if (toolArguments.empty())
+			{
+				output << "Usage: -validatebakedtextures " <<
+					"[diffuse|specular|normal] <texture file> [<texture file>...]" <<
+					std::endl;
+				return 1;
+			}
+
+			int failures = 0;
+			for (auto& file : toolArguments)
+				failures += ValidateBakedTexture(file, map, output) ? 0 : 1;
+
+			return failures;
+		}
+
+		if (tool == "-benchmarkload")
+		{
+			if (toolArguments.empty())
+			{
+				output << "Usage: -benchmarkload <mesh file> [<max threads>]" <<
+					std::endl;
+				return 1;
+			}
+
+			unsigned int maxThreads =
+				std::max(std::thread::hardware_concurrency(), 1u);
+			if (toolArguments.size() > 1)
+			{
+				maxThreads = std::max(
+					ParseCount<unsigned int>(toolArguments[1]), 1u);
+			}
+
+			return BenchmarkLoad(toolArguments[0], maxThreads, output);
+		}
+
+		if (tool == "-vertexlayoutreport")
+		{
+			if (toolArguments.size() != 1)
+			{
+				output << "Usage: -vertexlayoutreport <mesh file>" << std::endl;
+				return 1;
+			}
+
+			return ReportVertexLayouts(toolArguments[0], output);
+		}
+
+		if (tool == "-quantizationreport")
+		{
+			if (toolArguments.size() != 1)
+			{
+				output << "Usage: -quantizationreport <mesh file>" << std::endl;
+				return 1;
+			}
+
+			return ReportQuantization(toolArguments[0], output);
+		}
+
+		if (tool == "-bitangentreport")
+		{
+			if (toolArguments.size() != 1)
+			{
+				output << "Usage: -bitangentreport <mesh file>" << std::endl;
+				return 1;
+			}
+
+			return ReportBitangents(toolArguments[0], output);
+		}
+
+		if (tool == "-indexreport")
+		{
+			if (toolArguments.size() != 1)
+			{
+				output << "Usage: -indexreport <mesh file>" << std::endl;
+				return 1;
+			}
+
+			return ReportIndices(toolArguments[0], output);
+		}
+
+		if (tool == "-meshletreport")
+		{
+			if (toolArguments.size() != 1)
+			{
+				output << "Usage: -meshletreport <mesh file>" << std::endl;
+				return 1;
+			}
+
+			return ReportMeshlets(toolArguments[0], output);
+		}
+
+		if (tool == "-vertexcachereport")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -vertexcachereport <mesh file> [cache size]" <<
+					std::endl;
+				return 1;
+			}
+
+			unsigned int cacheSize = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) :
+				VERTEX_CACHE_SIZE;
+			return ReportVertexCache(toolArguments[0], cacheSize, output);
+		}
+
+		if (tool == "-conversionbench")
+		{
+			if (toolArguments.size() > 1)
+			{
+				output << "Usage: -conversionbench [vertices]" << std::endl;
+				return 1;
+			}
+
+			size_t nrOfVertices = toolArguments.empty() ? 1000000 :
+				ParseCount<size_t>(toolArguments[0]);
+			return BenchmarkConversion(nrOfVertices, output);
+		}
+
+		if (tool == "-asyncloadreport")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -asyncloadreport <mesh file> " <<
+					"[sub meshes per frame]" << std::endl;
+				return 1;
+			}
+
+			size_t subMeshesPerFrame = toolArguments.size() > 1 ?
+				std::max<size_t>(ParseCount<size_t>(toolArguments[1]), 1) : 8;
+			return ReportAsyncLoad(toolArguments[0], subMeshesPerFrame, output);
+		}
+
+		if (tool == "-decodereport")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -decodereport <mesh file> [threads]" << std::endl;
+				return 1;
+			}
+
+			unsigned int nrOfThreads = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) : 0;
+			return ReportTextureDecodes(toolArguments[0], nrOfThreads, output);
+		}
+
+		if (tool == "-memoryreport")
+		{
+			if (toolArguments.size() != 2)
+			{
+				output << "Usage: -memoryreport <mesh file> <budget in MiB>" <<
+					std::endl;
+				return 1;
+			}
+
+			size_t budget = ParseCount<size_t>(toolArguments[1]) *
+				1024 * 1024;
+			return ReportLoadMemory(toolArguments[0], budget, output);
+		}
+
+		if (tool == "-lodreport")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -lodreport <mesh file> [levels]" << std::endl;
+				return 1;
+			}
+
+			unsigned int nrOfLevels = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) : 4;
+			return ReportLevelsOfDetail(toolArguments[0], nrOfLevels, output);
+		}
+
+		if (tool == "-bcreport")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2 ||
+				(toolArguments.size() == 2 && toolArguments[1] != "bc7"))
+			{
+				output << "Usage: -bcreport <mesh file> [bc7]" << std::endl;
+				return 1;
+			}
+
+			return ReportBlockCompression(toolArguments[0],
+				toolArguments.size() == 2, output);
+		}
+
+		if (tool == "-bcbenchmark")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -bcbenchmark <texture file> [threads]" <<
+					std::endl;
+				return 1;
+			}
+
+			unsigned int nrOfThreads = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) : 0;
+			return BenchmarkBlockCompression(toolArguments[0], nrOfThreads, output);
+		}
+
+		if (tool == "-mipcheck")
+		{
+			if (!toolArguments.empty())
+			{
+				output << "Usage: -mipcheck" << std::endl;
+				return 1;
+			}
+
+			return CheckMipGeneration(output);
+		}
+
+		if (tool == "-footprintcheck")
+		{
+			if (!toolArguments.empty())
+			{
+				output << "Usage: -footprintcheck" << std::endl;
+				return 1;
+			}
+
+			return CheckTextureFootprints(output);
+		}
+
+		if (tool == "-mipfiltercheck")
+		{
+			if (!toolArguments.empty())
+			{
+				output << "Usage: -mipfiltercheck" << std::endl;
+				return 1;
+			}
+
+			return CheckMipFiltering(output);
+		}
+
+		if (tool == "-mipbenchmark")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -mipbenchmark <texture file> [threads]" <<
+					std::endl;
+				return 1;
+			}
+
+			unsigned int nrOfThreads = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) : 0;
+			return BenchmarkMipGeneration(toolArguments[0], nrOfThreads, output);
+		}
+
+		if (tool == "-floatpackingcheck")
+		{
+			if (!toolArguments.empty())
+			{
+				output << "Usage: -floatpackingcheck" << std::endl;
+				return 1;
+			}
+
+			return CheckFloatPacking(output);
+		}
+
+		if (tool == "-hdrbenchmark")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -hdrbenchmark <hdr file> [threads]" << std::endl;
+				return 1;
+			}
+
+			unsigned int nrOfThreads = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) : 0;
+			return BenchmarkHdrTexture(toolArguments[0], nrOfThreads, output);
+		}
+
+		if (tool == "-mipstagingreport")
+		{
+			MaterialMap map = ParseMaterialMap(toolArguments);
+			if (toolArguments.empty() || toolArguments.size() > 2)
+			{
+				output << "Usage: -mipstagingreport [diffuse|specular|normal] " <<
+					"<texture file> [threads]" << std::endl;
+				return 1;
+			}
+
+			unsigned int nrOfThreads = toolArguments.size() > 1 ?
+				ParseCount<unsigned int>(toolArguments[1]) : 0;
+			return ReportMipStaging(toolArguments[0], map, nrOfThreads, output);
+		}
+
+		if (tool == "-channelreport")
+		{
+			if (toolArguments.size() != 1)
+			{
+				output << "Usage: -channelreport <mesh file>" << std::endl;
+				return 1;
+			}
+
+			return ReportMaterialMapNarrowing(toolArguments[0], output);
+		}
+
+		if (tool == "-streamingsim")
+		{
+			if (toolArguments.empty() || toolArguments.size() > 3)
+			{
+				output << "Usage: -streamingsim <mesh file> [camera path file] " <<
+					"[budget in MiB]" << std::endl;
+				return 1;
+			}
+
+			std::string pathFile = toolArguments.size() > 1 ? toolArguments[1] : "";
+			size_t budget = toolArguments.size() > 2 ?
+				ParseCount<size_t>(toolArguments[2]) * 1024 * 1024 :
+				TextureStreamingSettings().budgetBytes;
+			return SimulateMeshTextureStreaming(toolArguments[0], pathFile, budget,
+				output);
+		}
+
+		if (tool == "-vtsim")
+		{
+			if (toolArguments.size() > 3)
+			{
+				output << "Usage: -vtsim [frames] [pool tiles] " <<
+					"[uploads per update]" << std::endl;
+				return 1;
+			}
+
+			size_t nrOfFrames = toolArguments.empty() ? 1000 :
+				ParseCount<size_t>(toolArguments[0]);
+			VirtualTextureSettings settings;
+			if (toolArguments.size() > 1)
+				settings.poolTiles = ParseCount<unsigned int>(toolArguments[1]);
+
+			if (toolArguments.size() > 2)
+			{
+				settings.maxUploadsPerUpdate =
+					ParseCount<unsigned int>(toolArguments[2]);
+			}
+
+			return SimulateVirtualTexturing(nrOfFrames, settings, output);
+		}
+
+		output << "Unknown tool " << tool << std::endl;
+		return 1;
+	}
+}
+
+int RunTool(const std::vector<std::string>& arguments, std::ostream& output)
+{
+	const std::string& tool = arguments[1];
+	std::vector<std::string> toolArguments(arguments.begin() + 2,
+		arguments.end());
+
+	// Malformed arguments and settings the tools reject throw, which would
+	// otherwise end the process without a message
+	try
+	{
+		return DispatchTool(tool, toolArguments, output);
+	}
+	catch (const std::exception& exception)
+	{
+		output << tool << " failed: " << exception.what() << std::endl;
+		return 1;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Headless bake, report and benchmark commands of the tools executable, the
+// second argument names the tool, e.g. "ModelViewerTools.exe -bakemeshcache a.gltf"
+int RunTool(const std::vector<std::string>& arguments, std::ostream& output);
\ No newline at end of file
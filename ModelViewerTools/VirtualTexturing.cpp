@@ -0,0 +1,454 @@
+#include "VirtualTexturing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "TextureFootprint.h"
+
+std::uint32_t PackTileFeedback(const TileAddress& tile)
+{
+	return static_cast<std::uint32_t>(tile.x) |
+		(static_cast<std::uint32_t>(tile.y) << 8) |
+		(static_cast<std::uint32_t>(tile.mip) << 16) |
+		(static_cast<std::uint32_t>(tile.texture) << 20);
+}
+
+TileAddress UnpackTileFeedback(std::uint32_t feedback)
+{
+	TileAddress toReturn;
+	toReturn.x = feedback & 0xFF;
+	toReturn.y = (feedback >> 8) & 0xFF;
+	toReturn.mip = (feedback >> 16) & 0xF;
+	toReturn.texture = feedback >> 20;
+	return toReturn;
+}
+
+namespace
+{
+	PageTableEntry CreatePageTableEntry(TileSlot slot, unsigned int mip)
+	{
+		return slot | (static_cast<PageTableEntry>(mip) << 24);
+	}
+}
+
+void VirtualTextureCache::LinkSlot(TileSlot slot)
+{
+	PoolSlot& toLink = slots[slot];
+	toLink.previous = INVALID_TILE_SLOT;
+	toLink.next = mostRecentlyUsed;
+	if (mostRecentlyUsed != INVALID_TILE_SLOT)
+		slots[mostRecentlyUsed].previous = slot;
+	else
+		leastRecentlyUsed = slot;
+
+	mostRecentlyUsed = slot;
+}
+
+void VirtualTextureCache::UnlinkSlot(TileSlot slot)
+{
+	PoolSlot& toUnlink = slots[slot];
+	if (toUnlink.previous != INVALID_TILE_SLOT)
+		slots[toUnlink.previous].next = toUnlink.next;
+	else
+		mostRecentlyUsed = toUnlink.next;
+
+	if (toUnlink.next != INVALID_TILE_SLOT)
+		slots[toUnlink.next].previous = toUnlink.previous;
+	else
+		leastRecentlyUsed = toUnlink.previous;
+
+	toUnlink.previous = INVALID_TILE_SLOT;
+	toUnlink.next = INVALID_TILE_SLOT;
+}
+
+void VirtualTextureCache::TouchSlot(TileSlot slot)
+{
+	slots[slot].lastUsedUpdate = statistics.nrOfUpdates;
+	if (slots[slot].pinned || slot == mostRecentlyUsed)
+		return;
+
+	UnlinkSlot(slot);
+	LinkSlot(slot);
+}
+
+void VirtualTextureCache::SetPageTableEntries(const TileAddress& tile,
+	TileSlot oldSlot, PageTableEntry newEntry)
+{
+	VirtualTexture& texture = textures[tile.texture];
+
+	// The last tile of a row or column also covers the children left over
+	// when a level has an odd number of texels
+	unsigned int beginX = tile.x;
+	unsigned int endX = tile.x + 1;
+	unsigned int beginY = tile.y;
+	unsigned int endY = tile.y + 1;
+	for (unsigned int mip = tile.mip + 1; mip-- > 0;)
+	{
+		for (unsigned int y = beginY; y < endY; ++y)
+		{
+			PageTableEntry* row = texture.pageTable.data() +
+				texture.levelOffsets[mip] + y * texture.levelTilesX[mip];
+			for (unsigned int x = beginX; x < endX; ++x)
+			{
+				bool replace = oldSlot != INVALID_TILE_SLOT ?
+					GetPageTableSlot(row[x]) == oldSlot :
+					GetPageTableMip(row[x]) > tile.mip;
+				if (replace)
+					row[x] = newEntry;
+			}
+		}
+
+		if (mip == 0)
+			break;
+
+		unsigned int childTilesX = texture.levelTilesX[mip - 1];
+		unsigned int childTilesY = texture.levelTilesY[mip - 1];
+		beginX = std::min(beginX * 2, childTilesX);
+		beginY = std::min(beginY * 2, childTilesY);
+		endX = endX == texture.levelTilesX[mip] ? childTilesX :
+			std::min(endX * 2, childTilesX);
+		endY = endY == texture.levelTilesY[mip] ? childTilesY :
+			std::min(endY * 2, childTilesY);
+	}
+}
+
+TileSlot VirtualTextureCache::AllocateSlot()
+{
+	if (!freeSlots.empty())
+	{
+		TileSlot toReturn = freeSlots.back();
+		freeSlots.pop_back();
+		return toReturn;
+	}
+
+	// Tiles the current feedback sampled are still on screen
+	TileSlot toReturn = leastRecentlyUsed;
+	if (toReturn == INVALID_TILE_SLOT ||
+		slots[toReturn].lastUsedUpdate == statistics.nrOfUpdates)
+	{
+		return INVALID_TILE_SLOT;
+	}
+
+	EvictSlot(toReturn);
+	return toReturn;
+}
+
+void VirtualTextureCache::EvictSlot(TileSlot slot)
+{
+	const TileAddress& tile = slots[slot].tile;
+	const VirtualTexture& texture = textures[tile.texture];
+	TileAddress parent = tile;
+	parent.mip = tile.mip + 1;
+	parent.x = std::min(tile.x / 2, texture.levelTilesX[parent.mip] - 1);
+	parent.y = std::min(tile.y / 2, texture.levelTilesY[parent.mip] - 1);
+	SetPageTableEntries(tile, slot, GetPageTableEntry(parent));
+
+	UnlinkSlot(slot);
+	slots[slot].resident = false;
+	++statistics.tilesEvicted;
+	--statistics.residentTiles;
+}
+
+TileUpload VirtualTextureCache::LoadTile(const TileAddress& tile,
+	TileSlot slot)
+{
+	PoolSlot& toLoad = slots[slot];
+	toLoad.tile = tile;
+	toLoad.lastUsedUpdate = statistics.nrOfUpdates;
+	toLoad.resident = true;
+	toLoad.pinned = false;
+	LinkSlot(slot);
+	SetPageTableEntries(tile, INVALID_TILE_SLOT,
+		CreatePageTableEntry(slot, tile.mip));
+
+	++statistics.tilesUploaded;
+	statistics.uploadedBytes += tileBytes;
+	++statistics.residentTiles;
+	statistics.peakResidentTiles = std::max(statistics.peakResidentTiles,
+		statistics.residentTiles);
+
+	TileUpload toReturn;
+	toReturn.tile = tile;
+	toReturn.slot = slot;
+	toReturn.location = GetPoolLocation(slot);
+	return toReturn;
+}
+
+bool VirtualTextureCache::IsValidTile(const TileAddress& tile) const
+{
+	if (tile.texture >= textures.size() || !textures[tile.texture].active)
+		return false;
+
+	const VirtualTexture& texture = textures[tile.texture];
+	return tile.mip < texture.levelTilesX.size() &&
+		tile.x < texture.levelTilesX[tile.mip] &&
+		tile.y < texture.levelTilesY[tile.mip];
+}
+
+VirtualTextureCache::VirtualTextureCache(
+	const VirtualTextureSettings& settingsToUse) : settings(settingsToUse)
+{
+	if (settings.tileSize == 0 || settings.poolTiles == 0 ||
+		settings.poolTiles >= 0xFFFFFF || settings.tilesPerPoolTexture == 0 ||
+		settings.tilesPerPoolTexture > 256)
+	{
+		throw std::runtime_error("Invalid virtual texture pool settings");
+	}
+
+	unsigned int layerSize = settings.tileSize + 2 * settings.tileBorder;
+	tileBytes = static_cast<size_t>(GetTextureFootprint(layerSize, layerSize,
+		settings.format, 1).totalBytes);
+
+	// Slots are handed out lowest first
+	slots.resize(settings.poolTiles);
+	freeSlots.reserve(settings.poolTiles);
+	for (TileSlot slot = settings.poolTiles; slot-- > 0;)
+		freeSlots.push_back(slot);
+}
+
+VirtualTextureIndex VirtualTextureCache::AddTexture(unsigned int width,
+	unsigned int height)
+{
+	VirtualTexture toAdd;
+	toAdd.width = width;
+	toAdd.height = height;
+	unsigned int levelWidth = std::max(width, 1u);
+	unsigned int levelHeight = std::max(height, 1u);
+	while (true)
+	{
+		toAdd.levelOffsets.push_back(toAdd.pageTable.size());
+		unsigned int tilesX = (levelWidth + settings.tileSize - 1) /
+			settings.tileSize;
+		unsigned int tilesY = (levelHeight + settings.tileSize - 1) /
+			settings.tileSize;
+		if (tilesX > MAX_TILES_PER_DIMENSION || tilesY > MAX_TILES_PER_DIMENSION)
+			throw std::runtime_error("Virtual texture has too many tiles");
+
+		toAdd.levelTilesX.push_back(tilesX);
+		toAdd.levelTilesY.push_back(tilesY);
+		toAdd.pageTable.resize(toAdd.pageTable.size() +
+			static_cast<size_t>(tilesX) * tilesY);
+		if (tilesX == 1 && tilesY == 1)
+			break;
+
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	toAdd.levelOffsets.push_back(toAdd.pageTable.size());
+	unsigned int coarsestMip =
+		static_cast<unsigned int>(toAdd.levelTilesX.size() - 1);
+	if (coarsestMip >= MAX_VIRTUAL_MIP_LEVELS)
+		throw std::runtime_error("Virtual texture has too many mip levels");
+
+	VirtualTextureIndex toReturn = textures.size();
+	if (!freeIndices.empty())
+		toReturn = freeIndices.back();
+	else if (toReturn >= MAX_VIRTUAL_TEXTURES)
+		throw std::runtime_error("Too many virtual textures");
+
+	TileSlot slot = AllocateSlot();
+	if (slot == INVALID_TILE_SLOT)
+		return VirtualTextureIndex(-1);
+
+	toAdd.active = true;
+	std::fill(toAdd.pageTable.begin(), toAdd.pageTable.end(),
+		CreatePageTableEntry(slot, coarsestMip));
+
+	if (toReturn == textures.size())
+		textures.push_back(std::move(toAdd));
+	else
+	{
+		freeIndices.pop_back();
+		textures[toReturn] = std::move(toAdd);
+	}
+
+	PoolSlot& pinned = slots[slot];
+	pinned.tile.texture = toReturn;
+	pinned.tile.mip = coarsestMip;
+	pinned.tile.x = 0;
+	pinned.tile.y = 0;
+	pinned.lastUsedUpdate = statistics.nrOfUpdates;
+	pinned.resident = true;
+	pinned.pinned = true;
+
+	TileUpload upload;
+	upload.tile = pinned.tile;
+	upload.slot = slot;
+	upload.location = GetPoolLocation(slot);
+	pendingUploads.push_back(upload);
+
+	++statistics.tilesUploaded;
+	statistics.uploadedBytes += tileBytes;
+	++statistics.residentTiles;
+	statistics.peakResidentTiles = std::max(statistics.peakResidentTiles,
+		statistics.residentTiles);
+
+	return toReturn;
+}
+
+void VirtualTextureCache::RemoveTexture(VirtualTextureIndex index)
+{
+	for (TileSlot slot = 0; slot < slots.size(); ++slot)
+	{
+		PoolSlot& toCheck = slots[slot];
+		if (!toCheck.resident || toCheck.tile.texture != index)
+			continue;
+
+		if (!toCheck.pinned)
+			UnlinkSlot(slot);
+
+		toCheck = PoolSlot();
+		freeSlots.push_back(slot);
+		--statistics.residentTiles;
+	}
+
+	pendingUploads.erase(std::remove_if(pendingUploads.begin(),
+		pendingUploads.end(), [index](const TileUpload& upload)
+		{
+			return upload.tile.texture == index;
+		}), pendingUploads.end());
+
+	textures[index] = VirtualTexture();
+	freeIndices.push_back(index);
+}
+
+void VirtualTextureCache::ProcessFeedback(const std::uint32_t* feedback,
+	size_t nrOfEntries, std::vector<TileUpload>& toFill)
+{
+	++statistics.nrOfUpdates;
+	toFill = pendingUploads;
+	pendingUploads.clear();
+
+	// Sorting groups the entries of each tile and keeps updates deterministic,
+	// empty entries sort last
+	sortedFeedback.assign(feedback, feedback + nrOfEntries);
+	std::sort(sortedFeedback.begin(), sortedFeedback.end());
+
+	requests.clear();
+	for (size_t first = 0; first < sortedFeedback.size();)
+	{
+		std::uint32_t value = sortedFeedback[first];
+		if (value == EMPTY_TILE_FEEDBACK)
+			break;
+
+		size_t last = first + 1;
+		while (last < sortedFeedback.size() && sortedFeedback[last] == value)
+			++last;
+
+		size_t count = last - first;
+		first = last;
+		TileAddress tile = UnpackTileFeedback(value);
+		if (!IsValidTile(tile))
+			continue;
+
+		statistics.feedbackEntries += count;
+		++statistics.tileRequests;
+
+		// The fallback of a missing tile was sampled in its place
+		PageTableEntry entry = GetPageTableEntry(tile);
+		TouchSlot(GetPageTableSlot(entry));
+		if (GetPageTableMip(entry) == tile.mip)
+		{
+			++statistics.tileHits;
+			statistics.feedbackHits += count;
+			continue;
+		}
+
+		TileRequest request;
+		request.feedback = value;
+		request.nrOfEntries = count;
+		request.missingMips = GetPageTableMip(entry) - tile.mip;
+		requests.push_back(request);
+	}
+
+	std::sort(requests.begin(), requests.end(),
+		[](const TileRequest& first, const TileRequest& second)
+		{
+			if (first.missingMips != second.missingMips)
+				return first.missingMips > second.missingMips;
+			if (first.nrOfEntries != second.nrOfEntries)
+				return first.nrOfEntries > second.nrOfEntries;
+			return first.feedback < second.feedback;
+		});
+
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		TileSlot slot = i < settings.maxUploadsPerUpdate ? AllocateSlot() :
+			INVALID_TILE_SLOT;
+		if (slot == INVALID_TILE_SLOT)
+		{
+			statistics.tilesDeferred += requests.size() - i;
+			break;
+		}
+
+		toFill.push_back(LoadTile(UnpackTileFeedback(requests[i].feedback),
+			slot));
+	}
+}
+
+unsigned int VirtualTextureCache::GetNrOfMipLevels(
+	VirtualTextureIndex index) const
+{
+	return static_cast<unsigned int>(textures[index].levelTilesX.size());
+}
+
+unsigned int VirtualTextureCache::GetNrOfTilesX(VirtualTextureIndex index,
+	unsigned int mip) const
+{
+	return textures[index].levelTilesX[mip];
+}
+
+unsigned int VirtualTextureCache::GetNrOfTilesY(VirtualTextureIndex index,
+	unsigned int mip) const
+{
+	return textures[index].levelTilesY[mip];
+}
+
+const std::vector<PageTableEntry>& VirtualTextureCache::GetPageTable(
+	VirtualTextureIndex index) const
+{
+	return textures[index].pageTable;
+}
+
+PageTableEntry VirtualTextureCache::GetPageTableEntry(
+	const TileAddress& tile) const
+{
+	const VirtualTexture& texture = textures[tile.texture];
+	return texture.pageTable[texture.levelOffsets[tile.mip] +
+		tile.y * texture.levelTilesX[tile.mip] + tile.x];
+}
+
+const TileAddress& VirtualTextureCache::GetSlotTile(TileSlot slot) const
+{
+	return slots[slot].tile;
+}
+
+TilePoolLocation VirtualTextureCache::GetPoolLocation(TileSlot slot) const
+{
+	TilePoolLocation toReturn;
+	toReturn.poolTexture = slot / settings.tilesPerPoolTexture;
+	toReturn.layer = slot % settings.tilesPerPoolTexture;
+	return toReturn;
+}
+
+unsigned int VirtualTextureCache::GetNrOfPoolTextures() const
+{
+	return (settings.poolTiles + settings.tilesPerPoolTexture - 1) /
+		settings.tilesPerPoolTexture;
+}
+
+size_t VirtualTextureCache::GetTileBytes() const
+{
+	return tileBytes;
+}
+
+const VirtualTextureSettings& VirtualTextureCache::GetSettings() const
+{
+	return settings;
+}
+
+const VirtualTextureStatistics& VirtualTextureCache::GetStatistics() const
+{
+	return statistics;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <Windows.h>
+#include <dxgiformat.h>
+
+typedef size_t VirtualTextureIndex;
+typedef std::uint32_t TileSlot;
+
+static const TileSlot INVALID_TILE_SLOT = TileSlot(-1);
+
+// Feedback entries pack the tile a pixel sampled into 32 bits, with tile x in
+// bits 0-7, tile y in bits 8-15, the mip in bits 16-19 and the texture in bits
+// 20-31. Pixels that sampled no virtual texture write EMPTY_TILE_FEEDBACK.
+static const std::uint32_t EMPTY_TILE_FEEDBACK = 0xFFFFFFFF;
+static const unsigned int MAX_VIRTUAL_TEXTURES = 4095;
+static const unsigned int MAX_VIRTUAL_MIP_LEVELS = 16;
+static const unsigned int MAX_TILES_PER_DIMENSION = 256;
+
+struct TileAddress
+{
+	VirtualTextureIndex texture = 0;
+	unsigned int mip = 0;
+	unsigned int x = 0;
+	unsigned int y = 0;
+};
+
+std::uint32_t PackTileFeedback(const TileAddress& tile);
+TileAddress UnpackTileFeedback(std::uint32_t feedback);
+
+// Page table entries hold the pool slot of the tile to sample in bits 0-23
+// and the mip of that tile in bits 24-31. A tile that is not resident points
+// at its closest resident ancestor, and the coarsest tile of every texture
+// stays resident, so every entry is valid.
+typedef std::uint32_t PageTableEntry;
+
+inline TileSlot GetPageTableSlot(PageTableEntry entry)
+{
+	return entry & 0xFFFFFF;
+}
+
+inline unsigned int GetPageTableMip(PageTableEntry entry)
+{
+	return entry >> 24;
+}
+
+// The pool is split over textures of up to tilesPerPoolTexture array layers,
+// as SetUpdateData addresses subresources with 8 bits. Tiles are uploaded
+// with the border on every side, so one layer is tileSize + 2 * tileBorder
+// texels wide and high.
+struct VirtualTextureSettings
+{
+	unsigned int tileSize = 128;
+	unsigned int tileBorder = 4;
+	unsigned int poolTiles = 1024;
+	unsigned int tilesPerPoolTexture = 256;
+	unsigned int maxUploadsPerUpdate = 32;
+	DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+};
+
+struct TilePoolLocation
+{
+	unsigned int poolTexture = 0;
+	unsigned int layer = 0;
+};
+
+// A tile to copy into the pool, the page table already points at it
+struct TileUpload
+{
+	TileAddress tile;
+	TileSlot slot = INVALID_TILE_SLOT;
+	TilePoolLocation location;
+};
+
+// Cumulative over every update. Requests are the distinct tiles of the
+// feedback, and hits those that were resident when it was written. Feedback
+// hits weight the same by the number of entries that sampled each tile.
+// Deferred tiles were missing but not loaded, because of the upload limit
+// or because every tile in the pool was used by the same feedback.
+struct VirtualTextureStatistics
+{
+	size_t nrOfUpdates = 0;
+	size_t feedbackEntries = 0;
+	size_t feedbackHits = 0;
+	size_t tileRequests = 0;
+	size_t tileHits = 0;
+	size_t tilesUploaded = 0;
+	size_t uploadedBytes = 0;
+	size_t tilesEvicted = 0;
+	size_t tilesDeferred = 0;
+	size_t residentTiles = 0;
+	size_t peakResidentTiles = 0;
+};
+
+// CPU side of virtual texturing only, without a device. The viewer has no
+// pool components or page table lookup in its shaders, so this is only run by
+// the -vtsim simulation of the tools. Textures are split into tiles of every
+// mip that share one fixed size pool, so textures of any size are placed
+// without fragmenting a heap. Each update parses the feedback of a frame,
+// refreshes the tiles it sampled in a least recently used order and loads the
+// missing ones, those falling back the most levels first. Tiles are only
+// evicted if the feedback being processed did not sample them.
+class VirtualTextureCache
+{
+private:
+	struct VirtualTexture
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::vector<unsigned int> levelTilesX;
+		std::vector<unsigned int> levelTilesY;
+		std::vector<size_t> levelOffsets; // Into the page table, one extra
+		std::vector<PageTableEntry> pageTable;
+		bool active = false;
+	};
+
+	// The least recently used list runs from the most recently used slot
+	// through next, pinned and free slots are not in it
+	struct PoolSlot
+	{
+		TileAddress tile;
+		TileSlot previous = INVALID_TILE_SLOT;
+		TileSlot next = INVALID_TILE_SLOT;
+		size_t lastUsedUpdate = 0;
+		bool resident = false;
+		bool pinned = false;
+	};
+
+	struct TileRequest
+	{
+		std::uint32_t feedback = EMPTY_TILE_FEEDBACK;
+		size_t nrOfEntries = 0;
+		unsigned int missingMips = 0;
+	};
+
+	VirtualTextureSettings settings;
+	std::vector<VirtualTexture> textures;
+	std::vector<VirtualTextureIndex> freeIndices;
+	std::vector<PoolSlot> slots;
+	std::vector<TileSlot> freeSlots;
+	TileSlot mostRecentlyUsed = INVALID_TILE_SLOT;
+	TileSlot leastRecentlyUsed = INVALID_TILE_SLOT;
+	std::vector<TileUpload> pendingUploads;
+	std::vector<std::uint32_t> sortedFeedback;
+	std::vector<TileRequest> requests;
+	size_t tileBytes = 0;
+	VirtualTextureStatistics statistics;
+
+	void LinkSlot(TileSlot slot);
+	void UnlinkSlot(TileSlot slot);
+	void TouchSlot(TileSlot slot);
+
+	// Points every entry of the tile and its descendants that currently
+	// falls back to oldSlot, or to a coarser tile than the new one if oldSlot
+	// is invalid, at newEntry
+	void SetPageTableEntries(const TileAddress& tile, TileSlot oldSlot,
+		PageTableEntry newEntry);
+	TileSlot AllocateSlot();
+	void EvictSlot(TileSlot slot);
+	TileUpload LoadTile(const TileAddress& tile, TileSlot slot);
+	bool IsValidTile(const TileAddress& tile) const;
+
+public:
+	// Throws for settings the pool can not be laid out with
+	VirtualTextureCache(const VirtualTextureSettings& settingsToUse);
+
+	// The coarsest tile, which holds the whole texture, is loaded right away
+	// and returned with the uploads of the next update. Returns
+	// VirtualTextureIndex(-1) if the pool has no slot for it. Throws for
+	// textures with more tiles or levels than the feedback can address.
+	VirtualTextureIndex AddTexture(unsigned int width, unsigned int height);
+	void RemoveTexture(VirtualTextureIndex index);
+
+	// Fills toFill with the tiles to copy into the pool before the page
+	// tables are used again. Entries of removed textures or outside their
+	// tiles are ignored.
+	void ProcessFeedback(const std::uint32_t* feedback, size_t nrOfEntries,
+		std::vector<TileUpload>& toFill);
+
+	unsigned int GetNrOfMipLevels(VirtualTextureIndex index) const;
+	unsigned int GetNrOfTilesX(VirtualTextureIndex index, unsigned int mip) const;
+	unsigned int GetNrOfTilesY(VirtualTextureIndex index, unsigned int mip) const;
+
+	// Every mip of the page table of a texture, the most detailed first with
+	// rows of GetNrOfTilesX entries
+	const std::vector<PageTableEntry>& GetPageTable(
+		VirtualTextureIndex index) const;
+	PageTableEntry GetPageTableEntry(const TileAddress& tile) const;
+
+	// The tile a resident slot holds
+	const TileAddress& GetSlotTile(TileSlot slot) const;
+	TilePoolLocation GetPoolLocation(TileSlot slot) const;
+	unsigned int GetNrOfPoolTextures() const;
+
+	// Bytes of one tile with its border, as uploaded
+	size_t GetTileBytes() const;
+	const VirtualTextureSettings& GetSettings() const;
+	const VirtualTextureStatistics& GetStatistics() const;
+};